@@ -28,3 +28,21 @@ add_md(struct memory_descriptor *md)
 
     return MEMORY_MANAGER_SUCCESS;
 }
+
+extern "C" int64_t
+add_mdl(struct memory_descriptor *mdl, int64_t num)
+{
+    (void) mdl;
+    (void) num;
+
+    return MEMORY_MANAGER_SUCCESS;
+}
+
+extern "C" int64_t
+add_pool(struct memory_descriptor *mdl, int64_t num)
+{
+    (void) mdl;
+    (void) num;
+
+    return MEMORY_MANAGER_SUCCESS;
+}
@@ -19,7 +19,9 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <memory.h>
 #include <debug_ring_interface.h>
+#include <exit_stats_interface.h>
 
 extern "C" int64_t
 get_drr(uint64_t vcpuid, struct debug_ring_resources_t **drr)
@@ -29,3 +31,28 @@ get_drr(uint64_t vcpuid, struct debug_ring_resources_t **drr)
 
     return GET_DRR_SUCCESS;
 }
+
+extern "C" int64_t
+get_memory_stats(struct memory_stats *stats)
+{
+    (void) stats;
+
+    return MEMORY_MANAGER_SUCCESS;
+}
+
+extern "C" int64_t
+get_dirty_bitmap(struct dirty_bitmap *bitmap)
+{
+    (void) bitmap;
+
+    return MEMORY_MANAGER_SUCCESS;
+}
+
+extern "C" int64_t
+get_exit_stats(uint64_t vcpuid, struct exit_stats *stats)
+{
+    (void) vcpuid;
+    (void) stats;
+
+    return GET_EXIT_STATS_SUCCESS;
+}
@@ -26,6 +26,8 @@
 #include <types.h>
 #include <error_codes.h>
 #include <bfelf_loader.h>
+#include <memory.h>
+#include <exit_stats_interface.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -183,6 +185,53 @@ common_stop_vmm(void);
 int64_t
 common_dump_vmm(struct debug_ring_resources_t **drr, uint64_t vcpuid);
 
+/**
+ * Memory Stats
+ *
+ * This gets the VMM's memory statistics (how much of the heap and page
+ * pools are in use, the high-water marks, the largest free fragments, etc).
+ * Like dump, the VMM must at least be loaded for this function to work as
+ * it has to do a symbol lookup. The VMM reads it's statistics without
+ * taking any locks, so this can be called while the VMM is running.
+ *
+ * @param stats a pointer to the memory stats to fill in
+ * @return BF_SUCCESS on success, negative error code on failure
+ */
+int64_t
+common_memory_stats(struct memory_stats *stats);
+
+/**
+ * Dirty Bitmap
+ *
+ * This harvests the next window of the VMM's dirty bitmap (which parts of
+ * memory have been written to since they were last harvested). Unlike
+ * memory stats, the VMM must be running for this function to work, as
+ * the dirty flags are kept in the EPT, which is only set up once the VMM
+ * is started.
+ *
+ * @param bitmap a pointer to the dirty bitmap to fill in
+ * @return BF_SUCCESS on success, negative error code on failure
+ */
+int64_t
+common_dirty_bitmap(struct dirty_bitmap *bitmap);
+
+/**
+ * Exit Stats
+ *
+ * This gets a vCPU's exit statistics (how many of each type of VM exit the
+ * vCPU has taken, and how long the VMM took to handle them). Like dump,
+ * the VMM must at least be loaded for this function to work, and the
+ * statistics of a vCPU are kept once the VMM is stopped. The VMM reads the
+ * statistics without taking any of the vCPU's locks, so this can be called
+ * while the VMM is running.
+ *
+ * @param stats a pointer to the exit stats to fill in
+ * @param vcpuid indicates which vCPU to get the exit stats of
+ * @return BF_SUCCESS on success, negative error code on failure
+ */
+int64_t
+common_exit_stats(struct exit_stats *stats, uint64_t vcpuid);
+
 #ifdef __cplusplus
 }
 #endif
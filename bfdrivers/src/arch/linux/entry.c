@@ -277,6 +277,101 @@ ioctl_dump_vmm(struct debug_ring_resources_t *user_drr)
     return BF_IOCTL_SUCCESS;
 }
 
+static long
+ioctl_mem_stats(struct memory_stats *user_stats)
+{
+    int64_t ret;
+    struct memory_stats stats;
+
+    ret = common_memory_stats(&stats);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_MEM_STATS: common_memory_stats failed: %p - %s\n", \
+              (void *)ret, ec_to_str(ret));
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = copy_to_user(user_stats, &stats, sizeof(struct memory_stats));
+    if (ret != 0)
+    {
+        ALERT("IOCTL_MEM_STATS: failed to copy memory from userspace\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_MEM_STATS: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
+static long
+ioctl_dirty_bitmap(struct dirty_bitmap *user_bitmap)
+{
+    int64_t ret;
+    struct dirty_bitmap *bitmap;
+
+    bitmap = platform_alloc_rw(sizeof(struct dirty_bitmap));
+    if (bitmap == 0)
+    {
+        ALERT("IOCTL_DIRTY_BITMAP: failed to allocate the dirty bitmap\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = common_dirty_bitmap(bitmap);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_DIRTY_BITMAP: common_dirty_bitmap failed: %p - %s\n", \
+              (void *)ret, ec_to_str(ret));
+        platform_free_rw(bitmap, sizeof(struct dirty_bitmap));
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = copy_to_user(user_bitmap, bitmap, sizeof(struct dirty_bitmap));
+    platform_free_rw(bitmap, sizeof(struct dirty_bitmap));
+
+    if (ret != 0)
+    {
+        ALERT("IOCTL_DIRTY_BITMAP: failed to copy memory from userspace\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_DIRTY_BITMAP: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
+static long
+ioctl_exit_stats(struct exit_stats *user_stats)
+{
+    int64_t ret;
+    struct exit_stats *stats;
+
+    stats = platform_alloc_rw(sizeof(struct exit_stats));
+    if (stats == 0)
+    {
+        ALERT("IOCTL_EXIT_STATS: failed to allocate the exit stats\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = common_exit_stats(stats, g_vcpuid);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_EXIT_STATS: common_exit_stats failed: %p - %s\n", \
+              (void *)ret, ec_to_str(ret));
+        platform_free_rw(stats, sizeof(struct exit_stats));
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = copy_to_user(user_stats, stats, sizeof(struct exit_stats));
+    platform_free_rw(stats, sizeof(struct exit_stats));
+
+    if (ret != 0)
+    {
+        ALERT("IOCTL_EXIT_STATS: failed to copy memory from userspace\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_EXIT_STATS: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
 static long
 ioctl_vmm_status(int64_t *status)
 {
@@ -358,6 +453,15 @@ dev_unlocked_ioctl(struct file *file,
         case IOCTL_SET_VCPUID:
             return ioctl_set_vcpuid((uint64_t *)arg);
 
+        case IOCTL_MEM_STATS:
+            return ioctl_mem_stats((struct memory_stats *)arg);
+
+        case IOCTL_DIRTY_BITMAP:
+            return ioctl_dirty_bitmap((struct dirty_bitmap *)arg);
+
+        case IOCTL_EXIT_STATS:
+            return ioctl_exit_stats((struct exit_stats *)arg);
+
         default:
             return -EINVAL;
     }
@@ -276,6 +276,57 @@ ioctl_dump_vmm(struct debug_ring_resources_t *user_drr)
     return BF_IOCTL_SUCCESS;
 }
 
+static long
+ioctl_mem_stats(struct memory_stats *stats)
+{
+    int64_t ret;
+
+    ret = common_memory_stats(stats);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_MEM_STATS: failed to get memory stats: %lld\n", ret);
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_MEM_STATS: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
+static long
+ioctl_dirty_bitmap(struct dirty_bitmap *bitmap)
+{
+    int64_t ret;
+
+    ret = common_dirty_bitmap(bitmap);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_DIRTY_BITMAP: failed to get dirty bitmap: %lld\n", ret);
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_DIRTY_BITMAP: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
+static long
+ioctl_exit_stats(struct exit_stats *stats)
+{
+    int64_t ret;
+
+    // The OSX driver entry does not support IOCTL_SET_VCPUID yet, so only
+    // the statistics of the first vCPU can be read.
+
+    ret = common_exit_stats(stats, 0);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_EXIT_STATS: failed to get exit stats: %lld\n", ret);
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_EXIT_STATS: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
 static long
 ioctl_vmm_status(int64_t *status)
 {
@@ -329,6 +380,17 @@ IOReturn org_bareflank_osx::methodCommand(bf_ioctl_t *in_ioctl, bf_ioctl_t *out_
         case IOCTL_VMM_STATUS:
             rc = ioctl_vmm_status((int64_t *)in_ioctl->addr);
             break;
+        case IOCTL_MEM_STATS:
+            rc = ioctl_mem_stats((struct memory_stats *)in_ioctl->addr);
+            break;
+
+        case IOCTL_DIRTY_BITMAP:
+            rc = ioctl_dirty_bitmap((struct dirty_bitmap *)in_ioctl->addr);
+            break;
+
+        case IOCTL_EXIT_STATS:
+            rc = ioctl_exit_stats((struct exit_stats *)in_ioctl->addr);
+            break;
         default:
             return (IOReturn) - EINVAL;
     }
@@ -198,6 +198,78 @@ ioctl_dump_vmm(struct debug_ring_resources_t *user_drr)
     return BF_IOCTL_SUCCESS;
 }
 
+static int64_t
+ioctl_mem_stats(struct memory_stats *user_stats, size_t size)
+{
+    int64_t ret;
+    struct memory_stats stats;
+
+    if (user_stats == 0 || size < sizeof(struct memory_stats))
+    {
+        ALERT("IOCTL_MEM_STATS: invalid output buffer\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = common_memory_stats(&stats);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_MEM_STATS: common_memory_stats failed: %p - %s\n",
+              (void *)ret, ec_to_str(ret));
+        return BF_IOCTL_FAILURE;
+    }
+
+    platform_memcpy(user_stats, &stats, sizeof(struct memory_stats));
+
+    DEBUG("IOCTL_MEM_STATS: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
+static int64_t
+ioctl_dirty_bitmap(struct dirty_bitmap *user_bitmap, size_t size)
+{
+    int64_t ret;
+
+    if (user_bitmap == 0 || size < sizeof(struct dirty_bitmap))
+    {
+        ALERT("IOCTL_DIRTY_BITMAP: invalid output buffer\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = common_dirty_bitmap(user_bitmap);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_DIRTY_BITMAP: common_dirty_bitmap failed: %p - %s\n",
+              (void *)ret, ec_to_str(ret));
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_DIRTY_BITMAP: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
+static int64_t
+ioctl_exit_stats(struct exit_stats *user_stats, size_t size)
+{
+    int64_t ret;
+
+    if (user_stats == 0 || size < sizeof(struct exit_stats))
+    {
+        ALERT("IOCTL_EXIT_STATS: invalid output buffer\n");
+        return BF_IOCTL_FAILURE;
+    }
+
+    ret = common_exit_stats(user_stats, g_vcpuid);
+    if (ret != BF_SUCCESS)
+    {
+        ALERT("IOCTL_EXIT_STATS: common_exit_stats failed: %p - %s\n",
+              (void *)ret, ec_to_str(ret));
+        return BF_IOCTL_FAILURE;
+    }
+
+    DEBUG("IOCTL_EXIT_STATS: succeeded\n");
+    return BF_IOCTL_SUCCESS;
+}
+
 static int64_t
 ioctl_vmm_status(int64_t *status)
 {
@@ -330,6 +402,18 @@ bareflankEvtIoDeviceControl(
             ret = ioctl_set_vcpuid((uint64_t *)in);
             break;
 
+        case IOCTL_MEM_STATS:
+            ret = ioctl_mem_stats((struct memory_stats *)out, out_size);
+            break;
+
+        case IOCTL_DIRTY_BITMAP:
+            ret = ioctl_dirty_bitmap((struct dirty_bitmap *)out, out_size);
+            break;
+
+        case IOCTL_EXIT_STATS:
+            ret = ioctl_exit_stats((struct exit_stats *)out, out_size);
+            break;
+
         default:
             goto FAILURE;
     }
@@ -40,6 +40,9 @@ struct module_t g_modules[MAX_NUM_MODULES];
 
 struct bfelf_loader_t g_loader;
 
+uint64_t g_num_pools = 0;
+char *g_pools[MAX_NUM_POOLS];
+
 int64_t g_num_cpus_started = 0;
 
 void *g_stack = 0;
@@ -142,7 +145,10 @@ int64_t
 add_md_to_memory_manager(struct module_t *module)
 {
     int64_t ret = 0;
+    int64_t num = 0;
+    int64_t size = 0;
     bfelf64_word s = 0;
+    struct memory_descriptor *mdl = 0;
 
     if (module == 0)
         return BF_ERROR_INVALID_ARG;
@@ -162,24 +168,97 @@ add_md_to_memory_manager(struct module_t *module)
         exec_s &= ~(MAX_PAGE_SIZE - 1);
         exec_e &= ~(MAX_PAGE_SIZE - 1);
 
-        for (; exec_s <= exec_e; exec_s += MAX_PAGE_SIZE)
-        {
-            struct memory_descriptor md;
+        num += (int64_t)((exec_e - exec_s) >> MAX_PAGE_SHIFT) + 1;
+    }
+
+    if (num == 0)
+        return BF_SUCCESS;
+
+    size = num * (int64_t)sizeof(struct memory_descriptor);
+
+    mdl = (struct memory_descriptor *)platform_alloc_rw(size);
+    if (mdl == 0)
+        return BF_ERROR_OUT_OF_MEMORY;
+
+    num = 0;
 
-            md.virt = exec_s;
-            md.phys = (uint64_t)platform_virt_to_phys((void *)md.virt);
+    for (s = 0; s < bfelf_file_num_segments(&module->file); s++)
+    {
+        uint64_t exec_s = 0;
+        uint64_t exec_e = 0;
+        struct bfelf_phdr *phdr = 0;
+
+        ret = bfelf_file_get_segment(&module->file, s, &phdr);
+        if (ret != BFELF_SUCCESS)
+            goto done;
+
+        exec_s = (uint64_t)module->exec + phdr->p_vaddr;
+        exec_e = (uint64_t)module->exec + phdr->p_vaddr + phdr->p_memsz;
+        exec_s &= ~(MAX_PAGE_SIZE - 1);
+        exec_e &= ~(MAX_PAGE_SIZE - 1);
+
+        for (; exec_s <= exec_e; exec_s += MAX_PAGE_SIZE, num++)
+        {
+            mdl[num].virt = exec_s;
+            mdl[num].phys = (uint64_t)platform_virt_to_phys((void *)exec_s);
 
             if ((phdr->p_flags & bfpf_x) != 0)
-                md.type = MEMORY_TYPE_R | MEMORY_TYPE_E;
+                mdl[num].type = MEMORY_TYPE_R | MEMORY_TYPE_E;
             else
-                md.type = MEMORY_TYPE_R | MEMORY_TYPE_W;
-
-            ret = execute_symbol("add_md", (uint64_t)&md, 0, 0);
-            if (ret != MEMORY_MANAGER_SUCCESS)
-                return ret;
+                mdl[num].type = MEMORY_TYPE_R | MEMORY_TYPE_W;
         }
     }
 
+    ret = execute_symbol("add_mdl", (uint64_t)mdl, (uint64_t)num, 0);
+
+done:
+
+    platform_free_rw(mdl, size);
+    return ret;
+}
+
+int64_t
+add_pool_to_memory_manager(void)
+{
+    int64_t i = 0;
+    int64_t ret = 0;
+    int64_t num = 0;
+    char *pool = 0;
+    struct memory_descriptor *mdl = 0;
+
+    if (g_num_pools >= MAX_NUM_POOLS)
+        return BF_ERROR_OUT_OF_MEMORY;
+
+    num = POOL_SIZE >> MAX_PAGE_SHIFT;
+
+    pool = (char *)platform_alloc_rw(POOL_SIZE);
+    if (pool == 0)
+        return BF_ERROR_OUT_OF_MEMORY;
+
+    mdl = (struct memory_descriptor *)platform_alloc_rw(num * (int64_t)sizeof(struct memory_descriptor));
+    if (mdl == 0)
+    {
+        platform_free_rw(pool, POOL_SIZE);
+        return BF_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        mdl[i].virt = (uint64_t)pool + (uint64_t)(i << MAX_PAGE_SHIFT);
+        mdl[i].phys = (uint64_t)platform_virt_to_phys((void *)mdl[i].virt);
+        mdl[i].type = MEMORY_TYPE_R | MEMORY_TYPE_W;
+    }
+
+    ret = execute_symbol("add_pool", (uint64_t)mdl, (uint64_t)num, 0);
+    platform_free_rw(mdl, num * (int64_t)sizeof(struct memory_descriptor));
+
+    if (ret != BF_SUCCESS)
+    {
+        platform_free_rw(pool, POOL_SIZE);
+        return ret;
+    }
+
+    g_pools[g_num_pools++] = pool;
     return BF_SUCCESS;
 }
 
@@ -267,6 +346,12 @@ common_reset(void)
 
     platform_memset(&g_modules, 0, sizeof(g_modules));
 
+    for (i = 0; i < g_num_pools; i++)
+        platform_free_rw(g_pools[i], POOL_SIZE);
+
+    platform_memset(&g_pools, 0, sizeof(g_pools));
+    g_num_pools = 0;
+
     g_num_modules = 0;
     g_vmm_status = VMM_UNLOADED;
 
@@ -440,6 +525,19 @@ common_load_vmm(void)
             goto failure;
     }
 
+    /*
+     * Each CPU needs it's own VMM resources (VMCS, stacks, etc...), so the
+     * VMM is given a pool of memory per CPU instead of sizing the VMM's
+     * built in page pool for the largest system it might run on.
+     */
+
+    for (i = 0; i < platform_num_cpus() && i < (int64_t)MAX_NUM_POOLS; i++)
+    {
+        ret = add_pool_to_memory_manager();
+        if (ret != BF_SUCCESS)
+            goto failure;
+    }
+
     g_vmm_status = VMM_LOADED;
     return BF_SUCCESS;
 
@@ -589,3 +687,57 @@ common_dump_vmm(struct debug_ring_resources_t **drr, uint64_t vcpuid)
 
     return BF_SUCCESS;
 }
+
+int64_t
+common_memory_stats(struct memory_stats *stats)
+{
+    int64_t ret = 0;
+
+    if (stats == 0)
+        return BF_ERROR_INVALID_ARG;
+
+    if (common_vmm_status() == VMM_UNLOADED)
+        return BF_ERROR_VMM_INVALID_STATE;
+
+    ret = execute_symbol("get_memory_stats", (uint64_t)stats, 0, 0);
+    if (ret != BFELF_SUCCESS)
+        return ret;
+
+    return BF_SUCCESS;
+}
+
+int64_t
+common_dirty_bitmap(struct dirty_bitmap *bitmap)
+{
+    int64_t ret = 0;
+
+    if (bitmap == 0)
+        return BF_ERROR_INVALID_ARG;
+
+    if (common_vmm_status() != VMM_RUNNING)
+        return BF_ERROR_VMM_INVALID_STATE;
+
+    ret = execute_symbol("get_dirty_bitmap", (uint64_t)bitmap, 0, 0);
+    if (ret != BFELF_SUCCESS)
+        return ret;
+
+    return BF_SUCCESS;
+}
+
+int64_t
+common_exit_stats(struct exit_stats *stats, uint64_t vcpuid)
+{
+    int64_t ret = 0;
+
+    if (stats == 0)
+        return BF_ERROR_INVALID_ARG;
+
+    if (common_vmm_status() == VMM_UNLOADED)
+        return BF_ERROR_VMM_INVALID_STATE;
+
+    ret = execute_symbol("get_exit_stats", (uint64_t)vcpuid, (uint64_t)stats, 0);
+    if (ret != BFELF_SUCCESS)
+        return ret;
+
+    return BF_SUCCESS;
+}
@@ -55,6 +55,9 @@ SOURCES+=test_common_dump.cpp
 SOURCES+=test_common_fini.cpp
 SOURCES+=test_common_init.cpp
 SOURCES+=test_common_load.cpp
+SOURCES+=test_common_memory_stats.cpp
+SOURCES+=test_common_dirty_bitmap.cpp
+SOURCES+=test_common_exit_stats.cpp
 SOURCES+=test_common_start.cpp
 SOURCES+=test_common_stop.cpp
 SOURCES+=test_common_unload.cpp
@@ -216,6 +216,27 @@ driver_entry_ut::list()
     this->test_common_dump_get_drr_missing();
     this->test_common_dump_get_drr_failure();
 
+    this->test_common_memory_stats_invalid_stats();
+    this->test_common_memory_stats_when_unloaded();
+    this->test_common_memory_stats_when_loaded();
+    this->test_common_memory_stats_when_running();
+    this->test_common_memory_stats_get_memory_stats_missing();
+    this->test_common_memory_stats_get_memory_stats_failure();
+
+    this->test_common_dirty_bitmap_invalid_bitmap();
+    this->test_common_dirty_bitmap_when_unloaded();
+    this->test_common_dirty_bitmap_when_loaded();
+    this->test_common_dirty_bitmap_when_running();
+    this->test_common_dirty_bitmap_get_dirty_bitmap_missing();
+    this->test_common_dirty_bitmap_get_dirty_bitmap_failure();
+
+    this->test_common_exit_stats_invalid_stats();
+    this->test_common_exit_stats_when_unloaded();
+    this->test_common_exit_stats_when_loaded();
+    this->test_common_exit_stats_when_running();
+    this->test_common_exit_stats_get_exit_stats_missing();
+    this->test_common_exit_stats_get_exit_stats_failure();
+
     this->test_helper_common_vmm_status();
     this->test_helper_get_file_invalid_index();
     this->test_helper_get_file_success();
@@ -232,6 +253,10 @@ driver_entry_ut::list()
     this->test_helper_execute_symbol_sym_success();
     this->test_helper_constructors_success();
     this->test_helper_add_md_to_memory_manager_null_module();
+    this->test_helper_add_md_to_memory_manager_out_of_memory();
+    this->test_helper_add_md_to_memory_manager_success();
+    this->test_helper_add_pool_to_memory_manager_out_of_memory();
+    this->test_helper_add_pool_to_memory_manager_success();
     this->test_helper_get_elf_file_size_null_module();
     this->test_helper_get_elf_file_size_get_segment_fails();
     this->test_helper_load_elf_file_null_module();
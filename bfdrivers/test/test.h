@@ -105,6 +105,27 @@ private:
     void test_common_dump_get_drr_missing();
     void test_common_dump_get_drr_failure();
 
+    void test_common_memory_stats_invalid_stats();
+    void test_common_memory_stats_when_unloaded();
+    void test_common_memory_stats_when_loaded();
+    void test_common_memory_stats_when_running();
+    void test_common_memory_stats_get_memory_stats_missing();
+    void test_common_memory_stats_get_memory_stats_failure();
+
+    void test_common_dirty_bitmap_invalid_bitmap();
+    void test_common_dirty_bitmap_when_unloaded();
+    void test_common_dirty_bitmap_when_loaded();
+    void test_common_dirty_bitmap_when_running();
+    void test_common_dirty_bitmap_get_dirty_bitmap_missing();
+    void test_common_dirty_bitmap_get_dirty_bitmap_failure();
+
+    void test_common_exit_stats_invalid_stats();
+    void test_common_exit_stats_when_unloaded();
+    void test_common_exit_stats_when_loaded();
+    void test_common_exit_stats_when_running();
+    void test_common_exit_stats_get_exit_stats_missing();
+    void test_common_exit_stats_get_exit_stats_failure();
+
     void test_helper_common_vmm_status();
     void test_helper_get_file_invalid_index();
     void test_helper_get_file_success();
@@ -122,6 +143,10 @@ private:
     void test_helper_constructors_success();
     void test_helper_destructors_success();
     void test_helper_add_md_to_memory_manager_null_module();
+    void test_helper_add_md_to_memory_manager_out_of_memory();
+    void test_helper_add_md_to_memory_manager_success();
+    void test_helper_add_pool_to_memory_manager_out_of_memory();
+    void test_helper_add_pool_to_memory_manager_success();
     void test_helper_get_elf_file_size_null_module();
     void test_helper_get_elf_file_size_get_segment_fails();
     void test_helper_load_elf_file_null_module();
@@ -0,0 +1,110 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <test.h>
+
+#include <entry.h>
+#include <common.h>
+#include <platform.h>
+#include <driver_entry_interface.h>
+
+void
+driver_entry_ut::test_common_dirty_bitmap_invalid_bitmap()
+{
+    EXPECT_TRUE(common_dirty_bitmap(nullptr) == BF_ERROR_INVALID_ARG);
+}
+
+void
+driver_entry_ut::test_common_dirty_bitmap_when_unloaded()
+{
+    struct dirty_bitmap bitmap = {};
+
+    EXPECT_TRUE(common_add_module(m_dummy_start_vmm_success, m_dummy_start_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_stop_vmm_success, m_dummy_stop_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_add_md_success, m_dummy_add_md_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_get_drr_success, m_dummy_get_drr_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_misc, m_dummy_misc_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_dirty_bitmap(&bitmap) == BF_ERROR_VMM_INVALID_STATE);
+    EXPECT_TRUE(common_fini() == BF_SUCCESS);
+}
+
+void
+driver_entry_ut::test_common_dirty_bitmap_when_loaded()
+{
+    struct dirty_bitmap bitmap = {};
+
+    EXPECT_TRUE(common_add_module(m_dummy_start_vmm_success, m_dummy_start_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_stop_vmm_success, m_dummy_stop_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_add_md_success, m_dummy_add_md_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_get_drr_success, m_dummy_get_drr_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_misc, m_dummy_misc_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_load_vmm() == BF_SUCCESS);
+    EXPECT_TRUE(common_dirty_bitmap(&bitmap) == BF_ERROR_VMM_INVALID_STATE);
+    EXPECT_TRUE(common_fini() == BF_SUCCESS);
+}
+
+void
+driver_entry_ut::test_common_dirty_bitmap_when_running()
+{
+    struct dirty_bitmap bitmap = {};
+
+    EXPECT_TRUE(common_add_module(m_dummy_start_vmm_success, m_dummy_start_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_stop_vmm_success, m_dummy_stop_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_add_md_success, m_dummy_add_md_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_get_drr_success, m_dummy_get_drr_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_misc, m_dummy_misc_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_load_vmm() == BF_SUCCESS);
+    EXPECT_TRUE(common_start_vmm() == BF_SUCCESS);
+    EXPECT_TRUE(common_dirty_bitmap(&bitmap) == BF_SUCCESS);
+    EXPECT_TRUE(common_fini() == BF_SUCCESS);
+}
+
+void
+driver_entry_ut::test_common_dirty_bitmap_get_dirty_bitmap_missing()
+{
+    struct dirty_bitmap bitmap = {};
+
+    EXPECT_TRUE(common_add_module(m_dummy_start_vmm_success, m_dummy_start_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_stop_vmm_success, m_dummy_stop_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_add_md_success, m_dummy_add_md_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_misc, m_dummy_misc_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_load_vmm() == BF_SUCCESS);
+    EXPECT_TRUE(common_start_vmm() == BF_SUCCESS);
+    EXPECT_TRUE(common_dirty_bitmap(&bitmap) == BFELF_ERROR_NO_SUCH_SYMBOL);
+    EXPECT_TRUE(common_fini() == BF_SUCCESS);
+}
+
+void
+driver_entry_ut::test_common_dirty_bitmap_get_dirty_bitmap_failure()
+{
+    struct dirty_bitmap bitmap = {};
+
+    EXPECT_TRUE(common_add_module(m_dummy_start_vmm_success, m_dummy_start_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_stop_vmm_success, m_dummy_stop_vmm_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_add_md_success, m_dummy_add_md_success_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_get_drr_failure, m_dummy_get_drr_failure_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_add_module(m_dummy_misc, m_dummy_misc_length) == BF_SUCCESS);
+    EXPECT_TRUE(common_load_vmm() == BF_SUCCESS);
+    EXPECT_TRUE(common_start_vmm() == BF_SUCCESS);
+    EXPECT_TRUE(common_dirty_bitmap(&bitmap) == MEMORY_MANAGER_FAILURE);
+    EXPECT_TRUE(common_fini() == BF_SUCCESS);
+}
@@ -35,7 +35,10 @@ enum type
     start = 4,
     stop = 5,
     dump = 6,
-    status = 7
+    status = 7,
+    mem = 8,
+    dirty = 9,
+    stats = 10
 };
 }
 
@@ -126,6 +129,9 @@ private:
     void parse_stop(const std::vector<std::string> &args, size_t index);
     void parse_dump(const std::vector<std::string> &args, size_t index);
     void parse_status(const std::vector<std::string> &args, size_t index);
+    void parse_mem(const std::vector<std::string> &args, size_t index);
+    void parse_dirty(const std::vector<std::string> &args, size_t index);
+    void parse_stats(const std::vector<std::string> &args, size_t index);
 
 private:
 
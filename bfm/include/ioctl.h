@@ -151,6 +151,49 @@ public:
     ///
     virtual void call_ioctl_vmm_status(int64_t *status);
 
+    /// Memory Stats
+    ///
+    /// Get's the VMM's memory statistics
+    ///
+    /// @param stats pointer to provide the memory statistics to
+    ///
+    /// @throws invalid_argument_error thrown if stats == 0
+    /// @throws ioctl_failed_error thrown if the ioctl failed. Note that this
+    ///    could have been because bfm was unable to ioctl the driver, or it
+    ///    could be because the driver entry reported a failure when executing
+    ///    the ioctl.
+    ///
+    virtual void call_ioctl_mem_stats(memory_stats *stats);
+
+    /// Dirty Bitmap
+    ///
+    /// Harvests the next window of the VMM's dirty bitmap
+    ///
+    /// @param bitmap pointer to provide the dirty bitmap to
+    ///
+    /// @throws invalid_argument_error thrown if bitmap == 0
+    /// @throws ioctl_failed_error thrown if the ioctl failed. Note that this
+    ///    could have been because bfm was unable to ioctl the driver, or it
+    ///    could be because the driver entry reported a failure when executing
+    ///    the ioctl.
+    ///
+    virtual void call_ioctl_dirty_bitmap(dirty_bitmap *bitmap);
+
+    /// Exit Stats
+    ///
+    /// Gets a vCPU's exit statistics
+    ///
+    /// @param stats pointer to provide the exit stats to
+    /// @param vcpuid indicates which vCPU to get the exit stats of
+    ///
+    /// @throws invalid_argument_error thrown if stats == 0
+    /// @throws ioctl_failed_error thrown if the ioctl failed. Note that this
+    ///    could have been because bfm was unable to ioctl the driver, or it
+    ///    could be because the driver entry reported a failure when executing
+    ///    the ioctl.
+    ///
+    virtual void call_ioctl_exit_stats(exit_stats *stats, uint64_t vcpuid);
+
 private:
     std::shared_ptr<ioctl_private_base> m_d;
 };
@@ -83,6 +83,9 @@ private:
     void stop_vmm(const std::shared_ptr<ioctl> &ctl);
     void dump_vmm(const std::shared_ptr<ioctl> &ctl, uint64_t vcpuid);
     void vmm_status(const std::shared_ptr<ioctl> &ctl);
+    void mem_stats(const std::shared_ptr<ioctl> &ctl);
+    void harvest_dirty(const std::shared_ptr<ioctl> &ctl);
+    void exit_stats(const std::shared_ptr<ioctl> &ctl, uint64_t vcpuid);
 
     int64_t get_status(const std::shared_ptr<ioctl> &ctl);
 };
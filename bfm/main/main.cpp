@@ -55,6 +55,9 @@ help()
     std::cout << "  or:  bfm [OPTION]... stop..." << std::endl;
     std::cout << "  or:  bfm [OPTION]... dump..." << std::endl;
     std::cout << "  or:  bfm [OPTION]... status..." << std::endl;
+    std::cout << "  or:  bfm [OPTION]... mem..." << std::endl;
+    std::cout << "  or:  bfm [OPTION]... dirty..." << std::endl;
+    std::cout << "  or:  bfm [OPTION]... stats..." << std::endl;
     std::cout << "Controls or queries the bareflank hypervisor" << std::endl;
     std::cout << std::endl;
     std::cout << "       -h, --help      show this help menu" << std::endl;
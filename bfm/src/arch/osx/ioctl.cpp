@@ -104,3 +104,30 @@ ioctl::call_ioctl_vmm_status(int64_t *status)
     if (d)
         d->call_ioctl_vmm_status(status);
 }
+
+void
+ioctl::call_ioctl_mem_stats(memory_stats *stats)
+{
+    auto d = std::dynamic_pointer_cast<ioctl_private>(m_d);
+
+    if (d)
+        d->call_ioctl_mem_stats(stats);
+}
+
+void
+ioctl::call_ioctl_dirty_bitmap(dirty_bitmap *bitmap)
+{
+    auto d = std::dynamic_pointer_cast<ioctl_private>(m_d);
+
+    if (d)
+        d->call_ioctl_dirty_bitmap(bitmap);
+}
+
+void
+ioctl::call_ioctl_exit_stats(exit_stats *stats, uint64_t vcpuid)
+{
+    auto d = std::dynamic_pointer_cast<ioctl_private>(m_d);
+
+    if (d)
+        d->call_ioctl_exit_stats(stats, vcpuid);
+}
@@ -261,3 +261,44 @@ ioctl_private::call_ioctl_vmm_status(int64_t *status)
     if (bf_read_ioctl(fd, IOCTL_VMM_STATUS, status) < 0)
         throw ioctl_failed(IOCTL_VMM_STATUS);
 }
+
+void
+ioctl_private::call_ioctl_mem_stats(memory_stats *stats)
+{
+    int fd = 0;
+
+    if (stats == nullptr)
+        throw unknown_command("stats == NULL");
+
+    if (bf_read_ioctl(fd, IOCTL_MEM_STATS, stats) < 0)
+        throw ioctl_failed(IOCTL_MEM_STATS);
+}
+
+void
+ioctl_private::call_ioctl_dirty_bitmap(dirty_bitmap *bitmap)
+{
+    int fd = 0;
+
+    if (bitmap == nullptr)
+        throw unknown_command("bitmap == NULL");
+
+    if (bf_read_ioctl(fd, IOCTL_DIRTY_BITMAP, bitmap) < 0)
+        throw ioctl_failed(IOCTL_DIRTY_BITMAP);
+}
+
+void
+ioctl_private::call_ioctl_exit_stats(exit_stats *stats, uint64_t vcpuid)
+{
+    int fd = 0;
+
+    // The OSX driver entry does not support IOCTL_SET_VCPUID yet, so it
+    // always provides the statistics of the first vCPU.
+
+    (void) vcpuid;
+
+    if (stats == nullptr)
+        throw unknown_command("stats == NULL");
+
+    if (bf_read_ioctl(fd, IOCTL_EXIT_STATS, stats) < 0)
+        throw ioctl_failed(IOCTL_EXIT_STATS);
+}
@@ -40,6 +40,9 @@ public:
     virtual void call_ioctl_stop_vmm();
     virtual void call_ioctl_dump_vmm(debug_ring_resources_t *drr);
     virtual void call_ioctl_vmm_status(int64_t *status);
+    virtual void call_ioctl_mem_stats(memory_stats *stats);
+    virtual void call_ioctl_dirty_bitmap(dirty_bitmap *bitmap);
+    virtual void call_ioctl_exit_stats(exit_stats *stats, uint64_t vcpuid);
 
 private:
     virtual int64_t bf_write_ioctl(int fd, uint32_t cmd, void *arg);
@@ -195,3 +195,36 @@ ioctl_private::call_ioctl_vmm_status(int64_t *status)
     if (bf_read_ioctl(fd, IOCTL_VMM_STATUS, status, sizeof(*status)) < 0)
         throw ioctl_failed(IOCTL_VMM_STATUS);
 }
+
+void
+ioctl_private::call_ioctl_mem_stats(memory_stats *stats)
+{
+    if (stats == nullptr)
+        throw std::invalid_argument("stats == NULL");
+
+    if (bf_read_ioctl(fd, IOCTL_MEM_STATS, stats, sizeof(*stats)) < 0)
+        throw ioctl_failed(IOCTL_MEM_STATS);
+}
+
+void
+ioctl_private::call_ioctl_dirty_bitmap(dirty_bitmap *bitmap)
+{
+    if (bitmap == nullptr)
+        throw std::invalid_argument("bitmap == NULL");
+
+    if (bf_read_ioctl(fd, IOCTL_DIRTY_BITMAP, bitmap, sizeof(*bitmap)) < 0)
+        throw ioctl_failed(IOCTL_DIRTY_BITMAP);
+}
+
+void
+ioctl_private::call_ioctl_exit_stats(exit_stats *stats, uint64_t vcpuid)
+{
+    if (stats == nullptr)
+        throw std::invalid_argument("stats == NULL");
+
+    if (bf_write_ioctl(fd, IOCTL_SET_VCPUID, &vcpuid, sizeof(vcpuid)) < 0)
+        throw ioctl_failed(IOCTL_SET_VCPUID);
+
+    if (bf_read_ioctl(fd, IOCTL_EXIT_STATS, stats, sizeof(*stats)) < 0)
+        throw ioctl_failed(IOCTL_EXIT_STATS);
+}
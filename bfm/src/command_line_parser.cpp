@@ -66,6 +66,9 @@ command_line_parser::parse(const std::vector<std::string> &args)
         if (arg == "stop") return parse_stop(args, i);
         if (arg == "dump") return parse_dump(args, i);
         if (arg == "status") return parse_status(args, i);
+        if (arg == "mem") return parse_mem(args, i);
+        if (arg == "dirty") return parse_dirty(args, i);
+        if (arg == "stats") return parse_stats(args, i);
 
         throw unknown_command(arg);
     }
@@ -170,3 +173,33 @@ command_line_parser::parse_status(const std::vector<std::string> &args, size_t i
     m_cmd = command_line_parser_command::status;
     m_modules.clear();
 }
+
+void
+command_line_parser::parse_mem(const std::vector<std::string> &args, size_t index)
+{
+    (void) args;
+    (void) index;
+
+    m_cmd = command_line_parser_command::mem;
+    m_modules.clear();
+}
+
+void
+command_line_parser::parse_dirty(const std::vector<std::string> &args, size_t index)
+{
+    (void) args;
+    (void) index;
+
+    m_cmd = command_line_parser_command::dirty;
+    m_modules.clear();
+}
+
+void
+command_line_parser::parse_stats(const std::vector<std::string> &args, size_t index)
+{
+    (void) args;
+    (void) index;
+
+    m_cmd = command_line_parser_command::stats;
+    m_modules.clear();
+}
@@ -21,6 +21,7 @@
 
 #include <gsl/gsl>
 
+#include <iomanip>
 #include <iostream>
 #include <exception.h>
 #include <ioctl_driver.h>
@@ -62,6 +63,15 @@ ioctl_driver::process(std::shared_ptr<file> f,
 
         case command_line_parser_command::status:
             return this->vmm_status(ctl);
+
+        case command_line_parser_command::mem:
+            return this->mem_stats(ctl);
+
+        case command_line_parser_command::dirty:
+            return this->harvest_dirty(ctl);
+
+        case command_line_parser_command::stats:
+            return this->exit_stats(ctl, clp->vcpuid());
     }
 }
 
@@ -198,6 +208,194 @@ ioctl_driver::vmm_status(const std::shared_ptr<ioctl> &ctl)
     }
 }
 
+static uint64_t
+fragmentation(uint64_t size, uint64_t in_use, uint64_t largest_free)
+{
+    auto free = size - in_use;
+
+    if (free == 0 || largest_free >= free)
+        return 0;
+
+    return 100 - (largest_free * 100 / free);
+}
+
+void
+ioctl_driver::mem_stats(const std::shared_ptr<ioctl> &ctl)
+{
+    auto stats = memory_stats();
+
+    switch (get_status(ctl))
+    {
+        case VMM_RUNNING: break;
+        case VMM_LOADED: break;
+        case VMM_UNLOADED: throw invalid_vmm_state("vmm must be loaded first");
+        case VMM_CORRUPT: throw corrupt_vmm();
+        default: throw unknown_status();
+    }
+
+    ctl->call_ioctl_mem_stats(&stats);
+
+    std::cout << "heap:" << std::endl;
+    std::cout << "  size:          " << stats.heap_size << std::endl;
+    std::cout << "  in use:        " << stats.heap_in_use << std::endl;
+    std::cout << "  peak:          " << stats.heap_peak << std::endl;
+    std::cout << "  largest free:  " << stats.heap_largest_free << std::endl;
+    std::cout << "  fragmentation: "
+              << fragmentation(stats.heap_size, stats.heap_in_use, stats.heap_largest_free) << "%" << std::endl;
+
+    std::cout << "page pools: " << stats.num_page_pools << std::endl;
+    std::cout << "  size:          " << stats.page_pool_size << std::endl;
+    std::cout << "  in use:        " << stats.page_pool_in_use << std::endl;
+    std::cout << "  peak:          " << stats.page_pool_peak << std::endl;
+    std::cout << "  largest free:  " << stats.page_pool_largest_free << std::endl;
+    std::cout << "  fragmentation: "
+              << fragmentation(stats.page_pool_size, stats.page_pool_in_use, stats.page_pool_largest_free) << "%" << std::endl;
+
+    std::cout << "failed allocations: " << stats.failed_allocs << std::endl;
+
+    std::cout << std::setw(12) << "size" << std::setw(16) << "allocs" << std::setw(16) << "frees" << std::endl;
+
+    for (auto i = 0U; i < MEMORY_STATS_NUM_CLASSES; i++)
+    {
+        auto size = (i == MEMORY_STATS_NUM_CLASSES - 1) ? std::string("> ") + std::to_string(16ULL << (i - 1)) :
+                    std::string("<= ") + std::to_string(16ULL << i);
+
+        std::cout << std::setw(12) << size
+                  << std::setw(16) << gsl::at(stats.allocs, i)
+                  << std::setw(16) << gsl::at(stats.frees, i) << std::endl;
+    }
+}
+
+static void
+print_dirty_range(uint64_t start, uint64_t end)
+{
+    if (start == end)
+        return;
+
+    std::cout << "  0x" << std::hex << std::setfill('0') << std::setw(16) << start
+              << " - 0x" << std::setw(16) << end << std::dec << std::setfill(' ') << std::endl;
+}
+
+void
+ioctl_driver::harvest_dirty(const std::shared_ptr<ioctl> &ctl)
+{
+    auto bitmap = dirty_bitmap();
+
+    switch (get_status(ctl))
+    {
+        case VMM_RUNNING: break;
+        case VMM_LOADED: throw invalid_vmm_state("vmm must be running first");
+        case VMM_UNLOADED: throw invalid_vmm_state("vmm must be running first");
+        case VMM_CORRUPT: throw corrupt_vmm();
+        default: throw unknown_status();
+    }
+
+    // The VMM hands out the dirty bitmap one window at a time, so that it
+    // never holds up the guest for long. The windows are harvested until
+    // all of memory has been covered once, and dirty granules are merged
+    // into ranges as they are found. A window is approximate if a vCPU did
+    // not flush its cached translations before the harvest returned.
+
+    auto harvested = 0ULL;
+    auto approximate = 0ULL;
+    auto num_dirty = 0ULL;
+    auto range_start = 0ULL;
+    auto range_end = 0ULL;
+
+    std::cout << "dirty:" << std::endl;
+
+    do
+    {
+        ctl->call_ioctl_dirty_bitmap(&bitmap);
+
+        if (bitmap.granularity == 0)
+            break;
+
+        for (auto i = 0ULL; i < bitmap.size / bitmap.granularity; i++)
+        {
+            if ((gsl::at(bitmap.bitmap, static_cast<std::ptrdiff_t>(i / 64)) & (1ULL << (i % 64))) == 0)
+                continue;
+
+            auto gpa = bitmap.gpa + (i * bitmap.granularity);
+
+            if (gpa != range_end)
+            {
+                print_dirty_range(range_start, range_end);
+                range_start = gpa;
+            }
+
+            range_end = gpa + bitmap.granularity;
+            num_dirty += bitmap.granularity;
+        }
+
+        if (bitmap.synchronized == 0)
+            approximate++;
+
+        harvested += bitmap.size;
+    }
+    while (bitmap.size != 0 && harvested < bitmap.total_size);
+
+    print_dirty_range(range_start, range_end);
+
+    std::cout << "total: " << num_dirty << " of " << bitmap.total_size << " bytes" << std::endl;
+    std::cout << "granularity: " << bitmap.granularity << " bytes" << std::endl;
+
+    if (approximate != 0)
+    {
+        std::cout << "approximate: " << approximate << " windows (writes through stale "
+                  << "TLB entries might be missing)" << std::endl;
+    }
+}
+
+void
+ioctl_driver::exit_stats(const std::shared_ptr<ioctl> &ctl, uint64_t vcpuid)
+{
+    // The exit stats are too large to be placed on the stack, as each exit
+    // reason has it's own latency histogram.
+
+    auto stats = std::make_unique<::exit_stats>();
+
+    switch (get_status(ctl))
+    {
+        case VMM_RUNNING: break;
+        case VMM_LOADED: break;
+        case VMM_UNLOADED: throw invalid_vmm_state("vmm must be loaded first");
+        case VMM_CORRUPT: throw corrupt_vmm();
+        default: throw unknown_status();
+    }
+
+    ctl->call_ioctl_exit_stats(stats.get(), vcpuid);
+
+    std::cout << "vcpu: " << stats->vcpuid << std::endl;
+    std::cout << std::setw(8) << "reason" << std::setw(16) << "count"
+              << std::setw(16) << "avg ticks" << std::endl;
+
+    for (auto i = 0; i < EXIT_STATS_NUM_REASONS; i++)
+    {
+        auto count = gsl::at(stats->count, i);
+
+        if (count == 0)
+            continue;
+
+        std::cout << std::setw(8) << i
+                  << std::setw(16) << count
+                  << std::setw(16) << gsl::at(stats->ticks, i) / count << std::endl;
+
+        for (auto b = 0; b < EXIT_STATS_NUM_BUCKETS; b++)
+        {
+            auto num = gsl::at(gsl::at(stats->histogram, i), b);
+
+            if (num == 0)
+                continue;
+
+            auto range = (b == EXIT_STATS_NUM_BUCKETS - 1) ? std::string(">= ") + std::to_string(1ULL << b) :
+                         std::string("< ") + std::to_string(1ULL << (b + 1));
+
+            std::cout << std::setw(24) << range << std::setw(16) << num << std::endl;
+        }
+    }
+}
+
 int64_t
 ioctl_driver::get_status(const std::shared_ptr<ioctl> &ctl)
 {
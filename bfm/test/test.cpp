@@ -63,6 +63,10 @@ bfm_ut::list()
     this->test_command_line_parser_with_valid_stop();
     this->test_command_line_parser_with_valid_dump();
     this->test_command_line_parser_with_valid_status();
+    this->test_command_line_parser_with_valid_mem();
+    this->test_command_line_parser_with_valid_dirty();
+    this->test_command_line_parser_with_valid_stats();
+    this->test_command_line_parser_with_valid_stats_vcpuid();
     this->test_command_line_parser_no_vcpuid();
     this->test_command_line_parser_invalid_vcpuid();
     this->test_command_line_parser_valid_vcpuid();
@@ -81,6 +85,12 @@ bfm_ut::list()
     this->test_ioctl_dump_vmm_failed();
     this->test_ioctl_vmm_status_with_invalid_drr();
     this->test_ioctl_vmm_status_failed();
+    this->test_ioctl_mem_stats_with_invalid_stats();
+    this->test_ioctl_mem_stats_failed();
+    this->test_ioctl_dirty_bitmap_with_invalid_bitmap();
+    this->test_ioctl_dirty_bitmap_failed();
+    this->test_ioctl_exit_stats_with_invalid_stats();
+    this->test_ioctl_exit_stats_failed();
 
     this->test_ioctl_driver_process_invalid_file();
     this->test_ioctl_driver_process_invalid_ioctl();
@@ -126,6 +136,25 @@ bfm_ut::list()
     this->test_ioctl_driver_process_vmm_status_unloaded();
     this->test_ioctl_driver_process_vmm_status_corrupt();
     this->test_ioctl_driver_process_vmm_status_unknown_status();
+    this->test_ioctl_driver_process_mem_stats_vmm_unloaded();
+    this->test_ioctl_driver_process_mem_stats_vmm_corrupted();
+    this->test_ioctl_driver_process_mem_stats_vmm_unknown_status();
+    this->test_ioctl_driver_process_mem_stats_failed();
+    this->test_ioctl_driver_process_mem_stats_success_running();
+    this->test_ioctl_driver_process_mem_stats_success_loaded();
+    this->test_ioctl_driver_process_exit_stats_vmm_unloaded();
+    this->test_ioctl_driver_process_exit_stats_vmm_corrupted();
+    this->test_ioctl_driver_process_exit_stats_vmm_unknown_status();
+    this->test_ioctl_driver_process_exit_stats_failed();
+    this->test_ioctl_driver_process_exit_stats_success_running();
+    this->test_ioctl_driver_process_exit_stats_success_loaded();
+    this->test_ioctl_driver_process_dirty_bitmap_vmm_unloaded();
+    this->test_ioctl_driver_process_dirty_bitmap_vmm_loaded();
+    this->test_ioctl_driver_process_dirty_bitmap_vmm_corrupted();
+    this->test_ioctl_driver_process_dirty_bitmap_vmm_unknown_status();
+    this->test_ioctl_driver_process_dirty_bitmap_failed();
+    this->test_ioctl_driver_process_dirty_bitmap_success();
+    this->test_ioctl_driver_process_dirty_bitmap_success_multiple_windows();
 
     this->test_split_empty_string();
     this->test_split_with_non_existing_delimiter();
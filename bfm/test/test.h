@@ -62,6 +62,10 @@ private:
     void test_command_line_parser_with_valid_stop();
     void test_command_line_parser_with_valid_dump();
     void test_command_line_parser_with_valid_status();
+    void test_command_line_parser_with_valid_mem();
+    void test_command_line_parser_with_valid_dirty();
+    void test_command_line_parser_with_valid_stats();
+    void test_command_line_parser_with_valid_stats_vcpuid();
     void test_command_line_parser_no_vcpuid();
     void test_command_line_parser_invalid_vcpuid();
     void test_command_line_parser_valid_vcpuid();
@@ -80,6 +84,12 @@ private:
     void test_ioctl_dump_vmm_failed();
     void test_ioctl_vmm_status_with_invalid_drr();
     void test_ioctl_vmm_status_failed();
+    void test_ioctl_mem_stats_with_invalid_stats();
+    void test_ioctl_mem_stats_failed();
+    void test_ioctl_dirty_bitmap_with_invalid_bitmap();
+    void test_ioctl_dirty_bitmap_failed();
+    void test_ioctl_exit_stats_with_invalid_stats();
+    void test_ioctl_exit_stats_failed();
 
     void test_ioctl_driver_process_invalid_file();
     void test_ioctl_driver_process_invalid_ioctl();
@@ -125,6 +135,25 @@ private:
     void test_ioctl_driver_process_vmm_status_unloaded();
     void test_ioctl_driver_process_vmm_status_corrupt();
     void test_ioctl_driver_process_vmm_status_unknown_status();
+    void test_ioctl_driver_process_mem_stats_vmm_unloaded();
+    void test_ioctl_driver_process_mem_stats_vmm_corrupted();
+    void test_ioctl_driver_process_mem_stats_vmm_unknown_status();
+    void test_ioctl_driver_process_mem_stats_failed();
+    void test_ioctl_driver_process_mem_stats_success_running();
+    void test_ioctl_driver_process_mem_stats_success_loaded();
+    void test_ioctl_driver_process_exit_stats_vmm_unloaded();
+    void test_ioctl_driver_process_exit_stats_vmm_corrupted();
+    void test_ioctl_driver_process_exit_stats_vmm_unknown_status();
+    void test_ioctl_driver_process_exit_stats_failed();
+    void test_ioctl_driver_process_exit_stats_success_running();
+    void test_ioctl_driver_process_exit_stats_success_loaded();
+    void test_ioctl_driver_process_dirty_bitmap_vmm_unloaded();
+    void test_ioctl_driver_process_dirty_bitmap_vmm_loaded();
+    void test_ioctl_driver_process_dirty_bitmap_vmm_corrupted();
+    void test_ioctl_driver_process_dirty_bitmap_vmm_unknown_status();
+    void test_ioctl_driver_process_dirty_bitmap_failed();
+    void test_ioctl_driver_process_dirty_bitmap_success();
+    void test_ioctl_driver_process_dirty_bitmap_success_multiple_windows();
 
     void test_split_empty_string();
     void test_split_with_non_existing_delimiter();
@@ -311,6 +311,54 @@ bfm_ut::test_command_line_parser_with_valid_status()
     EXPECT_TRUE(g_clp.modules() == "");
 }
 
+void
+bfm_ut::test_command_line_parser_with_valid_mem()
+{
+    auto args = {"mem"_s};
+
+    g_clp.reset();
+    EXPECT_NO_EXCEPTION(g_clp.parse(args));
+
+    EXPECT_TRUE(g_clp.cmd() == command_line_parser_command::mem);
+    EXPECT_TRUE(g_clp.modules() == "");
+}
+
+void
+bfm_ut::test_command_line_parser_with_valid_dirty()
+{
+    auto args = {"dirty"_s};
+
+    g_clp.reset();
+    EXPECT_NO_EXCEPTION(g_clp.parse(args));
+
+    EXPECT_TRUE(g_clp.cmd() == command_line_parser_command::dirty);
+    EXPECT_TRUE(g_clp.modules() == "");
+}
+
+void
+bfm_ut::test_command_line_parser_with_valid_stats()
+{
+    auto args = {"stats"_s};
+
+    g_clp.reset();
+    EXPECT_NO_EXCEPTION(g_clp.parse(args));
+
+    EXPECT_TRUE(g_clp.cmd() == command_line_parser_command::stats);
+    EXPECT_TRUE(g_clp.modules() == "");
+}
+
+void
+bfm_ut::test_command_line_parser_with_valid_stats_vcpuid()
+{
+    auto args = {"stats"_s, "--vcpuid"_s, "2"_s};
+
+    g_clp.reset();
+    EXPECT_NO_EXCEPTION(g_clp.parse(args));
+
+    EXPECT_TRUE(g_clp.cmd() == command_line_parser_command::stats);
+    EXPECT_TRUE(g_clp.vcpuid() == 2);
+}
+
 void
 bfm_ut::test_command_line_parser_no_vcpuid()
 {
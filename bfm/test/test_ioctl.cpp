@@ -207,3 +207,96 @@ bfm_ut::test_ioctl_vmm_status_failed()
         EXPECT_EXCEPTION(g_ctl.call_ioctl_vmm_status(&status), bfn::ioctl_failed_error);
     });
 }
+
+void
+bfm_ut::test_ioctl_mem_stats_with_invalid_stats()
+{
+    MockRepository mocks;
+
+    mocks.OnCallFunc(bf_send_ioctl).Return(0);
+    mocks.OnCallFunc(bf_read_ioctl).Return(0);
+    mocks.OnCallFunc(bf_write_ioctl).Return(0);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_ctl.call_ioctl_mem_stats(nullptr), std::invalid_argument);
+    });
+}
+
+void
+bfm_ut::test_ioctl_mem_stats_failed()
+{
+    memory_stats stats;
+    MockRepository mocks;
+
+    mocks.OnCallFunc(bf_send_ioctl).Return(-1);
+    mocks.OnCallFunc(bf_read_ioctl).Return(-1);
+    mocks.OnCallFunc(bf_write_ioctl).Return(-1);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_ctl.call_ioctl_mem_stats(&stats), bfn::ioctl_failed_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_dirty_bitmap_with_invalid_bitmap()
+{
+    MockRepository mocks;
+
+    mocks.OnCallFunc(bf_send_ioctl).Return(0);
+    mocks.OnCallFunc(bf_read_ioctl).Return(0);
+    mocks.OnCallFunc(bf_write_ioctl).Return(0);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_ctl.call_ioctl_dirty_bitmap(nullptr), std::invalid_argument);
+    });
+}
+
+void
+bfm_ut::test_ioctl_dirty_bitmap_failed()
+{
+    dirty_bitmap bitmap;
+    MockRepository mocks;
+
+    mocks.OnCallFunc(bf_send_ioctl).Return(-1);
+    mocks.OnCallFunc(bf_read_ioctl).Return(-1);
+    mocks.OnCallFunc(bf_write_ioctl).Return(-1);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_ctl.call_ioctl_dirty_bitmap(&bitmap), bfn::ioctl_failed_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_exit_stats_with_invalid_stats()
+{
+    MockRepository mocks;
+
+    mocks.OnCallFunc(bf_send_ioctl).Return(0);
+    mocks.OnCallFunc(bf_read_ioctl).Return(0);
+    mocks.OnCallFunc(bf_write_ioctl).Return(0);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_ctl.call_ioctl_exit_stats(nullptr, 0), std::invalid_argument);
+    });
+}
+
+void
+bfm_ut::test_ioctl_exit_stats_failed()
+{
+    auto stats = std::make_unique<exit_stats>();
+    MockRepository mocks;
+
+    mocks.OnCallFunc(bf_send_ioctl).Return(-1);
+    mocks.OnCallFunc(bf_read_ioctl).Return(-1);
+    mocks.OnCallFunc(bf_write_ioctl).Return(-1);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_ctl.call_ioctl_exit_stats(stats.get(), 0), bfn::ioctl_failed_error);
+    });
+}
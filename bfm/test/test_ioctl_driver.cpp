@@ -1145,3 +1145,518 @@ bfm_ut::test_ioctl_driver_process_vmm_status_unknown_status()
         EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::unknown_status_error);
     });
 }
+
+void
+bfm_ut::test_ioctl_driver_process_mem_stats_vmm_unloaded()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::mem);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_UNLOADED;
+    });
+
+    mocks.NeverCall(ctl.get(), ioctl::call_ioctl_mem_stats);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::invalid_vmm_state_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_mem_stats_vmm_corrupted()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::mem);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_CORRUPT;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::corrupt_vmm_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_mem_stats_vmm_unknown_status()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::mem);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = -1;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::unknown_status_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_mem_stats_failed()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::mem);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_LOADED;
+    });
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_mem_stats).Throw(
+        ioctl_failed(IOCTL_MEM_STATS)
+    );
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::ioctl_failed_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_mem_stats_success_running()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::mem);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_RUNNING;
+    });
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_mem_stats).Do([](auto * stats)
+    {
+        stats->heap_size = 0x1000;
+        stats->heap_in_use = 0x800;
+        stats->heap_largest_free = 0x400;
+        stats->allocs[0] = 10;
+        stats->frees[0] = 5;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_NO_EXCEPTION(g_driver.process(f, ctl, clp));
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_mem_stats_success_loaded()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::mem);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_LOADED;
+    });
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_mem_stats).Do([](auto * stats)
+    {
+        stats->page_pool_size = 0x1000;
+        stats->page_pool_in_use = 0x1000;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_NO_EXCEPTION(g_driver.process(f, ctl, clp));
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_exit_stats_vmm_unloaded()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::stats);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+    mocks.OnCall(clp.get(), command_line_parser::vcpuid).Return(0);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_UNLOADED;
+    });
+
+    mocks.NeverCall(ctl.get(), ioctl::call_ioctl_exit_stats);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::invalid_vmm_state_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_exit_stats_vmm_corrupted()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::stats);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+    mocks.OnCall(clp.get(), command_line_parser::vcpuid).Return(0);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_CORRUPT;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::corrupt_vmm_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_exit_stats_vmm_unknown_status()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::stats);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+    mocks.OnCall(clp.get(), command_line_parser::vcpuid).Return(0);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = -1;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::unknown_status_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_exit_stats_failed()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::stats);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+    mocks.OnCall(clp.get(), command_line_parser::vcpuid).Return(0);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_LOADED;
+    });
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_exit_stats).Throw(
+        ioctl_failed(IOCTL_EXIT_STATS)
+    );
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::ioctl_failed_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_exit_stats_success_running()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::stats);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+    mocks.OnCall(clp.get(), command_line_parser::vcpuid).Return(1);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_RUNNING;
+    });
+
+    mocks.ExpectCall(ctl.get(), ioctl::call_ioctl_exit_stats).With(_, 1).Do([](auto * stats, auto)
+    {
+        stats->vcpuid = 1;
+        stats->count[10] = 2;
+        stats->ticks[10] = 0x200;
+        stats->histogram[10][8] = 2;
+        stats->count[30] = 1;
+        stats->ticks[30] = 0xFFFFFFFFFFFF;
+        stats->histogram[30][EXIT_STATS_NUM_BUCKETS - 1] = 1;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_NO_EXCEPTION(g_driver.process(f, ctl, clp));
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_exit_stats_success_loaded()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::stats);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+    mocks.OnCall(clp.get(), command_line_parser::vcpuid).Return(0);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_LOADED;
+    });
+
+    mocks.ExpectCall(ctl.get(), ioctl::call_ioctl_exit_stats).With(_, 0);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_NO_EXCEPTION(g_driver.process(f, ctl, clp));
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_dirty_bitmap_vmm_unloaded()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::dirty);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_UNLOADED;
+    });
+
+    mocks.NeverCall(ctl.get(), ioctl::call_ioctl_dirty_bitmap);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::invalid_vmm_state_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_dirty_bitmap_vmm_loaded()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::dirty);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_LOADED;
+    });
+
+    mocks.NeverCall(ctl.get(), ioctl::call_ioctl_dirty_bitmap);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::invalid_vmm_state_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_dirty_bitmap_vmm_corrupted()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::dirty);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_CORRUPT;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::corrupt_vmm_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_dirty_bitmap_vmm_unknown_status()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::dirty);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = -1;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::unknown_status_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_dirty_bitmap_failed()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::dirty);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_RUNNING;
+    });
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_dirty_bitmap).Throw(
+        ioctl_failed(IOCTL_DIRTY_BITMAP)
+    );
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(g_driver.process(f, ctl, clp), bfn::ioctl_failed_error);
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_dirty_bitmap_success()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::dirty);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_RUNNING;
+    });
+
+    mocks.ExpectCall(ctl.get(), ioctl::call_ioctl_dirty_bitmap).Do([](auto * bitmap)
+    {
+        *bitmap = {};
+        bitmap->size = 0x1000000;
+        bitmap->total_size = 0x1000000;
+        bitmap->granularity = 0x200000;
+        bitmap->bitmap[0] = 0x37;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_NO_EXCEPTION(g_driver.process(f, ctl, clp));
+    });
+}
+
+void
+bfm_ut::test_ioctl_driver_process_dirty_bitmap_success_multiple_windows()
+{
+    MockRepository mocks;
+
+    auto f = bfn::mock_shared<file>(mocks);
+    auto ctl = bfn::mock_shared<ioctl>(mocks);
+    auto clp = bfn::mock_shared<command_line_parser>(mocks);
+
+    mocks.OnCall(clp.get(), command_line_parser::cmd).Return(command_line_parser_command::dirty);
+    mocks.OnCall(clp.get(), command_line_parser::modules).Return(""_s);
+
+    mocks.OnCall(ctl.get(), ioctl::call_ioctl_vmm_status).Do([](auto * status)
+    {
+        *status = VMM_RUNNING;
+    });
+
+    auto gpa = 0x0ULL;
+
+    mocks.ExpectCalls(ctl.get(), ioctl::call_ioctl_dirty_bitmap, 2).Do([&](auto * bitmap)
+    {
+        *bitmap = {};
+        bitmap->gpa = gpa;
+        bitmap->size = 0x800000;
+        bitmap->total_size = 0x1000000;
+        bitmap->granularity = 0x200000;
+        bitmap->synchronized = gpa == 0 ? 1 : 0;
+        bitmap->bitmap[0] = 0x8;
+
+        gpa += 0x800000;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_NO_EXCEPTION(g_driver.process(f, ctl, clp));
+    });
+}
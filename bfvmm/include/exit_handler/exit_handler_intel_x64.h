@@ -22,9 +22,35 @@
 #ifndef EXIT_HANDLER_INTEL_X64_H
 #define EXIT_HANDLER_INTEL_X64_H
 
+#include <array>
 #include <memory>
+#include <vector>
+#include <functional>
 #include <vmcs/vmcs_intel_x64.h>
+#include <vmcs/vmcs_field_cache_intel_x64.h>
+#include <exit_handler/exit_stats_intel_x64.h>
 #include <intrinsics/intrinsics_intel_x64.h>
+#include <memory_manager/dirty_ring_x64.h>
+#include <memory_manager/translation_cache_x64.h>
+
+// -----------------------------------------------------------------------------
+// I/O Instruction
+// -----------------------------------------------------------------------------
+
+/// I/O Instruction
+///
+/// The decoded exit qualification of an I/O instruction exit (see
+/// exit_handler_intel_x64::register_io_handler).
+///
+struct io_instruction_intel_x64
+{
+    uint16_t port;      ///< the first port that is accessed
+    uint8_t size;       ///< the size of the access in bytes (1, 2 or 4)
+    bool in;            ///< true for IN / INS, false for OUT / OUTS
+    bool string;        ///< true for INS / OUTS
+    bool rep;           ///< true if the instruction has a REP prefix
+    bool immediate;     ///< true if the port is an immediate, false for DX
+};
 
 // -----------------------------------------------------------------------------
 // Exit Handler
@@ -44,6 +70,13 @@
 /// can subclass this class, and overload the handlers that are needed. The
 /// basics are provided with this class to ease development.
 ///
+/// Exits are dispatched through a per-vCPU table, indexed by the basic exit
+/// reason, so a single exit reason can also be extended (or replaced)
+/// without subclassing, using register_handler and chain_handler. The
+/// default table stores pointers to the handle_* functions below, so an
+/// exit that uses the default table costs a single indirect call, the
+/// same as the virtual call the handle_* function would cost anyways.
+///
 class exit_handler_intel_x64
 {
 public:
@@ -73,6 +106,207 @@ public:
     ///
     virtual void halt() noexcept;
 
+    /// Exit Reason
+    ///
+    /// @return the exit reason of the current exit (read by dispatch)
+    ///
+    uint64_t exit_reason() const noexcept
+    { return m_exit_reason; }
+
+    /// Exit Qualification
+    ///
+    /// The remaining VM-exit information fields are only read from the
+    /// VMCS the first time they are asked for during an exit, and are then
+    /// cached until the next exit, so exits that do not need them (like
+    /// CPUID) never pay for the VMREAD.
+    ///
+    /// @return the exit qualification of the current exit
+    ///
+    uint64_t exit_qualification();
+
+    /// Exit Instruction Length
+    ///
+    /// @return the instruction length of the current exit (see
+    ///     exit_qualification for how this field is read)
+    ///
+    uint64_t exit_instruction_length();
+
+    /// Exit Instruction Information
+    ///
+    /// @return the instruction information of the current exit (see
+    ///     exit_qualification for how this field is read)
+    ///
+    uint64_t exit_instruction_information();
+
+    /// Enable VMCS Field Cache
+    ///
+    /// When enabled, vmread and vmwrite go through a per-vCPU write-back
+    /// cache (see vmcs_field_cache_intel_x64): each field is read from the
+    /// VMCS at most once per exit, and the fields that changed are written
+    /// back once, right before the guest is resumed. While the cache is
+    /// enabled, handlers must only access the guest's VMCS fields through
+    /// this class (and not through the vmcs class directly). The cache is
+    /// disabled by default.
+    ///
+    /// @param enabled true to enable the cache, false to disable it
+    ///
+    virtual void enable_vmcs_field_cache(bool enabled = true);
+
+    /// Is VMCS Field Cache Enabled
+    ///
+    /// @return true if the VMCS field cache is enabled, false otherwise
+    ///
+    bool is_enabled_vmcs_field_cache() const noexcept
+    { return m_vmcs_field_cache_enabled; }
+
+    /// Dirty Ring
+    ///
+    /// Returns the ring that this exit handler drains the vCPU's
+    /// page-modification log into. The exit handler is the ring's only
+    /// producer, so a single consumer can pop the guest physical addresses
+    /// of dirtied pages from it, from any core, while the vCPU is running.
+    ///
+    /// @return the dirty ring of this exit handler
+    ///
+    virtual dirty_ring_x64 &dirty_ring() noexcept
+    { return m_dirty_ring; }
+
+    /// I/O Handler
+    ///
+    /// Emulates an I/O instruction. For IN, the handler must place the
+    /// result in the low "size" bytes of state.rax, and for INS and OUTS,
+    /// the handler is responsible for the guest's memory and for updating
+    /// state.rsi, state.rdi and state.rcx. The exit handler advances RIP
+    /// once the handler returns.
+    ///
+    using io_handler_type =
+        std::function<void(const io_instruction_intel_x64 &io, state_save_intel_x64 &state)>;
+
+    /// Register I/O Handler
+    ///
+    /// Traps the ports [first, last] in this vCPU's I/O bitmaps, and
+    /// sends I/O instructions that touch one of these ports to the
+    /// provided handler. All other ports run without an exit. Note that an
+    /// access of more than one byte can start below first (i.e. io.port <
+    /// first), in which case it is sent to the handler of the lowest
+    /// registered port that it touches, which has to emulate (or split)
+    /// the whole access.
+    ///
+    /// @expects the VMCS has been set (i.e. the vCPU has been initialized)
+    /// @expects [first, last] does not overlap a registered range
+    ///
+    /// @param first the first port to trap
+    /// @param last the last port to trap
+    /// @param handler the handler to call when one of the ports is accessed
+    ///
+    virtual void register_io_handler(uint16_t first, uint16_t last, io_handler_type handler);
+
+    /// Handler
+    ///
+    /// Handles an exit. The exit handler resumes the guest once the
+    /// handler returns, so a handler that emulates an instruction must
+    /// advance RIP itself.
+    ///
+    using handler_type = std::function<void(exit_handler_intel_x64 &eh)>;
+
+    /// Chained Handler
+    ///
+    /// Handles an exit, with "next" being the handler that was registered
+    /// for the exit reason before this one. A chained handler can observe
+    /// an exit and then call next, or handle the exit itself and not call
+    /// next at all.
+    ///
+    using chained_handler_type =
+        std::function<void(exit_handler_intel_x64 &eh, const handler_type &next)>;
+
+    /// Member Handler
+    ///
+    /// Handles an exit using a member function of the exit handler (like
+    /// one of the handle_* functions, or a subclass's function cast to this
+    /// type), which is called with a single indirect call.
+    ///
+    using member_handler_type = void (exit_handler_intel_x64::*)();
+
+    /// Dispatch Entry
+    ///
+    /// The handler of a single basic exit reason. If member is set, it is
+    /// called, otherwise handler is. An entry with neither sends the exit
+    /// to the unimplemented handler.
+    ///
+    struct dispatch_entry_type
+    {
+        member_handler_type member = nullptr;
+        handler_type handler;
+    };
+
+    /// Dispatch Table
+    ///
+    /// The handlers of each basic exit reason.
+    ///
+    using dispatch_table_type = std::array<dispatch_entry_type, VM_EXIT_REASON_MAX + 1>;
+
+    /// Register Handler
+    ///
+    /// Replaces the handler of the provided basic exit reason. This copies
+    /// the current dispatch table, and installs the copy, so handlers
+    /// should be registered before the vCPU is launched when possible.
+    ///
+    /// @param exit_reason the basic exit reason to handle
+    /// @param handler the handler to call when this exit occurs
+    /// @throws std::invalid_argument if exit_reason is out of range or if
+    ///     handler is empty
+    ///
+    virtual void register_handler(uint64_t exit_reason, handler_type handler);
+
+    /// Register Member Handler
+    ///
+    /// Like register_handler, but the exit is handled by a member function
+    /// of this exit handler, which unlike a handler_type, only costs a
+    /// single indirect call.
+    ///
+    /// @param exit_reason the basic exit reason to handle
+    /// @param handler the member function to call when this exit occurs
+    /// @throws std::invalid_argument if exit_reason is out of range or if
+    ///     handler == nullptr
+    ///
+    virtual void register_handler(uint64_t exit_reason, member_handler_type handler);
+
+    /// Chain Handler
+    ///
+    /// Registers a handler that is passed the handler it replaces (see
+    /// chained_handler_type). If no handler was registered, "next" is the
+    /// unimplemented handler.
+    ///
+    /// @param exit_reason the basic exit reason to handle
+    /// @param handler the handler to call when this exit occurs
+    /// @throws std::invalid_argument if exit_reason is out of range or if
+    ///     handler is empty
+    ///
+    virtual void chain_handler(uint64_t exit_reason, chained_handler_type handler);
+
+    /// Dispatch Table
+    ///
+    /// @return the dispatch table that is currently installed. The table
+    ///     is never modified once it is installed, so it can be copied to
+    ///     build a new table.
+    ///
+    virtual std::shared_ptr<dispatch_table_type> dispatch_table() const
+    { return m_dispatch_table; }
+
+    /// Install Dispatch Table
+    ///
+    /// Replaces the entire dispatch table, which only costs a pointer swap,
+    /// so (for example) an extension can switch between prebuilt tables
+    /// at runtime. This must be called from the vCPU's own exit handler
+    /// (or before the vCPU is launched). The table that is replaced is
+    /// kept until the next exit, so a handler can replace the table that
+    /// it was called from.
+    ///
+    /// @param table the new dispatch table
+    /// @throws std::invalid_argument if table == nullptr
+    ///
+    virtual void install_dispatch_table(std::shared_ptr<dispatch_table_type> table);
+
 protected:
 
     virtual void handle_exception_or_non_maskable_interrupt();
@@ -133,17 +367,40 @@ protected:
     virtual void handle_invpcid();
     virtual void handle_vmfunc();
     virtual void handle_rdseed();
+    virtual void handle_page_modification_log_full();
     virtual void handle_xsaves();
     virtual void handle_xrstors();
 
+    virtual void pass_through_io(const io_instruction_intel_x64 &io);
+
     virtual void advance_rip();
     void unimplemented_handler();
 
+    void dispatch_handler(uint64_t basic_exit_reason);
+
     const char *exit_reason_to_str(uint64_t exit_reason);
 
+    uint64_t cached_exit_info(uint64_t field, uint64_t &value, uint32_t flag);
+
+    static std::shared_ptr<dispatch_table_type> default_dispatch_table();
+
     virtual uint64_t vmread(uint64_t field) const;
     virtual void vmwrite(uint64_t field, uint64_t value);
 
+    void vmwrite_uncached(uint64_t field, uint64_t value);
+    void flush_vmcs_field_cache();
+
+    /// Guest Translate
+    ///
+    /// Translates a guest virtual address to a guest physical address
+    /// using the guest's CR3. Translations are cached by the exit handler
+    /// for the rest of the current VM exit.
+    ///
+    /// @param virt the guest virtual address to translate
+    /// @return the translation (see page_walker_x64::walk)
+    ///
+    virtual page_walk_x64 guest_translate(uintptr_t virt);
+
 protected:
 
     friend class vcpu_ut;
@@ -156,9 +413,31 @@ protected:
     uint64_t m_exit_qualification;
     uint64_t m_exit_instruction_length;
     uint64_t m_exit_instruction_information;
+    uint32_t m_exit_info_cached;
+
+    bool m_vmcs_field_cache_enabled;
+    mutable vmcs_field_cache_intel_x64 m_vmcs_field_cache;
 
     std::shared_ptr<vmcs_intel_x64> m_vmcs;
     std::shared_ptr<state_save_intel_x64> m_state_save;
+    std::shared_ptr<exit_stats_intel_x64> m_exit_stats;
+
+    translation_cache_x64 m_translation_cache;
+    dirty_ring_x64 m_dirty_ring;
+
+    uint64_t m_pt_generation;
+
+    struct io_handler_entry
+    {
+        uint16_t first;
+        uint16_t last;
+        io_handler_type handler;
+    };
+
+    std::vector<io_handler_entry> m_io_handlers;
+
+    std::shared_ptr<dispatch_table_type> m_dispatch_table;
+    std::vector<std::shared_ptr<dispatch_table_type>> m_retired_dispatch_tables;
 
 private:
 
@@ -167,6 +446,9 @@ private:
 
     virtual void set_state_save(const std::shared_ptr<state_save_intel_x64> &state_save)
     { m_state_save = state_save; }
+
+    virtual void set_exit_stats(const std::shared_ptr<exit_stats_intel_x64> &exit_stats)
+    { m_exit_stats = exit_stats; }
 };
 
 #endif
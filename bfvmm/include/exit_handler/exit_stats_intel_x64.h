@@ -0,0 +1,130 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef EXIT_STATS_INTEL_X64_H
+#define EXIT_STATS_INTEL_X64_H
+
+#include <map>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <exit_stats_interface.h>
+
+/// Get Exit Statistics
+///
+/// Copies the statistics of the provided vCPU (see get_exit_stats_t).
+///
+/// @param vcpuid the vCPU to get the statistics of
+/// @param stats where to copy the statistics to
+/// @return GET_EXIT_STATS_SUCCESS on success, GET_EXIT_STATS_FAILURE if
+///     stats == nullptr or the vCPU does not exist
+///
+extern "C" int64_t get_exit_stats(uint64_t vcpuid, struct exit_stats *stats) noexcept;
+
+/// Exit Statistics
+///
+/// Counts the exits that a vCPU takes, per basic exit reason, along with
+/// the number of TSC ticks that were spent handling them, and a log2
+/// histogram of these ticks (see exit_stats_interface.h). Each vCPU owns
+/// one of these, and registers it by vcpuid, so that the driver entry can
+/// read it (using get_exit_stats) while the vCPU is running.
+///
+/// Only the vCPU that owns the statistics ever writes them, so recording
+/// an exit is just a handful of relaxed loads and stores (i.e. no locked
+/// instructions), and readers never block the vCPU. A reader might see
+/// an exit that is only partially recorded, which is fine for statistics.
+///
+class exit_stats_intel_x64
+{
+public:
+
+    /// Default Constructor
+    ///
+    /// Creates a new set of statistics, and registers it for the provided
+    /// vcpuid (replacing the statistics of any previous vCPU with the same
+    /// vcpuid).
+    ///
+    /// @param vcpuid the vCPU that owns these statistics
+    ///
+    exit_stats_intel_x64(uint64_t vcpuid);
+
+    /// Destructor
+    ///
+    virtual ~exit_stats_intel_x64() = default;
+
+    /// Record
+    ///
+    /// Records an exit. This should only be called by the vCPU that owns
+    /// these statistics.
+    ///
+    /// @param exit_reason the basic exit reason of the exit (exit reasons
+    ///     that are out of range are ignored)
+    /// @param ticks the number of TSC ticks spent handling the exit
+    ///
+    virtual void record(uint64_t exit_reason, uint64_t ticks) noexcept;
+
+    /// Read
+    ///
+    /// Copies the statistics. This can be called from any core.
+    ///
+    /// @param stats where to copy the statistics to
+    ///
+    virtual void read(struct exit_stats *stats) const noexcept;
+
+    /// Bucket
+    ///
+    /// @param ticks the number of TSC ticks spent handling an exit
+    /// @return the histogram bucket that counts an exit that took ticks
+    ///
+    static uint64_t bucket(uint64_t ticks) noexcept;
+
+private:
+
+    using counter_type = std::atomic<uint64_t>;
+
+    struct counters
+    {
+        uint64_t vcpuid;
+        std::array<counter_type, EXIT_STATS_NUM_REASONS> count;
+        std::array<counter_type, EXIT_STATS_NUM_REASONS> ticks;
+        std::array<std::array<counter_type, EXIT_STATS_NUM_BUCKETS>, EXIT_STATS_NUM_REASONS> histogram;
+    };
+
+    std::shared_ptr<counters> m_counters;
+
+    static void read(const counters &c, struct exit_stats *stats) noexcept;
+    static std::map<uint64_t, std::shared_ptr<counters> > &registry() noexcept;
+
+    friend int64_t get_exit_stats(uint64_t vcpuid, struct exit_stats *stats) noexcept;
+
+public:
+
+    /// Disable the copy consturctor
+    ///
+    exit_stats_intel_x64(const exit_stats_intel_x64 &) = delete;
+
+    /// Disable the copy operator
+    ///
+    exit_stats_intel_x64 &operator=(const exit_stats_intel_x64 &) = delete;
+};
+
+#endif
@@ -43,6 +43,20 @@ bool __vmptrst(void *vmcs_region) noexcept;
 bool __vmwrite(uint64_t field, uint64_t val) noexcept;
 bool __vmread(uint64_t field, uint64_t *val) noexcept;
 bool __vmlaunch(void) noexcept;
+bool __invvpid(uint64_t type, void *descriptor) noexcept;
+bool __invept(uint64_t type, void *descriptor) noexcept;
+
+// INVVPID Types
+// intel's software developer's manual, volume 3, section 30.3 (INVVPID)
+#define INVVPID_TYPE_INDIVIDUAL_ADDRESS                           0ULL
+#define INVVPID_TYPE_SINGLE_CONTEXT                               1ULL
+#define INVVPID_TYPE_ALL_CONTEXTS                                 2ULL
+#define INVVPID_TYPE_SINGLE_CONTEXT_RETAINING_GLOBALS             3ULL
+
+// INVEPT Types
+// intel's software developer's manual, volume 3, section 30.3 (INVEPT)
+#define INVEPT_TYPE_SINGLE_CONTEXT                                1ULL
+#define INVEPT_TYPE_ALL_CONTEXTS                                  2ULL
 
 // -----------------------------------------------------------------------------
 // State Save
@@ -157,6 +171,36 @@ public:
 
     virtual bool vmlaunch() const noexcept
     { return __vmlaunch(); }
+
+    virtual bool invvpid_individual_address(uint16_t vpid, uint64_t addr) const noexcept
+    {
+        uint64_t descriptor[2] = {vpid, addr};
+        return __invvpid(INVVPID_TYPE_INDIVIDUAL_ADDRESS, descriptor);
+    }
+
+    virtual bool invvpid_single_context(uint16_t vpid) const noexcept
+    {
+        uint64_t descriptor[2] = {vpid, 0};
+        return __invvpid(INVVPID_TYPE_SINGLE_CONTEXT, descriptor);
+    }
+
+    virtual bool invvpid_all_contexts() const noexcept
+    {
+        uint64_t descriptor[2] = {0, 0};
+        return __invvpid(INVVPID_TYPE_ALL_CONTEXTS, descriptor);
+    }
+
+    virtual bool invept_single_context(uint64_t eptp) const noexcept
+    {
+        uint64_t descriptor[2] = {eptp, 0};
+        return __invept(INVEPT_TYPE_SINGLE_CONTEXT, descriptor);
+    }
+
+    virtual bool invept_all_contexts() const noexcept
+    {
+        uint64_t descriptor[2] = {0, 0};
+        return __invept(INVEPT_TYPE_ALL_CONTEXTS, descriptor);
+    }
 };
 
 // -----------------------------------------------------------------------------
@@ -198,6 +242,7 @@ public:
 #define VMCS_GUEST_LDTR_SELECTOR                                  0x0000080C
 #define VMCS_GUEST_TR_SELECTOR                                    0x0000080E
 #define VMCS_GUEST_INTERRUPT_STATUS                               0x00000810
+#define VMCS_GUEST_PML_INDEX                                      0x00000812
 
 // 16bit Host State Fields
 #define VMCS_HOST_ES_SELECTOR                                     0x00000C00
@@ -223,6 +268,8 @@ public:
 #define VMCS_VM_ENTRY_MSR_LOAD_ADDRESS_HIGH                       0x0000200B
 #define VMCS_EXECUTIVE_VMCS_POINTER_FULL                          0x0000200C
 #define VMCS_EXECUTIVE_VMCS_POINTER_HIGH                          0x0000200D
+#define VMCS_PML_ADDRESS_FULL                                     0x0000200E
+#define VMCS_PML_ADDRESS_HIGH                                     0x0000200F
 #define VMCS_TSC_OFFSET_FULL                                      0x00002010
 #define VMCS_TSC_OFFSET_HIGH                                      0x00002011
 #define VMCS_VIRTUAL_APIC_ADDRESS_FULL                            0x00002012
@@ -448,6 +495,7 @@ public:
 #define VM_EXEC_S_PROC_BASED_ENABLE_VM_FUNCTIONS                  (1ULL << 13)
 #define VM_EXEC_S_PROC_BASED_VMCS_SHADOWING                       (1ULL << 14)
 #define VM_EXEC_S_PROC_BASED_RDSEED_EXITING                       (1ULL << 16)
+#define VM_EXEC_S_PROC_BASED_ENABLE_PML                           (1ULL << 17)
 #define VM_EXEC_S_PROC_BASED_EPT_VIOLATION_VE                     (1ULL << 18)
 #define VM_EXEC_S_PROC_BASED_ENABLE_XSAVES_XRSTORS                (1ULL << 20)
 
@@ -536,8 +584,10 @@ public:
 #define VM_EXIT_REASON_INVPCID                                    (58)
 #define VM_EXIT_REASON_VMFUNC                                     (59)
 #define VM_EXIT_REASON_RDSEED                                     (61)
+#define VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL                 (62)
 #define VM_EXIT_REASON_XSAVES                                     (63)
 #define VM_EXIT_REASON_XRSTORS                                    (64)
+#define VM_EXIT_REASON_MAX                                        (VM_EXIT_REASON_XRSTORS)
 
 // VM Activity State
 // intel's software developers manual, volume 3, 24.4.2
@@ -585,9 +635,19 @@ public:
 
 // VPID and EPT Capabilities
 // intel's software developer's manual, volume 3, appendix A.10
+#define IA32_VMX_EPT_VPID_CAP_PAGE_WALK_LENGTH_4                  (1 << 6)
 #define IA32_VMX_EPT_VPID_CAP_UC                                  (1 << 8)
 #define IA32_VMX_EPT_VPID_CAP_WB                                  (1 << 14)
+#define IA32_VMX_EPT_VPID_CAP_2M                                  (1 << 16)
+#define IA32_VMX_EPT_VPID_CAP_1G                                  (1 << 17)
+#define IA32_VMX_EPT_VPID_CAP_INVEPT                              (1 << 20)
 #define IA32_VMX_EPT_VPID_CAP_AD                                  (1 << 21)
+#define IA32_VMX_EPT_VPID_CAP_INVEPT_SINGLE_CONTEXT               (1 << 25)
+#define IA32_VMX_EPT_VPID_CAP_INVEPT_ALL_CONTEXTS                 (1 << 26)
+#define IA32_VMX_EPT_VPID_CAP_INVVPID                             (1ULL << 32)
+#define IA32_VMX_EPT_VPID_CAP_INVVPID_INDIVIDUAL_ADDRESS          (1ULL << 40)
+#define IA32_VMX_EPT_VPID_CAP_INVVPID_SINGLE_CONTEXT              (1ULL << 41)
+#define IA32_VMX_EPT_VPID_CAP_INVVPID_ALL_CONTEXTS                (1ULL << 42)
 
 // EPTP Format
 // intel's software developer's manual, volume 3, appendix 24.6.11
@@ -595,4 +655,34 @@ public:
 #define EPTP_PAGE_WALK_LENGTH                              0x0000000000000038
 #define EPTP_ACCESSED_DIRTY_FLAGS_ENABLED                  0x0000000000000040
 
+// MSR Bitmaps
+// intel's software developer's manual, volume 3, section 24.6.9
+#define MSR_BITMAP_SIZE                                           (0x1000)
+#define MSR_BITMAP_READ_OFFSET                                    (0x000)
+#define MSR_BITMAP_WRITE_OFFSET                                   (0x800)
+#define MSR_BITMAP_HIGH_OFFSET                                    (0x400)
+#define MSR_BITMAP_LOW_MSRS_LAST                                  (0x00001FFF)
+#define MSR_BITMAP_HIGH_MSRS_FIRST                                (0xC0000000)
+#define MSR_BITMAP_HIGH_MSRS_LAST                                 (0xC0001FFF)
+
+// I/O Bitmaps
+// intel's software developer's manual, volume 3, section 24.6.4
+#define IO_BITMAP_SIZE                                            (0x1000)
+#define IO_BITMAP_NUM_PORTS                                       (0x10000)
+
+// I/O Instruction Exit Qualification
+// intel's software developer's manual, volume 3, table 27-5
+#define IO_EXIT_QUALIFICATION_SIZE                                (0x0000000000000007)
+#define IO_EXIT_QUALIFICATION_DIRECTION_IN                        (0x0000000000000008)
+#define IO_EXIT_QUALIFICATION_STRING                              (0x0000000000000010)
+#define IO_EXIT_QUALIFICATION_REP                                 (0x0000000000000020)
+#define IO_EXIT_QUALIFICATION_IMMEDIATE                           (0x0000000000000040)
+#define IO_EXIT_QUALIFICATION_PORT                                (0x00000000FFFF0000)
+#define IO_EXIT_QUALIFICATION_PORT_SHIFT                          (16)
+
+// Page-Modification Log
+// intel's software developer's manual, volume 3, section 28.2.6
+#define PML_NUM_ENTRIES                                           (512)
+#define PML_INDEX_START                                           (PML_NUM_ENTRIES - 1)
+
 #endif
@@ -56,6 +56,8 @@ void __write_rflags(uint64_t val) noexcept;
 uint64_t __read_msr(uint32_t msr) noexcept;
 void __write_msr(uint32_t msr, uint64_t val) noexcept;
 
+uint64_t __read_tsc(void) noexcept;
+
 uint64_t __read_rip(void) noexcept;
 
 uint64_t __read_cr0(void) noexcept;
@@ -104,9 +106,11 @@ void __write_idt(void *idt) noexcept;
 
 void __outb(uint16_t port, uint8_t val) noexcept;
 void __outw(uint16_t port, uint16_t val) noexcept;
+void __outd(uint16_t port, uint32_t val) noexcept;
 
 uint8_t __inb(uint16_t port) noexcept;
 uint16_t __inw(uint16_t port) noexcept;
+uint32_t __ind(uint16_t port) noexcept;
 
 #ifdef __cplusplus
 }
@@ -172,6 +176,9 @@ public:
     virtual void write_msr(uint32_t msr, uint64_t val) const noexcept
     { __write_msr(msr, val); }
 
+    virtual uint64_t read_tsc() const noexcept
+    { return __read_tsc(); }
+
     virtual uint64_t read_rip() const noexcept
     { return __read_rip(); }
 
@@ -268,11 +275,17 @@ public:
     virtual void write_portio_16(uint16_t port, uint16_t value) const noexcept
     { __outw(port, value); }
 
+    virtual void write_portio_32(uint16_t port, uint32_t value) const noexcept
+    { __outd(port, value); }
+
     virtual uint8_t read_portio_8(uint16_t port) const noexcept
     { return __inb(port); }
 
     virtual uint16_t read_portio_16(uint16_t port) const noexcept
     { return __inw(port); }
+
+    virtual uint32_t read_portio_32(uint16_t port) const noexcept
+    { return __ind(port); }
 };
 
 // -----------------------------------------------------------------------------
@@ -359,6 +372,16 @@ public:
 #define CR4_SMAP_SMAP_ENABLE_BIT                                    (1ULL << 21)
 #define CR4_PKE_PROTECTION_KEY_ENABLE_BIT                           (1ULL << 22)
 
+// 64-ia-32-architectures-software-developer-manual, section 3.2 (CPUID)
+// Extended Processor Info and Feature Bits
+#define CPUID_EXTENDED_FEATURE_BITS                                 0x80000001
+#define CPUID_EXTENDED_FEATURE_EDX_PDPE1GB                          (1U << 26)
+
+// 64-ia-32-architectures-software-developer-manual, section 3.2 (CPUID)
+// Virtual and Physical Address Sizes
+#define CPUID_ADDRESS_SIZES                                         0x80000008
+#define CPUID_ADDRESS_SIZES_EAX_PHYS_ADDR_BITS                      0x000000FF
+
 // 64-ia-32-architectures-software-developer-manual, section 35.1
 // IA-32 Architectural MSRs
 #define IA32_PERF_GLOBAL_CTRL_MSR                                   0x0000038F
@@ -367,6 +390,13 @@ public:
 #define IA32_SYSENTER_ESP_MSR                                       0x00000175
 #define IA32_SYSENTER_EIP_MSR                                       0x00000176
 #define IA32_PAT_MSR                                                0x00000277
+#define IA32_MTRRCAP_MSR                                            0x000000FE
+#define IA32_MTRR_PHYSBASE0_MSR                                     0x00000200
+#define IA32_MTRR_PHYSMASK0_MSR                                     0x00000201
+#define IA32_MTRR_FIX64K_00000_MSR                                  0x00000250
+#define IA32_MTRR_FIX16K_80000_MSR                                  0x00000258
+#define IA32_MTRR_FIX4K_C0000_MSR                                   0x00000268
+#define IA32_MTRR_DEF_TYPE_MSR                                      0x000002FF
 #define IA32_EFER_MSR                                               0xC0000080
 #define IA32_FS_BASE_MSR                                            0xC0000100
 #define IA32_GS_BASE_MSR                                            0xC0000101
@@ -417,6 +447,17 @@ public:
 #define IA32_EFER_LMA                                               (1ULL << 10)
 #define IA32_EFER_NXE                                               (1ULL << 11)
 
+// MTRRs
+// 64-ia-32-architectures-software-developer-manual, section 11.11
+#define IA32_MTRRCAP_VCNT                                           (0xFFULL)
+#define IA32_MTRRCAP_FIX                                            (1ULL << 8)
+#define IA32_MTRR_DEF_TYPE_TYPE                                     (0xFFULL)
+#define IA32_MTRR_DEF_TYPE_FE                                       (1ULL << 10)
+#define IA32_MTRR_DEF_TYPE_E                                        (1ULL << 11)
+#define IA32_MTRR_PHYSBASE_TYPE                                     (0xFFULL)
+#define IA32_MTRR_PHYSMASK_VALID                                    (1ULL << 11)
+#define IA32_MTRR_PHYS_ADDR_MASK                                    (0x000FFFFFFFFFF000ULL)
+
 // Serial COM Port Addresses
 // http://wiki.osdev.org/Serial_Ports
 #define COM1_PORT                                                   0x3f8
@@ -0,0 +1,125 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef DIRTY_RING_X64_H
+#define DIRTY_RING_X64_H
+
+#include <atomic>
+#include <memory>
+#include <constants.h>
+
+/// Dirty Ring
+///
+/// A single producer, single consumer ring of guest physical addresses.
+/// Each vCPU owns one of these, and pushes the pages that its
+/// page-modification log reports as dirty into it from the exit handler,
+/// while a consumer on any core pops them, without either side taking a
+/// lock. The producer only ever writes the tail, and the consumer only
+/// ever writes the head, so all that is needed is for each side to
+/// publish its index with a release store, after it is done with the
+/// entry.
+///
+/// The producer never waits for the consumer. If the ring is full, the
+/// address is dropped, and the drop is counted, so that the consumer can
+/// tell that it has missed pages (and needs to fall back to a full scan).
+///
+class dirty_ring_x64
+{
+public:
+
+    /// Default Constructor
+    ///
+    /// @expects size is a power of 2
+    ///
+    /// @param size the number of entries in the ring
+    ///
+    dirty_ring_x64(uint64_t size = DIRTY_RING_SIZE);
+
+    /// Destructor
+    ///
+    virtual ~dirty_ring_x64() = default;
+
+    /// Push
+    ///
+    /// Adds an address to the ring. This should only be called by the
+    /// producer (i.e. the vCPU that owns the ring).
+    ///
+    /// @param gpa the guest physical address to add
+    /// @return true if the address was added, false if the ring was full
+    ///     (in which case the drop is counted)
+    ///
+    virtual bool push(uintptr_t gpa) noexcept;
+
+    /// Pop
+    ///
+    /// Removes the oldest address from the ring. This should only be
+    /// called by the consumer, but can be called from any core.
+    ///
+    /// @param gpa where to store the address that was removed
+    /// @return true if an address was removed, false if the ring was empty
+    ///
+    virtual bool pop(uintptr_t &gpa) noexcept;
+
+    /// Size
+    ///
+    /// @return the number of addresses in the ring. Note that this is only
+    ///     a snapshot, as the other side might be using the ring.
+    ///
+    virtual uint64_t size() const noexcept;
+
+    /// Capacity
+    ///
+    /// @return the number of addresses that fit in the ring
+    ///
+    virtual uint64_t capacity() const noexcept
+    { return m_mask + 1; }
+
+    /// Drops
+    ///
+    /// @return the number of addresses that were dropped because the ring
+    ///     was full
+    ///
+    virtual uint64_t drops() const noexcept
+    { return m_drops.load(std::memory_order_relaxed); }
+
+private:
+
+    uint64_t m_mask;
+
+    std::unique_ptr<uintptr_t[]> m_entries;
+
+    std::atomic<uint64_t> m_head;
+    std::atomic<uint64_t> m_tail;
+    std::atomic<uint64_t> m_drops;
+
+public:
+
+    /// Disable the copy consturctor
+    ///
+    dirty_ring_x64(const dirty_ring_x64 &) = delete;
+
+    /// Disable the copy operator
+    ///
+    dirty_ring_x64 &operator=(const dirty_ring_x64 &) = delete;
+};
+
+#endif
@@ -0,0 +1,218 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef EPT_ENTRY_INTEL_X64_H
+#define EPT_ENTRY_INTEL_X64_H
+
+#include <stdint.h>
+#include <memory_manager/page_table_entry_x64.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+// -----------------------------------------------------------------------------
+
+// EPT Entry Format
+// intel's software developer's manual, volume 3, section 28.2.2
+#define EPTE_FLAGS_R (0x1ULL << 0)
+#define EPTE_FLAGS_W (0x1ULL << 1)
+#define EPTE_FLAGS_X (0x1ULL << 2)
+#define EPTE_FLAGS_IPAT (0x1ULL << 6)
+#define EPTE_FLAGS_PS (0x1ULL << 7)
+#define EPTE_FLAGS_A (0x1ULL << 8)
+#define EPTE_FLAGS_D (0x1ULL << 9)
+#define EPTE_FLAGS_MAPPED (0x1ULL << 11)
+#define EPTE_MEMORY_TYPE_SHIFT 3
+#define EPTE_MEMORY_TYPE_MASK (0x7ULL << EPTE_MEMORY_TYPE_SHIFT)
+#define EPTE_PHYS_ADDR_MASK 0x000FFFFFFFFFF000
+
+#define EPTE_FLAGS_RWX (EPTE_FLAGS_R | EPTE_FLAGS_W | EPTE_FLAGS_X)
+
+#define EPTE_FLAGS_ATTRS (EPTE_FLAGS_RWX | EPTE_MEMORY_TYPE_MASK | \
+                          EPTE_FLAGS_IPAT)
+
+// EPT Memory Types
+// intel's software developer's manual, volume 3, section 28.2.6
+#define EPT_MEMORY_TYPE_UC 0ULL
+#define EPT_MEMORY_TYPE_WC 1ULL
+#define EPT_MEMORY_TYPE_WT 4ULL
+#define EPT_MEMORY_TYPE_WP 5ULL
+#define EPT_MEMORY_TYPE_WB 6ULL
+
+#define EPTE_MEMORY_TYPE(a) ((a) << EPTE_MEMORY_TYPE_SHIFT)
+
+#include <gsl/gsl>
+
+// -----------------------------------------------------------------------------
+// Definition
+// -----------------------------------------------------------------------------
+
+/// EPT Entry
+///
+/// An EPT entry is a view of a single entry in a hardware extended page
+/// table. Like page_table_entry_x64, it does not own the entry, and it
+/// does not cache any of the entry's state, so it is cheap to create, and
+/// copy, on demand.
+///
+class ept_entry_intel_x64
+{
+public:
+
+    /// Default Constructor
+    ///
+    /// @param epte the entry that this EPT entry encapsulates.
+    ///
+    ept_entry_intel_x64(gsl::not_null<uintptr_t *> epte) noexcept;
+
+    /// Destructor
+    ///
+    virtual ~ept_entry_intel_x64() = default;
+
+    /// Read Access
+    ///
+    /// @return true if reads are allowed, false otherwise
+    ///
+    virtual bool read_access() const noexcept;
+
+    /// Set Read Access
+    ///
+    /// @param enabled true if reads are allowed, false otherwise
+    ///
+    virtual void set_read_access(bool enabled) noexcept;
+
+    /// Write Access
+    ///
+    /// @return true if writes are allowed, false otherwise
+    ///
+    virtual bool write_access() const noexcept;
+
+    /// Set Write Access
+    ///
+    /// @param enabled true if writes are allowed, false otherwise
+    ///
+    virtual void set_write_access(bool enabled) noexcept;
+
+    /// Execute Access
+    ///
+    /// @return true if instruction fetches are allowed, false otherwise
+    ///
+    virtual bool execute_access() const noexcept;
+
+    /// Set Execute Access
+    ///
+    /// @param enabled true if instruction fetches are allowed, false
+    ///     otherwise
+    ///
+    virtual void set_execute_access(bool enabled) noexcept;
+
+    /// Memory Type
+    ///
+    /// Only valid for entries that map a page.
+    ///
+    /// @return the EPT_MEMORY_TYPE_xxx of this entry
+    ///
+    virtual uint64_t memory_type() const noexcept;
+
+    /// Set Memory Type
+    ///
+    /// @expects type is one of the EPT_MEMORY_TYPE_xxx
+    ///
+    /// @param type the EPT_MEMORY_TYPE_xxx of this entry
+    ///
+    virtual void set_memory_type(uint64_t type);
+
+    /// Ignore PAT
+    ///
+    /// @return true if the guest's PAT is ignored for this entry, false
+    ///     otherwise
+    ///
+    virtual bool ignore_pat() const noexcept;
+
+    /// Set Ignore PAT
+    ///
+    /// @param enabled true if the guest's PAT is ignored for this entry,
+    ///     false otherwise
+    ///
+    virtual void set_ignore_pat(bool enabled) noexcept;
+
+    /// Page Size
+    ///
+    /// Only valid for PDPT and PD entries.
+    ///
+    /// @return true if this entry maps a large page, false otherwise
+    ///
+    virtual bool ps() const noexcept;
+
+    /// Set Page Size
+    ///
+    /// @param enabled true if the entry maps a large page, false otherwise
+    ///
+    virtual void set_ps(bool enabled) noexcept;
+
+    /// Accessed
+    ///
+    /// Only updated by the CPU if accessed and dirty flags are enabled in
+    /// the EPTP.
+    ///
+    /// @return true if this entry has been accessed, false otherwise
+    ///
+    virtual bool accessed() const noexcept;
+
+    /// Set Accessed
+    ///
+    /// @param enabled true if this entry has been accessed, false
+    ///     otherwise
+    ///
+    virtual void set_accessed(bool enabled) noexcept;
+
+    /// Dirty
+    ///
+    /// Only updated by the CPU if accessed and dirty flags are enabled in
+    /// the EPTP.
+    ///
+    /// @return true if this entry is dirty, false otherwise
+    ///
+    virtual bool dirty() const noexcept;
+
+    /// Set Dirty
+    ///
+    /// @param enabled true if this entry is dirty, false otherwise
+    ///
+    virtual void set_dirty(bool enabled) noexcept;
+
+    /// Physical Address
+    ///
+    /// @return the physical address of the entry
+    ///
+    virtual uintptr_t phys_addr() const noexcept;
+
+    /// Set Physical Address
+    ///
+    /// @param addr the physical address of the entry
+    ///
+    virtual void set_phys_addr(uintptr_t addr) noexcept;
+
+private:
+
+    gsl::not_null<uintptr_t *> m_epte;
+};
+
+#endif
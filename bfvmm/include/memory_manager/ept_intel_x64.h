@@ -0,0 +1,231 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef EPT_INTEL_X64_H
+#define EPT_INTEL_X64_H
+
+#include <memory>
+#include <vector>
+#include <memory_manager/ept_entry_intel_x64.h>
+
+#include <gsl/gsl>
+
+/// Extended Page Table
+///
+/// An extended page table owns a single hardware EPT table (a PML4, PDPT,
+/// PD or PT), which translates guest physical addresses into host physical
+/// addresses. Like page_table_x64, the hardware table is the only place the
+/// entries are stored, and the only software state a table keeps is a side
+/// array of the child tables it owns.
+///
+/// Large pages are used wherever the range allows it, as each large page
+/// saves the guest both TLB entries and page walk steps. Large pages are
+/// only split when part of one needs different attributes, and a table is
+/// merged back into a large page once all of its entries agree again.
+///
+/// Since another core might be walking the EPT (or have parts of it cached)
+/// while it is being modified, a table that is unlinked is not freed right
+/// away, but retired, and only freed by free_retired(), once every core has
+/// invalidated its cached translations.
+///
+class ept_intel_x64 : public ept_entry_intel_x64
+{
+public:
+
+    /// Constructor
+    ///
+    /// Creates an EPT table, and stores the parent entry that points to
+    /// this table, which is given full access (the leaf entries decide
+    /// the actual access rights).
+    ///
+    /// @param epte the parent EPT entry that points to this table
+    /// @param bits the index bits of this table's level (PML4_INDEX for
+    ///     a PML4, PT_INDEX for a PT)
+    ///
+    ept_intel_x64(uintptr_t *epte = nullptr, uint64_t bits = PML4_INDEX);
+
+    /// Destructor
+    ///
+    ~ept_intel_x64() override = default;
+
+    /// Map Range
+    ///
+    /// Maps the guest physical range [gpa, gpa + size) to the host physical
+    /// range [phys_addr, phys_addr + size), using 2MB or 1GB pages (up to
+    /// max_page_size) where both addresses are aligned, and enough of the
+    /// range is left. This should only be called on the PML4.
+    ///
+    /// If part of the range is already mapped, std::logic_error is thrown,
+    /// and the part of the range that was mapped before the overlap
+    /// remains mapped.
+    ///
+    /// @expects gpa, phys_addr and size are 4k aligned
+    /// @expects attrs only contains EPTE_FLAGS_ATTRS
+    /// @expects max_page_size is PAGE_SIZE_4K, PAGE_SIZE_2M or PAGE_SIZE_1G
+    ///
+    /// @param gpa the guest physical address of the start of the range
+    /// @param phys_addr the host physical address of the start of the range
+    /// @param size the size of the range in bytes
+    /// @param attrs the EPTE_FLAGS_xxx and memory type of each leaf entry
+    /// @param max_page_size the largest page size to map the range with.
+    ///     Note that 1GB pages are not supported by all CPUs.
+    ///
+    virtual void map_range(uintptr_t gpa, uintptr_t phys_addr, uint64_t size,
+                           uint64_t attrs, uint64_t max_page_size = PAGE_SIZE_2M);
+
+    /// Unmap Range
+    ///
+    /// Unmaps [gpa, gpa + size). Parts of the range that are not mapped
+    /// are ignored. A large page that is only partially covered by the
+    /// range is split first, and tables that no longer map anything are
+    /// retired (see free_retired()). Note that it is up to the caller to
+    /// INVEPT if this EPT is in use.
+    ///
+    /// @expects gpa and size are 4k aligned
+    ///
+    /// @param gpa the guest physical address of the start of the range
+    /// @param size the size of the range in bytes
+    ///
+    virtual void unmap_range(uintptr_t gpa, uint64_t size);
+
+    /// Protect Range
+    ///
+    /// Changes the attributes of [gpa, gpa + size) to attrs. Parts of the
+    /// range that are not mapped are ignored. A large page that is only
+    /// partially covered by the range is split (down to 4k pages if
+    /// needed), while a table whose entries end up with the same attributes,
+    /// and map contiguous memory, is merged back into a large page (up to
+    /// max_page_size), retiring the table (see free_retired()). Note that it
+    /// is up to the caller to INVEPT if this EPT is in use.
+    ///
+    /// @expects gpa and size are 4k aligned
+    /// @expects attrs only contains EPTE_FLAGS_ATTRS
+    /// @expects max_page_size is PAGE_SIZE_4K, PAGE_SIZE_2M or PAGE_SIZE_1G
+    ///
+    /// @param gpa the guest physical address of the start of the range
+    /// @param size the size of the range in bytes
+    /// @param attrs the EPTE_FLAGS_xxx and memory type of each leaf entry
+    /// @param max_page_size the largest page size tables are merged into
+    ///
+    virtual void protect_range(uintptr_t gpa, uint64_t size, uint64_t attrs,
+                               uint64_t max_page_size = PAGE_SIZE_2M);
+
+    /// Entry
+    ///
+    /// @param gpa the guest physical address to look up
+    /// @return the leaf entry that maps gpa
+    ///
+    /// @throws std::invalid_argument if gpa is not mapped
+    ///
+    virtual ept_entry_intel_x64 entry(uintptr_t gpa);
+
+    /// Harvest Dirty
+    ///
+    /// Reports which parts of [gpa, gpa + size) have been written to since
+    /// they were last harvested, and clears the dirty flags that it reports.
+    /// Bit i of the bitmap covers [gpa + i * granularity, gpa + (i + 1) *
+    /// granularity), and a page that is larger than the granularity sets
+    /// every bit that it covers (bits are only ever set, never cleared).
+    ///
+    /// A table whose parent entry does not have the accessed flag set has
+    /// not been walked by the CPU since the last harvest, and is skipped
+    /// without being read, which is what keeps a harvest of mostly idle
+    /// memory cheap. The accessed flag of a table is only cleared if the
+    /// range covers the whole table, and the dirty flag of a page is only
+    /// cleared if the range covers the whole page, so that harvesting the
+    /// range in pieces does not lose anything.
+    ///
+    /// Note that the CPU only sets these flags if accessed and dirty flags
+    /// are turned on in the EPTP, and that it is up to the caller to INVEPT
+    /// if any flags were cleared, as the TLB might still hold translations
+    /// that are already marked as dirty.
+    ///
+    /// @expects gpa and size are granularity aligned
+    /// @expects granularity is a power of two, and at least 4k
+    /// @expects bitmap has at least size / granularity bits
+    ///
+    /// @param gpa the guest physical address of the start of the range
+    /// @param size the size of the range in bytes
+    /// @param bitmap the bitmap to set the dirty bits in
+    /// @param granularity the number of bytes covered by each bit
+    /// @return the number of entries whose flags were cleared
+    ///
+    virtual uint64_t harvest_dirty(uintptr_t gpa, uint64_t size,
+                                   gsl::span<uint64_t> bitmap,
+                                   uint64_t granularity);
+
+    /// Number Of Tables
+    ///
+    /// @return the number of hardware EPT tables used by this table, and
+    ///     all of the tables below it
+    ///
+    virtual uint64_t num_tables() const noexcept;
+
+    /// Free Retired Tables
+    ///
+    /// Frees the tables that unmap_range() and protect_range() have
+    /// unlinked from this EPT. Until a core INVEPTs, it might still walk
+    /// these tables (or hold translations that they provided), so this
+    /// should only be called once every core that uses this EPT has
+    /// invalidated its translations since the tables were retired.
+    ///
+    virtual void free_retired() noexcept;
+
+    /// Number Of Retired Tables
+    ///
+    /// @return the number of tables that have been unlinked from this EPT,
+    ///     and are waiting to be freed by free_retired()
+    ///
+    virtual uint64_t num_retired() const noexcept;
+
+private:
+
+    friend class memory_manager_ut;
+
+    using retired_tables = std::vector<std::shared_ptr<ept_intel_x64>>;
+
+    void map_entries(uintptr_t gpa, uintptr_t phys_addr, uint64_t size, uint64_t attrs, uint64_t leaf_bits);
+    uint64_t unmap_entries(uintptr_t gpa, uint64_t size, retired_tables &retired);
+    uint64_t protect_entries(uintptr_t gpa, uint64_t size, uint64_t attrs, uint64_t leaf_bits,
+                             retired_tables &retired);
+    uint64_t harvest_entries(uintptr_t gpa, uint64_t size, uintptr_t base,
+                             gsl::span<uint64_t> bitmap, uint64_t granularity);
+
+    std::shared_ptr<ept_intel_x64> add_table(uint64_t index);
+    void split(uint64_t index);
+    void merge(uint64_t index, uint64_t leaf_bits, retired_tables &retired);
+    bool empty() const noexcept;
+
+private:
+
+    uint64_t m_bits;
+
+    gsl::span<uintptr_t> m_pt;
+    std::unique_ptr<uintptr_t[]> m_pt_owner;
+
+    std::unique_ptr<std::shared_ptr<ept_intel_x64>[]> m_tables;
+    retired_tables m_retired;
+
+    uintptr_t m_eptp_shadow;
+};
+
+#endif
@@ -22,10 +22,38 @@
 #ifndef MEMORY_MANAGER_H
 #define MEMORY_MANAGER_H
 
-#include <map>
+#include <vector>
 #include <stddef.h>
 #include <stdint.h>
 #include <memory.h>
+#include <memory_manager/memory_range_index.h>
+
+/// Memory Range Listener
+///
+/// Receives the ranges of virtual memory that are added to the memory
+/// manager (for example, the host page tables, which need to map each
+/// range that is added).
+///
+class memory_range_listener
+{
+public:
+
+    /// Destructor
+    ///
+    virtual ~memory_range_listener() = default;
+
+    /// Ranges Added
+    ///
+    /// Called with each set of ranges that is added to the memory manager,
+    /// while the memory manager's add_mdl lock is held, so calls are never
+    /// made in parallel. If this function throws, the ranges are removed
+    /// from the memory manager, and add_mdl fails.
+    ///
+    /// @param ranges the ranges that were added
+    /// @param num the number of ranges in ranges
+    ///
+    virtual void ranges_added(const memory_range *ranges, int64_t num) = 0;
+};
 
 /// The memory manager has two specific functions:
 /// - malloc / free memory
@@ -34,14 +62,21 @@
 /// To support malloc / free, the memory manager is given both heap memory
 /// and a page pool. If a malloc is requested whose size is a multiple of
 /// MAX_PAGE_SIZE, the page pool is used. All other requests come from the
-/// heap.
+/// heap. Small heap requests are first served from a per-core magazine
+/// cache, which is refilled from, and flushed to the heap in batches so
+/// that the global heap lock is only taken once per batch. The heap and the
+/// first page pool are built into the VMM, and the driver entry can add
+/// more page pools using add_pool. Heap requests that do not fit in the
+/// heap spill into the page pools that were added by the driver entry.
 ///
 /// To support virt / phys mappings, the memory manager has an add_mdl
 /// function that is called by the driver entry. Each time the driver entry
 /// allocates memory for an ELF module, it must call add_mdl with a list of
 /// page mappings that tells the VMM how to convert from virt to phys and back.
 /// The memory manager uses this information to provide the VMM with the needed
-/// conversions.
+/// conversions. Pages that are contiguous in both virtual and physical
+/// memory are merged into a single range, and conversions are done using a
+/// memory_range_index, and thus do not take a lock.
 ///
 /// Finally, this module also provides the libc functions that are needed by
 /// libc++ for new / delete. For this reason, this modules is required to get
@@ -103,6 +138,47 @@ public:
     ///
     virtual void free(void *ptr) noexcept;
 
+    /// Calloc
+    ///
+    /// Allocates memory for an array of nmemb elements of size bytes each,
+    /// and sets the memory to zero. Note that malloc does not zero memory,
+    /// so this is the only allocation function that pays for zeroing. Page
+    /// sized requests are served from a list of pages that were zeroed
+    /// ahead of time (see refill_zeroed_pages) if the list is not empty.
+    ///
+    /// @param nmemb the number of elements to allocate
+    /// @param size the size of each element in bytes
+    /// @return a pointer to the zeroed memory, or nullptr if the memory
+    ///     could not be allocated, or nmemb * size overflows
+    ///
+    virtual void *calloc(size_t nmemb, size_t size) noexcept;
+
+    /// Realloc
+    ///
+    /// Changes the size of memory previously allocated by a call to malloc.
+    /// If possible, the memory is resized in place. Heap memory grows in
+    /// place if the fragment that follows it is free and large enough, and
+    /// all memory can shrink in place. Otherwise, new memory is allocated,
+    /// the contents are copied, and the old memory is freed. If ptr is 0,
+    /// this is the same as malloc, and if size is 0, this is the same as
+    /// free.
+    ///
+    /// @param ptr a pointer to memory previously allocated using malloc
+    /// @param size the new size in bytes
+    /// @return a pointer to the resized memory, or nullptr if the memory
+    ///     could not be resized, in which case ptr is left untouched
+    ///
+    virtual void *realloc(void *ptr, size_t size) noexcept;
+
+    /// Refill Zeroed Pages
+    ///
+    /// Tops up the list of pre-zeroed pages that calloc uses for page sized
+    /// requests. Zeroing a page is expensive, so this should be called from
+    /// a path that is not performance sensitive (for example when a vCPU
+    /// is started) and not from an exit handler.
+    ///
+    virtual void refill_zeroed_pages() noexcept;
+
     /// Virtual Address To Physical Address
     ///
     /// Given a virtual address, returns a physical address. If the memory
@@ -191,35 +267,109 @@ public:
     ///
     virtual void *phys_to_virt_ptr(void *phys);
 
-    /// Adds Memory Descriptor List
+    /// Adds Memory Descriptor
     ///
-    /// Adds a memory descriptor list to the memory manager. The memory
+    /// Adds a memory descriptor to the memory manager. The memory
     /// descriptors are used by the memory manager to do address conversions
-    /// and lookup memory access rights. Note that this function should only
-    /// by called by the driver entry point prior to initialization.
+    /// and lookup memory access rights.
     ///
     /// @param md a pointer to a memory descriptor
     ///
-    /// @throws invalid_argument_error thrown if mdl == 0 or num == 0
-    /// @throws invalid_mdl_error thrown if a memory descriptor in the list
-    ///     is not the size of a page, if the virtual address is not page
+    /// @throws invalid_argument_error thrown if md == 0, or if the virt,
+    ///     phys or type of the memory descriptor is 0
+    /// @throws logic_error thrown if the virtual address is not page
     ///     aligned, or if the physical address is not page aligned.
     ///
     virtual void add_md(memory_descriptor *md);
 
-    /// Get Virt to Phys Map
+    /// Adds Memory Descriptor List
+    ///
+    /// Adds a memory descriptor list to the memory manager. This is the
+    /// same as calling add_md for each memory descriptor in the list, with
+    /// the exception that the list is validated as a whole prior to adding
+    /// any memory descriptors, and the lock is only taken once. If any of the
+    /// memory descriptors cannot be added, none of them are. Note that this
+    /// function should only by called by the driver entry point prior to
+    /// initialization.
+    ///
+    /// @param mdl a pointer to a list of memory descriptors
+    /// @param num the number of memory descriptors in the list
+    ///
+    /// @throws invalid_argument_error thrown if mdl == 0 or num <= 0, or if
+    ///     the virt, phys or type of a memory descriptor in the list is 0
+    /// @throws logic_error thrown if a memory descriptor in the list has a
+    ///     virtual or physical address that is not page aligned.
+    ///
+    virtual void add_mdl(memory_descriptor *mdl, int64_t num);
+
+    /// Add Pool
+    ///
+    /// Adds a chunk of memory to the memory manager as a new page pool. The
+    /// chunk is described by a memory descriptor list that must be
+    /// virtually contiguous and writable, and the list is added to the
+    /// memory manager (the same as add_mdl) so that the chunk can be
+    /// converted to physical addresses. The first few pages of the chunk
+    /// are used to keep track of the rest. Note that this function should
+    /// only be called by the driver entry prior to starting the VMM, as the
+    /// VMM's page tables are created from the memory descriptors when the
+    /// VMM is started.
+    ///
+    /// @param mdl a pointer to a list of memory descriptors
+    /// @param num the number of memory descriptors (pages) in the list
+    ///
+    /// @throws invalid_argument_error thrown if mdl == 0 or num < 2, or if
+    ///     the list is not virtually contiguous or not writable, or if
+    ///     add_mdl would throw
+    /// @throws runtime_error thrown if MAX_NUM_POOLS pools have already
+    ///     been added
+    ///
+    virtual void add_pool(memory_descriptor *mdl, int64_t num);
+
+    /// Get Virt to Phys Ranges
     ///
-    /// @return the entire virtual to physical memory descriptor map
+    /// @return the ranges of virtual memory that have been added, and the
+    ///     physical memory they map to, sorted by virtual address
     ///
-    virtual const std::map<uintptr_t, memory_descriptor> &virt_to_phys_map() const noexcept
-    { return m_virt_to_phys_map; }
+    virtual const std::vector<memory_range> &virt_to_phys_ranges() const noexcept
+    { return m_virt_to_phys_index.ranges(); }
 
-    /// Get Phys to Virt Map
+    /// Get Phys to Virt Ranges
     ///
-    /// @return the entire physical to virtual memory descriptor map
+    /// @return the ranges of physical memory that have been added, and the
+    ///     virtual memory they map to, sorted by physical address
     ///
-    virtual const std::map<uintptr_t, memory_descriptor> &phys_to_virt_map() const noexcept
-    { return m_phys_to_virt_map; }
+    virtual const std::vector<memory_range> &phys_to_virt_ranges() const noexcept
+    { return m_phys_to_virt_index.ranges(); }
+
+    /// Statistics
+    ///
+    /// Returns the memory manager's usage statistics (how much of the heap
+    /// and page pools are in use, their high-water marks, the largest free
+    /// fragments, and the number of allocations / frees per size class).
+    /// The counters are kept by whichever core already holds the lock for
+    /// the memory they describe, and are read without taking any locks, so
+    /// this is safe to call while the VMM is running, but the counters are
+    /// not read as a single atomic snapshot.
+    ///
+    /// @return the memory manager's usage statistics
+    ///
+    virtual memory_stats stats() const noexcept;
+
+    /// Set Range Listener
+    ///
+    /// Registers a listener that is told about each range of virtual
+    /// memory that is added. Before this function returns, the listener is
+    /// given all of the ranges that have already been added, under the
+    /// same lock as add_mdl, so the listener never misses, or sees twice,
+    /// any range. Only one listener is supported, and passing nullptr
+    /// removes the current listener.
+    ///
+    /// @param listener the listener to register
+    ///
+    /// @throws any exception thrown by listener, in which case the listener
+    ///     is not registered
+    ///
+    virtual void set_range_listener(memory_range_listener *listener);
 
 public:
 
@@ -240,8 +390,17 @@ private:
     virtual void free_heap(void *ptr) noexcept;
     virtual void free_page(void *ptr) noexcept;
 
+    virtual uint64_t magazine_id() const noexcept;
+    virtual void *malloc_magazine(size_t size) noexcept;
+    virtual bool free_magazine(void *ptr) noexcept;
+    virtual void flush_magazines() noexcept;
+
     virtual void clear() noexcept;
 
+    void *alloc_heap_blocks(int64_t blocks) noexcept;
+    void release_heap_blocks(int64_t idx) noexcept;
+    bool resize_heap_blocks(int64_t idx, int64_t blocks) noexcept;
+
 private:
 
     /// Default Constructor
@@ -250,11 +409,11 @@ private:
 
 private:
 
-    uint64_t m_heap_index;
-    uint64_t m_page_index;
+    bool m_magazines_enabled;
+    memory_range_listener *m_range_listener;
 
-    std::map<uintptr_t, memory_descriptor> m_virt_to_phys_map;
-    std::map<uintptr_t, memory_descriptor> m_phys_to_virt_map;
+    memory_range_index m_virt_to_phys_index;
+    memory_range_index m_phys_to_virt_index;
 };
 
 /// Memory Manager Macro
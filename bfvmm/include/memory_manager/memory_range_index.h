@@ -0,0 +1,161 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef MEMORY_RANGE_INDEX_H
+#define MEMORY_RANGE_INDEX_H
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+// -----------------------------------------------------------------------------
+// Definition
+// -----------------------------------------------------------------------------
+
+/// Memory Range
+///
+/// Describes a contiguous range of memory that maps to another contiguous
+/// range of memory (for example, a range of virtual addresses that maps to
+/// a range of physical addresses).
+///
+struct memory_range
+{
+    uintptr_t from;
+    uintptr_t to;
+    uintptr_t size;
+    uint8_t type;
+};
+
+/// Memory Range Index
+///
+/// Maps ranges of memory to other ranges of memory (for example, virtual
+/// addresses to physical addresses). Ranges that are contiguous on both
+/// sides, and have the same type, are merged into a single range, so the
+/// amount of memory used by the index, and the cost of a lookup, depend on
+/// the number of contiguous ranges, and not on the number of pages that
+/// are mapped.
+///
+/// Lookups are wait-free and O(log ranges). The ranges are stored as a
+/// sorted array that is never modified once it is published. Inserts and
+/// removals build a new array, and publish it with a single atomic store,
+/// so a lookup never takes a lock or retries. Each lookup registers itself
+/// with one of two reader counters (picked by the parity of the current
+/// epoch), and once a new array is published, the old array is freed as
+/// soon as every lookup that might still be using it has finished, so only
+/// one array is ever kept. Inserts and removals must be serialized by the
+/// caller, and since each one copies the array (and waits for in flight
+/// lookups), ranges should be inserted in batches when possible.
+///
+class memory_range_index
+{
+public:
+
+    using ranges_type = std::vector<memory_range>;
+
+    /// Constructor
+    ///
+    memory_range_index() noexcept;
+
+    /// Destructor
+    ///
+    /// @note this function is not safe to call while lookups are in flight
+    ///
+    virtual ~memory_range_index() = default;
+
+    /// Insert
+    ///
+    /// Adds a list of ranges to the index. Any memory that is already mapped
+    /// by a range in the index is replaced, and if ranges in the list
+    /// overlap, the range that comes last in the list wins.
+    ///
+    /// @note this function must be serialized with remove
+    ///
+    /// @param list the list of ranges to add
+    /// @param num the number of ranges in the list
+    ///
+    /// @throws std::invalid_argument if list == nullptr, or if a range in
+    ///     the list has a size of 0 or wraps around the address space
+    ///
+    virtual void insert(const memory_range *list, int64_t num);
+
+    /// Remove
+    ///
+    /// Removes [from, from + size) from the index. Ranges that are only
+    /// partially removed are split. If the memory is not mapped, the call is
+    /// ignored.
+    ///
+    /// @note this function must be serialized with insert
+    ///
+    /// @param from the start of the memory to unmap
+    /// @param size the number of bytes to unmap
+    ///
+    virtual void remove(uintptr_t from, uintptr_t size);
+
+    /// Lookup
+    ///
+    /// @param from the address to translate
+    /// @return the address that "from" maps to, or 0 if "from" is not mapped
+    ///
+    virtual uintptr_t lookup(uintptr_t from) const noexcept;
+
+    /// Ranges
+    ///
+    /// @return the ranges in the index, sorted by "from". The returned list
+    ///     is never modified, and remains valid until the next insert or
+    ///     remove, so the caller must serialize this with insert / remove.
+    ///
+    virtual const ranges_type &ranges() const noexcept
+    { return *m_current.load(std::memory_order_acquire); }
+
+public:
+
+    /// Disable the copy consturctor
+    ///
+    memory_range_index(const memory_range_index &) = delete;
+
+    /// Disable the copy operator
+    ///
+    memory_range_index &operator=(const memory_range_index &) = delete;
+
+private:
+
+    using working_type = std::map<uintptr_t, memory_range>;
+
+    working_type working_copy() const;
+    void publish(const working_type &ranges);
+    void synchronize() noexcept;
+
+    static void carve(working_type &ranges, uintptr_t from, uintptr_t size);
+    static void place(working_type &ranges, const memory_range &range);
+
+private:
+
+    ranges_type m_empty;
+    std::atomic<const ranges_type *> m_current;
+    std::unique_ptr<ranges_type> m_version;
+
+    std::atomic<uint64_t> m_epoch;
+    mutable std::atomic<uint64_t> m_readers[2];
+};
+
+#endif
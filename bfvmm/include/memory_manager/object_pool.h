@@ -0,0 +1,241 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <new>
+#include <mutex>
+#include <memory>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <constants.h>
+
+/// Object Pool Slot Size
+///
+/// Objects that are smaller than a cache line are rounded up to a power of
+/// two so that they never straddle a cache line, and larger objects are
+/// rounded up to a multiple of a cache line so that two objects never
+/// share one (which would cause false sharing between vCPUs).
+///
+/// @param size the size of the object
+/// @param slot the smallest slot size to consider
+/// @return the size of the slot the object is stored in
+///
+constexpr size_t
+object_pool_slot_size(size_t size, size_t slot = sizeof(void *)) noexcept
+{
+    return size > MAX_CACHE_LINE_SIZE ?
+           (size + MAX_CACHE_LINE_SIZE - 1) & ~(MAX_CACHE_LINE_SIZE - 1) :
+           slot >= size ? slot : object_pool_slot_size(size, slot << 1);
+}
+
+/// Object Pool
+///
+/// Hands out fixed size slots that are carved out of slabs of
+/// OBJECT_POOL_SLAB_SIZE bytes. Freed slots are kept on a free list (stored
+/// in the slots themselves) and are reused before a new slab is allocated,
+/// so allocating an object is a lock and a pop instead of a trip through the
+/// general purpose allocator, and a slab refill replaces OBJECT_POOL_SLAB_SIZE
+/// / slot_size mallocs. Slabs are never returned to the memory manager, as
+/// the objects that use the object pools (page tables, vCPUs) are created
+/// in bulk, and are recreated in bulk as well.
+///
+/// There is one object pool per slot size, which is shared by all of the
+/// types with that slot size. Use object_pool_allocator to allocate objects
+/// from the object pools.
+///
+template<size_t slot_size>
+class object_pool
+{
+    static_assert(slot_size >= sizeof(void *), "slot is too small");
+    static_assert(slot_size <= OBJECT_POOL_SLAB_SIZE, "slot is too large");
+
+public:
+
+    /// Get Singleton Instance
+    ///
+    /// @return the object pool for slot_size
+    ///
+    static object_pool *instance() noexcept
+    {
+        static object_pool self;
+        return &self;
+    }
+
+    /// Allocate
+    ///
+    /// @return a slot of slot_size bytes
+    ///
+    /// @throws std::bad_alloc thrown if a new slab is needed, and it could
+    ///     not be allocated
+    ///
+    void *allocate()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (m_free == nullptr)
+            refill();
+
+        auto slot = m_free;
+        m_free = slot->next;
+
+        return slot;
+    }
+
+    /// Deallocate
+    ///
+    /// @param ptr a slot previously returned by allocate. If ptr is 0, the
+    ///     call is ignored.
+    ///
+    void deallocate(void *ptr) noexcept
+    {
+        if (ptr == nullptr)
+            return;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto slot = static_cast<free_slot *>(ptr);
+        slot->next = m_free;
+        m_free = slot;
+    }
+
+    /// Number Of Slabs
+    ///
+    /// @return the number of slabs that have been allocated by this pool
+    ///
+    uint64_t num_slabs() const noexcept
+    { return m_num_slabs; }
+
+private:
+
+    struct free_slot
+    { free_slot *next; };
+
+    void refill()
+    {
+        // Slabs are a multiple of a page, and thus are page aligned, which
+        // keeps each slot aligned to it's size (or a cache line).
+
+        auto slab = static_cast<uint8_t *>(malloc(OBJECT_POOL_SLAB_SIZE));
+
+        if (slab == nullptr)
+            throw std::bad_alloc();
+
+        for (auto i = (OBJECT_POOL_SLAB_SIZE / slot_size); i > 0; i--)
+        {
+            auto slot = reinterpret_cast<free_slot *>(slab + ((i - 1) * slot_size));
+            slot->next = m_free;
+            m_free = slot;
+        }
+
+        m_num_slabs++;
+    }
+
+    object_pool() noexcept = default;
+
+private:
+
+    std::mutex m_mutex;
+    free_slot *m_free{nullptr};
+    uint64_t m_num_slabs{0};
+
+public:
+
+    object_pool(const object_pool &) = delete;
+    object_pool &operator=(const object_pool &) = delete;
+};
+
+/// Object Pool Allocator
+///
+/// A standard allocator that allocates single objects from the object pool
+/// for the object's slot size. This is meant to be used with
+/// std::allocate_shared, which rebinds the allocator to the type that holds
+/// both the object and it's reference counts, so that the object and it's
+/// control block come from the object pool with a single allocation.
+/// Requests for more than one object (which the object pools do not
+/// support) fall back to new / delete.
+///
+/// @code
+/// auto pt = std::allocate_shared<page_table_x64>(object_pool_allocator<page_table_x64>());
+/// @endcode
+///
+template<typename T>
+class object_pool_allocator
+{
+public:
+
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    { using other = object_pool_allocator<U>; };
+
+    object_pool_allocator() noexcept = default;
+
+    template<typename U>
+    object_pool_allocator(const object_pool_allocator<U> &) noexcept
+    { }
+
+    T *allocate(size_t n)
+    {
+        static_assert(alignof(T) <= MAX_CACHE_LINE_SIZE, "object is over aligned");
+
+        if (n != 1)
+            return static_cast<T *>(::operator new(n * sizeof(T)));
+
+        return static_cast<T *>(pool()->allocate());
+    }
+
+    void deallocate(T *ptr, size_t n) noexcept
+    {
+        if (n != 1)
+            return ::operator delete(ptr);
+
+        pool()->deallocate(ptr);
+    }
+
+    static object_pool<object_pool_slot_size(sizeof(T))> *pool() noexcept
+    { return object_pool<object_pool_slot_size(sizeof(T))>::instance(); }
+};
+
+template<typename T, typename U>
+bool operator==(const object_pool_allocator<T> &, const object_pool_allocator<U> &) noexcept
+{ return true; }
+
+template<typename T, typename U>
+bool operator!=(const object_pool_allocator<T> &, const object_pool_allocator<U> &) noexcept
+{ return false; }
+
+/// Allocate Shared From Object Pool
+///
+/// Same as std::make_shared, except that the object (and it's control
+/// block) are allocated from an object pool.
+///
+/// @param args the arguments to pass to T's constructor
+/// @return a shared_ptr to the newly created T
+///
+template<typename T, typename... Args>
+std::shared_ptr<T> make_pooled(Args &&... args)
+{ return std::allocate_shared<T>(object_pool_allocator<T>(), std::forward<Args>(args)...); }
+
+#endif
@@ -33,6 +33,8 @@
 #define BITS_PER_INDEX 9
 #define INDEX_MASK 0x1FFULL
 #define PML4_INDEX 39
+#define PDPT_INDEX 30
+#define PD_INDEX 21
 #define PT_INDEX 12
 #define PTE_PHYS_ADDR_MASK 0x000FFFFFFFFFF000
 
@@ -44,24 +46,40 @@
 #define PTE_FLAGS_A (0x1ULL << 5)
 #define PTE_FLAGS_D (0x1ULL << 6)
 #define PTE_FLAGS_PAT (0x1ULL << 7)
+#define PTE_FLAGS_PS (0x1ULL << 7)
 #define PTE_FLAGS_G (0x1ULL << 8)
+#define PTE_FLAGS_MAPPED (0x1ULL << 9)
 #define PTE_FLAGS_NX (0x1ULL << 63)
 
 #define PT_BYTES (PT_SIZE * PTE_SIZE)
 
+#define PTE_FLAGS_ATTRS (PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_US | \
+                         PTE_FLAGS_PWT | PTE_FLAGS_PCD | PTE_FLAGS_A | \
+                         PTE_FLAGS_D | PTE_FLAGS_G | PTE_FLAGS_NX)
+
+#define PAGE_SIZE_4K (0x1ULL << PT_INDEX)
+#define PAGE_SIZE_2M (0x1ULL << PD_INDEX)
+#define PAGE_SIZE_1G (0x1ULL << PDPT_INDEX)
+
 #include <gsl/gsl>
 
 // -----------------------------------------------------------------------------
 // Definition
 // -----------------------------------------------------------------------------
 
+/// Page Table Entry
+///
+/// A page table entry is a view of a single entry in a hardware page
+/// table. It does not own the entry, and it does not cache any of the
+/// entry's state, so it is cheap to create, and copy, on demand.
+///
 class page_table_entry_x64
 {
 public:
 
     /// Default Constructor
     ///
-    /// @param entry the entry that this page table entry encapsulates.
+    /// @param pte the entry that this page table entry encapsulates.
     ///
     page_table_entry_x64(gsl::not_null<uintptr_t *> pte) noexcept;
 
@@ -169,6 +187,21 @@ public:
     ///
     virtual void set_pat(bool enabled) noexcept;
 
+    /// Page Size
+    ///
+    /// Only valid for PDPT and PD entries, where this bit shares its
+    /// position with the PAT bit of a PT entry.
+    ///
+    /// @return true if this entry maps a large page, false otherwise
+    ///
+    virtual bool ps() const noexcept;
+
+    /// Set Page Size
+    ///
+    /// @param enabled true if the entry maps a large page, false otherwise
+    ///
+    virtual void set_ps(bool enabled) noexcept;
+
     /// Global
     ///
     /// @return true if this entry is global, false otherwise
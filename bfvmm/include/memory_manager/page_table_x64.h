@@ -19,15 +19,29 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+
 #ifndef PAGE_TABLE_X64_H
 #define PAGE_TABLE_X64_H
 
-#include <vector>
 #include <memory>
+#include <vector>
 #include <memory_manager/page_table_entry_x64.h>
 
 #include <gsl/gsl>
 
+/// Page Table
+///
+/// A page table owns a single hardware page table (a PML4, PDPT, PD or PT),
+/// which is the only place the entries of the table are stored. Entries
+/// are handed out as page_table_entry_x64 views of the hardware table. The
+/// only software state a table keeps is a side array of the child tables
+/// it owns, which a PT (the last level) does not have.
+///
+/// Since another core might be walking these page tables (or have parts of
+/// them cached) while they are being modified, a table that is unlinked is
+/// not freed right away, but retired, and only freed by free_retired(),
+/// once every core has flushed its TLB.
+///
 class page_table_x64 : public page_table_entry_x64
 {
 public:
@@ -38,9 +52,19 @@ public:
     /// this entry so that you can modify the properties of this page table
     /// as needed.
     ///
+    /// The parent entry is written with a single atomic store once the
+    /// table has been filled in, so that the page tables can be changed
+    /// while they are in use.
+    ///
     /// @param pte the parent page table entry that points to this table
+    /// @param bits the index bits of this table's level (PML4_INDEX for
+    ///     a PML4, PT_INDEX for a PT)
+    /// @param large_page if not 0, the large page entry that this table
+    ///     replaces. The table is filled with smaller pages that map the
+    ///     same memory, with the same attributes, before the parent entry
+    ///     is replaced, so the memory never becomes unmapped.
     ///
-    page_table_x64(uintptr_t *pte = nullptr);
+    page_table_x64(uintptr_t *pte = nullptr, uint64_t bits = PML4_INDEX, uintptr_t large_page = 0);
 
     /// Destructor
     ///
@@ -58,18 +82,152 @@ public:
     /// @return the resulting page. Note that this page is blank, and it's
     ///     properties (like present) should be set by the caller
     ///
-    virtual std::shared_ptr<page_table_entry_x64> add_page(uintptr_t virt_addr);
+    virtual page_table_entry_x64 add_page(uintptr_t virt_addr);
+
+    /// Add 2MB Page
+    ///
+    /// Adds a 2MB page to the page table structure. The resulting entry
+    /// lives in the PD, and has its PS bit set. Like add_page, this should
+    /// only be called on the PML4 page table.
+    ///
+    /// @expects virt_addr is 2MB aligned
+    ///
+    /// @param virt_addr the virtual address to add to the set of page tables.
+    /// @return the resulting page. Note that only the PS bit is set, the
+    ///     rest of it's properties should be set by the caller
+    ///
+    virtual page_table_entry_x64 add_page_2m(uintptr_t virt_addr);
+
+    /// Add 1GB Page
+    ///
+    /// Adds a 1GB page to the page table structure. The resulting entry
+    /// lives in the PDPT, and has its PS bit set. Like add_page, this should
+    /// only be called on the PML4 page table.
+    ///
+    /// @expects virt_addr is 1GB aligned
+    ///
+    /// @param virt_addr the virtual address to add to the set of page tables.
+    /// @return the resulting page. Note that only the PS bit is set, the
+    ///     rest of it's properties should be set by the caller
+    ///
+    virtual page_table_entry_x64 add_page_1g(uintptr_t virt_addr);
+
+    /// Map Range
+    ///
+    /// Maps [virt_addr, virt_addr + size) to [phys_addr, phys_addr + size).
+    /// Each level of the page tables is walked once for the entire range,
+    /// and the leaf entries are filled in one after another. Where both
+    /// addresses are aligned, and enough of the range is left, a 2MB or
+    /// 1GB page is used instead of 4k pages (up to max_page_size).
+    /// Like add_page, this should only be called on the PML4 page table.
+    ///
+    /// If part of the range is already mapped, std::logic_error is thrown,
+    /// and the part of the range that was mapped before the overlap
+    /// remains mapped.
+    ///
+    /// @expects virt_addr, phys_addr and size are 4k aligned
+    /// @expects attrs only contains PTE_FLAGS_ATTRS
+    /// @expects max_page_size is PAGE_SIZE_4K, PAGE_SIZE_2M or PAGE_SIZE_1G
+    ///
+    /// @param virt_addr the virtual address of the start of the range
+    /// @param phys_addr the physical address of the start of the range
+    /// @param size the size of the range in bytes
+    /// @param attrs the PTE_FLAGS_xxx to set in each of the leaf entries
+    /// @param max_page_size the largest page size to map the range with.
+    ///     Note that 1GB pages are not supported by all CPUs.
+    ///
+    virtual void map_range(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size,
+                           uint64_t attrs, uint64_t max_page_size = PAGE_SIZE_2M);
+
+    /// Remap Range
+    ///
+    /// Like map_range, but memory in the range that is already mapped is
+    /// replaced instead of causing an error. Each entry is replaced with a
+    /// single atomic store, so memory in the range never becomes unmapped,
+    /// which allows these page tables to be changed while they are in use.
+    /// A large page that is only partially covered by the range is split
+    /// first (which also never unmaps it), and existing tables are kept, so
+    /// the range might end up mapped with smaller pages than max_page_size.
+    /// Note that it is up to the caller to flush the TLB if these page
+    /// tables are in use.
+    ///
+    /// @expects virt_addr, phys_addr and size are 4k aligned
+    /// @expects attrs only contains PTE_FLAGS_ATTRS
+    /// @expects max_page_size is PAGE_SIZE_4K, PAGE_SIZE_2M or PAGE_SIZE_1G
+    ///
+    /// @param virt_addr the virtual address of the start of the range
+    /// @param phys_addr the physical address of the start of the range
+    /// @param size the size of the range in bytes
+    /// @param attrs the PTE_FLAGS_xxx to set in each of the leaf entries
+    /// @param max_page_size the largest page size to map the range with.
+    ///
+    virtual void remap_range(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size,
+                             uint64_t attrs, uint64_t max_page_size = PAGE_SIZE_2M);
+
+    /// Unmap Range
+    ///
+    /// Unmaps [virt_addr, virt_addr + size). Parts of the range that are
+    /// not mapped are ignored. A large page that is only partially covered
+    /// by the range is split into smaller pages first, and tables that no
+    /// longer map anything are retired (see free_retired()). Note that it
+    /// is up to the caller to flush the TLB if these page tables are in use.
+    ///
+    /// @expects virt_addr and size are 4k aligned
+    ///
+    /// @param virt_addr the virtual address of the start of the range
+    /// @param size the size of the range in bytes
+    ///
+    virtual void unmap_range(uintptr_t virt_addr, uint64_t size);
+
+    /// Number Of Tables
+    ///
+    /// @return the number of hardware page tables used by this table, and
+    ///     all of the tables below it
+    ///
+    virtual uint64_t num_tables() const noexcept;
+
+    /// Free Retired Tables
+    ///
+    /// Frees the tables that unmap_range() has unlinked from these page
+    /// tables. Until a core flushes its TLB, it might still walk these
+    /// tables (or hold paging-structure entries that point to them), so
+    /// this should only be called once every core that uses these page
+    /// tables has flushed its TLB since the tables were retired.
+    ///
+    virtual void free_retired() noexcept;
+
+    /// Number Of Retired Tables
+    ///
+    /// @return the number of tables that have been unlinked from these
+    ///     page tables, and are waiting to be freed by free_retired()
+    ///
+    virtual uint64_t num_retired() const noexcept;
 
 private:
 
-    virtual std::shared_ptr<page_table_entry_x64> add_page(uintptr_t virt_addr, uint64_t bits);
+    friend class memory_manager_ut;
+
+    using retired_tables = std::vector<std::shared_ptr<page_table_x64>>;
+
+    page_table_entry_x64 add_page(uintptr_t virt_addr, uint64_t leaf_bits);
+
+    void map_entries(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size, uint64_t attrs, uint64_t leaf_bits);
+    void remap_entries(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size, uint64_t attrs, uint64_t leaf_bits);
+    uint64_t unmap_entries(uintptr_t virt_addr, uint64_t size, retired_tables &retired);
+
+    std::shared_ptr<page_table_x64> add_table(uint64_t index);
+    std::shared_ptr<page_table_x64> split(uint64_t index);
+    bool empty() const noexcept;
 
 private:
 
+    uint64_t m_bits;
+
     gsl::span<uintptr_t> m_pt;
     std::unique_ptr<uintptr_t[]> m_pt_owner;
 
-    std::vector<std::shared_ptr<page_table_entry_x64> > m_ptes;
+    std::unique_ptr<std::shared_ptr<page_table_x64>[]> m_tables;
+    retired_tables m_retired;
 
     uintptr_t m_cr3_shadow;
 };
@@ -0,0 +1,91 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef PAGE_WALKER_X64_H
+#define PAGE_WALKER_X64_H
+
+#include <stdint.h>
+#include <memory_manager/page_table_entry_x64.h>
+
+/// Page Walk
+///
+/// The result of a page walk. If present is false, the rest of the fields
+/// are not valid. The permissions are the combined permissions of every
+/// level of the walk (i.e. an address is only writable if each level is
+/// writable, and is not executable if any level is not executable).
+///
+struct page_walk_x64
+{
+    bool present;
+    uintptr_t phys;
+    uint64_t page_size;
+    bool rw;
+    bool us;
+    bool nx;
+};
+
+/// Page Walker
+///
+/// Translates virtual addresses by walking x64 4-level page tables in
+/// software, the same way the hardware does. This works for both the
+/// host's page tables (root_page_table_x64), and a guest's page tables
+/// (GVA -> GPA, using the guest's CR3).
+///
+/// Each table of the walk has to be readable by the VMM. By default, the
+/// tables are located using the memory manager's phys_to_virt, which knows
+/// about all of the memory that has been given to the VMM (including the
+/// host page tables). Subclasses can override table() to read tables from
+/// other memory.
+///
+class page_walker_x64
+{
+public:
+
+    /// Default Constructor
+    ///
+    page_walker_x64() noexcept = default;
+
+    /// Destructor
+    ///
+    virtual ~page_walker_x64() = default;
+
+    /// Walk
+    ///
+    /// @param cr3 the CR3 of the page tables to walk
+    /// @param virt the virtual address to translate
+    /// @return the result of the walk. If a level of the walk is not
+    ///     present (or cannot be read), the result is not present.
+    ///
+    virtual page_walk_x64 walk(uintptr_t cr3, uintptr_t virt) const;
+
+protected:
+
+    /// Table
+    ///
+    /// @param phys the physical address of a page table
+    /// @return a pointer to the page table, or nullptr if the table cannot
+    ///     be read
+    ///
+    virtual const uintptr_t *table(uintptr_t phys) const;
+};
+
+#endif
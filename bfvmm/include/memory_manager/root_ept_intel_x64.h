@@ -0,0 +1,302 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef ROOT_EPT_INTEL_X64_H
+#define ROOT_EPT_INTEL_X64_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <memory.h>
+#include <intrinsics/intrinsics_intel_x64.h>
+#include <memory_manager/ept_intel_x64.h>
+
+// -----------------------------------------------------------------------------
+// Macros
+// -----------------------------------------------------------------------------
+
+// EPTP Format
+// intel's software developer's manual, volume 3, section 24.6.11
+#define EPTP_PAGE_WALK_LENGTH_4 (0x3ULL << 3)
+
+// The identity map is made of 2MB (or larger) pages, so the CPU cannot
+// tell us about writes at a finer granularity than this anyways, and with
+// 2MB granules, each dirty bitmap covers 8GB of memory.
+#define EPT_DIRTY_BITMAP_GRANULARITY PAGE_SIZE_2M
+
+// -----------------------------------------------------------------------------
+// Definition
+// -----------------------------------------------------------------------------
+
+/// Root EPT
+///
+/// The root EPT is the set of extended page tables (starting with a PML4)
+/// that is shared by every vCPU that runs the host OS. It identity maps
+/// host physical memory, with full access, using the largest pages that
+/// the CPU supports, so that turning EPT on costs the host OS as few TLB
+/// entries (and page walk steps) as possible.
+///
+/// Like the root page table, the EPT is built once, by whichever core
+/// calls eptp() first, and the resulting EPTP is published atomically.
+///
+/// Each vCPU that uses the EPT attaches its acknowledged generation (see
+/// attach()), which it updates each time it INVEPTs. Tables that are
+/// unlinked from the EPT are only freed once every attached vCPU has
+/// acknowledged a generation that is at least as new as the modification
+/// that unlinked them, as until then a vCPU might still be walking them.
+///
+/// With EPT on, the MTRRs no longer take part in the guest's memory type,
+/// so the identity map is split along the MTRRs, and each part is given
+/// the memory type the MTRRs give it (see eptp()).
+///
+/// The root EPT is opt-in (see enable()), as it only covers the first
+/// EPT_IDENTITY_MAP_SIZE bytes of memory (EPT violations are not handled).
+///
+class root_ept_intel_x64
+{
+public:
+
+    /// Default Constructor
+    ///
+    /// @param intrinsics the intrinsics used to force this core to exit
+    ///     while waiting for the vCPUs to acknowledge a harvest
+    ///
+    root_ept_intel_x64(std::shared_ptr<intrinsics_intel_x64> intrinsics = nullptr);
+
+    /// Destructor
+    ///
+    virtual ~root_ept_intel_x64() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static root_ept_intel_x64 *instance() noexcept;
+
+    /// Enable
+    ///
+    /// Tells each VMCS that is set up from now on to turn EPT on, using the
+    /// root EPT. This is off by default, as any access to memory above the
+    /// identity map halts the host. Only enable this on systems where all
+    /// of memory (including MMIO) is below the identity map's size.
+    ///
+    virtual void enable() noexcept;
+
+    /// Is Enabled
+    ///
+    /// @return true if enable() has been called, false otherwise
+    ///
+    virtual bool is_enabled() const noexcept;
+
+    /// EPTP
+    ///
+    /// Returns the EPTP of the root EPT, building the identity map first if
+    /// this is the first call.
+    ///
+    /// The identity map's memory types are taken from the calling core's
+    /// MTRRs (which the OS keeps the same on every core). Each part of the
+    /// identity map gets the type that the fixed and variable MTRRs give it,
+    /// and the ignore PAT bit is left clear, so the guest's PAT is combined
+    /// with it the same way it would be combined with the MTRRs.
+    ///
+    /// @return the physical address of the root EPT's PML4, with a write-
+    ///     back memory type, and a page walk length of 4
+    ///
+    /// @throws std::runtime_error if a variable MTRR's mask is not
+    ///     contiguous
+    /// @throws any exception thrown while building the identity map, in
+    ///     which case the next call will try again
+    ///
+    virtual uint64_t eptp();
+
+    /// Set Max Page Size
+    ///
+    /// Sets the largest page size that is used to map memory, and that
+    /// pages are merged back into. This should be called before eptp().
+    /// Defaults to PAGE_SIZE_2M, as 1GB pages are not supported by all CPUs.
+    ///
+    /// @expects max_page_size is PAGE_SIZE_2M or PAGE_SIZE_1G
+    ///
+    /// @param max_page_size the largest page size to map memory with
+    ///
+    virtual void set_max_page_size(uint64_t max_page_size);
+
+    /// Set Identity Map Size
+    ///
+    /// Sets how much host physical memory is identity mapped. This should
+    /// be called before eptp(), and should not be larger than the CPU's
+    /// physical address width allows. Defaults to EPT_IDENTITY_MAP_SIZE.
+    ///
+    /// @expects size is non-zero, 2MB aligned, and no larger than 256TB
+    ///
+    /// @param size the size of the identity map in bytes
+    ///
+    virtual void set_identity_map_size(uint64_t size);
+
+    /// Enable Accessed And Dirty Flags
+    ///
+    /// Tells the CPU to set the accessed and dirty flags of the EPT's
+    /// entries (which is needed to harvest dirty pages). This should be
+    /// called before eptp(), and only if the CPU supports it.
+    ///
+    virtual void enable_accessed_dirty() noexcept;
+
+    /// Attach
+    ///
+    /// Registers a vCPU that uses the EPT. The vCPU must INVEPT, and then
+    /// store the generation() it read before the INVEPT into *acked, each
+    /// time it sees a new generation.
+    ///
+    /// @expects acked != nullptr
+    ///
+    /// @param acked the last generation the vCPU has acknowledged
+    ///
+    virtual void attach(std::atomic<uint64_t> *acked);
+
+    /// Detach
+    ///
+    /// Unregisters a vCPU that no longer uses the EPT. Does nothing if the
+    /// vCPU is not attached.
+    ///
+    /// @param acked the pointer that was given to attach()
+    ///
+    virtual void detach(std::atomic<uint64_t> *acked) noexcept;
+
+    /// Protect Range
+    ///
+    /// Changes the attributes of [gpa, gpa + size), splitting large pages,
+    /// and merging them back, as needed (see ept_intel_x64::protect_range).
+    /// Builds the identity map first if needed. The generation is
+    /// incremented, so that each vCPU INVEPTs before it next resumes the
+    /// guest, and tables that this unlinks are freed once every attached
+    /// vCPU has acknowledged the new generation. Note that the memory type
+    /// in attrs replaces the one the range was given from the MTRRs.
+    ///
+    /// @expects gpa and size are 4k aligned
+    /// @expects attrs only contains EPTE_FLAGS_ATTRS
+    ///
+    /// @param gpa the guest physical address of the start of the range
+    /// @param size the size of the range in bytes
+    /// @param attrs the EPTE_FLAGS_xxx and memory type of each leaf entry
+    ///
+    virtual void protect_range(uintptr_t gpa, uint64_t size, uint64_t attrs);
+
+    /// Harvest Dirty
+    ///
+    /// Harvests the next window of the identity map (see
+    /// ept_intel_x64::harvest_dirty), starting where the last harvest left
+    /// off, and wrapping back to 0 once the end of the identity map is
+    /// reached. Each window is at most DIRTY_BITMAP_NUM_WORDS * 64 granules,
+    /// which bounds how long the EPT's lock is held, so that all of memory
+    /// can be sampled often without stalling the vCPUs that modify the EPT.
+    ///
+    /// Since the EPT is shared by every vCPU, so is the harvest. If any
+    /// flags were cleared, the generation is incremented, so that each vCPU
+    /// INVEPTs before it next resumes the guest, and the harvest waits (up
+    /// to EPT_HARVEST_SYNC_ATTEMPTS checks) for every attached vCPU to
+    /// acknowledge the new generation, as until then, a vCPU can still write
+    /// through translations that are already marked as dirty, which the
+    /// dirty flags would miss. The VMM cannot interrupt a vCPU that is
+    /// running the guest, so if one does not exit in time, the harvest is
+    /// reported as approximate (see dirty_bitmap::synchronized).
+    ///
+    /// @expects bitmap != nullptr
+    /// @expects accessed and dirty flags are enabled
+    ///
+    /// @param bitmap the dirty bitmap to fill in
+    ///
+    /// @throws std::logic_error if accessed and dirty flags are not enabled
+    ///
+    virtual void harvest_dirty(struct dirty_bitmap *bitmap);
+
+    /// Generation
+    ///
+    /// @return the number of modifications (harvests that have cleared
+    ///     flags, and calls to protect_range()) made to the EPT. A vCPU that
+    ///     has not seen the current generation needs to INVEPT before it
+    ///     resumes the guest.
+    ///
+    virtual uint64_t generation() const noexcept;
+
+    /// Number Of Tables
+    ///
+    /// @return the number of hardware EPT tables used by the root EPT, or
+    ///     0 if it has not been built yet
+    ///
+    virtual uint64_t num_tables();
+
+private:
+
+    friend class memory_manager_ut;
+
+    struct memory_type_range
+    {
+        uintptr_t gpa;
+        uint64_t size;
+        uint64_t type;
+    };
+
+    std::vector<memory_type_range> memory_type_ranges(uint64_t size) const;
+
+    bool acknowledged(uint64_t generation) const noexcept;
+    bool synchronize(uint64_t generation);
+    void free_retired() noexcept;
+
+private:
+
+    std::shared_ptr<intrinsics_intel_x64> m_intrinsics;
+
+    std::mutex m_mutex;
+    std::atomic<bool> m_enabled;
+    std::atomic<uint64_t> m_eptp;
+    std::atomic<uint64_t> m_max_page_size;
+    std::atomic<uint64_t> m_identity_map_size;
+    std::atomic<bool> m_accessed_dirty;
+    std::atomic<uint64_t> m_generation;
+
+    uintptr_t m_harvest_gpa;
+    uint64_t m_retired_generation;
+
+    std::vector<std::atomic<uint64_t> *> m_vcpus;
+
+    std::shared_ptr<ept_intel_x64> m_pml4;
+
+public:
+
+    /// Disable the copy consturctor
+    ///
+    root_ept_intel_x64(const root_ept_intel_x64 &) = delete;
+
+    /// Disable the copy operator
+    ///
+    root_ept_intel_x64 &operator=(const root_ept_intel_x64 &) = delete;
+};
+
+/// Root EPT Macro
+///
+/// The following macro can be used to quickly call the root EPT.
+/// This call is guaranteed to not be NULL
+///
+#define g_ept root_ept_intel_x64::instance()
+
+#endif
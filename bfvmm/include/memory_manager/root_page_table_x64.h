@@ -0,0 +1,140 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef ROOT_PAGE_TABLE_X64_H
+#define ROOT_PAGE_TABLE_X64_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <memory_manager/memory_manager.h>
+#include <memory_manager/page_table_x64.h>
+
+/// Root Page Table
+///
+/// The root page table is the set of page tables (starting with a PML4)
+/// that is shared by every core while it is in the VMM (i.e. the host's
+/// CR3). It maps each range of virtual memory that has been added to the
+/// memory manager.
+///
+/// The page tables are built once, by whichever core calls cr3() first,
+/// and the resulting CR3 is published atomically, so the rest of the cores
+/// can call cr3() in parallel without taking a lock. Once built, the root
+/// page table registers itself as the memory manager's range listener, so
+/// memory that is added later is mapped as it is added, instead of needing
+/// the page tables to be rebuilt.
+///
+class root_page_table_x64 : public memory_range_listener
+{
+public:
+
+    /// Default Constructor
+    ///
+    root_page_table_x64() noexcept;
+
+    /// Destructor
+    ///
+    ~root_page_table_x64() override;
+
+    /// Get Singleton Instance
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static root_page_table_x64 *instance() noexcept;
+
+    /// CR3
+    ///
+    /// Returns the CR3 of the root page table, building the page tables
+    /// first if this is the first call.
+    ///
+    /// @return the physical address of the root page table's PML4
+    ///
+    /// @throws any exception thrown while building the page tables, in
+    ///     which case the next call will try again
+    ///
+    virtual uintptr_t cr3();
+
+    /// Set Max Page Size
+    ///
+    /// Sets the largest page size that is used to map memory. Note that
+    /// this only affects memory that is mapped after this call, so it
+    /// should be called before cr3(). Defaults to PAGE_SIZE_2M, as 1GB
+    /// pages are not supported by all CPUs.
+    ///
+    /// @expects max_page_size is PAGE_SIZE_4K, PAGE_SIZE_2M or PAGE_SIZE_1G
+    ///
+    /// @param max_page_size the largest page size to map memory with
+    ///
+    virtual void set_max_page_size(uint64_t max_page_size);
+
+    /// Generation
+    ///
+    /// The generation is incremented each time memory is mapped into the
+    /// root page table after it has been built. Mappings are replaced in
+    /// place, but a core might still have the old mappings in it's TLB, so
+    /// each core compares this with the generation it last saw each time it
+    /// enters the VMM, and flushes it's TLB if it has changed.
+    ///
+    /// @return the current generation
+    ///
+    virtual uint64_t generation() const noexcept
+    { return m_generation.load(std::memory_order_acquire); }
+
+    /// Ranges Added
+    ///
+    /// Maps ranges of virtual memory that have been added to the memory
+    /// manager. Ranges that are already mapped are replaced in place, with
+    /// atomic stores, as other cores might be using the page tables.
+    ///
+    /// @param ranges the ranges that were added
+    /// @param num the number of ranges in ranges
+    ///
+    void ranges_added(const memory_range *ranges, int64_t num) override;
+
+private:
+
+    std::mutex m_mutex;
+    std::atomic<uintptr_t> m_cr3;
+    std::atomic<uint64_t> m_max_page_size;
+    std::atomic<uint64_t> m_generation;
+
+    std::shared_ptr<page_table_x64> m_pml4;
+
+public:
+
+    /// Disable the copy consturctor
+    ///
+    root_page_table_x64(const root_page_table_x64 &) = delete;
+
+    /// Disable the copy operator
+    ///
+    root_page_table_x64 &operator=(const root_page_table_x64 &) = delete;
+};
+
+/// Root Page Table Macro
+///
+/// The following macro can be used to quickly call the root page table.
+/// This call is guaranteed to not be NULL
+///
+#define g_pt root_page_table_x64::instance()
+
+#endif
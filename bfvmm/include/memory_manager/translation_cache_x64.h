@@ -0,0 +1,130 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef TRANSLATION_CACHE_X64_H
+#define TRANSLATION_CACHE_X64_H
+
+#include <array>
+#include <memory>
+#include <constants.h>
+#include <memory_manager/page_walker_x64.h>
+
+/// Translation Cache
+///
+/// A small, software TLB that caches the results of a page walker. Each
+/// vCPU owns one of these (so it does not need a lock), and entries are
+/// tagged by the CR3 that they were walked with, so the host's, and the
+/// guest's translations can be cached at the same time. The cache is
+/// direct mapped by 4k virtual page (a large page takes one entry for
+/// each 4k page that is looked up), and only translations that are
+/// present are cached.
+///
+/// Like a hardware TLB, the cache does not know when page tables are
+/// changed, so it is up to the owner to flush it. As the guest can change
+/// it's page tables without the VMM knowing, a vCPU should flush() on each
+/// VM exit, which only increments a generation count, so a cached
+/// translation is reused for the rest of the exit (i.e. while fetching the
+/// rest of an instruction, or more of the stack).
+///
+class translation_cache_x64
+{
+public:
+
+    /// Default Constructor
+    ///
+    /// @param walker the page walker used on a miss. If nullptr, a default
+    ///     page walker is used.
+    ///
+    translation_cache_x64(std::shared_ptr<page_walker_x64> walker = nullptr);
+
+    /// Destructor
+    ///
+    virtual ~translation_cache_x64() = default;
+
+    /// Translate
+    ///
+    /// Translates a virtual address, using a cached translation if there
+    /// is one, and walking the page tables if there is not.
+    ///
+    /// @param cr3 the CR3 of the page tables to translate with
+    /// @param virt the virtual address to translate
+    /// @return the translation (see page_walker_x64::walk)
+    ///
+    virtual page_walk_x64 translate(uintptr_t cr3, uintptr_t virt);
+
+    /// Flush
+    ///
+    /// Removes all of the translations from the cache.
+    ///
+    virtual void flush() noexcept;
+
+    /// Flush CR3
+    ///
+    /// Removes all of the translations for a CR3 from the cache.
+    ///
+    /// @param cr3 the CR3 to flush
+    ///
+    virtual void flush(uintptr_t cr3) noexcept;
+
+    /// Flush Page
+    ///
+    /// Removes the translation for a single page from the cache.
+    ///
+    /// @param cr3 the CR3 of the translation to flush
+    /// @param virt the virtual address of the translation to flush
+    ///
+    virtual void flush(uintptr_t cr3, uintptr_t virt) noexcept;
+
+    /// Hits
+    ///
+    /// @return the number of translations that were found in the cache
+    ///
+    virtual uint64_t hits() const noexcept
+    { return m_hits; }
+
+    /// Misses
+    ///
+    /// @return the number of translations that needed a page walk
+    ///
+    virtual uint64_t misses() const noexcept
+    { return m_misses; }
+
+private:
+
+    struct entry_type
+    {
+        uint64_t generation;
+        uintptr_t cr3;
+        uintptr_t virt;
+        page_walk_x64 walk;
+    };
+
+    std::shared_ptr<page_walker_x64> m_walker;
+
+    uint64_t m_generation;
+    std::array<entry_type, TRANSLATION_CACHE_SIZE> m_entries;
+
+    uint64_t m_hits;
+    uint64_t m_misses;
+};
+
+#endif
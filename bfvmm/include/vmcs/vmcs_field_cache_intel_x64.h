@@ -0,0 +1,146 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef VMCS_FIELD_CACHE_INTEL_X64_H
+#define VMCS_FIELD_CACHE_INTEL_X64_H
+
+#include <array>
+#include <stdint.h>
+#include <functional>
+#include <constants.h>
+
+/// VMCS Field Cache
+///
+/// A write-back cache of VMCS fields, for the duration of a single VM exit.
+/// Each VMREAD and VMWRITE is an instruction (behind a virtual call) that
+/// is a lot slower than a memory access, and handlers tend to touch the
+/// same fields (RIP, RFLAGS, the control registers, etc...) more than once,
+/// so the exit handler can use this class to read each field at most once
+/// per exit, and write each field that changed exactly once, right before
+/// the guest is resumed.
+///
+/// The cache has no knowledge of the VMCS itself. The owner fills it after
+/// a miss, and provides the function that writes the dirty fields back
+/// when it is flushed. The cache holds at most VMCS_FIELD_CACHE_SIZE
+/// fields, and once it is full, it simply stops caching (i.e. the owner
+/// has to access the VMCS directly), so nothing ever needs to be evicted.
+///
+class vmcs_field_cache_intel_x64
+{
+public:
+
+    /// Write Back Function
+    ///
+    /// Writes a single dirty field back to the VMCS.
+    ///
+    using writer_type = std::function<void(uint64_t field, uint64_t value)>;
+
+    /// Default Constructor
+    ///
+    vmcs_field_cache_intel_x64() noexcept;
+
+    /// Destructor
+    ///
+    virtual ~vmcs_field_cache_intel_x64() = default;
+
+    /// Read
+    ///
+    /// @param field the VMCS field to look up
+    /// @param value where to store the field's value on a hit
+    /// @return true on a hit, false if the field is not in the cache
+    ///
+    virtual bool read(uint64_t field, uint64_t &value) const noexcept;
+
+    /// Fill
+    ///
+    /// Adds a field that was just read from the VMCS to the cache. A
+    /// field that is already cached is left alone, as it might be dirty.
+    ///
+    /// @param field the VMCS field that was read
+    /// @param value the value that was read
+    ///
+    virtual void fill(uint64_t field, uint64_t value) noexcept;
+
+    /// Write
+    ///
+    /// Buffers a write to a field. The field is only marked as dirty if
+    /// its value actually changed, so writing back the value that was
+    /// read does not cost a VMWRITE.
+    ///
+    /// @param field the VMCS field to write
+    /// @param value the value to write
+    /// @return true if the write was buffered, false if the cache is full
+    ///     (in which case the owner has to write the VMCS directly)
+    ///
+    virtual bool write(uint64_t field, uint64_t value) noexcept;
+
+    /// Flush
+    ///
+    /// Writes each dirty field back using the provided function, and marks
+    /// it as clean. Fields stay cached, so this can be called in the middle
+    /// of an exit (e.g. before code that accesses the VMCS directly).
+    ///
+    /// @param writer the function used to write each dirty field
+    ///
+    virtual void flush(const writer_type &writer);
+
+    /// Invalidate
+    ///
+    /// Drops every field, without writing anything back. This must be
+    /// called at the start of each exit, as the guest changes the VMCS
+    /// while it runs.
+    ///
+    virtual void invalidate() noexcept
+    { m_size = 0; m_num_dirty = 0; }
+
+    /// Size
+    ///
+    /// @return the number of fields in the cache
+    ///
+    virtual uint64_t size() const noexcept
+    { return m_size; }
+
+    /// Dirty
+    ///
+    /// @return the number of fields that will be written by the next flush
+    ///
+    virtual uint64_t num_dirty() const noexcept
+    { return m_num_dirty; }
+
+private:
+
+    struct entry
+    {
+        uint64_t field;
+        uint64_t value;
+        bool dirty;
+    };
+
+    entry *find(uint64_t field) noexcept;
+    const entry *find(uint64_t field) const noexcept;
+
+    uint64_t m_size;
+    uint64_t m_num_dirty;
+    std::array<entry, VMCS_FIELD_CACHE_SIZE> m_entries;
+};
+
+#endif
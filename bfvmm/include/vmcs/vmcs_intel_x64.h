@@ -22,7 +22,9 @@
 #ifndef VMCS_INTEL_X64_H
 #define VMCS_INTEL_X64_H
 
+#include <atomic>
 #include <memory>
+#include <gsl/gsl>
 #include <vmcs/vmcs_intel_x64_state.h>
 #include <intrinsics/intrinsics_intel_x64.h>
 
@@ -63,7 +65,9 @@ public:
 
     /// Destructor
     ///
-    virtual ~vmcs_intel_x64() = default;
+    /// Detaches the VMCS from the root EPT, if it was attached by launch().
+    ///
+    virtual ~vmcs_intel_x64();
 
     /// Launch
     ///
@@ -141,6 +145,80 @@ public:
     ///
     virtual void clear();
 
+    /// VPID
+    ///
+    /// Returns the VPID that tags the guest-linear translations of this
+    /// VMCS. Note that the VPID is only used (and thus only needs to be
+    /// flushed with INVVPID) if the CPU supports VPIDs.
+    ///
+    /// @return the VPID of this VMCS
+    ///
+    virtual uint16_t vpid() const noexcept
+    { return m_vpid; }
+
+    /// Page-Modification Log
+    ///
+    /// Returns the page-modification log of this VMCS. When PML is
+    /// enabled, the CPU logs the guest physical address of each page whose
+    /// EPT dirty flag it sets into this log, filling it from the last entry
+    /// down, and exits once the log is full. Empty if PML is not enabled.
+    ///
+    /// @return the page-modification log of this VMCS
+    ///
+    virtual gsl::span<uint64_t> pml() const noexcept
+    { return {m_pml.get(), m_pml ? PML_NUM_ENTRIES : 0}; }
+
+    /// Trap Read MSR
+    ///
+    /// Causes RDMSR of the provided MSR to exit to the exit handler. Note
+    /// that MSRs outside of the ranges covered by the MSR bitmap (i.e.
+    /// 0x0 - 0x1FFF and 0xC0000000 - 0xC0001FFF) always exit. This can be
+    /// called before, or after the VMCS has been launched.
+    ///
+    /// @param msr the MSR to trap
+    ///
+    virtual void trap_read_msr(uint32_t msr);
+
+    /// Trap Write MSR
+    ///
+    /// Causes WRMSR of the provided MSR to exit to the exit handler (see
+    /// trap_read_msr).
+    ///
+    /// @param msr the MSR to trap
+    ///
+    virtual void trap_write_msr(uint32_t msr);
+
+    /// Pass Through MSR
+    ///
+    /// Lets the guest execute RDMSR and WRMSR of the provided MSR without
+    /// an exit. Only do this for MSRs that the VMM does not need to
+    /// emulate, and whose state is not held in the VMCS.
+    ///
+    /// @expects msr is covered by the MSR bitmap (see trap_read_msr)
+    /// @param msr the MSR to pass through
+    ///
+    virtual void pass_through_msr(uint32_t msr);
+
+    /// Trap I/O Port
+    ///
+    /// Causes IN, INS, OUT and OUTS that access the provided port to exit
+    /// to the exit handler. Note that an access of more than one byte
+    /// exits if any of the ports it touches is trapped. This can be called
+    /// before, or after the VMCS has been launched.
+    ///
+    /// @param port the port to trap
+    ///
+    virtual void trap_io_port(uint16_t port);
+
+    /// Pass Through I/O Port
+    ///
+    /// Lets the guest access the provided port without an exit. All ports
+    /// are passed through by default.
+    ///
+    /// @param port the port to pass through
+    ///
+    virtual void pass_through_io_port(uint16_t port);
+
 protected:
 
     virtual void create_vmcs_region();
@@ -149,6 +227,12 @@ protected:
     virtual void create_exit_handler_stack();
     virtual void release_exit_handler_stack();
 
+    virtual void create_pml();
+    virtual void release_pml();
+
+    virtual void attach_ept();
+    virtual void detach_ept() noexcept;
+
     virtual void write_16bit_control_state(const std::shared_ptr<vmcs_intel_x64_state> &state);
     virtual void write_64bit_control_state(const std::shared_ptr<vmcs_intel_x64_state> &state);
     virtual void write_32bit_control_state(const std::shared_ptr<vmcs_intel_x64_state> &state);
@@ -174,6 +258,12 @@ protected:
     virtual void vmwrite(uint64_t field, uint64_t value);
 
     virtual void filter_unsupported(uint64_t msr, uint64_t &ctrl);
+    virtual bool is_supported_ept_identity_map() const;
+    virtual bool is_supported_vpid_tagging() const;
+    virtual bool is_supported_ept_accessed_dirty() const;
+    virtual bool is_supported_pml_logging() const;
+
+    bool update_msr_bitmap(uint32_t msr, std::ptrdiff_t offset, bool trap) noexcept;
 
 protected:
 
@@ -268,6 +358,7 @@ protected:
     virtual bool is_enabled_vm_functions() const;
     virtual bool is_enabled_vmcs_shadowing() const;
     virtual bool is_enabled_rdseed_exiting() const;
+    virtual bool is_enabled_pml() const;
     virtual bool is_enabled_ept_violation_ve() const;
     virtual bool is_enabled_xsave_xrestore() const;
 
@@ -333,6 +424,7 @@ protected:
     virtual bool is_supported_vm_functions() const;
     virtual bool is_supported_vmcs_shadowing() const;
     virtual bool is_supported_rdseed_exiting() const;
+    virtual bool is_supported_pml() const;
     virtual bool is_supported_ept_violation_ve() const;
     virtual bool is_supported_xsave_xrestore() const;
 
@@ -554,6 +646,7 @@ protected:
     virtual void check_control_unrestricted_guests();
     virtual void check_control_enable_vm_functions();
     virtual void check_control_enable_vmcs_shadowing();
+    virtual void check_control_enable_pml_checks();
     virtual void check_control_enable_ept_violation_checks();
 
     virtual void checks_on_vm_exit_control_fields();
@@ -586,6 +679,16 @@ protected:
     uintptr_t m_vmcs_region_phys;
     std::unique_ptr<uint32_t[]> m_vmcs_region;
 
+    uint16_t m_vpid;
+    bool m_ept_attached;
+    std::atomic<uint64_t> m_ept_generation;
+
+    uintptr_t m_pml_phys;
+    std::unique_ptr<uint64_t[]> m_pml;
+
+    std::unique_ptr<uint8_t[]> m_msr_bitmap;
+    std::unique_ptr<uint8_t[]> m_io_bitmaps;
+
     std::unique_ptr<char[]> m_exit_handler_stack;
     std::shared_ptr<state_save_intel_x64> m_state_save;
 
@@ -24,6 +24,7 @@
 #include <entry/entry.h>
 #include <guard_exceptions.h>
 #include <vcpu/vcpu_manager.h>
+#include <memory_manager/memory_manager.h>
 
 extern "C" int64_t
 start_vmm(uint64_t arg) noexcept
@@ -36,6 +37,8 @@ start_vmm(uint64_t arg) noexcept
             g_vcm->delete_vcpu(arg);
         });
 
+        g_mm->refill_zeroed_pages();
+
         g_vcm->create_vcpu(arg);
         g_vcm->run_vcpu(arg);
 
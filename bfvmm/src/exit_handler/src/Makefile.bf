@@ -65,6 +65,7 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 ################################################################################
 
 SOURCES+=exit_handler_intel_x64.cpp
+SOURCES+=exit_stats_intel_x64.cpp
 SOURCES+=exit_handler_intel_x64_entry.cpp
 SOURCES+=exit_handler_intel_x64_support.asm
 
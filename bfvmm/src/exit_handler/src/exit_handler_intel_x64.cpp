@@ -24,16 +24,28 @@
 #include <exit_handler/exit_handler_intel_x64.h>
 #include <exit_handler/exit_handler_intel_x64_entry.h>
 #include <exit_handler/exit_handler_intel_x64_support.h>
+#include <memory_manager/root_page_table_x64.h>
 
 #include <mutex>
 std::mutex g_unimplemented_handler_mutex;
 
+// Which of the lazily read VM-exit information fields have been read from
+// the VMCS during the current exit.
+
+constexpr const uint32_t exit_info_qualification = (1U << 0);
+constexpr const uint32_t exit_info_instruction_length = (1U << 1);
+constexpr const uint32_t exit_info_instruction_information = (1U << 2);
+
 exit_handler_intel_x64::exit_handler_intel_x64(std::shared_ptr<intrinsics_intel_x64> intrinsics) :
     m_intrinsics(std::move(intrinsics)),
     m_exit_reason(0),
     m_exit_qualification(0),
     m_exit_instruction_length(0),
-    m_exit_instruction_information(0)
+    m_exit_instruction_information(0),
+    m_exit_info_cached(0),
+    m_vmcs_field_cache_enabled(false),
+    m_pt_generation(g_pt->generation()),
+    m_dispatch_table(default_dispatch_table())
 {
     if (!m_intrinsics)
         m_intrinsics = std::make_shared<intrinsics_intel_x64>();
@@ -42,263 +54,252 @@ exit_handler_intel_x64::exit_handler_intel_x64(std::shared_ptr<intrinsics_intel_
 void
 exit_handler_intel_x64::dispatch()
 {
-    m_exit_reason =
-        vmread(VMCS_EXIT_REASON);
-    m_exit_qualification =
-        vmread(VMCS_EXIT_QUALIFICATION);
-    m_exit_instruction_length =
-        vmread(VMCS_VM_EXIT_INSTRUCTION_LENGTH);
-    m_exit_instruction_information =
-        vmread(VMCS_VM_EXIT_INSTRUCTION_INFORMATION);
-
-    switch (m_exit_reason & 0x0000FFFF)
-    {
-        case VM_EXIT_REASON_EXCEPTION_OR_NON_MASKABLE_INTERRUPT:
-            handle_exception_or_non_maskable_interrupt();
-            break;
-
-        case VM_EXIT_REASON_EXTERNAL_INTERRUPT:
-            handle_external_interrupt();
-            break;
-
-        case VM_EXIT_REASON_TRIPLE_FAULT:
-            handle_triple_fault();
-            break;
-
-        case VM_EXIT_REASON_INIT_SIGNAL:
-            handle_init_signal();
-            break;
-
-        case VM_EXIT_REASON_SIPI:
-            handle_sipi();
-            break;
-
-        case VM_EXIT_REASON_SMI:
-            handle_smi();
-            break;
-
-        case VM_EXIT_REASON_OTHER_SMI:
-            handle_other_smi();
-            break;
-
-        case VM_EXIT_REASON_INTERRUPT_WINDOW:
-            handle_interrupt_window();
-            break;
-
-        case VM_EXIT_REASON_NMI_WINDOW:
-            handle_nmi_window();
-            break;
-
-        case VM_EXIT_REASON_TASK_SWITCH:
-            handle_task_switch();
-            break;
+    // When exit statistics are enabled (i.e. by the vCPU), the time spent
+    // handling the exit is measured from here until the guest is resumed.
 
-        case VM_EXIT_REASON_CPUID:
-            handle_cpuid();
-            break;
-
-        case VM_EXIT_REASON_GETSEC:
-            handle_getsec();
-            break;
-
-        case VM_EXIT_REASON_HLT:
-            handle_hlt();
-            break;
-
-        case VM_EXIT_REASON_INVD:
-            handle_invd();
-            break;
-
-        case VM_EXIT_REASON_INVLPG:
-            handle_invlpg();
-            break;
-
-        case VM_EXIT_REASON_RDPMC:
-            handle_rdpmc();
-            break;
-
-        case VM_EXIT_REASON_RDTSC:
-            handle_rdtsc();
-            break;
-
-        case VM_EXIT_REASON_RSM:
-            handle_rsm();
-            break;
-
-        case VM_EXIT_REASON_VMCALL:
-            handle_vmcall();
-            break;
+    auto start = m_exit_stats ? m_intrinsics->read_tsc() : 0;
 
-        case VM_EXIT_REASON_VMCLEAR:
-            handle_vmclear();
-            break;
+    // With VPIDs enabled, VM exits and VM entries no longer flush the VMM's
+    // translations, so if memory has been remapped in the VMM's page tables
+    // since this core last looked, the TLB is flushed by reloading CR3 (the
+    // VMM's mappings are not global). This is the first thing done on each
+    // exit, which costs a single atomic load when nothing has changed.
 
-        case VM_EXIT_REASON_VMLAUNCH:
-            handle_vmlaunch();
-            break;
+    auto pt_generation = g_pt->generation();
 
-        case VM_EXIT_REASON_VMPTRLD:
-            handle_vmptrld();
-            break;
-
-        case VM_EXIT_REASON_VMPTRST:
-            handle_vmptrst();
-            break;
-
-        case VM_EXIT_REASON_VMREAD:
-            handle_vmread();
-            break;
+    if (pt_generation != m_pt_generation)
+    {
+        m_intrinsics->write_cr3(m_intrinsics->read_cr3());
+        m_pt_generation = pt_generation;
+    }
 
-        case VM_EXIT_REASON_VMRESUME:
-            handle_vmresume();
-            break;
+    // The guest can change it's page tables while it is running, so
+    // translations are only cached for the duration of a single exit.
 
-        case VM_EXIT_REASON_VMWRITE:
-            handle_vmwrite();
-            break;
+    m_translation_cache.flush();
 
-        case VM_EXIT_REASON_VMXOFF:
-            handle_vmxoff();
-            break;
+    // Tables that were replaced during the last exit might have still been
+    // in use by the handler that replaced them, so they are only released
+    // once that handler has returned.
 
-        case VM_EXIT_REASON_VMXON:
-            handle_vmxon();
-            break;
+    if (!m_retired_dispatch_tables.empty())
+        m_retired_dispatch_tables.clear();
 
-        case VM_EXIT_REASON_CONTROL_REGISTER_ACCESSES:
-            handle_control_register_accesses();
-            break;
+    // Only the exit reason is needed to dispatch the exit. The rest of the
+    // VM-exit information fields are read if (and when) a handler asks
+    // for them.
 
-        case VM_EXIT_REASON_MOV_DR:
-            handle_mov_dr();
-            break;
+    m_vmcs_field_cache.invalidate();
 
-        case VM_EXIT_REASON_IO_INSTRUCTION:
-            handle_io_instruction();
-            break;
+    m_exit_info_cached = 0;
+    m_exit_reason = vmread(VMCS_EXIT_REASON);
 
-        case VM_EXIT_REASON_RDMSR:
-            handle_rdmsr();
-            break;
+    auto basic_exit_reason = m_exit_reason & 0x0000FFFF;
 
-        case VM_EXIT_REASON_WRMSR:
-            handle_wrmsr();
-            break;
+    this->dispatch_handler(basic_exit_reason);
 
-        case VM_EXIT_REASON_VM_ENTRY_FAILURE_INVALID_GUEST_STATE:
-            handle_vm_entry_failure_invalid_guest_state();
-            break;
+    this->flush_vmcs_field_cache();
 
-        case VM_EXIT_REASON_VM_ENTRY_FAILURE_MSR_LOADING:
-            handle_vm_entry_failure_msr_loading();
-            break;
+    if (m_exit_stats)
+        m_exit_stats->record(basic_exit_reason, m_intrinsics->read_tsc() - start);
 
-        case VM_EXIT_REASON_MWAIT:
-            handle_mwait();
-            break;
-
-        case VM_EXIT_REASON_MONITOR_TRAP_FLAG:
-            handle_monitor_trap_flag();
-            break;
-
-        case VM_EXIT_REASON_MONITOR:
-            handle_monitor();
-            break;
+    m_vmcs->resume();
+}
 
-        case VM_EXIT_REASON_PAUSE:
-            handle_pause();
-            break;
+uint64_t
+exit_handler_intel_x64::exit_qualification()
+{
+    return cached_exit_info(VMCS_EXIT_QUALIFICATION,
+                            m_exit_qualification,
+                            exit_info_qualification);
+}
 
-        case VM_EXIT_REASON_VM_ENTRY_FAILURE_MACHINE_CHECK_EVENT:
-            handle_vm_entry_failure_machine_check_event();
-            break;
+uint64_t
+exit_handler_intel_x64::exit_instruction_length()
+{
+    return cached_exit_info(VMCS_VM_EXIT_INSTRUCTION_LENGTH,
+                            m_exit_instruction_length,
+                            exit_info_instruction_length);
+}
 
-        case VM_EXIT_REASON_TPR_BELOW_THRESHOLD:
-            handle_tpr_below_threshold();
-            break;
+uint64_t
+exit_handler_intel_x64::exit_instruction_information()
+{
+    return cached_exit_info(VMCS_VM_EXIT_INSTRUCTION_INFORMATION,
+                            m_exit_instruction_information,
+                            exit_info_instruction_information);
+}
 
-        case VM_EXIT_REASON_APIC_ACCESS:
-            handle_apic_access();
-            break;
+void
+exit_handler_intel_x64::enable_vmcs_field_cache(bool enabled)
+{
+    this->flush_vmcs_field_cache();
 
-        case VM_EXIT_REASON_VIRTUALIZED_EOI:
-            handle_virtualized_eoi();
-            break;
+    m_vmcs_field_cache.invalidate();
+    m_vmcs_field_cache_enabled = enabled;
+}
 
-        case VM_EXIT_REASON_ACCESS_TO_GDTR_OR_IDTR:
-            handle_access_to_gdtr_or_idtr();
-            break;
+void
+exit_handler_intel_x64::register_handler(uint64_t exit_reason, handler_type handler)
+{
+    if (exit_reason > VM_EXIT_REASON_MAX)
+        throw std::invalid_argument("exit_reason is out of range");
 
-        case VM_EXIT_REASON_ACCESS_TO_LDTR_OR_TR:
-            handle_access_to_ldtr_or_tr();
-            break;
+    if (!handler)
+        throw std::invalid_argument("handler == nullptr");
 
-        case VM_EXIT_REASON_EPT_VIOLATION:
-            handle_ept_violation();
-            break;
+    auto table = std::make_shared<dispatch_table_type>(*m_dispatch_table);
+    (*table)[exit_reason] = {nullptr, std::move(handler)};
 
-        case VM_EXIT_REASON_EPT_MISCONFIGURATION:
-            handle_ept_misconfiguration();
-            break;
+    this->install_dispatch_table(std::move(table));
+}
 
-        case VM_EXIT_REASON_INVEPT:
-            handle_invept();
-            break;
+void
+exit_handler_intel_x64::register_handler(uint64_t exit_reason, member_handler_type handler)
+{
+    if (exit_reason > VM_EXIT_REASON_MAX)
+        throw std::invalid_argument("exit_reason is out of range");
 
-        case VM_EXIT_REASON_RDTSCP:
-            handle_rdtscp();
-            break;
+    if (handler == nullptr)
+        throw std::invalid_argument("handler == nullptr");
 
-        case VM_EXIT_REASON_VMX_PREEMPTION_TIMER_EXPIRED:
-            handle_vmx_preemption_timer_expired();
-            break;
+    auto table = std::make_shared<dispatch_table_type>(*m_dispatch_table);
+    (*table)[exit_reason] = {handler, nullptr};
 
-        case VM_EXIT_REASON_INVVPID:
-            handle_invvpid();
-            break;
+    this->install_dispatch_table(std::move(table));
+}
 
-        case VM_EXIT_REASON_WBINVD:
-            handle_wbinvd();
-            break;
+void
+exit_handler_intel_x64::chain_handler(uint64_t exit_reason, chained_handler_type handler)
+{
+    if (exit_reason > VM_EXIT_REASON_MAX)
+        throw std::invalid_argument("exit_reason is out of range");
 
-        case VM_EXIT_REASON_XSETBV:
-            handle_xsetbv();
-            break;
+    if (!handler)
+        throw std::invalid_argument("handler == nullptr");
 
-        case VM_EXIT_REASON_APIC_WRITE:
-            handle_apic_write();
-            break;
+    const auto &entry = (*m_dispatch_table)[exit_reason];
+    auto next = entry.handler;
 
-        case VM_EXIT_REASON_RDRAND:
-            handle_rdrand();
-            break;
+    if (entry.member != nullptr)
+    {
+        next = [member = entry.member](exit_handler_intel_x64 &eh)
+        { (eh.*member)(); };
+    }
+    else if (!next)
+    {
+        next = [](exit_handler_intel_x64 &eh)
+        { eh.unimplemented_handler(); };
+    }
 
-        case VM_EXIT_REASON_INVPCID:
-            handle_invpcid();
-            break;
+    this->register_handler(exit_reason, [handler, next](exit_handler_intel_x64 &eh)
+    { handler(eh, next); });
+}
 
-        case VM_EXIT_REASON_VMFUNC:
-            handle_vmfunc();
-            break;
+void
+exit_handler_intel_x64::install_dispatch_table(std::shared_ptr<dispatch_table_type> table)
+{
+    if (!table)
+        throw std::invalid_argument("table == nullptr");
 
-        case VM_EXIT_REASON_RDSEED:
-            handle_rdseed();
-            break;
+    if (m_dispatch_table)
+        m_retired_dispatch_tables.push_back(std::move(m_dispatch_table));
 
-        case VM_EXIT_REASON_XSAVES:
-            handle_xsaves();
-            break;
+    m_dispatch_table = std::move(table);
+}
 
-        case VM_EXIT_REASON_XRSTORS:
-            handle_xrstors();
-            break;
+void
+exit_handler_intel_x64::dispatch_handler(uint64_t basic_exit_reason)
+{
+    if (basic_exit_reason <= VM_EXIT_REASON_MAX)
+    {
+        const auto &entry = (*m_dispatch_table)[basic_exit_reason];
+
+        if (entry.member != nullptr)
+        {
+            (this->*entry.member)();
+            return;
+        }
+
+        if (entry.handler)
+        {
+            entry.handler(*this);
+            return;
+        }
+    }
 
-        default:
-            unimplemented_handler();
-            break;
-    };
+    unimplemented_handler();
+}
 
-    m_vmcs->resume();
+std::shared_ptr<exit_handler_intel_x64::dispatch_table_type>
+exit_handler_intel_x64::default_dispatch_table()
+{
+    auto table = std::make_shared<dispatch_table_type>();
+    auto &handlers = *table;
+
+    handlers[VM_EXIT_REASON_EXCEPTION_OR_NON_MASKABLE_INTERRUPT].member = &exit_handler_intel_x64::handle_exception_or_non_maskable_interrupt;
+    handlers[VM_EXIT_REASON_EXTERNAL_INTERRUPT].member = &exit_handler_intel_x64::handle_external_interrupt;
+    handlers[VM_EXIT_REASON_TRIPLE_FAULT].member = &exit_handler_intel_x64::handle_triple_fault;
+    handlers[VM_EXIT_REASON_INIT_SIGNAL].member = &exit_handler_intel_x64::handle_init_signal;
+    handlers[VM_EXIT_REASON_SIPI].member = &exit_handler_intel_x64::handle_sipi;
+    handlers[VM_EXIT_REASON_SMI].member = &exit_handler_intel_x64::handle_smi;
+    handlers[VM_EXIT_REASON_OTHER_SMI].member = &exit_handler_intel_x64::handle_other_smi;
+    handlers[VM_EXIT_REASON_INTERRUPT_WINDOW].member = &exit_handler_intel_x64::handle_interrupt_window;
+    handlers[VM_EXIT_REASON_NMI_WINDOW].member = &exit_handler_intel_x64::handle_nmi_window;
+    handlers[VM_EXIT_REASON_TASK_SWITCH].member = &exit_handler_intel_x64::handle_task_switch;
+    handlers[VM_EXIT_REASON_CPUID].member = &exit_handler_intel_x64::handle_cpuid;
+    handlers[VM_EXIT_REASON_GETSEC].member = &exit_handler_intel_x64::handle_getsec;
+    handlers[VM_EXIT_REASON_HLT].member = &exit_handler_intel_x64::handle_hlt;
+    handlers[VM_EXIT_REASON_INVD].member = &exit_handler_intel_x64::handle_invd;
+    handlers[VM_EXIT_REASON_INVLPG].member = &exit_handler_intel_x64::handle_invlpg;
+    handlers[VM_EXIT_REASON_RDPMC].member = &exit_handler_intel_x64::handle_rdpmc;
+    handlers[VM_EXIT_REASON_RDTSC].member = &exit_handler_intel_x64::handle_rdtsc;
+    handlers[VM_EXIT_REASON_RSM].member = &exit_handler_intel_x64::handle_rsm;
+    handlers[VM_EXIT_REASON_VMCALL].member = &exit_handler_intel_x64::handle_vmcall;
+    handlers[VM_EXIT_REASON_VMCLEAR].member = &exit_handler_intel_x64::handle_vmclear;
+    handlers[VM_EXIT_REASON_VMLAUNCH].member = &exit_handler_intel_x64::handle_vmlaunch;
+    handlers[VM_EXIT_REASON_VMPTRLD].member = &exit_handler_intel_x64::handle_vmptrld;
+    handlers[VM_EXIT_REASON_VMPTRST].member = &exit_handler_intel_x64::handle_vmptrst;
+    handlers[VM_EXIT_REASON_VMREAD].member = &exit_handler_intel_x64::handle_vmread;
+    handlers[VM_EXIT_REASON_VMRESUME].member = &exit_handler_intel_x64::handle_vmresume;
+    handlers[VM_EXIT_REASON_VMWRITE].member = &exit_handler_intel_x64::handle_vmwrite;
+    handlers[VM_EXIT_REASON_VMXOFF].member = &exit_handler_intel_x64::handle_vmxoff;
+    handlers[VM_EXIT_REASON_VMXON].member = &exit_handler_intel_x64::handle_vmxon;
+    handlers[VM_EXIT_REASON_CONTROL_REGISTER_ACCESSES].member = &exit_handler_intel_x64::handle_control_register_accesses;
+    handlers[VM_EXIT_REASON_MOV_DR].member = &exit_handler_intel_x64::handle_mov_dr;
+    handlers[VM_EXIT_REASON_IO_INSTRUCTION].member = &exit_handler_intel_x64::handle_io_instruction;
+    handlers[VM_EXIT_REASON_RDMSR].member = &exit_handler_intel_x64::handle_rdmsr;
+    handlers[VM_EXIT_REASON_WRMSR].member = &exit_handler_intel_x64::handle_wrmsr;
+    handlers[VM_EXIT_REASON_VM_ENTRY_FAILURE_INVALID_GUEST_STATE].member = &exit_handler_intel_x64::handle_vm_entry_failure_invalid_guest_state;
+    handlers[VM_EXIT_REASON_VM_ENTRY_FAILURE_MSR_LOADING].member = &exit_handler_intel_x64::handle_vm_entry_failure_msr_loading;
+    handlers[VM_EXIT_REASON_MWAIT].member = &exit_handler_intel_x64::handle_mwait;
+    handlers[VM_EXIT_REASON_MONITOR_TRAP_FLAG].member = &exit_handler_intel_x64::handle_monitor_trap_flag;
+    handlers[VM_EXIT_REASON_MONITOR].member = &exit_handler_intel_x64::handle_monitor;
+    handlers[VM_EXIT_REASON_PAUSE].member = &exit_handler_intel_x64::handle_pause;
+    handlers[VM_EXIT_REASON_VM_ENTRY_FAILURE_MACHINE_CHECK_EVENT].member = &exit_handler_intel_x64::handle_vm_entry_failure_machine_check_event;
+    handlers[VM_EXIT_REASON_TPR_BELOW_THRESHOLD].member = &exit_handler_intel_x64::handle_tpr_below_threshold;
+    handlers[VM_EXIT_REASON_APIC_ACCESS].member = &exit_handler_intel_x64::handle_apic_access;
+    handlers[VM_EXIT_REASON_VIRTUALIZED_EOI].member = &exit_handler_intel_x64::handle_virtualized_eoi;
+    handlers[VM_EXIT_REASON_ACCESS_TO_GDTR_OR_IDTR].member = &exit_handler_intel_x64::handle_access_to_gdtr_or_idtr;
+    handlers[VM_EXIT_REASON_ACCESS_TO_LDTR_OR_TR].member = &exit_handler_intel_x64::handle_access_to_ldtr_or_tr;
+    handlers[VM_EXIT_REASON_EPT_VIOLATION].member = &exit_handler_intel_x64::handle_ept_violation;
+    handlers[VM_EXIT_REASON_EPT_MISCONFIGURATION].member = &exit_handler_intel_x64::handle_ept_misconfiguration;
+    handlers[VM_EXIT_REASON_INVEPT].member = &exit_handler_intel_x64::handle_invept;
+    handlers[VM_EXIT_REASON_RDTSCP].member = &exit_handler_intel_x64::handle_rdtscp;
+    handlers[VM_EXIT_REASON_VMX_PREEMPTION_TIMER_EXPIRED].member = &exit_handler_intel_x64::handle_vmx_preemption_timer_expired;
+    handlers[VM_EXIT_REASON_INVVPID].member = &exit_handler_intel_x64::handle_invvpid;
+    handlers[VM_EXIT_REASON_WBINVD].member = &exit_handler_intel_x64::handle_wbinvd;
+    handlers[VM_EXIT_REASON_XSETBV].member = &exit_handler_intel_x64::handle_xsetbv;
+    handlers[VM_EXIT_REASON_APIC_WRITE].member = &exit_handler_intel_x64::handle_apic_write;
+    handlers[VM_EXIT_REASON_RDRAND].member = &exit_handler_intel_x64::handle_rdrand;
+    handlers[VM_EXIT_REASON_INVPCID].member = &exit_handler_intel_x64::handle_invpcid;
+    handlers[VM_EXIT_REASON_VMFUNC].member = &exit_handler_intel_x64::handle_vmfunc;
+    handlers[VM_EXIT_REASON_RDSEED].member = &exit_handler_intel_x64::handle_rdseed;
+    handlers[VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL].member = &exit_handler_intel_x64::handle_page_modification_log_full;
+    handlers[VM_EXIT_REASON_XSAVES].member = &exit_handler_intel_x64::handle_xsaves;
+    handlers[VM_EXIT_REASON_XRSTORS].member = &exit_handler_intel_x64::handle_xrstors;
+
+    return table;
 }
 
 void
@@ -459,6 +460,7 @@ exit_handler_intel_x64::handle_vmwrite()
 void
 exit_handler_intel_x64::handle_vmxoff()
 {
+    this->flush_vmcs_field_cache();
     m_vmcs->promote();
 }
 
@@ -476,7 +478,63 @@ exit_handler_intel_x64::handle_mov_dr()
 
 void
 exit_handler_intel_x64::handle_io_instruction()
-{ unimplemented_handler(); }
+{
+    io_instruction_intel_x64 io;
+    auto qualification = exit_qualification();
+
+    io.port = static_cast<uint16_t>((qualification & IO_EXIT_QUALIFICATION_PORT) >> IO_EXIT_QUALIFICATION_PORT_SHIFT);
+    io.size = static_cast<uint8_t>((qualification & IO_EXIT_QUALIFICATION_SIZE) + 1);
+    io.in = (qualification & IO_EXIT_QUALIFICATION_DIRECTION_IN) != 0;
+    io.string = (qualification & IO_EXIT_QUALIFICATION_STRING) != 0;
+    io.rep = (qualification & IO_EXIT_QUALIFICATION_REP) != 0;
+    io.immediate = (qualification & IO_EXIT_QUALIFICATION_IMMEDIATE) != 0;
+
+    // An access of more than one byte exits if any of the ports that it
+    // touches is trapped, so an access can exit without starting at a
+    // registered port. Passing such an access through would access the
+    // trapped port on real hardware, so it is sent to the handler of the
+    // lowest registered port that it touches instead. Since registered
+    // ranges do not overlap, a range that contains the first port wins.
+
+    auto last = static_cast<uint32_t>(io.port) + io.size - 1;
+    const io_handler_entry *owner = nullptr;
+
+    for (const auto &entry : m_io_handlers)
+    {
+        if (io.port >= entry.first && io.port <= entry.last)
+        {
+            owner = &entry;
+            break;
+        }
+
+        if (io.port < entry.first && last >= entry.first)
+        {
+            if (owner == nullptr || entry.first < owner->first)
+                owner = &entry;
+        }
+    }
+
+    if (owner != nullptr)
+    {
+        owner->handler(io, *m_state_save);
+        advance_rip();
+
+        return;
+    }
+
+    // Otherwise, the access does not touch a registered port (e.g. the
+    // port was trapped through the VMCS directly), and it is executed on
+    // behalf of the guest.
+
+    if (io.string)
+    {
+        unimplemented_handler();
+        return;
+    }
+
+    pass_through_io(io);
+    advance_rip();
+}
 
 void
 exit_handler_intel_x64::handle_rdmsr()
@@ -686,6 +744,25 @@ void
 exit_handler_intel_x64::handle_rdseed()
 { unimplemented_handler(); }
 
+void
+exit_handler_intel_x64::handle_page_modification_log_full()
+{
+    // The CPU fills the log from the last entry down, so the valid entries
+    // are the ones above the index. Once the log is full, the index has
+    // wrapped (to 0xFFFF), and all of the entries are valid. Note that the
+    // write that caused this exit has not been logged yet, and is retried
+    // (and logged) once the guest is resumed, so RIP is not advanced.
+
+    auto pml = m_vmcs->pml();
+    auto index = vmread(VMCS_GUEST_PML_INDEX) & 0x000000000000FFFF;
+    auto first = index < PML_NUM_ENTRIES ? index + 1 : 0;
+
+    for (auto i = first; i < static_cast<uint64_t>(pml.size()); i++)
+        m_dirty_ring.push(pml[static_cast<std::ptrdiff_t>(i)] & ~(PAGE_SIZE_4K - 1));
+
+    vmwrite(VMCS_GUEST_PML_INDEX, PML_INDEX_START);
+}
+
 void
 exit_handler_intel_x64::handle_xsaves()
 { unimplemented_handler(); }
@@ -694,10 +771,75 @@ void
 exit_handler_intel_x64::handle_xrstors()
 { unimplemented_handler(); }
 
+void
+exit_handler_intel_x64::register_io_handler(uint16_t first, uint16_t last, io_handler_type handler)
+{
+    if (first > last)
+        throw std::invalid_argument("first > last");
+
+    if (!handler)
+        throw std::invalid_argument("handler == nullptr");
+
+    if (!m_vmcs)
+        throw std::logic_error("the vmcs has not been set");
+
+    for (const auto &entry : m_io_handlers)
+    {
+        if (first <= entry.last && last >= entry.first)
+            throw std::invalid_argument("the ports overlap a registered io handler");
+    }
+
+    m_io_handlers.push_back({first, last, std::move(handler)});
+
+    for (auto port = static_cast<uint32_t>(first); port <= last; port++)
+        m_vmcs->trap_io_port(static_cast<uint16_t>(port));
+}
+
+void
+exit_handler_intel_x64::pass_through_io(const io_instruction_intel_x64 &io)
+{
+    if (io.in)
+    {
+        switch (io.size)
+        {
+            case 1:
+                m_state_save->rax &= 0xFFFFFFFFFFFFFF00;
+                m_state_save->rax |= m_intrinsics->read_portio_8(io.port);
+                break;
+
+            case 2:
+                m_state_save->rax &= 0xFFFFFFFFFFFF0000;
+                m_state_save->rax |= m_intrinsics->read_portio_16(io.port);
+                break;
+
+            default:
+                m_state_save->rax = m_intrinsics->read_portio_32(io.port);
+                break;
+        }
+    }
+    else
+    {
+        switch (io.size)
+        {
+            case 1:
+                m_intrinsics->write_portio_8(io.port, static_cast<uint8_t>(m_state_save->rax));
+                break;
+
+            case 2:
+                m_intrinsics->write_portio_16(io.port, static_cast<uint16_t>(m_state_save->rax));
+                break;
+
+            default:
+                m_intrinsics->write_portio_32(io.port, static_cast<uint32_t>(m_state_save->rax));
+                break;
+        }
+    }
+}
+
 void
 exit_handler_intel_x64::advance_rip()
 {
-    m_state_save->rip += m_exit_instruction_length;
+    m_state_save->rip += exit_instruction_length();
 }
 
 void
@@ -714,11 +856,11 @@ exit_handler_intel_x64::unimplemented_handler()
     bferror << "- exit reason string: "
             << exit_reason_to_str(m_exit_reason & 0x0000FFFF) << bfendl;
     bferror << "- exit qualification: "
-            << view_as_pointer(m_exit_qualification) << bfendl;
+            << view_as_pointer(exit_qualification()) << bfendl;
     bferror << "- instruction length: "
-            << view_as_pointer(m_exit_instruction_length) << bfendl;
+            << view_as_pointer(exit_instruction_length()) << bfendl;
     bferror << "- instruction information: "
-            << view_as_pointer(m_exit_instruction_information) << bfendl;
+            << view_as_pointer(exit_instruction_information()) << bfendl;
 
     if ((m_exit_reason & 0x80000000) != 0)
     {
@@ -726,6 +868,8 @@ exit_handler_intel_x64::unimplemented_handler()
         bferror << "VM-entry failure detected!!!" << bfendl;
         bferror << bfendl;
 
+        this->flush_vmcs_field_cache();
+
         m_vmcs->check_vmcs_control_state();
         m_vmcs->check_vmcs_guest_state();
         m_vmcs->check_vmcs_host_state();
@@ -736,6 +880,18 @@ exit_handler_intel_x64::unimplemented_handler()
     this->halt();
 }
 
+uint64_t
+exit_handler_intel_x64::cached_exit_info(uint64_t field, uint64_t &value, uint32_t flag)
+{
+    if ((m_exit_info_cached & flag) == 0)
+    {
+        value = vmread(field);
+        m_exit_info_cached |= flag;
+    }
+
+    return value;
+}
+
 const char *
 exit_handler_intel_x64::exit_reason_to_str(uint64_t exit_reason)
 {
@@ -915,6 +1071,9 @@ exit_handler_intel_x64::exit_reason_to_str(uint64_t exit_reason)
         case VM_EXIT_REASON_RDSEED:
             return "VM_EXIT_REASON_RDSEED";
 
+        case VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL:
+            return "VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL";
+
         case VM_EXIT_REASON_XSAVES:
             return "VM_EXIT_REASON_XSAVES";
 
@@ -931,6 +1090,9 @@ exit_handler_intel_x64::vmread(uint64_t field) const
 {
     uint64_t value = 0;
 
+    if (m_vmcs_field_cache_enabled && m_vmcs_field_cache.read(field, value))
+        return value;
+
     if (!m_intrinsics->vmread(field, &value))
     {
         bferror << "exit_handler_intel_x64::vmread failed:" << bfendl;
@@ -939,11 +1101,29 @@ exit_handler_intel_x64::vmread(uint64_t field) const
         throw std::runtime_error("vmread failed");
     }
 
+    if (m_vmcs_field_cache_enabled)
+        m_vmcs_field_cache.fill(field, value);
+
     return value;
 }
 
+page_walk_x64
+exit_handler_intel_x64::guest_translate(uintptr_t virt)
+{
+    return m_translation_cache.translate(vmread(VMCS_GUEST_CR3), virt);
+}
+
 void
 exit_handler_intel_x64::vmwrite(uint64_t field, uint64_t value)
+{
+    if (m_vmcs_field_cache_enabled && m_vmcs_field_cache.write(field, value))
+        return;
+
+    this->vmwrite_uncached(field, value);
+}
+
+void
+exit_handler_intel_x64::vmwrite_uncached(uint64_t field, uint64_t value)
 {
     if (!m_intrinsics->vmwrite(field, value))
     {
@@ -954,3 +1134,10 @@ exit_handler_intel_x64::vmwrite(uint64_t field, uint64_t value)
         throw std::runtime_error("vmwrite failed");
     }
 }
+
+void
+exit_handler_intel_x64::flush_vmcs_field_cache()
+{
+    m_vmcs_field_cache.flush([&](uint64_t field, uint64_t value)
+    { this->vmwrite_uncached(field, value); });
+}
@@ -0,0 +1,138 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <mutex>
+#include <exit_handler/exit_stats_intel_x64.h>
+#include <intrinsics/intrinsics_intel_x64.h>
+
+static_assert(VM_EXIT_REASON_MAX < EXIT_STATS_NUM_REASONS,
+              "EXIT_STATS_NUM_REASONS must cover every basic exit reason");
+
+// -----------------------------------------------------------------------------
+// Global
+// -----------------------------------------------------------------------------
+
+// The registry is only used when a vCPU is created, and when the driver
+// entry asks for a vCPU's statistics, never while an exit is recorded.
+
+std::mutex g_exit_stats_mutex;
+
+extern "C" int64_t
+get_exit_stats(uint64_t vcpuid, struct exit_stats *stats) noexcept
+{
+    if (stats == nullptr)
+        return GET_EXIT_STATS_FAILURE;
+
+    std::lock_guard<std::mutex> guard(g_exit_stats_mutex);
+
+    auto &registry = exit_stats_intel_x64::registry();
+    auto iter = registry.find(vcpuid);
+
+    if (iter == registry.end())
+        return GET_EXIT_STATS_FAILURE;
+
+    exit_stats_intel_x64::read(*iter->second, stats);
+
+    return GET_EXIT_STATS_SUCCESS;
+}
+
+// -----------------------------------------------------------------------------
+// Exit Statistics Implementation
+// -----------------------------------------------------------------------------
+
+exit_stats_intel_x64::exit_stats_intel_x64(uint64_t vcpuid) :
+    m_counters(std::make_shared<counters>())
+{
+    m_counters->vcpuid = vcpuid;
+
+    for (auto i = 0U; i < EXIT_STATS_NUM_REASONS; i++)
+    {
+        m_counters->count[i] = 0;
+        m_counters->ticks[i] = 0;
+
+        for (auto &bucket : m_counters->histogram[i])
+            bucket = 0;
+    }
+
+    std::lock_guard<std::mutex> guard(g_exit_stats_mutex);
+    registry()[vcpuid] = m_counters;
+}
+
+void
+exit_stats_intel_x64::record(uint64_t exit_reason, uint64_t ticks) noexcept
+{
+    if (exit_reason >= EXIT_STATS_NUM_REASONS)
+        return;
+
+    // The owning vCPU is the only writer, so the counters do not need a
+    // read-modify-write. The atomics are only here so that readers on
+    // other cores see whole values.
+
+    auto &count = m_counters->count[exit_reason];
+    auto &total = m_counters->ticks[exit_reason];
+    auto &histogram = m_counters->histogram[exit_reason][bucket(ticks)];
+
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    total.store(total.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+    histogram.store(histogram.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void
+exit_stats_intel_x64::read(struct exit_stats *stats) const noexcept
+{
+    if (stats == nullptr)
+        return;
+
+    read(*m_counters, stats);
+}
+
+uint64_t
+exit_stats_intel_x64::bucket(uint64_t ticks) noexcept
+{
+    if (ticks == 0)
+        return 0;
+
+    auto b = static_cast<uint64_t>(63 - __builtin_clzll(ticks));
+    return b < EXIT_STATS_NUM_BUCKETS ? b : EXIT_STATS_NUM_BUCKETS - 1;
+}
+
+void
+exit_stats_intel_x64::read(const counters &c, struct exit_stats *stats) noexcept
+{
+    stats->vcpuid = c.vcpuid;
+
+    for (auto i = 0U; i < EXIT_STATS_NUM_REASONS; i++)
+    {
+        stats->count[i] = c.count[i].load(std::memory_order_relaxed);
+        stats->ticks[i] = c.ticks[i].load(std::memory_order_relaxed);
+
+        for (auto j = 0U; j < EXIT_STATS_NUM_BUCKETS; j++)
+            stats->histogram[i][j] = c.histogram[i][j].load(std::memory_order_relaxed);
+    }
+}
+
+std::map<uint64_t, std::shared_ptr<exit_stats_intel_x64::counters> > &
+exit_stats_intel_x64::registry() noexcept
+{
+    static std::map<uint64_t, std::shared_ptr<counters> > s_registry;
+    return s_registry;
+}
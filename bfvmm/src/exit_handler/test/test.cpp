@@ -78,6 +78,11 @@ exit_handler_intel_x64_ut::list()
     this->test_vm_exit_reason_control_register_accesses();
     this->test_vm_exit_reason_mov_dr();
     this->test_vm_exit_reason_io_instruction();
+    this->test_vm_exit_reason_io_instruction_in();
+    this->test_vm_exit_reason_io_instruction_string();
+    this->test_vm_exit_reason_io_instruction_handler();
+    this->test_vm_exit_reason_io_instruction_handler_straddle();
+    this->test_register_io_handler_invalid();
     this->test_vm_exit_reason_rdmsr_debug_ctl();
     this->test_vm_exit_reason_rdmsr_pat();
     this->test_vm_exit_reason_rdmsr_efer();
@@ -124,12 +129,32 @@ exit_handler_intel_x64_ut::list()
     this->test_vm_exit_reason_invpcid();
     this->test_vm_exit_reason_vmfunc();
     this->test_vm_exit_reason_rdseed();
+    this->test_vm_exit_reason_page_modification_log_full();
+    this->test_vm_exit_reason_page_modification_log_partial();
     this->test_vm_exit_reason_xsaves();
     this->test_vm_exit_reason_xrstors();
     this->test_vm_exit_reason_to_string();
     this->test_halt();
     this->test_vmread_failure();
     this->test_vmwrite_failure();
+    this->test_guest_translate();
+    this->test_register_handler();
+    this->test_register_handler_invalid();
+    this->test_chain_handler();
+    this->test_chain_handler_unimplemented();
+    this->test_install_dispatch_table();
+    this->test_install_dispatch_table_from_handler();
+    this->test_register_member_handler();
+    this->test_dispatch_benchmark();
+    this->test_exit_info_not_read_unless_needed();
+    this->test_exit_info_read_once_per_exit();
+    this->test_vmcs_field_cache_write_back();
+    this->test_vmcs_field_cache_disabled();
+    this->test_exit_stats_bucket();
+    this->test_exit_stats_record();
+    this->test_exit_stats_get_exit_stats();
+    this->test_exit_stats_dispatch();
+    this->test_dispatch_flushes_tlb_on_pt_generation();
 
     return true;
 }
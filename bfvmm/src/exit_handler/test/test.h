@@ -24,6 +24,8 @@
 
 #include <unittest.h>
 
+class exit_handler_intel_x64;
+
 class exit_handler_intel_x64_ut : public unittest
 {
 public:
@@ -77,6 +79,11 @@ private:
     void test_vm_exit_reason_control_register_accesses();
     void test_vm_exit_reason_mov_dr();
     void test_vm_exit_reason_io_instruction();
+    void test_vm_exit_reason_io_instruction_in();
+    void test_vm_exit_reason_io_instruction_string();
+    void test_vm_exit_reason_io_instruction_handler();
+    void test_vm_exit_reason_io_instruction_handler_straddle();
+    void test_register_io_handler_invalid();
     void test_vm_exit_reason_rdmsr_debug_ctl();
     void test_vm_exit_reason_rdmsr_pat();
     void test_vm_exit_reason_rdmsr_efer();
@@ -123,12 +130,34 @@ private:
     void test_vm_exit_reason_invpcid();
     void test_vm_exit_reason_vmfunc();
     void test_vm_exit_reason_rdseed();
+    void test_vm_exit_reason_page_modification_log_full();
+    void test_vm_exit_reason_page_modification_log_partial();
     void test_vm_exit_reason_xsaves();
     void test_vm_exit_reason_xrstors();
     void test_vm_exit_reason_to_string();
     void test_halt();
     void test_vmread_failure();
     void test_vmwrite_failure();
+    void test_guest_translate();
+    void test_register_handler();
+    void test_register_handler_invalid();
+    void test_chain_handler();
+    void test_chain_handler_unimplemented();
+    void test_install_dispatch_table();
+    void test_install_dispatch_table_from_handler();
+    void test_register_member_handler();
+    void test_dispatch_benchmark();
+
+    static void switch_dispatch(exit_handler_intel_x64 &eh, uint64_t basic_exit_reason);
+    void test_exit_info_not_read_unless_needed();
+    void test_exit_info_read_once_per_exit();
+    void test_vmcs_field_cache_write_back();
+    void test_vmcs_field_cache_disabled();
+    void test_exit_stats_bucket();
+    void test_exit_stats_record();
+    void test_exit_stats_get_exit_stats();
+    void test_exit_stats_dispatch();
+    void test_dispatch_flushes_tlb_on_pt_generation();
 };
 
 #endif
@@ -23,6 +23,12 @@
 #include <vmcs/vmcs_intel_x64.h>
 #include <exit_handler/exit_handler_intel_x64.h>
 #include <exit_handler/exit_handler_intel_x64_support.h>
+#include <memory_manager/memory_manager.h>
+#include <memory_manager/root_page_table_x64.h>
+
+#include <vector>
+#include <iostream>
+#include <algorithm>
 
 uint64_t g_field = 0;
 uint64_t g_value = 0;
@@ -57,6 +63,25 @@ stubbed_vmread(uint64_t field, uint64_t *value)
     return true;
 }
 
+uint64_t g_exit_info_reads = 0;
+
+bool
+counted_vmread(uint64_t field, uint64_t *value)
+{
+    switch (field)
+    {
+        case VMCS_EXIT_QUALIFICATION:
+        case VMCS_VM_EXIT_INSTRUCTION_LENGTH:
+        case VMCS_VM_EXIT_INSTRUCTION_INFORMATION:
+            g_exit_info_reads++;
+            break;
+        default:
+            break;
+    }
+
+    return stubbed_vmread(field, value);
+}
+
 bool
 stubbed_vmwrite(uint64_t field, uint64_t value)
 {
@@ -66,6 +91,32 @@ stubbed_vmwrite(uint64_t field, uint64_t value)
     return true;
 }
 
+uint64_t g_rflags_reads = 0;
+uint64_t g_rflags_writes = 0;
+
+bool
+counted_rflags_vmread(uint64_t field, uint64_t *value)
+{
+    if (field == VMCS_GUEST_RFLAGS)
+    {
+        g_rflags_reads++;
+        *value = 0x2;
+
+        return true;
+    }
+
+    return stubbed_vmread(field, value);
+}
+
+bool
+counted_rflags_vmwrite(uint64_t field, uint64_t value)
+{
+    if (field == VMCS_GUEST_RFLAGS)
+        g_rflags_writes++;
+
+    return stubbed_vmwrite(field, value);
+}
+
 void
 exit_handler_intel_x64_ut::test_invalid_intrinics()
 {
@@ -896,7 +947,72 @@ exit_handler_intel_x64_ut::test_vm_exit_reason_io_instruction()
     eh->set_vmcs(vmcs);
     eh->set_state_save(ss);
 
+    ss->rax = 0x12345678;
+    ss->rip = 0x1000;
+    g_exit_reason = VM_EXIT_REASON_IO_INSTRUCTION;
+    g_exit_qualification = 0x00800001;
+    g_exit_instruction_length = 1;
+
+    mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::write_portio_16).With(0x80, 0x5678);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->dispatch();
+        EXPECT_TRUE(ss->rip == 0x1001);
+    });
+
+    g_exit_qualification = 0;
+}
+
+void
+exit_handler_intel_x64_ut::test_vm_exit_reason_io_instruction_in()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    ss->rax = 0xFFFFFFFFFFFFFFFF;
+    g_exit_reason = VM_EXIT_REASON_IO_INSTRUCTION;
+    g_exit_qualification = 0x0CF80000 | IO_EXIT_QUALIFICATION_DIRECTION_IN | 0x3;
+
+    mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::read_portio_32).With(0xCF8).Return(0x80000000);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->dispatch();
+        EXPECT_TRUE(ss->rax == 0x80000000);
+    });
+
+    g_exit_qualification = 0;
+}
+
+void
+exit_handler_intel_x64_ut::test_vm_exit_reason_io_instruction_string()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
     g_exit_reason = VM_EXIT_REASON_IO_INSTRUCTION;
+    g_exit_qualification = 0x00800000 | IO_EXIT_QUALIFICATION_STRING;
 
     mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::stop);
     mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
@@ -905,6 +1021,145 @@ exit_handler_intel_x64_ut::test_vm_exit_reason_io_instruction()
     {
         eh->dispatch();
     });
+
+    g_exit_qualification = 0;
+}
+
+void
+exit_handler_intel_x64_ut::test_vm_exit_reason_io_instruction_handler()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::trap_io_port).With(0x402);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::trap_io_port).With(0x403);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto called = false;
+    io_instruction_intel_x64 decoded = {};
+
+    ss->rip = 0x1000;
+    g_exit_reason = VM_EXIT_REASON_IO_INSTRUCTION;
+    g_exit_qualification = 0x04030000 | IO_EXIT_QUALIFICATION_DIRECTION_IN |
+                           IO_EXIT_QUALIFICATION_STRING | IO_EXIT_QUALIFICATION_REP | 0x1;
+    g_exit_instruction_length = 2;
+
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->register_io_handler(0x402, 0x403, [&](const auto & io, auto & state)
+        {
+            called = true;
+            decoded = io;
+            state.rcx = 0;
+        });
+
+        eh->dispatch();
+
+        EXPECT_TRUE(called);
+        EXPECT_TRUE(decoded.port == 0x403);
+        EXPECT_TRUE(decoded.size == 2);
+        EXPECT_TRUE(decoded.in);
+        EXPECT_TRUE(decoded.string);
+        EXPECT_TRUE(decoded.rep);
+        EXPECT_FALSE(decoded.immediate);
+        EXPECT_TRUE(ss->rip == 0x1002);
+    });
+
+    g_exit_qualification = 0;
+}
+
+void
+exit_handler_intel_x64_ut::test_vm_exit_reason_io_instruction_handler_straddle()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+    mocks.OnCall(vmcs.get(), vmcs_intel_x64::trap_io_port);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto called_low = false;
+    auto called_high = false;
+    io_instruction_intel_x64 decoded = {};
+
+    // A 4 byte OUT to 0x3FE touches 0x3FE - 0x401, where 0x3FE and 0x3FF
+    // are not trapped, but 0x400 and 0x401 are. It must not reach the
+    // hardware, and is sent to the handler of 0x400 (and not 0x401).
+
+    ss->rax = 0x12345678;
+    ss->rip = 0x1000;
+    g_exit_reason = VM_EXIT_REASON_IO_INSTRUCTION;
+    g_exit_qualification = 0x03FE0000 | 0x3;
+    g_exit_instruction_length = 1;
+
+    mocks.NeverCall(intrinsics.get(), intrinsics_intel_x64::write_portio_32);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->register_io_handler(0x401, 0x401, [&](const auto &, auto &)
+        { called_high = true; });
+
+        eh->register_io_handler(0x400, 0x400, [&](const auto & io, auto &)
+        {
+            called_low = true;
+            decoded = io;
+        });
+
+        eh->dispatch();
+
+        EXPECT_TRUE(called_low);
+        EXPECT_FALSE(called_high);
+        EXPECT_TRUE(decoded.port == 0x3FE);
+        EXPECT_TRUE(decoded.size == 4);
+        EXPECT_FALSE(decoded.in);
+        EXPECT_TRUE(ss->rip == 0x1001);
+    });
+
+    g_exit_qualification = 0;
+}
+
+void
+exit_handler_intel_x64_ut::test_register_io_handler_invalid()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(vmcs.get(), vmcs_intel_x64::trap_io_port);
+
+    auto handler = [](const auto &, auto &) {};
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_EXCEPTION(eh->register_io_handler(0x10, 0x20, handler), std::logic_error);
+
+        eh->set_vmcs(vmcs);
+
+        EXPECT_EXCEPTION(eh->register_io_handler(0x20, 0x10, handler), std::invalid_argument);
+        EXPECT_EXCEPTION(eh->register_io_handler(0x10, 0x20, nullptr), std::invalid_argument);
+        EXPECT_NO_EXCEPTION(eh->register_io_handler(0x10, 0x20, handler));
+        EXPECT_EXCEPTION(eh->register_io_handler(0x20, 0x30, handler), std::invalid_argument);
+        EXPECT_EXCEPTION(eh->register_io_handler(0x00, 0x10, handler), std::invalid_argument);
+        EXPECT_NO_EXCEPTION(eh->register_io_handler(0x21, 0x30, handler));
+        EXPECT_NO_EXCEPTION(eh->register_io_handler(0xFFFF, 0xFFFF, handler));
+    });
 }
 
 void
@@ -2246,6 +2501,94 @@ exit_handler_intel_x64_ut::test_vm_exit_reason_rdseed()
     });
 }
 
+void
+exit_handler_intel_x64_ut::test_vm_exit_reason_page_modification_log_full()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    uint64_t pml[PML_NUM_ENTRIES];
+    for (auto i = 0U; i < PML_NUM_ENTRIES; i++)
+        pml[i] = (i << 12) | 0x123;
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+    mocks.OnCall(vmcs.get(), vmcs_intel_x64::pml).Return(gsl::span<uint64_t>(pml));
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    ss->rip = 0x1000;
+    g_value = 0xFFFF;
+    g_exit_reason = VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL;
+    g_exit_instruction_length = 4;
+
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->dispatch();
+
+        EXPECT_TRUE(g_field == VMCS_GUEST_PML_INDEX);
+        EXPECT_TRUE(g_value == PML_INDEX_START);
+        EXPECT_TRUE(ss->rip == 0x1000);
+        EXPECT_TRUE(eh->dirty_ring().size() == PML_NUM_ENTRIES);
+
+        auto in_order = true;
+        for (auto i = 0U; i < PML_NUM_ENTRIES; i++)
+        {
+            uintptr_t gpa = 0;
+            if (!eh->dirty_ring().pop(gpa) || gpa != (i << 12))
+                in_order = false;
+        }
+
+        EXPECT_TRUE(in_order);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_vm_exit_reason_page_modification_log_partial()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    uint64_t pml[PML_NUM_ENTRIES] = {};
+    pml[PML_NUM_ENTRIES - 2] = 0x0000000ABCDEF123;
+    pml[PML_NUM_ENTRIES - 1] = 0x0000000000042000;
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+    mocks.OnCall(vmcs.get(), vmcs_intel_x64::pml).Return(gsl::span<uint64_t>(pml));
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    g_value = PML_NUM_ENTRIES - 3;
+    g_exit_reason = VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL;
+
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        uintptr_t gpa = 0;
+
+        eh->dispatch();
+
+        EXPECT_TRUE(g_value == PML_INDEX_START);
+        EXPECT_TRUE(eh->dirty_ring().size() == 2);
+        EXPECT_TRUE(eh->dirty_ring().pop(gpa));
+        EXPECT_TRUE(gpa == 0x0000000ABCDEF000);
+        EXPECT_TRUE(eh->dirty_ring().pop(gpa));
+        EXPECT_TRUE(gpa == 0x0000000000042000);
+    });
+}
+
 void
 exit_handler_intel_x64_ut::test_vm_exit_reason_xsaves()
 {
@@ -2366,6 +2709,7 @@ exit_handler_intel_x64_ut::test_vm_exit_reason_to_string()
     EXPECT_TRUE(eh->exit_reason_to_str(VM_EXIT_REASON_INVPCID) == STRINGIFY_MACRO(VM_EXIT_REASON_INVPCID));
     EXPECT_TRUE(eh->exit_reason_to_str(VM_EXIT_REASON_VMFUNC) == STRINGIFY_MACRO(VM_EXIT_REASON_VMFUNC));
     EXPECT_TRUE(eh->exit_reason_to_str(VM_EXIT_REASON_RDSEED) == STRINGIFY_MACRO(VM_EXIT_REASON_RDSEED));
+    EXPECT_TRUE(eh->exit_reason_to_str(VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL) == STRINGIFY_MACRO(VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL));
     EXPECT_TRUE(eh->exit_reason_to_str(VM_EXIT_REASON_XSAVES) == STRINGIFY_MACRO(VM_EXIT_REASON_XSAVES));
     EXPECT_TRUE(eh->exit_reason_to_str(VM_EXIT_REASON_XRSTORS) == STRINGIFY_MACRO(VM_EXIT_REASON_XRSTORS));
     EXPECT_TRUE(eh->exit_reason_to_str(0x100000) == STRINGIFY_MACRO(UNKNOWN));
@@ -2449,3 +2793,967 @@ exit_handler_intel_x64_ut::test_vmwrite_failure()
         EXPECT_EXCEPTION(eh->dispatch(), std::runtime_error);
     });
 }
+
+void
+exit_handler_intel_x64_ut::test_guest_translate()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.ExpectCallOverload(mm, (void *(memory_manager::*)(uintptr_t))&memory_manager::phys_to_virt_ptr).With(0x0000000ABCDEF000).Return(nullptr);
+
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+
+    g_value = 0x0000000ABCDEF000;
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        EXPECT_FALSE(eh->guest_translate(0x1000).present);
+        EXPECT_TRUE(g_field == VMCS_GUEST_CR3);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_register_handler()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto called = 0;
+    g_exit_reason = VM_EXIT_REASON_CPUID;
+
+    mocks.NeverCall(intrinsics.get(), intrinsics_intel_x64::cpuid);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->register_handler(VM_EXIT_REASON_CPUID, [&](exit_handler_intel_x64 &)
+        { called++; });
+
+        eh->dispatch();
+        EXPECT_TRUE(called == 1);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_register_handler_invalid()
+{
+    auto eh = std::make_unique<exit_handler_intel_x64>();
+    auto handler = [](exit_handler_intel_x64 &) {};
+    auto chained = [](exit_handler_intel_x64 &, const exit_handler_intel_x64::handler_type &) {};
+
+    EXPECT_EXCEPTION(eh->register_handler(VM_EXIT_REASON_MAX + 1, handler), std::invalid_argument);
+    EXPECT_EXCEPTION(eh->register_handler(VM_EXIT_REASON_CPUID, exit_handler_intel_x64::handler_type(nullptr)), std::invalid_argument);
+    EXPECT_EXCEPTION(eh->register_handler(VM_EXIT_REASON_MAX + 1, &exit_handler_intel_x64::halt), std::invalid_argument);
+    EXPECT_EXCEPTION(eh->register_handler(VM_EXIT_REASON_CPUID, exit_handler_intel_x64::member_handler_type(nullptr)), std::invalid_argument);
+    EXPECT_EXCEPTION(eh->chain_handler(VM_EXIT_REASON_MAX + 1, chained), std::invalid_argument);
+    EXPECT_EXCEPTION(eh->chain_handler(VM_EXIT_REASON_CPUID, nullptr), std::invalid_argument);
+    EXPECT_EXCEPTION(eh->install_dispatch_table(nullptr), std::invalid_argument);
+}
+
+void
+exit_handler_intel_x64_ut::test_chain_handler()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto observed = 0;
+    g_exit_reason = VM_EXIT_REASON_CPUID;
+
+    mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::cpuid);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->chain_handler(VM_EXIT_REASON_CPUID, [&](exit_handler_intel_x64 & eh, const auto & next)
+        {
+            observed++;
+            next(eh);
+        });
+
+        eh->dispatch();
+        EXPECT_TRUE(observed == 1);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_chain_handler_unimplemented()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto table = std::make_shared<exit_handler_intel_x64::dispatch_table_type>();
+    g_exit_reason = VM_EXIT_REASON_CPUID;
+
+    mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::stop);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->install_dispatch_table(table);
+        eh->chain_handler(VM_EXIT_REASON_CPUID, [&](exit_handler_intel_x64 & eh, const auto & next)
+        { next(eh); });
+
+        eh->dispatch();
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_install_dispatch_table()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto called = 0;
+    auto original = eh->dispatch_table();
+    auto table = std::make_shared<exit_handler_intel_x64::dispatch_table_type>();
+
+    (*table)[VM_EXIT_REASON_RDMSR].handler = [&](exit_handler_intel_x64 &)
+    { called++; };
+
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+    mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::stop);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+    mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::cpuid);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->install_dispatch_table(table);
+        EXPECT_TRUE(eh->dispatch_table() == table);
+
+        g_exit_reason = VM_EXIT_REASON_RDMSR;
+        eh->dispatch();
+        EXPECT_TRUE(called == 1);
+
+        g_exit_reason = VM_EXIT_REASON_CPUID;
+        eh->dispatch();
+
+        eh->install_dispatch_table(original);
+        eh->dispatch();
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_install_dispatch_table_from_handler()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto marker = std::make_shared<int>(42);
+    std::weak_ptr<int> weak_marker = marker;
+
+    g_exit_reason = VM_EXIT_REASON_VMCALL;
+
+    mocks.ExpectCalls(vmcs.get(), vmcs_intel_x64::resume, 2);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->register_handler(VM_EXIT_REASON_VMCALL, [this, marker](exit_handler_intel_x64 & eh)
+        {
+            auto table = std::make_shared<exit_handler_intel_x64::dispatch_table_type>();
+            (*table)[VM_EXIT_REASON_VMCALL].handler = [](exit_handler_intel_x64 &) {};
+
+            eh.install_dispatch_table(table);
+
+            // The table that this handler was called from (and thus this
+            // lambda's captures) must still be alive here.
+            EXPECT_TRUE(*marker == 42);
+        });
+
+        marker.reset();
+
+        eh->dispatch();
+        EXPECT_FALSE(weak_marker.expired());
+
+        eh->dispatch();
+        EXPECT_TRUE(weak_marker.expired());
+    });
+}
+
+class exit_handler_dispatch_benchmark : public exit_handler_intel_x64
+{
+public:
+
+    uint64_t num_exits = 0;
+
+    void handle_cpuid() override
+    { num_exits++; }
+
+    void handle_rdmsr() override
+    { num_exits++; }
+
+    void handle_wrmsr() override
+    { num_exits++; }
+
+    void handle_io_instruction() override
+    { num_exits++; }
+
+    void handle_control_register_accesses() override
+    { num_exits++; }
+
+    void handle_vmcall() override
+    { num_exits++; }
+
+    void handle_ept_violation() override
+    { num_exits++; }
+
+    void handle_xsetbv() override
+    { num_exits++; }
+
+    void handle_member()
+    { num_exits++; }
+};
+
+void
+exit_handler_intel_x64_ut::test_register_member_handler()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_dispatch_benchmark>();
+    eh->m_intrinsics = intrinsics;
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    auto observed = 0;
+    g_exit_reason = VM_EXIT_REASON_RDMSR;
+
+    mocks.ExpectCalls(vmcs.get(), vmcs_intel_x64::resume, 3);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        // The default table calls the subclass's overrides, and a member
+        // handler can be chained like any other handler.
+
+        eh->dispatch();
+        EXPECT_TRUE(eh->num_exits == 1);
+
+        eh->register_handler(VM_EXIT_REASON_RDMSR,
+                             static_cast<exit_handler_intel_x64::member_handler_type>(&exit_handler_dispatch_benchmark::handle_member));
+        eh->dispatch();
+        EXPECT_TRUE(eh->num_exits == 2);
+
+        eh->chain_handler(VM_EXIT_REASON_RDMSR, [&](exit_handler_intel_x64 & eh, const auto & next)
+        {
+            observed++;
+            next(eh);
+        });
+
+        eh->dispatch();
+        EXPECT_TRUE(eh->num_exits == 3);
+        EXPECT_TRUE(observed == 1);
+    });
+}
+
+// The switch that dispatch() used before exits were dispatched through a
+// table. It is kept out of line, and only sees the exit handler through its
+// base class (like dispatch() did), so the compiler cannot devirtualize the
+// calls to the benchmark's handlers.
+
+__attribute__((noinline)) void
+exit_handler_intel_x64_ut::switch_dispatch(exit_handler_intel_x64 &eh, uint64_t basic_exit_reason)
+{
+    switch (basic_exit_reason)
+    {
+        case VM_EXIT_REASON_EXCEPTION_OR_NON_MASKABLE_INTERRUPT:
+            eh.handle_exception_or_non_maskable_interrupt();
+            break;
+
+        case VM_EXIT_REASON_EXTERNAL_INTERRUPT:
+            eh.handle_external_interrupt();
+            break;
+
+        case VM_EXIT_REASON_TRIPLE_FAULT:
+            eh.handle_triple_fault();
+            break;
+
+        case VM_EXIT_REASON_INIT_SIGNAL:
+            eh.handle_init_signal();
+            break;
+
+        case VM_EXIT_REASON_SIPI:
+            eh.handle_sipi();
+            break;
+
+        case VM_EXIT_REASON_SMI:
+            eh.handle_smi();
+            break;
+
+        case VM_EXIT_REASON_OTHER_SMI:
+            eh.handle_other_smi();
+            break;
+
+        case VM_EXIT_REASON_INTERRUPT_WINDOW:
+            eh.handle_interrupt_window();
+            break;
+
+        case VM_EXIT_REASON_NMI_WINDOW:
+            eh.handle_nmi_window();
+            break;
+
+        case VM_EXIT_REASON_TASK_SWITCH:
+            eh.handle_task_switch();
+            break;
+
+        case VM_EXIT_REASON_CPUID:
+            eh.handle_cpuid();
+            break;
+
+        case VM_EXIT_REASON_GETSEC:
+            eh.handle_getsec();
+            break;
+
+        case VM_EXIT_REASON_HLT:
+            eh.handle_hlt();
+            break;
+
+        case VM_EXIT_REASON_INVD:
+            eh.handle_invd();
+            break;
+
+        case VM_EXIT_REASON_INVLPG:
+            eh.handle_invlpg();
+            break;
+
+        case VM_EXIT_REASON_RDPMC:
+            eh.handle_rdpmc();
+            break;
+
+        case VM_EXIT_REASON_RDTSC:
+            eh.handle_rdtsc();
+            break;
+
+        case VM_EXIT_REASON_RSM:
+            eh.handle_rsm();
+            break;
+
+        case VM_EXIT_REASON_VMCALL:
+            eh.handle_vmcall();
+            break;
+
+        case VM_EXIT_REASON_VMCLEAR:
+            eh.handle_vmclear();
+            break;
+
+        case VM_EXIT_REASON_VMLAUNCH:
+            eh.handle_vmlaunch();
+            break;
+
+        case VM_EXIT_REASON_VMPTRLD:
+            eh.handle_vmptrld();
+            break;
+
+        case VM_EXIT_REASON_VMPTRST:
+            eh.handle_vmptrst();
+            break;
+
+        case VM_EXIT_REASON_VMREAD:
+            eh.handle_vmread();
+            break;
+
+        case VM_EXIT_REASON_VMRESUME:
+            eh.handle_vmresume();
+            break;
+
+        case VM_EXIT_REASON_VMWRITE:
+            eh.handle_vmwrite();
+            break;
+
+        case VM_EXIT_REASON_VMXOFF:
+            eh.handle_vmxoff();
+            break;
+
+        case VM_EXIT_REASON_VMXON:
+            eh.handle_vmxon();
+            break;
+
+        case VM_EXIT_REASON_CONTROL_REGISTER_ACCESSES:
+            eh.handle_control_register_accesses();
+            break;
+
+        case VM_EXIT_REASON_MOV_DR:
+            eh.handle_mov_dr();
+            break;
+
+        case VM_EXIT_REASON_IO_INSTRUCTION:
+            eh.handle_io_instruction();
+            break;
+
+        case VM_EXIT_REASON_RDMSR:
+            eh.handle_rdmsr();
+            break;
+
+        case VM_EXIT_REASON_WRMSR:
+            eh.handle_wrmsr();
+            break;
+
+        case VM_EXIT_REASON_VM_ENTRY_FAILURE_INVALID_GUEST_STATE:
+            eh.handle_vm_entry_failure_invalid_guest_state();
+            break;
+
+        case VM_EXIT_REASON_VM_ENTRY_FAILURE_MSR_LOADING:
+            eh.handle_vm_entry_failure_msr_loading();
+            break;
+
+        case VM_EXIT_REASON_MWAIT:
+            eh.handle_mwait();
+            break;
+
+        case VM_EXIT_REASON_MONITOR_TRAP_FLAG:
+            eh.handle_monitor_trap_flag();
+            break;
+
+        case VM_EXIT_REASON_MONITOR:
+            eh.handle_monitor();
+            break;
+
+        case VM_EXIT_REASON_PAUSE:
+            eh.handle_pause();
+            break;
+
+        case VM_EXIT_REASON_VM_ENTRY_FAILURE_MACHINE_CHECK_EVENT:
+            eh.handle_vm_entry_failure_machine_check_event();
+            break;
+
+        case VM_EXIT_REASON_TPR_BELOW_THRESHOLD:
+            eh.handle_tpr_below_threshold();
+            break;
+
+        case VM_EXIT_REASON_APIC_ACCESS:
+            eh.handle_apic_access();
+            break;
+
+        case VM_EXIT_REASON_VIRTUALIZED_EOI:
+            eh.handle_virtualized_eoi();
+            break;
+
+        case VM_EXIT_REASON_ACCESS_TO_GDTR_OR_IDTR:
+            eh.handle_access_to_gdtr_or_idtr();
+            break;
+
+        case VM_EXIT_REASON_ACCESS_TO_LDTR_OR_TR:
+            eh.handle_access_to_ldtr_or_tr();
+            break;
+
+        case VM_EXIT_REASON_EPT_VIOLATION:
+            eh.handle_ept_violation();
+            break;
+
+        case VM_EXIT_REASON_EPT_MISCONFIGURATION:
+            eh.handle_ept_misconfiguration();
+            break;
+
+        case VM_EXIT_REASON_INVEPT:
+            eh.handle_invept();
+            break;
+
+        case VM_EXIT_REASON_RDTSCP:
+            eh.handle_rdtscp();
+            break;
+
+        case VM_EXIT_REASON_VMX_PREEMPTION_TIMER_EXPIRED:
+            eh.handle_vmx_preemption_timer_expired();
+            break;
+
+        case VM_EXIT_REASON_INVVPID:
+            eh.handle_invvpid();
+            break;
+
+        case VM_EXIT_REASON_WBINVD:
+            eh.handle_wbinvd();
+            break;
+
+        case VM_EXIT_REASON_XSETBV:
+            eh.handle_xsetbv();
+            break;
+
+        case VM_EXIT_REASON_APIC_WRITE:
+            eh.handle_apic_write();
+            break;
+
+        case VM_EXIT_REASON_RDRAND:
+            eh.handle_rdrand();
+            break;
+
+        case VM_EXIT_REASON_INVPCID:
+            eh.handle_invpcid();
+            break;
+
+        case VM_EXIT_REASON_VMFUNC:
+            eh.handle_vmfunc();
+            break;
+
+        case VM_EXIT_REASON_RDSEED:
+            eh.handle_rdseed();
+            break;
+
+        case VM_EXIT_REASON_PAGE_MODIFICATION_LOG_FULL:
+            eh.handle_page_modification_log_full();
+            break;
+
+        case VM_EXIT_REASON_XSAVES:
+            eh.handle_xsaves();
+            break;
+
+        case VM_EXIT_REASON_XRSTORS:
+            eh.handle_xrstors();
+            break;
+
+        default:
+            eh.unimplemented_handler();
+            break;
+    }
+}
+
+void
+exit_handler_intel_x64_ut::test_dispatch_benchmark()
+{
+    // Compares the cost of dispatching an exit through the default table
+    // with the switch that it replaced. Both call the same virtual handle_*
+    // functions, and the exit reasons are mixed in a pseudo random order
+    // so that the benchmark is not just measuring the branch predictor.
+
+    constexpr const auto num_reasons = 4096;
+    constexpr const auto num_iterations = 1000;
+
+    const uint64_t reasons[] =
+    {
+        VM_EXIT_REASON_CPUID,
+        VM_EXIT_REASON_RDMSR,
+        VM_EXIT_REASON_WRMSR,
+        VM_EXIT_REASON_IO_INSTRUCTION,
+        VM_EXIT_REASON_CONTROL_REGISTER_ACCESSES,
+        VM_EXIT_REASON_VMCALL,
+        VM_EXIT_REASON_EPT_VIOLATION,
+        VM_EXIT_REASON_XSETBV
+    };
+
+    std::vector<uint64_t> exits;
+
+    for (auto i = 0ULL, n = 1ULL; i < num_reasons; i++)
+    {
+        n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+        exits.push_back(reasons[(n >> 33) % (sizeof(reasons) / sizeof(reasons[0]))]);
+    }
+
+    auto eh = std::make_unique<exit_handler_dispatch_benchmark>();
+
+    // Each variant is run a few times, and the fastest run is kept, so
+    // that the first run does not also pay for warming up the caches.
+
+    auto run = [&](auto dispatch)
+    {
+        auto best = ~0ULL;
+
+        for (auto round = 0; round < 3; round++)
+        {
+            auto start = __builtin_ia32_rdtsc();
+
+            for (auto i = 0; i < num_iterations; i++)
+            {
+                for (const auto &exit : exits)
+                    dispatch(exit);
+            }
+
+            best = std::min(best, (__builtin_ia32_rdtsc() - start) / (num_reasons * num_iterations));
+        }
+
+        return best;
+    };
+
+    auto switch_cycles = run([&](auto exit) { switch_dispatch(*eh, exit); });
+    auto table_cycles = run([&](auto exit) { eh->dispatch_handler(exit); });
+
+    EXPECT_TRUE(eh->num_exits == 6ULL * num_reasons * num_iterations);
+
+    std::cout << std::endl;
+    std::cout << "exit dispatch (cycles/exit):" << std::endl;
+    std::cout << "  switch: " << switch_cycles << ", table: " << table_cycles << std::endl;
+}
+
+void
+exit_handler_intel_x64_ut::test_exit_info_not_read_unless_needed()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(counted_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::cpuid);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    g_exit_reason = VM_EXIT_REASON_CPUID;
+    g_exit_instruction_length = 2;
+    g_exit_info_reads = 0;
+
+    mocks.NeverCall(intrinsics.get(), intrinsics_intel_x64::stop);
+    mocks.ExpectCall(vmcs.get(), vmcs_intel_x64::resume);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->dispatch();
+
+        // CPUID only needs the instruction length, to advance RIP
+
+        EXPECT_TRUE(g_exit_info_reads == 1);
+        EXPECT_TRUE(ss->rip == 2);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_exit_info_read_once_per_exit()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(counted_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    uint64_t qualification = 0;
+    uint64_t information = 0;
+
+    g_exit_reason = VM_EXIT_REASON_VMCALL;
+    g_exit_info_reads = 0;
+
+    mocks.ExpectCalls(vmcs.get(), vmcs_intel_x64::resume, 2);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->register_handler(VM_EXIT_REASON_VMCALL, [&](exit_handler_intel_x64 & eh)
+        {
+            qualification = eh.exit_qualification();
+            qualification = eh.exit_qualification();
+            information = eh.exit_instruction_information();
+            information = eh.exit_instruction_information();
+        });
+
+        g_exit_qualification = 1;
+        g_exit_instruction_information = 2;
+        eh->dispatch();
+
+        EXPECT_TRUE(g_exit_info_reads == 2);
+        EXPECT_TRUE(qualification == 1);
+        EXPECT_TRUE(information == 2);
+
+        // The cache is only valid for a single exit
+
+        g_exit_qualification = 3;
+        g_exit_instruction_information = 4;
+        eh->dispatch();
+
+        EXPECT_TRUE(g_exit_info_reads == 4);
+        EXPECT_TRUE(qualification == 3);
+        EXPECT_TRUE(information == 4);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_vmcs_field_cache_write_back()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(counted_rflags_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(counted_rflags_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    eh->enable_vmcs_field_cache();
+    EXPECT_TRUE(eh->is_enabled_vmcs_field_cache());
+
+    g_exit_reason = VM_EXIT_REASON_VMCALL;
+    g_rflags_reads = 0;
+    g_rflags_writes = 0;
+
+    mocks.ExpectCalls(vmcs.get(), vmcs_intel_x64::resume, 2);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->register_handler(VM_EXIT_REASON_VMCALL, [&](exit_handler_intel_x64 & eh)
+        {
+            eh.vmwrite(VMCS_GUEST_RFLAGS, eh.vmread(VMCS_GUEST_RFLAGS) | 0x100);
+            eh.vmwrite(VMCS_GUEST_RFLAGS, eh.vmread(VMCS_GUEST_RFLAGS) | 0x200);
+            eh.vmwrite(VMCS_GUEST_RFLAGS, 0x302);
+        });
+
+        eh->dispatch();
+
+        // RFLAGS is read once, and only its final value is written back
+
+        EXPECT_TRUE(g_rflags_reads == 1);
+        EXPECT_TRUE(g_rflags_writes == 1);
+        EXPECT_TRUE(g_field == VMCS_GUEST_RFLAGS);
+        EXPECT_TRUE(g_value == 0x302);
+
+        // The cache does not carry over from one exit to the next
+
+        eh->dispatch();
+
+        EXPECT_TRUE(g_rflags_reads == 2);
+        EXPECT_TRUE(g_rflags_writes == 2);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_vmcs_field_cache_disabled()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(counted_rflags_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(counted_rflags_vmwrite);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    EXPECT_FALSE(eh->is_enabled_vmcs_field_cache());
+
+    g_exit_reason = VM_EXIT_REASON_VMCALL;
+    g_rflags_reads = 0;
+    g_rflags_writes = 0;
+
+    mocks.ExpectCalls(vmcs.get(), vmcs_intel_x64::resume, 2);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->register_handler(VM_EXIT_REASON_VMCALL, [&](exit_handler_intel_x64 & eh)
+        {
+            eh.vmwrite(VMCS_GUEST_RFLAGS, eh.vmread(VMCS_GUEST_RFLAGS) | 0x100);
+            eh.vmwrite(VMCS_GUEST_RFLAGS, eh.vmread(VMCS_GUEST_RFLAGS) | 0x200);
+        });
+
+        eh->dispatch();
+
+        EXPECT_TRUE(g_rflags_reads == 2);
+        EXPECT_TRUE(g_rflags_writes == 2);
+
+        eh->dispatch();
+
+        EXPECT_TRUE(g_rflags_reads == 4);
+        EXPECT_TRUE(g_rflags_writes == 4);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_exit_stats_bucket()
+{
+    EXPECT_TRUE(exit_stats_intel_x64::bucket(0) == 0);
+    EXPECT_TRUE(exit_stats_intel_x64::bucket(1) == 0);
+    EXPECT_TRUE(exit_stats_intel_x64::bucket(2) == 1);
+    EXPECT_TRUE(exit_stats_intel_x64::bucket(3) == 1);
+    EXPECT_TRUE(exit_stats_intel_x64::bucket(1000) == 9);
+    EXPECT_TRUE(exit_stats_intel_x64::bucket(1024) == 10);
+    EXPECT_TRUE(exit_stats_intel_x64::bucket(0xFFFFFFFFFFFFFFFF) == EXIT_STATS_NUM_BUCKETS - 1);
+}
+
+void
+exit_handler_intel_x64_ut::test_exit_stats_record()
+{
+    auto stats = std::make_unique<exit_stats>();
+    exit_stats_intel_x64 es(0x1000);
+
+    es.record(VM_EXIT_REASON_CPUID, 100);
+    es.record(VM_EXIT_REASON_CPUID, 120);
+    es.record(VM_EXIT_REASON_RDMSR, 4000);
+    es.record(EXIT_STATS_NUM_REASONS, 4000);
+
+    es.read(stats.get());
+
+    EXPECT_TRUE(stats->vcpuid == 0x1000);
+    EXPECT_TRUE(stats->count[VM_EXIT_REASON_CPUID] == 2);
+    EXPECT_TRUE(stats->ticks[VM_EXIT_REASON_CPUID] == 220);
+    EXPECT_TRUE(stats->histogram[VM_EXIT_REASON_CPUID][6] == 2);
+    EXPECT_TRUE(stats->count[VM_EXIT_REASON_RDMSR] == 1);
+    EXPECT_TRUE(stats->ticks[VM_EXIT_REASON_RDMSR] == 4000);
+    EXPECT_TRUE(stats->histogram[VM_EXIT_REASON_RDMSR][11] == 1);
+    EXPECT_TRUE(stats->count[VM_EXIT_REASON_WRMSR] == 0);
+
+    EXPECT_NO_EXCEPTION(es.read(nullptr));
+}
+
+void
+exit_handler_intel_x64_ut::test_exit_stats_get_exit_stats()
+{
+    auto stats = std::make_unique<exit_stats>();
+
+    {
+        exit_stats_intel_x64 es(0x2000);
+        es.record(VM_EXIT_REASON_VMCALL, 10);
+    }
+
+    EXPECT_TRUE(get_exit_stats(0x2000, nullptr) == GET_EXIT_STATS_FAILURE);
+    EXPECT_TRUE(get_exit_stats(0x2001, stats.get()) == GET_EXIT_STATS_FAILURE);
+
+    // The statistics outlive the vCPU that owned them, so they can still
+    // be read once the vCPU has been deleted
+
+    EXPECT_TRUE(get_exit_stats(0x2000, stats.get()) == GET_EXIT_STATS_SUCCESS);
+    EXPECT_TRUE(stats->vcpuid == 0x2000);
+    EXPECT_TRUE(stats->count[VM_EXIT_REASON_VMCALL] == 1);
+
+    // A new vCPU with the same vcpuid starts over
+
+    exit_stats_intel_x64 es(0x2000);
+
+    EXPECT_TRUE(get_exit_stats(0x2000, stats.get()) == GET_EXIT_STATS_SUCCESS);
+    EXPECT_TRUE(stats->count[VM_EXIT_REASON_VMCALL] == 0);
+}
+
+void
+exit_handler_intel_x64_ut::test_exit_stats_dispatch()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::cpuid);
+
+    auto tsc = 100ULL;
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::read_tsc).Do([&]
+    {
+        tsc += 1000;
+        return tsc;
+    });
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto es = std::make_shared<exit_stats_intel_x64>(0x3000);
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+    eh->set_exit_stats(es);
+
+    auto stats = std::make_unique<exit_stats>();
+
+    g_exit_reason = VM_EXIT_REASON_CPUID;
+
+    mocks.NeverCall(intrinsics.get(), intrinsics_intel_x64::stop);
+    mocks.ExpectCalls(vmcs.get(), vmcs_intel_x64::resume, 2);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->dispatch();
+        eh->dispatch();
+
+        es->read(stats.get());
+
+        EXPECT_TRUE(stats->count[VM_EXIT_REASON_CPUID] == 2);
+        EXPECT_TRUE(stats->ticks[VM_EXIT_REASON_CPUID] == 2000);
+        EXPECT_TRUE(stats->histogram[VM_EXIT_REASON_CPUID][9] == 2);
+    });
+}
+
+void
+exit_handler_intel_x64_ut::test_dispatch_flushes_tlb_on_pt_generation()
+{
+    MockRepository mocks;
+    auto vmcs = bfn::mock_shared<vmcs_intel_x64>(mocks);
+    auto intrinsics = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+    auto pt = mocks.Mock<root_page_table_x64>();
+
+    auto generation = 10ULL;
+
+    mocks.OnCallFunc(root_page_table_x64::instance).Return(pt);
+    mocks.OnCall(pt, root_page_table_x64::generation).Do([&] { return generation; });
+
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmread).Do(stubbed_vmread);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::vmwrite).Do(stubbed_vmwrite);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::cpuid);
+    mocks.OnCall(intrinsics.get(), intrinsics_intel_x64::read_cr3).Return(0x1000);
+
+    auto ss = std::make_shared<state_save_intel_x64>();
+    auto eh = std::make_unique<exit_handler_intel_x64>(intrinsics);
+    eh->set_vmcs(vmcs);
+    eh->set_state_save(ss);
+
+    g_exit_reason = VM_EXIT_REASON_CPUID;
+
+    // The TLB is only flushed on the first exit after the generation has
+    // changed
+
+    mocks.OnCall(vmcs.get(), vmcs_intel_x64::resume);
+    mocks.ExpectCall(intrinsics.get(), intrinsics_intel_x64::write_cr3).With(0x1000);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        eh->dispatch();
+
+        generation++;
+
+        eh->dispatch();
+        eh->dispatch();
+    });
+}
@@ -28,6 +28,8 @@ global __vmptrst:function
 global __vmwrite:function
 global __vmread:function
 global __vmlaunch:function
+global __invvpid:function
+global __invept:function
 
 section .text
 
@@ -80,6 +82,18 @@ __vmread:
     jbe __vmx_failure
     jmp __vmx_success
 
+; bool __invvpid(uint64_t type, void *descriptor)
+__invvpid:
+    invvpid rdi, [rsi]
+    jbe __vmx_failure
+    jmp __vmx_success
+
+; bool __invept(uint64_t type, void *descriptor)
+__invept:
+    invept rdi, [rsi]
+    jbe __vmx_failure
+    jmp __vmx_success
+
 ; vmx instruction failed
 __vmx_failure:
     mov rax, 0x0
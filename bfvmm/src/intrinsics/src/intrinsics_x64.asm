@@ -35,6 +35,7 @@ global __read_rflags:function
 global __write_rflags:function
 global __read_msr:function
 global __write_msr:function
+global __read_tsc:function
 global __read_rip:function
 global __read_cr0:function
 global __write_cr0:function
@@ -69,6 +70,8 @@ global __outb:function
 global __inb:function
 global __outw:function
 global __inw:function
+global __outd:function
+global __ind:function
 
 section .text
 
@@ -214,6 +217,13 @@ __write_msr:
 
     ret
 
+; uint64_t __read_tsc(void)
+__read_tsc:
+    rdtsc
+    shl rdx, 32
+    or rax, rdx
+    ret
+
 ; uint64_t __read_rip(void)
 __read_rip:
     lea rax, [rel $]
@@ -409,3 +419,17 @@ __inw:
     mov dx, di
 	in ax, dx
 	ret
+
+; void __outd(uint16_t port, uint32_t val)
+__outd:
+    mov dx, di
+    mov eax, esi
+    out dx, eax
+    ret
+
+; uint32_t __ind(uint16_t port)
+__ind:
+    xor rax, rax
+    mov dx, di
+    in eax, dx
+    ret
@@ -67,6 +67,14 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 SOURCES+=memory_manager.cpp
 SOURCES+=page_table_x64.cpp
 SOURCES+=page_table_entry_x64.cpp
+SOURCES+=root_page_table_x64.cpp
+SOURCES+=page_walker_x64.cpp
+SOURCES+=translation_cache_x64.cpp
+SOURCES+=dirty_ring_x64.cpp
+SOURCES+=ept_intel_x64.cpp
+SOURCES+=ept_entry_intel_x64.cpp
+SOURCES+=root_ept_intel_x64.cpp
+SOURCES+=memory_range_index.cpp
 HEADERS=
 
 INCLUDE_PATHS+=./
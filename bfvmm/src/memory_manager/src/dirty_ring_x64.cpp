@@ -0,0 +1,81 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <stdexcept>
+#include <memory_manager/dirty_ring_x64.h>
+
+static_assert((DIRTY_RING_SIZE & (DIRTY_RING_SIZE - 1)) == 0,
+              "DIRTY_RING_SIZE must be a power of 2");
+
+dirty_ring_x64::dirty_ring_x64(uint64_t size) :
+    m_mask(size - 1),
+    m_head(0),
+    m_tail(0),
+    m_drops(0)
+{
+    if (size == 0 || (size & (size - 1)) != 0)
+        throw std::invalid_argument("size must be a power of 2");
+
+    m_entries = std::make_unique<uintptr_t[]>(size);
+}
+
+bool
+dirty_ring_x64::push(uintptr_t gpa) noexcept
+{
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    auto head = m_head.load(std::memory_order_acquire);
+
+    if (tail - head > m_mask)
+    {
+        m_drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    m_entries[tail & m_mask] = gpa;
+    m_tail.store(tail + 1, std::memory_order_release);
+
+    return true;
+}
+
+bool
+dirty_ring_x64::pop(uintptr_t &gpa) noexcept
+{
+    auto head = m_head.load(std::memory_order_relaxed);
+    auto tail = m_tail.load(std::memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    gpa = m_entries[head & m_mask];
+    m_head.store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
+uint64_t
+dirty_ring_x64::size() const noexcept
+{
+    auto head = m_head.load(std::memory_order_acquire);
+    auto tail = m_tail.load(std::memory_order_acquire);
+
+    return tail - head;
+}
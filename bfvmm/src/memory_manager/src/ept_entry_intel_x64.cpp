@@ -0,0 +1,148 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <stdexcept>
+#include <memory_manager/ept_entry_intel_x64.h>
+
+ept_entry_intel_x64::ept_entry_intel_x64(gsl::not_null<uintptr_t *> epte) noexcept :
+    m_epte(epte)
+{
+}
+
+bool
+ept_entry_intel_x64::read_access() const noexcept
+{
+    return (*m_epte & EPTE_FLAGS_R) != 0;
+}
+
+void
+ept_entry_intel_x64::set_read_access(bool enabled) noexcept
+{
+    enabled ? *m_epte |= EPTE_FLAGS_R : *m_epte &= ~EPTE_FLAGS_R;
+}
+
+bool
+ept_entry_intel_x64::write_access() const noexcept
+{
+    return (*m_epte & EPTE_FLAGS_W) != 0;
+}
+
+void
+ept_entry_intel_x64::set_write_access(bool enabled) noexcept
+{
+    enabled ? *m_epte |= EPTE_FLAGS_W : *m_epte &= ~EPTE_FLAGS_W;
+}
+
+bool
+ept_entry_intel_x64::execute_access() const noexcept
+{
+    return (*m_epte & EPTE_FLAGS_X) != 0;
+}
+
+void
+ept_entry_intel_x64::set_execute_access(bool enabled) noexcept
+{
+    enabled ? *m_epte |= EPTE_FLAGS_X : *m_epte &= ~EPTE_FLAGS_X;
+}
+
+uint64_t
+ept_entry_intel_x64::memory_type() const noexcept
+{
+    return (*m_epte & EPTE_MEMORY_TYPE_MASK) >> EPTE_MEMORY_TYPE_SHIFT;
+}
+
+void
+ept_entry_intel_x64::set_memory_type(uint64_t type)
+{
+    switch (type)
+    {
+        case EPT_MEMORY_TYPE_UC:
+        case EPT_MEMORY_TYPE_WC:
+        case EPT_MEMORY_TYPE_WT:
+        case EPT_MEMORY_TYPE_WP:
+        case EPT_MEMORY_TYPE_WB:
+            *m_epte = (*m_epte & ~EPTE_MEMORY_TYPE_MASK) | EPTE_MEMORY_TYPE(type);
+            break;
+
+        default:
+            throw std::invalid_argument("set_memory_type: invalid memory type");
+    }
+}
+
+bool
+ept_entry_intel_x64::ignore_pat() const noexcept
+{
+    return (*m_epte & EPTE_FLAGS_IPAT) != 0;
+}
+
+void
+ept_entry_intel_x64::set_ignore_pat(bool enabled) noexcept
+{
+    enabled ? *m_epte |= EPTE_FLAGS_IPAT : *m_epte &= ~EPTE_FLAGS_IPAT;
+}
+
+bool
+ept_entry_intel_x64::ps() const noexcept
+{
+    return (*m_epte & EPTE_FLAGS_PS) != 0;
+}
+
+void
+ept_entry_intel_x64::set_ps(bool enabled) noexcept
+{
+    enabled ? *m_epte |= EPTE_FLAGS_PS : *m_epte &= ~EPTE_FLAGS_PS;
+}
+
+bool
+ept_entry_intel_x64::accessed() const noexcept
+{
+    return (*m_epte & EPTE_FLAGS_A) != 0;
+}
+
+void
+ept_entry_intel_x64::set_accessed(bool enabled) noexcept
+{
+    enabled ? *m_epte |= EPTE_FLAGS_A : *m_epte &= ~EPTE_FLAGS_A;
+}
+
+bool
+ept_entry_intel_x64::dirty() const noexcept
+{
+    return (*m_epte & EPTE_FLAGS_D) != 0;
+}
+
+void
+ept_entry_intel_x64::set_dirty(bool enabled) noexcept
+{
+    enabled ? *m_epte |= EPTE_FLAGS_D : *m_epte &= ~EPTE_FLAGS_D;
+}
+
+uintptr_t
+ept_entry_intel_x64::phys_addr() const noexcept
+{
+    return *m_epte & EPTE_PHYS_ADDR_MASK;
+}
+
+void
+ept_entry_intel_x64::set_phys_addr(uintptr_t addr) noexcept
+{
+    *m_epte = (*m_epte & ~EPTE_PHYS_ADDR_MASK) | (addr & EPTE_PHYS_ADDR_MASK);
+}
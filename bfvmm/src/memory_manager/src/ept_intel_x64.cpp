@@ -0,0 +1,495 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <gsl/gsl>
+
+#include <memory_manager/object_pool.h>
+#include <memory_manager/memory_manager.h>
+#include <memory_manager/ept_intel_x64.h>
+
+static uint64_t
+max_page_size_to_bits(uint64_t max_page_size)
+{
+    switch (max_page_size)
+    {
+        case PAGE_SIZE_4K:
+            return PT_INDEX;
+
+        case PAGE_SIZE_2M:
+            return PD_INDEX;
+
+        case PAGE_SIZE_1G:
+            return PDPT_INDEX;
+
+        default:
+            throw std::invalid_argument("invalid max_page_size");
+    }
+}
+
+ept_intel_x64::ept_intel_x64(uintptr_t *epte, uint64_t bits) :
+    ept_entry_intel_x64(epte != nullptr ? epte : & m_eptp_shadow),
+    m_bits(bits),
+    m_eptp_shadow(0)
+{
+    m_pt_owner = std::make_unique<uintptr_t[]>(4096 / sizeof(uintptr_t));
+    m_pt = gsl::span<uintptr_t>(m_pt_owner.get(), PT_SIZE);
+
+    if (m_bits > PT_INDEX)
+        m_tables = std::make_unique<std::shared_ptr<ept_intel_x64>[]>(PT_SIZE);
+
+    this->set_phys_addr(g_mm->virt_to_phys(m_pt_owner.get()));
+    this->set_read_access(true);
+    this->set_write_access(true);
+    this->set_execute_access(true);
+}
+
+void
+ept_intel_x64::map_range(uintptr_t gpa, uintptr_t phys_addr, uint64_t size,
+                         uint64_t attrs, uint64_t max_page_size)
+{
+    if (((gpa | phys_addr | size) & (PAGE_SIZE_4K - 1)) != 0)
+        throw std::invalid_argument("map_range: gpa, phys_addr and size must be 4k aligned");
+
+    if ((attrs & ~EPTE_FLAGS_ATTRS) != 0)
+        throw std::invalid_argument("map_range: invalid attrs");
+
+    map_entries(gpa, phys_addr, size, attrs, max_page_size_to_bits(max_page_size));
+}
+
+void
+ept_intel_x64::unmap_range(uintptr_t gpa, uint64_t size)
+{
+    if (((gpa | size) & (PAGE_SIZE_4K - 1)) != 0)
+        throw std::invalid_argument("unmap_range: gpa and size must be 4k aligned");
+
+    if (unmap_entries(gpa, size, m_retired) != 0)
+        throw std::invalid_argument("unmap_range: range is out of bounds");
+}
+
+void
+ept_intel_x64::protect_range(uintptr_t gpa, uint64_t size, uint64_t attrs,
+                             uint64_t max_page_size)
+{
+    if (((gpa | size) & (PAGE_SIZE_4K - 1)) != 0)
+        throw std::invalid_argument("protect_range: gpa and size must be 4k aligned");
+
+    if ((attrs & ~EPTE_FLAGS_ATTRS) != 0)
+        throw std::invalid_argument("protect_range: invalid attrs");
+
+    auto leaf_bits = max_page_size_to_bits(max_page_size);
+
+    if (protect_entries(gpa, size, attrs, leaf_bits, m_retired) != 0)
+        throw std::invalid_argument("protect_range: range is out of bounds");
+}
+
+ept_entry_intel_x64
+ept_intel_x64::entry(uintptr_t gpa)
+{
+    if ((gpa >> (m_bits + BITS_PER_INDEX)) != 0)
+        throw std::invalid_argument("entry: gpa is out of bounds");
+
+    auto pt = this;
+
+    while (true)
+    {
+        auto index = (gpa >> pt->m_bits) & INDEX_MASK;
+
+        if (pt->m_tables && pt->m_tables[index])
+        {
+            pt = pt->m_tables[index].get();
+            continue;
+        }
+
+        if ((pt->m_pt[index] & EPTE_FLAGS_MAPPED) == 0)
+            throw std::invalid_argument("entry: gpa is not mapped");
+
+        return ept_entry_intel_x64(&pt->m_pt[index]);
+    }
+}
+
+uint64_t
+ept_intel_x64::harvest_dirty(uintptr_t gpa, uint64_t size,
+                             gsl::span<uint64_t> bitmap, uint64_t granularity)
+{
+    if (granularity < PAGE_SIZE_4K || (granularity & (granularity - 1)) != 0)
+        throw std::invalid_argument("harvest_dirty: invalid granularity");
+
+    if (((gpa | size) & (granularity - 1)) != 0)
+        throw std::invalid_argument("harvest_dirty: gpa and size must be granularity aligned");
+
+    if (size / granularity > static_cast<uint64_t>(bitmap.size()) * 64)
+        throw std::invalid_argument("harvest_dirty: bitmap is too small");
+
+    if (size == 0)
+        return 0;
+
+    if (((gpa + size - 1) >> (m_bits + BITS_PER_INDEX)) != 0)
+        throw std::invalid_argument("harvest_dirty: range is out of bounds");
+
+    return harvest_entries(gpa, size, gpa, bitmap, granularity);
+}
+
+uint64_t
+ept_intel_x64::num_tables() const noexcept
+{
+    auto num = 1ULL;
+
+    if (!m_tables)
+        return num;
+
+    for (auto i = 0; i < PT_SIZE; i++)
+    {
+        if (m_tables[i])
+            num += m_tables[i]->num_tables();
+    }
+
+    return num;
+}
+
+void
+ept_intel_x64::free_retired() noexcept
+{
+    m_retired.clear();
+}
+
+uint64_t
+ept_intel_x64::num_retired() const noexcept
+{
+    return m_retired.size();
+}
+
+void
+ept_intel_x64::map_entries(uintptr_t gpa, uintptr_t phys_addr, uint64_t size,
+                           uint64_t attrs, uint64_t leaf_bits)
+{
+    auto entry_size = 1ULL << m_bits;
+    auto index = (gpa >> m_bits) & INDEX_MASK;
+
+    auto leaf = attrs | EPTE_FLAGS_MAPPED;
+
+    if (m_bits != PT_INDEX)
+        leaf |= EPTE_FLAGS_PS;
+
+    while (size != 0)
+    {
+        if (index >= PT_SIZE)
+            throw std::invalid_argument("map_range: range is out of bounds");
+
+        auto offset = gpa & (entry_size - 1);
+        auto chunk = entry_size - offset < size ? entry_size - offset : size;
+
+        if (m_bits <= leaf_bits && chunk == entry_size && (phys_addr & (entry_size - 1)) == 0)
+        {
+            if (m_pt[index] != 0)
+                throw std::logic_error("map_range: page mapping already exists");
+
+            m_pt[index] = (phys_addr & EPTE_PHYS_ADDR_MASK) | leaf;
+        }
+        else
+        {
+            auto pt = m_tables[index];
+
+            if (!pt)
+                pt = add_table(index);
+
+            pt->map_entries(gpa, phys_addr, chunk, attrs, leaf_bits);
+        }
+
+        gpa += chunk;
+        phys_addr += chunk;
+        size -= chunk;
+        index++;
+    }
+}
+
+uint64_t
+ept_intel_x64::unmap_entries(uintptr_t gpa, uint64_t size, retired_tables &retired)
+{
+    auto entry_size = 1ULL << m_bits;
+    auto index = (gpa >> m_bits) & INDEX_MASK;
+
+    while (size != 0 && index < PT_SIZE)
+    {
+        auto offset = gpa & (entry_size - 1);
+        auto chunk = entry_size - offset < size ? entry_size - offset : size;
+
+        if (m_tables && m_tables[index])
+        {
+            m_tables[index]->unmap_entries(gpa, chunk, retired);
+
+            if (m_tables[index]->empty())
+            {
+                retired.push_back(m_tables[index]);
+
+                m_pt[index] = 0;
+                m_tables[index].reset();
+            }
+        }
+        else if (m_pt[index] != 0)
+        {
+            if (chunk == entry_size)
+            {
+                m_pt[index] = 0;
+            }
+            else
+            {
+                split(index);
+                m_tables[index]->unmap_entries(gpa, chunk, retired);
+            }
+        }
+
+        gpa += chunk;
+        size -= chunk;
+        index++;
+    }
+
+    return size;
+}
+
+uint64_t
+ept_intel_x64::protect_entries(uintptr_t gpa, uint64_t size, uint64_t attrs,
+                               uint64_t leaf_bits, retired_tables &retired)
+{
+    // The CPU might set the accessed and dirty flags of an entry on another
+    // core while its attributes are being changed, so a leaf entry is only
+    // ever replaced with a compare and exchange, which keeps those flags.
+
+    auto entry_size = 1ULL << m_bits;
+    auto index = (gpa >> m_bits) & INDEX_MASK;
+
+    while (size != 0 && index < PT_SIZE)
+    {
+        auto offset = gpa & (entry_size - 1);
+        auto chunk = entry_size - offset < size ? entry_size - offset : size;
+
+        if (m_tables && m_tables[index])
+        {
+            m_tables[index]->protect_entries(gpa, chunk, attrs, leaf_bits, retired);
+            merge(index, leaf_bits, retired);
+        }
+        else if (m_pt[index] != 0 && (m_pt[index] & EPTE_FLAGS_ATTRS) != attrs)
+        {
+            if (chunk == entry_size)
+            {
+                auto entry = __atomic_load_n(&m_pt[index], __ATOMIC_RELAXED);
+
+                while (!__atomic_compare_exchange_n(&m_pt[index], &entry, (entry & ~EPTE_FLAGS_ATTRS) | attrs,
+                                                    false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+            }
+            else
+            {
+                split(index);
+                m_tables[index]->protect_entries(gpa, chunk, attrs, leaf_bits, retired);
+            }
+        }
+
+        gpa += chunk;
+        size -= chunk;
+        index++;
+    }
+
+    return size;
+}
+
+uint64_t
+ept_intel_x64::harvest_entries(uintptr_t gpa, uint64_t size, uintptr_t base,
+                               gsl::span<uint64_t> bitmap, uint64_t granularity)
+{
+    // The CPU sets the accessed and dirty flags with a locked operation,
+    // and might do so on another core while the flags are being harvested,
+    // so flags are only ever cleared with an atomic AND (which also tells
+    // us whether the flag was still set). The entries are read without a
+    // lock first, so that clean entries do not cost a locked operation.
+
+    auto cleared = 0ULL;
+    auto entry_size = 1ULL << m_bits;
+    auto index = (gpa >> m_bits) & INDEX_MASK;
+
+    while (size != 0 && index < PT_SIZE)
+    {
+        auto offset = gpa & (entry_size - 1);
+        auto chunk = entry_size - offset < size ? entry_size - offset : size;
+
+        auto epte = &m_pt[index];
+
+        if (m_tables && m_tables[index])
+        {
+            if ((*epte & EPTE_FLAGS_A) != 0)
+            {
+                if (chunk == entry_size)
+                {
+                    __atomic_fetch_and(epte, ~EPTE_FLAGS_A, __ATOMIC_SEQ_CST);
+                    cleared++;
+                }
+
+                cleared += m_tables[index]->harvest_entries(gpa, chunk, base, bitmap, granularity);
+            }
+        }
+        else if ((*epte & EPTE_FLAGS_D) != 0)
+        {
+            if (chunk == entry_size)
+            {
+                __atomic_fetch_and(epte, ~(EPTE_FLAGS_A | EPTE_FLAGS_D), __ATOMIC_SEQ_CST);
+                cleared++;
+            }
+
+            auto first = (gpa - base) / granularity;
+            auto last = (gpa + chunk - 1 - base) / granularity;
+
+            for (auto i = first; i <= last; i++)
+                bitmap[static_cast<std::ptrdiff_t>(i / 64)] |= 1ULL << (i % 64);
+        }
+
+        gpa += chunk;
+        size -= chunk;
+        index++;
+    }
+
+    return cleared;
+}
+
+std::shared_ptr<ept_intel_x64>
+ept_intel_x64::add_table(uint64_t index)
+{
+    if (m_pt[index] != 0)
+        throw std::logic_error("add_table: large page mapping already exists");
+
+    auto pt = make_pooled<ept_intel_x64>(&m_pt[index], m_bits - BITS_PER_INDEX);
+    m_tables[index] = pt;
+
+    return pt;
+}
+
+void
+ept_intel_x64::split(uint64_t index)
+{
+    // Replaces a large page with a table of smaller pages that map the
+    // same physical memory with the same attributes. Unlike the host's
+    // page tables, the EPT might be in use by another core while it is
+    // being split, so the new table is filled in before the large page is
+    // swapped out for it, which is a single atomic exchange. A PDPT entry is
+    // split into 2MB pages, which can be split again if needed. The accessed
+    // and dirty flags are copied to each of the smaller pages, so that a
+    // large page that was written to is still reported as dirty, and flags
+    // that the CPU set between the copy and the exchange are added after.
+
+    auto entry = __atomic_load_n(&m_pt[index], __ATOMIC_RELAXED);
+    auto attrs = entry & (EPTE_FLAGS_ATTRS | EPTE_FLAGS_MAPPED | EPTE_FLAGS_A | EPTE_FLAGS_D);
+    auto phys_addr = entry & EPTE_PHYS_ADDR_MASK;
+
+    auto pt = make_pooled<ept_intel_x64>(nullptr, m_bits - BITS_PER_INDEX);
+
+    auto leaf = attrs;
+    auto entry_size = 1ULL << pt->m_bits;
+
+    if (pt->m_bits != PT_INDEX)
+        leaf |= EPTE_FLAGS_PS;
+
+    for (auto i = 0; i < PT_SIZE; i++)
+        pt->m_pt[i] = ((phys_addr + (i * entry_size)) & EPTE_PHYS_ADDR_MASK) | leaf;
+
+    auto accessed = (entry & (EPTE_FLAGS_A | EPTE_FLAGS_D)) != 0 ? EPTE_FLAGS_A : 0;
+
+    m_tables[index] = pt;
+
+    auto old = __atomic_exchange_n(&m_pt[index], pt->phys_addr() | EPTE_FLAGS_RWX | accessed, __ATOMIC_SEQ_CST);
+    auto flags = (old & ~entry) & (EPTE_FLAGS_A | EPTE_FLAGS_D);
+
+    if (flags == 0)
+        return;
+
+    __atomic_fetch_or(&m_pt[index], EPTE_FLAGS_A, __ATOMIC_SEQ_CST);
+
+    for (auto i = 0; i < PT_SIZE; i++)
+        __atomic_fetch_or(&pt->m_pt[i], flags, __ATOMIC_SEQ_CST);
+}
+
+void
+ept_intel_x64::merge(uint64_t index, uint64_t leaf_bits, retired_tables &retired)
+{
+    // Replaces a table with a single large page, if every entry in the
+    // table is a page (and not a table), with the same attributes, and
+    // together the pages map contiguous, aligned physical memory. If any
+    // of the pages are accessed or dirty, so is the large page, so that
+    // merging does not lose writes that have not been harvested yet. The
+    // large page is swapped in with an atomic exchange, after which the
+    // table's flags are collected once more, as the CPU might have set them
+    // after they were first read. The table is retired rather than freed,
+    // as another core might still be walking it.
+
+    if (m_bits > leaf_bits)
+        return;
+
+    const auto &pt = m_tables[index];
+
+    auto entry_size = 1ULL << pt->m_bits;
+    auto first = pt->m_pt[0];
+
+    auto flags = 0ULL;
+    auto attrs = first & EPTE_FLAGS_ATTRS;
+    auto phys_addr = first & EPTE_PHYS_ADDR_MASK;
+
+    if ((phys_addr & ((1ULL << m_bits) - 1)) != 0)
+        return;
+
+    for (auto i = 0; i < PT_SIZE; i++)
+    {
+        auto entry = __atomic_load_n(&pt->m_pt[i], __ATOMIC_RELAXED);
+
+        if ((entry & EPTE_FLAGS_MAPPED) == 0)
+            return;
+
+        if ((entry & EPTE_FLAGS_ATTRS) != attrs)
+            return;
+
+        if ((entry & EPTE_PHYS_ADDR_MASK) != phys_addr + (i * entry_size))
+            return;
+
+        flags |= entry & (EPTE_FLAGS_A | EPTE_FLAGS_D);
+    }
+
+    retired.push_back(pt);
+
+    __atomic_exchange_n(&m_pt[index], phys_addr | attrs | flags | EPTE_FLAGS_MAPPED | EPTE_FLAGS_PS, __ATOMIC_SEQ_CST);
+
+    auto missed = 0ULL;
+
+    for (auto i = 0; i < PT_SIZE; i++)
+        missed |= __atomic_load_n(&pt->m_pt[i], __ATOMIC_SEQ_CST) & (EPTE_FLAGS_A | EPTE_FLAGS_D);
+
+    if ((missed & ~flags) != 0)
+        __atomic_fetch_or(&m_pt[index], missed, __ATOMIC_SEQ_CST);
+
+    m_tables[index].reset();
+}
+
+bool
+ept_intel_x64::empty() const noexcept
+{
+    for (auto i = 0; i < PT_SIZE; i++)
+    {
+        if (m_pt[i] != 0)
+            return false;
+    }
+
+    return true;
+}
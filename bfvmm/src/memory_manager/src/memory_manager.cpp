@@ -24,6 +24,8 @@
 #include <string.h>
 
 #include <array>
+#include <atomic>
+#include <algorithm>
 #include <gsl/gsl>
 
 #include <debug.h>
@@ -36,6 +38,21 @@
 // -----------------------------------------------------------------------------
 
 #define ALLOCATED 0x8000000000000000
+#define CACHED 0x4000000000000000
+
+#define BLOCK_SIZE_MASK 0x000000003FFFFFFF
+#define BLOCK_PREV_SHIFT 32
+
+#define HEAP_CHUNK_SHIFT 6
+#define HEAP_CHUNK_SIZE (1 << HEAP_CHUNK_SHIFT)
+#define HEAP_NUM_CHUNKS ((MAX_HEAP_POOL + HEAP_CHUNK_SIZE - 1) >> HEAP_CHUNK_SHIFT)
+#define HEAP_NONE 0xFFFFFFFF
+
+#define PAGE_FREE 0x4000000000000000
+#define PAGE_NONE -1
+#define PAGE_MAX_ORDERS 64
+
+#define MAGAZINE_NUM_CLASSES (MAGAZINE_MAX_BLOCKS - 1)
 
 // -----------------------------------------------------------------------------
 // Global Memory
@@ -44,343 +61,1422 @@
 struct mmpage_t
 { uint8_t mem[MAX_PAGE_SIZE]; };
 
-uint64_t g_heap_pool_owner[MAX_HEAP_POOL] __attribute__((aligned(MAX_PAGE_SIZE))) = {};
-gsl::span<uint64_t> g_heap_pool{g_heap_pool_owner};
+uint64_t g_heap_pool_owner[MAX_HEAP_POOL] __attribute__((aligned(MAX_PAGE_SIZE))) = {};
+gsl::span<uint64_t> g_heap_pool{g_heap_pool_owner};
+
+// The heap is divided into fragments, each starting with a header that
+// stores the size of the fragment in blocks, the size of the fragment
+// before it (so that freed fragments can be coalesced with both of their
+// neighbours in constant time) and whether or not it is allocated.
+//
+// To find the first fragment that is large enough for an allocation without
+// walking the heap, the heap is split into chunks of HEAP_CHUNK_SIZE blocks.
+// For each chunk, the index of the first header in the chunk is stored, and
+// a max tree (stored as an implicit binary tree with the leaves at the end)
+// stores the size of the largest free fragment that starts in each chunk.
+// An allocation walks down the tree to the first chunk that has a large
+// enough fragment, and then walks at most HEAP_CHUNK_SIZE headers in that
+// chunk, which bounds the cost of malloc / free regardless of how fragmented
+// the heap is.
+
+constexpr uint64_t
+heap_tree_leaves(uint64_t leaves = 1) noexcept
+{ return leaves >= HEAP_NUM_CHUNKS ? leaves : heap_tree_leaves(leaves << 1); }
+
+uint32_t g_heap_first_owner[HEAP_NUM_CHUNKS] = {};
+gsl::span<uint32_t> g_heap_first{g_heap_first_owner};
+
+uint32_t g_heap_tree_owner[heap_tree_leaves() << 1] = {};
+gsl::span<uint32_t> g_heap_tree{g_heap_tree_owner};
+
+mmpage_t g_page_pool_owner[MAX_PAGE_POOL] __attribute__((aligned(MAX_PAGE_SIZE))) = {};
+uint64_t g_page_allocated_owner[MAX_PAGE_POOL] __attribute__((aligned(MAX_PAGE_SIZE))) = {};
+int64_t g_page_next_owner[MAX_PAGE_POOL] = {};
+int64_t g_page_prev_owner[MAX_PAGE_POOL] = {};
+
+// Each page pool is managed by a buddy allocator. Free blocks are always
+// 2^order pages, naturally aligned relative to the start of the page pool,
+// and are stored on a doubly linked free list per order. The first page of
+// each block is marked in "allocated", either with the block's order and
+// PAGE_FREE, or with the number of pages that were allocated and ALLOCATED.
+// Allocations that are not a power of two are carved from the next largest
+// order, and the unused pages at the end are returned to the free lists, so
+// they are still aligned to that order without wasting pages.
+//
+// Blocks are only aligned relative to their page pool. The built in page
+// pool is page aligned (the VMM is only loaded at a page aligned address),
+// and so are the pools added with add_pool, so a 2MB block is 2MB aligned
+// in memory only if its page pool happens to be. Padding the built in page
+// pool to a 2MB boundary would cost up to another 2MB of VMM image for
+// virtual alignment alone, as the driver entry does not back the VMM with
+// 2MB aligned physical memory anyway.
+//
+// The first page pool is built into the VMM. The rest are chunks of memory
+// that are given to the VMM by the driver entry using add_pool, and store
+// their bookkeeping in the first few pages of the chunk. Page pools are
+// only ever added, so once a page pool is published (by incrementing
+// g_num_page_pools) free can look up which page pool a pointer belongs to
+// without taking a lock.
+//
+// add_pool reserves its slot (g_num_reserved_page_pools, under
+// g_malloc_mutex) before it registers the pool's memory, so two calls can
+// never be given the same slot, or a slot past the end of g_page_pools.
+// Slots are filled in out of order, and are only published once every slot
+// before them is ready.
+
+struct page_pool_t
+{
+    gsl::span<mmpage_t> pages;
+    gsl::span<uint64_t> allocated;
+    gsl::span<int64_t> next;
+    gsl::span<int64_t> prev;
+
+    int64_t max_order;
+    int64_t free[PAGE_MAX_ORDERS];
+
+    std::atomic<int64_t> largest;
+
+    bool ready;
+};
+
+constexpr int64_t
+page_pool_order(uint64_t pages, int64_t order = 0) noexcept
+{ return (2ULL << order) > pages ? order : page_pool_order(pages, order + 1); }
+
+page_pool_t g_page_pools_owner[MAX_NUM_POOLS + 1] = {};
+gsl::span<page_pool_t> g_page_pools{g_page_pools_owner};
+
+std::atomic<int64_t> g_num_page_pools(0);
+int64_t g_num_reserved_page_pools = 0;
+
+// calloc is the only allocation that has to return zeroed memory, so
+// malloc does not zero anything. To keep the cost of zeroing off of the
+// exit path for page sized callocs, a list of pages that are already
+// zeroed is kept, which is topped up using refill_zeroed_pages. Pages on
+// this list are allocated from the point of view of the page pools.
+
+void *g_zeroed_pages_owner[ZEROED_PAGES] = {};
+gsl::span<void *> g_zeroed_pages{g_zeroed_pages_owner};
+
+int64_t g_num_zeroed_pages = 0;
+
+// -----------------------------------------------------------------------------
+// Statistics
+// -----------------------------------------------------------------------------
+
+// The statistics are kept next to the state they describe, and are only
+// ever updated by a core that holds the lock protecting that state (the
+// heap / page pool counters under g_malloc_mutex, and the magazine counters
+// under the magazine's mutex). Since there is only ever one writer, the
+// counters are updated with a relaxed load and store instead of a locked
+// read-modify-write, and the only cost on the allocation path is a couple
+// of plain adds. The counters are atomics so that they can be read without
+// taking any of the locks, which allows the driver entry to read them while
+// the VMM is running.
+
+struct alloc_stats_t
+{
+    std::atomic<uint64_t> heap_in_use;
+    std::atomic<uint64_t> heap_peak;
+    std::atomic<uint64_t> heap_largest_free;
+    std::atomic<uint64_t> page_in_use;
+    std::atomic<uint64_t> page_peak;
+    std::atomic<uint64_t> failed_allocs;
+    std::atomic<uint64_t> allocs[MEMORY_STATS_NUM_CLASSES];
+    std::atomic<uint64_t> frees[MEMORY_STATS_NUM_CLASSES];
+};
+
+alloc_stats_t g_stats = {};
+
+static void
+stat_add(std::atomic<uint64_t> &stat, uint64_t val) noexcept
+{ stat.store(stat.load(std::memory_order_relaxed) + val, std::memory_order_relaxed); }
+
+static void
+stat_sub(std::atomic<uint64_t> &stat, uint64_t val) noexcept
+{ stat.store(stat.load(std::memory_order_relaxed) - val, std::memory_order_relaxed); }
+
+static void
+stat_use(std::atomic<uint64_t> &in_use, std::atomic<uint64_t> &peak, uint64_t val) noexcept
+{
+    stat_add(in_use, val);
+
+    if (in_use.load(std::memory_order_relaxed) > peak.load(std::memory_order_relaxed))
+        peak.store(in_use.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+static uint64_t
+size_class(uint64_t bytes) noexcept
+{
+    if (bytes <= 16)
+        return 0;
+
+    auto cls = static_cast<uint64_t>(64 - __builtin_clzll(bytes - 1) - 4);
+    return std::min(cls, static_cast<uint64_t>(MEMORY_STATS_NUM_CLASSES - 1));
+}
+
+// -----------------------------------------------------------------------------
+// Mutexes
+// -----------------------------------------------------------------------------
+
+#include <mutex>
+
+std::mutex g_malloc_mutex;
+std::mutex g_add_md_mutex;
+
+// -----------------------------------------------------------------------------
+// Magazines
+// -----------------------------------------------------------------------------
+
+// Each core owns a magazine which caches small heap allocations, one stack
+// of cached blocks per size class (indexed by the number of blocks - 2, as
+// the smallest allocation is a header + one block). Cached blocks remain
+// allocated from the point of view of the heap, and are marked CACHED so
+// that a double free cannot place the same block in a magazine twice. The
+// magazine's mutex is only ever contended if two cores share a magazine, or
+// a flush of all of the magazines is in progress.
+//
+struct magazine_t
+{
+    std::mutex mutex;
+    uint64_t count[MAGAZINE_NUM_CLASSES];
+    uint64_t *slots[MAGAZINE_NUM_CLASSES][MAGAZINE_SIZE];
+
+    std::atomic<uint64_t> allocs[MEMORY_STATS_NUM_CLASSES];
+    std::atomic<uint64_t> frees[MEMORY_STATS_NUM_CLASSES];
+} __attribute__((aligned(MAX_CACHE_LINE_SIZE)));
+
+magazine_t g_magazines_owner[MAX_MAGAZINES] = {};
+gsl::span<magazine_t> g_magazines{g_magazines_owner};
+
+static void
+reset_stats() noexcept
+{
+    for (auto &&magazine : g_magazines)
+    {
+        for (auto &&stat : magazine.allocs)
+            stat.store(0, std::memory_order_relaxed);
+
+        for (auto &&stat : magazine.frees)
+            stat.store(0, std::memory_order_relaxed);
+    }
+
+    for (auto &&stat : g_stats.allocs)
+        stat.store(0, std::memory_order_relaxed);
+
+    for (auto &&stat : g_stats.frees)
+        stat.store(0, std::memory_order_relaxed);
+
+    g_stats.heap_in_use.store(0, std::memory_order_relaxed);
+    g_stats.heap_peak.store(0, std::memory_order_relaxed);
+    g_stats.page_in_use.store(0, std::memory_order_relaxed);
+    g_stats.page_peak.store(0, std::memory_order_relaxed);
+    g_stats.failed_allocs.store(0, std::memory_order_relaxed);
+}
+
+static int64_t
+heap_blocks(size_t size) noexcept
+{ return (size & (0x7)) != 0 ? (size >> 3) + 2 : (size >> 3) + 1; }
+
+static uint64_t
+heap_bytes(int64_t blocks) noexcept
+{ return static_cast<uint64_t>(blocks - 1) * sizeof(uint64_t); }
+
+static int64_t
+block_size(int64_t idx) noexcept
+{ return static_cast<int64_t>(g_heap_pool[idx] & BLOCK_SIZE_MASK); }
+
+static int64_t
+block_prev(int64_t idx) noexcept
+{ return static_cast<int64_t>((g_heap_pool[idx] >> BLOCK_PREV_SHIFT) & BLOCK_SIZE_MASK); }
+
+static bool
+block_free(int64_t idx) noexcept
+{ return (g_heap_pool[idx] & ALLOCATED) == 0; }
+
+static void
+set_block(int64_t idx, int64_t size, int64_t prev, uint64_t flags = 0) noexcept
+{ g_heap_pool[idx] = flags | (static_cast<uint64_t>(prev) << BLOCK_PREV_SHIFT) | static_cast<uint64_t>(size); }
+
+// The header of an allocated fragment is shared by two owners. The prev
+// field is written by whoever holds g_malloc_mutex (when the fragment before
+// it is split or merged), while the CACHED flag is written by whichever
+// magazine holds the fragment, which only holds that magazine's mutex. Both
+// are therefore updated with atomic operations so that neither write can
+// undo the other. The rest of the header is only ever written while the
+// fragment is free, or by the owner of the fragment.
+
+static void
+set_block_prev(int64_t idx, int64_t prev) noexcept
+{
+    if (idx >= g_heap_pool.size())
+        return;
+
+    auto header = &g_heap_pool[idx];
+    auto old_header = __atomic_load_n(header, __ATOMIC_RELAXED);
+    auto new_header = 0ULL;
+
+    do
+    {
+        new_header = (old_header & ~(static_cast<uint64_t>(BLOCK_SIZE_MASK) << BLOCK_PREV_SHIFT)) |
+                     (static_cast<uint64_t>(prev) << BLOCK_PREV_SHIFT);
+    }
+    while (!__atomic_compare_exchange_n(header, &old_header, new_header, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+static uint64_t
+load_block(int64_t idx) noexcept
+{ return __atomic_load_n(&g_heap_pool[idx], __ATOMIC_RELAXED); }
+
+static void
+set_block_cached(int64_t idx) noexcept
+{ __atomic_fetch_or(&g_heap_pool[idx], CACHED, __ATOMIC_RELAXED); }
+
+static void
+clear_block_cached(int64_t idx) noexcept
+{ __atomic_fetch_and(&g_heap_pool[idx], ~CACHED, __ATOMIC_RELAXED); }
+
+static void
+update_heap_chunk(int64_t chunk) noexcept
+{
+    uint32_t largest = 0;
+    int64_t end = (chunk + 1) << HEAP_CHUNK_SHIFT;
+
+    if (g_heap_first[chunk] != HEAP_NONE)
+    {
+        for (int64_t idx = g_heap_first[chunk]; idx < end && idx < g_heap_pool.size(); idx += block_size(idx))
+        {
+            if (block_free(idx))
+                largest = std::max(largest, static_cast<uint32_t>(block_size(idx)));
+        }
+    }
+
+    auto node = static_cast<int64_t>(heap_tree_leaves()) + chunk;
+
+    if (g_heap_tree[node] == largest)
+        return;
+
+    g_heap_tree[node] = largest;
+
+    for (node >>= 1; node > 0; node >>= 1)
+    {
+        auto largest_child = std::max(g_heap_tree[node << 1], g_heap_tree[(node << 1) + 1]);
+
+        if (g_heap_tree[node] == largest_child)
+            return;
+
+        g_heap_tree[node] = largest_child;
+    }
+
+    g_stats.heap_largest_free.store(g_heap_tree[1], std::memory_order_relaxed);
+}
+
+static void
+add_heap_header(int64_t idx) noexcept
+{
+    auto chunk = idx >> HEAP_CHUNK_SHIFT;
+
+    if (g_heap_first[chunk] == HEAP_NONE || g_heap_first[chunk] > idx)
+        g_heap_first[chunk] = gsl::narrow_cast<uint32_t>(idx);
+}
+
+static void
+remove_heap_header(int64_t idx, int64_t next) noexcept
+{
+    auto chunk = idx >> HEAP_CHUNK_SHIFT;
+
+    if (g_heap_first[chunk] == idx)
+    {
+        if (next < g_heap_pool.size() && (next >> HEAP_CHUNK_SHIFT) == chunk)
+            g_heap_first[chunk] = gsl::narrow_cast<uint32_t>(next);
+        else
+            g_heap_first[chunk] = HEAP_NONE;
+    }
+
+    g_heap_pool[idx] = 0;
+}
+
+static void
+reset_heap() noexcept
+{
+    for (auto &&first : g_heap_first)
+        first = HEAP_NONE;
+
+    for (auto &&node : g_heap_tree)
+        node = 0;
+
+    set_block(0, g_heap_pool.size(), 0);
+
+    add_heap_header(0);
+    update_heap_chunk(0);
+}
+
+static void
+push_page_block(page_pool_t &pool, int64_t idx, int64_t order) noexcept
+{
+    pool.allocated[idx] = static_cast<uint64_t>(order) | PAGE_FREE;
+
+    pool.prev[idx] = PAGE_NONE;
+    pool.next[idx] = pool.free[order];
+
+    if (pool.free[order] != PAGE_NONE)
+        pool.prev[pool.free[order]] = idx;
+
+    pool.free[order] = idx;
+
+    if (order > pool.largest.load(std::memory_order_relaxed))
+        pool.largest.store(order, std::memory_order_relaxed);
+}
+
+static void
+remove_page_block(page_pool_t &pool, int64_t idx, int64_t order) noexcept
+{
+    if (pool.prev[idx] != PAGE_NONE)
+        pool.next[pool.prev[idx]] = pool.next[idx];
+    else
+        pool.free[order] = pool.next[idx];
+
+    if (pool.next[idx] != PAGE_NONE)
+        pool.prev[pool.next[idx]] = pool.prev[idx];
+
+    pool.allocated[idx] = 0;
+
+    if (pool.free[order] != PAGE_NONE || order != pool.largest.load(std::memory_order_relaxed))
+        return;
+
+    while (order >= 0 && pool.free[order] == PAGE_NONE)
+        order--;
+
+    pool.largest.store(order, std::memory_order_relaxed);
+}
+
+static void
+free_page_block(page_pool_t &pool, int64_t idx, int64_t order) noexcept
+{
+    for (; order < pool.max_order; order++)
+    {
+        int64_t buddy = idx ^ (1LL << order);
+
+        if (buddy + (1LL << order) > pool.pages.size())
+            break;
+
+        if (pool.allocated[buddy] != (static_cast<uint64_t>(order) | PAGE_FREE))
+            break;
+
+        remove_page_block(pool, buddy, order);
+        idx = std::min(idx, buddy);
+    }
+
+    push_page_block(pool, idx, order);
+}
+
+static void
+free_page_range(page_pool_t &pool, int64_t idx, int64_t pages) noexcept
+{
+    // A range of pages is returned as the largest naturally aligned blocks
+    // that fit, each of which is then coalesced with it's buddy if it can.
+
+    while (pages > 0)
+    {
+        int64_t order = 0;
+
+        while (order < pool.max_order &&
+               (idx & ((2LL << order) - 1)) == 0 && (2LL << order) <= pages)
+            order++;
+
+        free_page_block(pool, idx, order);
+
+        idx += 1LL << order;
+        pages -= 1LL << order;
+    }
+}
+
+static void *
+alloc_page_blocks(page_pool_t &pool, int64_t pages) noexcept
+{
+    int64_t order = 0;
+
+    while ((1LL << order) < pages)
+        order++;
+
+    auto current = order;
+
+    while (current <= pool.max_order && pool.free[current] == PAGE_NONE)
+        current++;
+
+    if (current > pool.max_order)
+        return nullptr;
+
+    auto idx = pool.free[current];
+    remove_page_block(pool, idx, current);
+
+    while (current > order)
+    {
+        current--;
+        push_page_block(pool, idx + (1LL << current), current);
+    }
+
+    pool.allocated[idx] = static_cast<uint64_t>(pages) | ALLOCATED;
+    free_page_range(pool, idx + pages, (1LL << order) - pages);
+
+    return &pool.pages[idx];
+}
+
+static void
+reset_page_pool(page_pool_t &pool) noexcept
+{
+    pool.max_order = page_pool_order(static_cast<uint64_t>(pool.pages.size()));
+
+    for (auto &&head : pool.free)
+        head = PAGE_NONE;
+
+    pool.largest.store(PAGE_NONE, std::memory_order_relaxed);
+    free_page_range(pool, 0, pool.pages.size());
+}
+
+static void
+reset_page_pools() noexcept
+{
+    auto &&pool = g_page_pools[0];
+
+    pool.pages = gsl::span<mmpage_t>(g_page_pool_owner);
+    pool.allocated = gsl::span<uint64_t>(g_page_allocated_owner);
+    pool.next = gsl::span<int64_t>(g_page_next_owner);
+    pool.prev = gsl::span<int64_t>(g_page_prev_owner);
+
+    reset_page_pool(pool);
+
+    for (auto &&slot : g_page_pools)
+        slot.ready = false;
+
+    pool.ready = true;
+
+    g_num_reserved_page_pools = 1;
+    g_num_page_pools.store(1, std::memory_order_release);
+}
+
+static void
+publish_page_pools() noexcept
+{
+    auto num = g_num_page_pools.load(std::memory_order_relaxed);
+
+    while (num < g_num_reserved_page_pools && g_page_pools[num].ready)
+        num++;
+
+    g_num_page_pools.store(num, std::memory_order_release);
+}
+
+static void *
+alloc_pages(int64_t pages, int64_t first) noexcept
+{
+    std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+    auto num = g_num_page_pools.load(std::memory_order_relaxed);
+
+    for (auto i = first; i < num; i++)
+    {
+        auto &&pool = g_page_pools[i];
+
+        if (pages > pool.pages.size())
+            continue;
+
+        if (auto ptr = alloc_page_blocks(pool, pages))
+        {
+            auto bytes = static_cast<uint64_t>(pages) << MAX_PAGE_SHIFT;
+
+            stat_use(g_stats.page_in_use, g_stats.page_peak, bytes);
+            stat_add(g_stats.allocs[size_class(bytes)], 1);
+
+            return ptr;
+        }
+    }
+
+    // Every allocation that cannot be satisfied by the heap ends up here,
+    // so this is the only place failed allocations have to be counted.
+
+    stat_add(g_stats.failed_allocs, 1);
+    return nullptr;
+}
+
+static page_pool_t *
+find_page_pool(void *ptr) noexcept
+{
+    auto num = g_num_page_pools.load(std::memory_order_acquire);
+
+    for (auto i = 0LL; i < num; i++)
+    {
+        if (g_page_pools[i].pages.contains(static_cast<mmpage_t *>(ptr)))
+            return &g_page_pools[i];
+    }
+
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------------------
+
+memory_manager *
+memory_manager::instance() noexcept
+{
+    static memory_manager self;
+    return &self;
+}
+
+void *
+memory_manager::malloc(size_t size) noexcept
+{
+    if (size == 0)
+        return nullptr;
+
+    // We ensure that when allocating memory that if it is a multiple of a page,
+    // we use the page pool instead of the heap. The page pool is page aligned
+    // which is needed for a lot of tasks.
+    //
+    // Note that when creating a shared_ptr, the reference counter is allocated
+    // with the memory which means that if you std::make_shared<page>() you
+    // will allocate more than a page, resulting in unaligned memory. The
+    // solution to this is to new the memory, and pass the resulting ptr to
+    // share_ptr constructor (which will create it's own reference on it's own)
+    //
+    // Note the heap uses a header to keep track of each segment, while the
+    // page pool uses a seperate allocated buffer. The page pool needs it's
+    // own buffer to ensure each page is page aligned.
+
+    if ((size & (MAX_PAGE_SIZE - 1)) == 0)
+        return malloc_page(size);
+
+    // Small allocations are served from the current core's magazine. If the
+    // magazine cannot be refilled, or the allocation is too large to be
+    // cached, the heap is used instead. Since the magazines hold on to heap
+    // memory, if the heap is exhausted, the magazines are flushed and the
+    // allocation is tried again before giving up.
+
+    if (m_magazines_enabled)
+    {
+        if (auto ptr = malloc_magazine(size))
+            return ptr;
+
+        if (auto ptr = malloc_heap(size))
+            return ptr;
+
+        flush_magazines();
+    }
+
+    if (auto ptr = malloc_heap(size))
+        return ptr;
+
+    // The heap has a fixed size, but the driver entry can add page pools
+    // using add_pool, so once the heap is exhausted, the allocation spills
+    // into those page pools (rounded up to whole pages). The built in page
+    // pool is left for page allocations.
+
+    auto pages = static_cast<int64_t>(size >> MAX_PAGE_SHIFT) + 1;
+    return alloc_pages(pages, 1);
+}
+
+void
+memory_manager::free(void *ptr) noexcept
+{
+    if (ptr == nullptr)
+        return;
+
+    if (g_heap_pool.contains(static_cast<uint64_t *>(ptr)))
+    {
+        if (!m_magazines_enabled || !free_magazine(ptr))
+            free_heap(ptr);
+    }
+
+    if (find_page_pool(ptr) != nullptr)
+        free_page(ptr);
+}
+
+void *
+memory_manager::calloc(size_t nmemb, size_t size) noexcept
+{
+    if (nmemb != 0 && size > SIZE_MAX / nmemb)
+        return nullptr;
+
+    auto total = nmemb * size;
+
+    if (total == MAX_PAGE_SIZE)
+    {
+        std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+        if (g_num_zeroed_pages > 0)
+            return g_zeroed_pages[--g_num_zeroed_pages];
+    }
+
+    auto ptr = this->malloc(total);
+
+    if (ptr != nullptr)
+        __builtin_memset(ptr, 0, total);
+
+    return ptr;
+}
+
+void *
+memory_manager::realloc(void *ptr, size_t size) noexcept
+{
+    if (ptr == nullptr)
+        return this->malloc(size);
+
+    if (size == 0)
+    {
+        this->free(ptr);
+        return nullptr;
+    }
+
+    // The allocation is resized in place if it can be. Heap allocations
+    // are only resized in place if the new size would also come from the
+    // heap, as page sized allocations have to be page aligned, while any
+    // page pool allocation can shrink in place, including heap allocations
+    // that spilled into the page pools.
+
+    size_t old_size = 0;
+
+    if (g_heap_pool.contains(static_cast<uint64_t *>(ptr)))
+    {
+        auto idx = g_heap_pool.index_from_ptr(static_cast<uint64_t *>(ptr)) - 1;
+
+        if ((size & (MAX_PAGE_SIZE - 1)) != 0)
+        {
+            std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+            if (resize_heap_blocks(idx, heap_blocks(size)))
+                return ptr;
+        }
+
+        old_size = static_cast<size_t>(block_size(idx) - 1) * sizeof(uint64_t);
+    }
+
+    if (auto pool = find_page_pool(ptr))
+    {
+        auto idx = pool->pages.index_from_ptr(static_cast<mmpage_t *>(ptr));
+        auto pages = static_cast<int64_t>((size + MAX_PAGE_SIZE - 1) >> MAX_PAGE_SHIFT);
+
+        std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+        auto old_pages = static_cast<int64_t>(pool->allocated[idx] & ~ALLOCATED);
+
+        if (pages <= old_pages)
+        {
+            pool->allocated[idx] = static_cast<uint64_t>(pages) | ALLOCATED;
+            free_page_range(*pool, idx + pages, old_pages - pages);
+
+            stat_sub(g_stats.page_in_use, static_cast<uint64_t>(old_pages - pages) << MAX_PAGE_SHIFT);
+
+            return ptr;
+        }
+
+        old_size = static_cast<size_t>(old_pages) << MAX_PAGE_SHIFT;
+    }
+
+    if (old_size == 0)
+        return nullptr;
+
+    auto new_ptr = this->malloc(size);
+
+    if (new_ptr == nullptr)
+        return nullptr;
+
+    __builtin_memcpy(new_ptr, ptr, std::min(old_size, size));
+    this->free(ptr);
+
+    return new_ptr;
+}
+
+void
+memory_manager::refill_zeroed_pages() noexcept
+{
+    int64_t needed = 0;
+
+    {
+        std::lock_guard<std::mutex> guard(g_malloc_mutex);
+        needed = g_zeroed_pages.size() - g_num_zeroed_pages;
+    }
+
+    for (; needed > 0; needed--)
+    {
+        auto page = malloc_page(MAX_PAGE_SIZE);
+
+        if (page == nullptr)
+            return;
+
+        __builtin_memset(page, 0, MAX_PAGE_SIZE);
+
+        {
+            std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+            if (g_num_zeroed_pages < g_zeroed_pages.size())
+            {
+                g_zeroed_pages[g_num_zeroed_pages++] = page;
+                continue;
+            }
+        }
+
+        free_page(page);
+        return;
+    }
+}
+
+uintptr_t
+memory_manager::virt_to_phys(uintptr_t virt)
+{
+    return m_virt_to_phys_index.lookup(virt);
+}
+
+uintptr_t
+memory_manager::virt_to_phys(void *virt)
+{
+    return this->virt_to_phys(reinterpret_cast<uintptr_t>(virt));
+}
+
+void *
+memory_manager::virt_to_phys_ptr(uintptr_t virt)
+{
+    return reinterpret_cast<void *>(this->virt_to_phys(virt));
+}
+
+void *
+memory_manager::virt_to_phys_ptr(void *virt)
+{
+    return reinterpret_cast<void *>(this->virt_to_phys(virt));
+}
+
+uintptr_t
+memory_manager::phys_to_virt(uintptr_t phys)
+{
+    return m_phys_to_virt_index.lookup(phys);
+}
+
+uintptr_t
+memory_manager::phys_to_virt(void *phys)
+{
+    return this->phys_to_virt(reinterpret_cast<uintptr_t>(phys));
+}
+
+void *
+memory_manager::phys_to_virt_ptr(uintptr_t phys)
+{
+    return reinterpret_cast<void *>(this->phys_to_virt(phys));
+}
+
+void *
+memory_manager::phys_to_virt_ptr(void *phys)
+{
+    return reinterpret_cast<void *>(this->phys_to_virt(phys));
+}
+
+void *
+memory_manager::malloc_heap(size_t size) noexcept
+{
+    int64_t blocks = heap_blocks(size);
+
+    if (blocks > g_heap_pool.size())
+        return nullptr;
+
+    std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+    auto ptr = alloc_heap_blocks(blocks);
+
+    if (ptr != nullptr)
+        stat_add(g_stats.allocs[size_class(heap_bytes(blocks))], 1);
+
+    return ptr;
+}
+
+void *
+memory_manager::malloc_page(size_t size) noexcept
+{
+    return alloc_pages(static_cast<int64_t>(size >> MAX_PAGE_SHIFT), 0);
+}
+
+void
+memory_manager::free_heap(void *ptr) noexcept
+{
+    auto idx = g_heap_pool.index_from_ptr(static_cast<uint64_t *>(ptr)) - 1;
+
+    std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+    if (block_free(idx))
+        return;
+
+    stat_add(g_stats.frees[size_class(heap_bytes(block_size(idx)))], 1);
+    release_heap_blocks(idx);
+}
+
+void
+memory_manager::free_page(void *ptr) noexcept
+{
+    auto pool = find_page_pool(ptr);
+
+    if (pool == nullptr)
+        return;
+
+    auto idx = pool->pages.index_from_ptr(static_cast<mmpage_t *>(ptr));
+
+    std::lock_guard<std::mutex> guard(g_malloc_mutex);
+
+    if ((pool->allocated[idx] & ALLOCATED) == 0)
+        return;
+
+    auto pages = static_cast<int64_t>(pool->allocated[idx] & ~ALLOCATED);
+
+    pool->allocated[idx] = 0;
+    free_page_range(*pool, idx, pages);
+
+    auto bytes = static_cast<uint64_t>(pages) << MAX_PAGE_SHIFT;
+
+    stat_sub(g_stats.page_in_use, bytes);
+    stat_add(g_stats.frees[size_class(bytes)], 1);
+}
+
+uint64_t
+memory_manager::magazine_id() const noexcept
+{
+    // The VMM does not have thread local storage, so the caller's stack is
+    // used to identify it instead. Each vCPU has it's own exit handler stack
+    // (as does each thread in the unit tests), so hashing the stack address
+    // spreads the callers across the magazines without having to execute
+    // anything that might serialize or trap (like cpuid). If two callers end
+    // up sharing a magazine, the result is contention, not corruption.
+
+    auto stack = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+    auto hash = (stack >> __builtin_ctzll(STACK_SIZE)) * 0x9E3779B97F4A7C15ULL;
+
+    return (hash >> 32) % MAX_MAGAZINES;
+}
+
+void *
+memory_manager::malloc_magazine(size_t size) noexcept
+{
+    auto blocks = heap_blocks(size);
+
+    if (blocks > static_cast<int64_t>(MAGAZINE_MAX_BLOCKS))
+        return nullptr;
+
+    auto &&magazine = g_magazines[magazine_id()];
+    auto &&count = magazine.count[blocks - 2];
+    auto &&slots = magazine.slots[blocks - 2];
+
+    std::lock_guard<std::mutex> magazine_guard(magazine.mutex);
+
+    if (count == 0)
+    {
+        std::lock_guard<std::mutex> heap_guard(g_malloc_mutex);
+
+        for (; count < MAGAZINE_BATCH; count++)
+        {
+            auto ptr = static_cast<uint64_t *>(alloc_heap_blocks(blocks));
+
+            if (ptr == nullptr)
+                break;
+
+            set_block_cached(g_heap_pool.index_from_ptr(ptr) - 1);
+            slots[count] = ptr;
+        }
+
+        // The blocks were allocated in address order, which is reversed so
+        // that they are handed out in address order as well.
+
+        std::reverse(&slots[0], &slots[count]);
+    }
+
+    if (count == 0)
+        return nullptr;
+
+    auto ptr = slots[--count];
+    clear_block_cached(g_heap_pool.index_from_ptr(ptr) - 1);
+
+    stat_add(magazine.allocs[size_class(heap_bytes(blocks))], 1);
+    return ptr;
+}
+
+bool
+memory_manager::free_magazine(void *ptr) noexcept
+{
+    auto idx = g_heap_pool.index_from_ptr(static_cast<uint64_t *>(ptr)) - 1;
+
+    auto header = load_block(idx);
+
+    if ((header & ALLOCATED) == 0)
+        return false;
+
+    if ((header & CACHED) != 0)
+        return true;
+
+    auto blocks = static_cast<int64_t>(header & BLOCK_SIZE_MASK);
+
+    if (blocks > static_cast<int64_t>(MAGAZINE_MAX_BLOCKS))
+        return false;
+
+    auto &&magazine = g_magazines[magazine_id()];
+    auto &&count = magazine.count[blocks - 2];
+    auto &&slots = magazine.slots[blocks - 2];
+
+    std::lock_guard<std::mutex> magazine_guard(magazine.mutex);
 
-mmpage_t g_page_pool_owner[MAX_PAGE_POOL] __attribute__((aligned(MAX_PAGE_SIZE))) = {};
-gsl::span<mmpage_t> g_page_pool{g_page_pool_owner};
+    if (count == MAGAZINE_SIZE)
+    {
+        std::lock_guard<std::mutex> heap_guard(g_malloc_mutex);
 
-uint64_t g_page_allocated_owner[MAX_PAGE_POOL] __attribute__((aligned(MAX_PAGE_SIZE))) = {};
-gsl::span<uint64_t> g_page_allocated{g_page_allocated_owner};
+        // The oldest blocks are at the bottom of the stack, and are the ones
+        // that are returned to the heap, keeping the recently freed (and
+        // likely still cached) blocks in the magazine.
 
-// -----------------------------------------------------------------------------
-// Mutexes
-// -----------------------------------------------------------------------------
+        for (auto i = 0ULL; i < MAGAZINE_BATCH; i++)
+            release_heap_blocks(g_heap_pool.index_from_ptr(slots[i]) - 1);
 
-#include <mutex>
+        std::copy(&slots[MAGAZINE_BATCH], &slots[count], &slots[0]);
+        count -= MAGAZINE_BATCH;
+    }
 
-std::mutex g_malloc_mutex;
-std::mutex g_add_md_mutex;
+    set_block_cached(idx);
+    slots[count++] = static_cast<uint64_t *>(ptr);
 
-// -----------------------------------------------------------------------------
-// Implementation
-// -----------------------------------------------------------------------------
+    stat_add(magazine.frees[size_class(heap_bytes(blocks))], 1);
+    return true;
+}
 
-memory_manager *
-memory_manager::instance() noexcept
+void
+memory_manager::flush_magazines() noexcept
 {
-    static memory_manager self;
-    return &self;
+    for (auto &&magazine : g_magazines)
+    {
+        std::lock_guard<std::mutex> magazine_guard(magazine.mutex);
+        std::lock_guard<std::mutex> heap_guard(g_malloc_mutex);
+
+        for (auto c = 0ULL; c < MAGAZINE_NUM_CLASSES; c++)
+        {
+            for (auto i = 0ULL; i < magazine.count[c]; i++)
+                release_heap_blocks(g_heap_pool.index_from_ptr(magazine.slots[c][i]) - 1);
+
+            magazine.count[c] = 0;
+        }
+    }
 }
 
 void *
-memory_manager::malloc(size_t size) noexcept
+memory_manager::alloc_heap_blocks(int64_t blocks) noexcept
 {
-    if (size == 0)
+    if (g_heap_tree[1] < blocks)
         return nullptr;
 
-    // We ensure that when allocating memory that if it is a multiple of a page,
-    // we use the page pool instead of the heap. The page pool is page aligned
-    // which is needed for a lot of tasks.
-    //
-    // Note that when creating a shared_ptr, the reference counter is allocated
-    // with the memory which means that if you std::make_shared<page>() you
-    // will allocate more than a page, resulting in unaligned memory. The
-    // solution to this is to new the memory, and pass the resulting ptr to
-    // share_ptr constructor (which will create it's own reference on it's own)
-    //
-    // Note the heap uses a header to keep track of each segment, while the
-    // page pool uses a seperate allocated buffer. The page pool needs it's
-    // own buffer to ensure each page is page aligned.
+    auto node = 1LL;
+    auto leaves = static_cast<int64_t>(heap_tree_leaves());
 
-    if ((size & (MAX_PAGE_SIZE - 1)) == 0)
-        return malloc_page(size);
+    while (node < leaves)
+        node = g_heap_tree[node << 1] >= blocks ? node << 1 : (node << 1) + 1;
+
+    int64_t idx = g_heap_first[node - leaves];
+
+    while (!block_free(idx) || block_size(idx) < blocks)
+        idx += block_size(idx);
+
+    auto size = block_size(idx);
+    set_block(idx, blocks, block_prev(idx), ALLOCATED);
+
+    if (size > blocks)
+    {
+        set_block(idx + blocks, size - blocks, blocks);
+        set_block_prev(idx + size, size - blocks);
+
+        add_heap_header(idx + blocks);
+        update_heap_chunk((idx + blocks) >> HEAP_CHUNK_SHIFT);
+    }
+
+    update_heap_chunk(idx >> HEAP_CHUNK_SHIFT);
+    stat_use(g_stats.heap_in_use, g_stats.heap_peak, static_cast<uint64_t>(blocks) * sizeof(uint64_t));
 
-    return malloc_heap(size);
+    return &g_heap_pool[idx + 1];
 }
 
 void
-memory_manager::free(void *ptr) noexcept
+memory_manager::release_heap_blocks(int64_t idx) noexcept
 {
-    if (ptr == nullptr)
+    if (block_free(idx))
         return;
 
-    if (g_heap_pool.contains(static_cast<uint64_t *>(ptr)))
-        free_heap(ptr);
+    auto size = block_size(idx);
+    auto next = idx + size;
+    auto prev = idx - block_prev(idx);
 
-    if (g_page_pool.contains(static_cast<mmpage_t *>(ptr)))
-        free_page(ptr);
-}
+    stat_sub(g_stats.heap_in_use, static_cast<uint64_t>(size) * sizeof(uint64_t));
 
-uintptr_t
-memory_manager::virt_to_phys(uintptr_t virt)
-{
-    std::lock_guard<std::mutex> guard(g_add_md_mutex);
+    auto next_merged = next < g_heap_pool.size() && block_free(next);
+    auto prev_merged = idx != 0 && block_free(prev);
 
-    const auto &md_iter = m_virt_to_phys_map.find(virt >> MAX_PAGE_SHIFT);
+    if (next_merged)
+    {
+        size += block_size(next);
+        remove_heap_header(next, idx + size);
+    }
 
-    if (md_iter == m_virt_to_phys_map.end())
-        return 0;
+    if (prev_merged)
+    {
+        size += block_size(prev);
+        remove_heap_header(idx, prev + size);
+    }
 
-    auto upper = md_iter->second.phys & ~(MAX_PAGE_SIZE - 1);
-    auto lower = virt & (MAX_PAGE_SIZE - 1);
+    // The headers that were merged are only removed from their chunks once
+    // the merged header is written, as updating a chunk walks the headers.
 
-    return upper | lower;
-}
+    auto start = prev_merged ? prev : idx;
 
-uintptr_t
-memory_manager::virt_to_phys(void *virt)
-{
-    return this->virt_to_phys(reinterpret_cast<uintptr_t>(virt));
-}
+    set_block(start, size, block_prev(start));
+    set_block_prev(start + size, size);
 
-void *
-memory_manager::virt_to_phys_ptr(uintptr_t virt)
-{
-    return reinterpret_cast<void *>(this->virt_to_phys(virt));
-}
+    if (next_merged)
+        update_heap_chunk(next >> HEAP_CHUNK_SHIFT);
 
-void *
-memory_manager::virt_to_phys_ptr(void *virt)
-{
-    return reinterpret_cast<void *>(this->virt_to_phys(virt));
+    if (prev_merged)
+        update_heap_chunk(idx >> HEAP_CHUNK_SHIFT);
+
+    update_heap_chunk(start >> HEAP_CHUNK_SHIFT);
 }
 
-uintptr_t
-memory_manager::phys_to_virt(uintptr_t phys)
+bool
+memory_manager::resize_heap_blocks(int64_t idx, int64_t blocks) noexcept
 {
-    std::lock_guard<std::mutex> guard(g_add_md_mutex);
+    auto size = block_size(idx);
+    auto next = idx + size;
 
-    const auto &md_iter = m_phys_to_virt_map.find(phys >> MAX_PAGE_SHIFT);
+    if (blocks == size)
+        return true;
 
-    if (md_iter == m_phys_to_virt_map.end())
-        return 0;
+    if (blocks < size)
+    {
+        // The end of the fragment is split off as an allocated fragment,
+        // and then released so that it is merged with it's next neighbour.
 
-    auto upper = md_iter->second.virt & ~(MAX_PAGE_SIZE - 1);
-    auto lower = phys & (MAX_PAGE_SIZE - 1);
+        set_block(idx, blocks, block_prev(idx), ALLOCATED);
+        set_block(idx + blocks, size - blocks, blocks, ALLOCATED);
+        set_block_prev(next, size - blocks);
 
-    return upper | lower;
-}
+        add_heap_header(idx + blocks);
+        release_heap_blocks(idx + blocks);
 
-uintptr_t
-memory_manager::phys_to_virt(void *phys)
-{
-    return this->phys_to_virt(reinterpret_cast<uintptr_t>(phys));
+        return true;
+    }
+
+    if (next >= g_heap_pool.size() || !block_free(next))
+        return false;
+
+    auto total = size + block_size(next);
+
+    if (total < blocks)
+        return false;
+
+    remove_heap_header(next, next + block_size(next));
+    set_block(idx, blocks, block_prev(idx), ALLOCATED);
+
+    if (total > blocks)
+    {
+        set_block(idx + blocks, total - blocks, blocks);
+        set_block_prev(idx + total, total - blocks);
+
+        add_heap_header(idx + blocks);
+        update_heap_chunk((idx + blocks) >> HEAP_CHUNK_SHIFT);
+    }
+    else
+    {
+        set_block_prev(idx + total, blocks);
+    }
+
+    update_heap_chunk(next >> HEAP_CHUNK_SHIFT);
+    update_heap_chunk(idx >> HEAP_CHUNK_SHIFT);
+
+    stat_use(g_stats.heap_in_use, g_stats.heap_peak, static_cast<uint64_t>(blocks - size) * sizeof(uint64_t));
+    return true;
 }
 
-void *
-memory_manager::phys_to_virt_ptr(uintptr_t phys)
+static void
+validate_md(const memory_descriptor *md)
 {
-    return reinterpret_cast<void *>(this->phys_to_virt(phys));
+    if (md == nullptr)
+        throw std::invalid_argument("md == NULL");
+
+    if (md->virt == 0)
+        throw std::invalid_argument("md->virt == 0");
+
+    if (md->phys == 0)
+        throw std::invalid_argument("md->phys == 0");
+
+    if ((reinterpret_cast<uintptr_t>(md->virt) & (MAX_PAGE_SIZE - 1)) != 0)
+        throw std::logic_error("virt address is not page aligned");
+
+    if ((reinterpret_cast<uintptr_t>(md->phys) & (MAX_PAGE_SIZE - 1)) != 0)
+        throw std::logic_error("phys address is not page aligned");
 }
 
-void *
-memory_manager::phys_to_virt_ptr(void *phys)
+void
+memory_manager::add_md(memory_descriptor *md)
 {
-    return reinterpret_cast<void *>(this->phys_to_virt(phys));
+    this->add_mdl(md, 1);
 }
 
-void *
-memory_manager::malloc_heap(size_t size) noexcept
+void
+memory_manager::add_mdl(memory_descriptor *mdl, int64_t num)
 {
-    int64_t blocks = (size & (0x7)) != 0 ? (size >> 3) + 2 : (size >> 3) + 1;
-
-    if (blocks > g_heap_pool.size())
-        return nullptr;
+    if (mdl == nullptr)
+        throw std::invalid_argument("mdl == NULL");
 
-    std::lock_guard<std::mutex> guard(g_malloc_mutex);
+    if (num <= 0)
+        throw std::invalid_argument("num <= 0");
 
-    int64_t sidx = m_heap_index;
-    int64_t cidx = m_heap_index;
-    int64_t fragment_size = 0;
+    // The whole list is validated before anything is added so that a bad
+    // descriptor does not leave the memory manager with half of a module.
 
-    auto fa1 = gsl::finally([&]
+    for (auto i = 0LL; i < num; i++)
     {
-        m_heap_index = sidx + blocks;
-    });
+        validate_md(&mdl[i]);
 
-    auto fa2 = gsl::finally([&]
-    {
-        g_heap_pool[sidx] = blocks | ALLOCATED;
-    });
+        if (mdl[i].type == 0)
+            throw std::invalid_argument("md->type == 0");
+    }
 
-    while (cidx < g_heap_pool.size() && sidx + blocks <= g_heap_pool.size())
-    {
-        if (g_heap_pool[cidx] == 0)
-            return &g_heap_pool[sidx + 1];
+    // Runs of pages that are contiguous in both virtual and physical memory
+    // are added as a single range. The driver entry allocates each module
+    // as a single block of virtual memory, so how many ranges a module ends
+    // up with mostly depends on how physically fragmented that block is.
 
-        auto allocated = ((g_heap_pool[cidx] & ALLOCATED) == 0);
+    std::vector<memory_range> virt_ranges;
+    std::vector<memory_range> phys_ranges;
 
-        if (allocated)
+    for (auto i = 0LL; i < num; i++)
+    {
+        if (!virt_ranges.empty())
         {
-            fragment_size += g_heap_pool[cidx];
-
-            if (fragment_size == blocks)
-                return &g_heap_pool[sidx + 1];
+            auto &range = virt_ranges.back();
 
-            if (fragment_size < blocks)
-                fa1.ignore();
-
-            if (fragment_size > blocks)
+            if (range.from + range.size == mdl[i].virt &&
+                range.to + range.size == mdl[i].phys && range.type == mdl[i].type)
             {
-                g_heap_pool[sidx + blocks] = fragment_size - blocks;
-                return &g_heap_pool[sidx + 1];
+                range.size += MAX_PAGE_SIZE;
+                continue;
             }
         }
 
-        cidx += (g_heap_pool[cidx] & ~ALLOCATED);
+        virt_ranges.push_back({mdl[i].virt, mdl[i].phys, MAX_PAGE_SIZE, mdl[i].type});
+    }
+
+    for (const auto &range : virt_ranges)
+        phys_ranges.push_back({range.to, range.from, range.size, range.type});
 
-        if (!allocated)
-        {
-            sidx = cidx;
-            fragment_size = 0;
-        }
+    std::lock_guard<std::mutex> guard(g_add_md_mutex);
+
+    m_virt_to_phys_index.insert(virt_ranges.data(), static_cast<int64_t>(virt_ranges.size()));
+
+    try
+    {
+        m_phys_to_virt_index.insert(phys_ranges.data(), static_cast<int64_t>(phys_ranges.size()));
+    }
+    catch (...)
+    {
+        for (const auto &range : virt_ranges)
+            m_virt_to_phys_index.remove(range.from, range.size);
+
+        throw;
     }
 
-    fa1.ignore();
-    fa2.ignore();
+    try
+    {
+        if (m_range_listener != nullptr)
+            m_range_listener->ranges_added(virt_ranges.data(), static_cast<int64_t>(virt_ranges.size()));
+    }
+    catch (...)
+    {
+        for (const auto &range : virt_ranges)
+        {
+            m_virt_to_phys_index.remove(range.from, range.size);
+            m_phys_to_virt_index.remove(range.to, range.size);
+        }
 
-    return nullptr;
+        throw;
+    }
 }
 
-void *
-memory_manager::malloc_page(size_t size) noexcept
+void
+memory_manager::set_range_listener(memory_range_listener *listener)
 {
-    int64_t pages = size >> 12;
+    std::lock_guard<std::mutex> guard(g_add_md_mutex);
 
-    if (pages > g_page_allocated.size())
-        return nullptr;
+    m_range_listener = nullptr;
 
-    std::lock_guard<std::mutex> guard(g_malloc_mutex);
+    if (listener == nullptr)
+        return;
 
-    int64_t sidx = m_page_index;
-    int64_t cidx = m_page_index;
-    int64_t fragment_size = 0;
+    const auto &ranges = m_virt_to_phys_index.ranges();
 
-    auto fa1 = gsl::finally([&]
-    {
-        m_page_index = sidx + pages;
-    });
+    if (!ranges.empty())
+        listener->ranges_added(ranges.data(), static_cast<int64_t>(ranges.size()));
+
+    m_range_listener = listener;
+}
+
+void
+memory_manager::add_pool(memory_descriptor *mdl, int64_t num)
+{
+    if (mdl == nullptr)
+        throw std::invalid_argument("mdl == NULL");
+
+    if (num < 2)
+        throw std::invalid_argument("num < 2");
 
-    auto fa2 = gsl::finally([&]
+    for (auto i = 1LL; i < num; i++)
     {
-        g_page_allocated[sidx] = pages | ALLOCATED;
-    });
+        if (mdl[i].virt != mdl[0].virt + (static_cast<uint64_t>(i) << MAX_PAGE_SHIFT))
+            throw std::invalid_argument("pool is not virtually contiguous");
+    }
 
-    while (cidx < g_page_pool.size() && sidx + pages <= g_page_pool.size())
+    for (auto i = 0LL; i < num; i++)
     {
-        if (g_page_allocated[cidx] == 0)
-            return &g_page_pool[sidx];
+        if ((mdl[i].type & MEMORY_TYPE_W) == 0)
+            throw std::invalid_argument("pool is not writable");
+    }
 
-        auto allocated = ((g_page_allocated[cidx] & ALLOCATED) == 0);
+    auto idx = 0LL;
 
-        if (allocated)
-        {
-            fragment_size += g_page_allocated[cidx];
+    {
+        std::lock_guard<std::mutex> guard(g_malloc_mutex);
 
-            if (fragment_size == pages)
-                return &g_page_pool[sidx];
+        if (g_num_reserved_page_pools > static_cast<int64_t>(MAX_NUM_POOLS))
+            throw std::runtime_error("max number of pools reached");
 
-            if (fragment_size < pages)
-                fa1.ignore();
+        idx = g_num_reserved_page_pools++;
+    }
 
-            if (fragment_size > pages)
-            {
-                g_page_allocated[sidx + pages] = fragment_size - pages;
-                return &g_page_pool[sidx];
-            }
-        }
+    auto &&pool = g_page_pools[idx];
+
+    try
+    {
+        this->add_mdl(mdl, num);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> guard(g_malloc_mutex);
 
-        cidx += (g_page_allocated[cidx] & ~ALLOCATED);
+        // If another add_pool reserved a slot after this one, the slot has
+        // to be published (as an empty pool) so that theirs can be.
 
-        if (!allocated)
+        if (idx == g_num_reserved_page_pools - 1)
+        {
+            g_num_reserved_page_pools--;
+        }
+        else
         {
-            sidx = cidx;
-            fragment_size = 0;
+            pool.pages = gsl::span<mmpage_t>();
+            reset_page_pool(pool);
+
+            pool.ready = true;
+            publish_page_pools();
         }
+
+        throw;
     }
 
-    fa1.ignore();
-    fa2.ignore();
+    // The pool's bookkeeping (allocated / next / prev for each page) is
+    // stored at the start of the pool, and the rest of the pool is handed
+    // out as pages.
 
-    return nullptr;
-}
+    auto meta = sizeof(uint64_t) + sizeof(int64_t) + sizeof(int64_t);
+    auto meta_pages = static_cast<int64_t>((num * meta + MAX_PAGE_SIZE - 1) >> MAX_PAGE_SHIFT);
+    auto pages = num - meta_pages;
 
-void
-memory_manager::free_heap(void *ptr) noexcept
-{
-    auto idx = g_heap_pool.index_from_ptr(static_cast<uint64_t *>(ptr)) - 1;
+    auto base = reinterpret_cast<uint8_t *>(mdl[0].virt);
+    auto allocated = reinterpret_cast<uint64_t *>(base);
+    auto next = reinterpret_cast<int64_t *>(allocated + pages);
+    auto prev = next + pages;
+
+    std::lock_guard<std::mutex> guard(g_malloc_mutex);
 
-    g_heap_pool[idx] &= ~ALLOCATED;
+    pool.pages = gsl::span<mmpage_t>(reinterpret_cast<mmpage_t *>(base) + meta_pages, pages);
+    pool.allocated = gsl::span<uint64_t>(allocated, pages);
+    pool.next = gsl::span<int64_t>(next, pages);
+    pool.prev = gsl::span<int64_t>(prev, pages);
 
-    if (m_heap_index > static_cast<uint64_t>(idx))
-        m_heap_index = idx;
-}
-void
-memory_manager::free_page(void *ptr) noexcept
-{
-    auto idx = g_page_pool.index_from_ptr(static_cast<mmpage_t *>(ptr));
+    __builtin_memset(static_cast<void *>(allocated), 0, static_cast<size_t>(pages) * sizeof(uint64_t));
 
-    g_page_allocated[idx] &= ~ALLOCATED;
+    reset_page_pool(pool);
 
-    if (m_page_index > static_cast<uint64_t>(idx))
-        m_page_index = idx;
+    pool.ready = true;
+    publish_page_pools();
 }
 
-void
-memory_manager::add_md(memory_descriptor *md)
+memory_stats
+memory_manager::stats() const noexcept
 {
-    if (md == nullptr)
-        throw std::invalid_argument("md == NULL");
-
-    if (md->virt == 0)
-        throw std::invalid_argument("md->virt == 0");
+    memory_stats stats = {};
 
-    if (md->phys == 0)
-        throw std::invalid_argument("md->phys == 0");
+    stats.heap_size = g_heap_pool.size() * sizeof(uint64_t);
+    stats.heap_in_use = g_stats.heap_in_use.load(std::memory_order_relaxed);
+    stats.heap_peak = g_stats.heap_peak.load(std::memory_order_relaxed);
 
-    if ((reinterpret_cast<uintptr_t>(md->virt) & (MAX_PAGE_SIZE - 1)) != 0)
-        throw std::logic_error("virt address is not page aligned");
+    if (auto blocks = g_stats.heap_largest_free.load(std::memory_order_relaxed))
+        stats.heap_largest_free = heap_bytes(static_cast<int64_t>(blocks));
 
-    if ((reinterpret_cast<uintptr_t>(md->phys) & (MAX_PAGE_SIZE - 1)) != 0)
-        throw std::logic_error("phys address is not page aligned");
+    auto num = g_num_page_pools.load(std::memory_order_acquire);
 
-    auto fa1 = gsl::finally([&]
+    for (auto i = 0LL; i < num; i++)
     {
-        std::lock_guard<std::mutex> guard(g_add_md_mutex);
+        auto &&pool = g_page_pools[i];
+        auto largest = pool.largest.load(std::memory_order_relaxed);
 
-        m_virt_to_phys_map.erase(reinterpret_cast<uintptr_t>(md->virt) >> MAX_PAGE_SHIFT);
-        m_phys_to_virt_map.erase(reinterpret_cast<uintptr_t>(md->phys) >> MAX_PAGE_SHIFT);
-    });
+        stats.page_pool_size += static_cast<uint64_t>(pool.pages.size()) << MAX_PAGE_SHIFT;
 
-    if (md->type == 0)
-        throw std::invalid_argument("md->type == 0");
-    else
+        if (largest != PAGE_NONE)
+            stats.page_pool_largest_free = std::max(stats.page_pool_largest_free, static_cast<uint64_t>(MAX_PAGE_SIZE << largest));
+    }
+
+    stats.page_pool_in_use = g_stats.page_in_use.load(std::memory_order_relaxed);
+    stats.page_pool_peak = g_stats.page_peak.load(std::memory_order_relaxed);
+    stats.num_page_pools = static_cast<uint64_t>(num);
+    stats.failed_allocs = g_stats.failed_allocs.load(std::memory_order_relaxed);
+
+    for (auto c = 0ULL; c < MEMORY_STATS_NUM_CLASSES; c++)
     {
-        std::lock_guard<std::mutex> guard(g_add_md_mutex);
+        stats.allocs[c] = g_stats.allocs[c].load(std::memory_order_relaxed);
+        stats.frees[c] = g_stats.frees[c].load(std::memory_order_relaxed);
 
-        m_virt_to_phys_map[reinterpret_cast<uintptr_t>(md->virt) >> MAX_PAGE_SHIFT] = *md;
-        m_phys_to_virt_map[reinterpret_cast<uintptr_t>(md->phys) >> MAX_PAGE_SHIFT] = *md;
+        for (auto &&magazine : g_magazines)
+        {
+            stats.allocs[c] += magazine.allocs[c].load(std::memory_order_relaxed);
+            stats.frees[c] += magazine.frees[c].load(std::memory_order_relaxed);
+        }
     }
 
-    fa1.ignore();
+    return stats;
 }
 
 void
 memory_manager::clear() noexcept
 {
-    m_heap_index = 0;
-    m_page_index = 0;
+    for (auto &&magazine : g_magazines)
+        __builtin_memset(static_cast<void *>(magazine.count), 0, sizeof(magazine.count));
+
+    reset_stats();
+
+    g_num_zeroed_pages = 0;
 
     __builtin_memset(static_cast<void *>(g_heap_pool_owner), 0, MAX_HEAP_POOL * sizeof(uint64_t));
     __builtin_memset(static_cast<void *>(g_page_pool_owner), 0, MAX_PAGE_POOL * sizeof(mmpage_t));
     __builtin_memset(static_cast<void *>(g_page_allocated_owner), 0, MAX_PAGE_POOL * sizeof(uint64_t));
+
+    reset_heap();
+    reset_page_pools();
 }
 
 memory_manager::memory_manager() noexcept :
-    m_heap_index(0),
-    m_page_index(0)
+#ifdef CROSS_COMPILED
+    m_magazines_enabled(true),
+#else
+    m_magazines_enabled(false),
+#endif
+    m_range_listener(nullptr)
 {
+    reset_heap();
+    reset_page_pools();
 }
 
 extern "C" int64_t
@@ -392,6 +1488,35 @@ add_md(struct memory_descriptor *md) noexcept
     });
 }
 
+extern "C" int64_t
+add_mdl(struct memory_descriptor *mdl, int64_t num) noexcept
+{
+    return guard_exceptions(MEMORY_MANAGER_FAILURE, [&]
+    {
+        g_mm->add_mdl(mdl, num);
+    });
+}
+
+extern "C" int64_t
+add_pool(struct memory_descriptor *mdl, int64_t num) noexcept
+{
+    return guard_exceptions(MEMORY_MANAGER_FAILURE, [&]
+    {
+        g_mm->add_pool(mdl, num);
+    });
+}
+
+extern "C" int64_t
+get_memory_stats(struct memory_stats *stats) noexcept
+{
+    if (stats == nullptr)
+        return MEMORY_MANAGER_FAILURE;
+
+    *stats = g_mm->stats();
+
+    return MEMORY_MANAGER_SUCCESS;
+}
+
 #ifdef CROSS_COMPILED
 
 extern "C" void *
@@ -399,10 +1524,7 @@ _malloc_r(struct _reent *reent, size_t size)
 {
     (void) reent;
 
-    if (auto ptr = g_mm->malloc(size))
-        return __builtin_memset(ptr, 0, size);
-
-    return nullptr;
+    return g_mm->malloc(size);
 }
 
 extern "C" void
@@ -416,14 +1538,17 @@ _free_r(struct _reent *reent, void *ptr)
 extern "C" void *
 _calloc_r(struct _reent *reent, size_t nmemb, size_t size)
 {
-    return _malloc_r(reent, nmemb * size);
+    (void) reent;
+
+    return g_mm->calloc(nmemb, size);
 }
 
 extern "C" void *
 _realloc_r(struct _reent *reent, void *ptr, size_t size)
 {
-    _free_r(reent, ptr);
-    return _malloc_r(reent, size);
+    (void) reent;
+
+    return g_mm->realloc(ptr, size);
 }
 
 #endif
@@ -0,0 +1,218 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <memory_manager/memory_range_index.h>
+
+memory_range_index::memory_range_index() noexcept
+{
+    m_current.store(&m_empty, std::memory_order_relaxed);
+    m_epoch.store(0, std::memory_order_relaxed);
+
+    for (auto &&readers : m_readers)
+        readers.store(0, std::memory_order_relaxed);
+}
+
+void
+memory_range_index::insert(const memory_range *list, int64_t num)
+{
+    if (list == nullptr)
+        throw std::invalid_argument("list == NULL");
+
+    for (auto i = 0LL; i < num; i++)
+    {
+        if (list[i].size == 0)
+            throw std::invalid_argument("range.size == 0");
+
+        if (list[i].from + list[i].size < list[i].from)
+            throw std::invalid_argument("range wraps around the address space");
+    }
+
+    auto ranges = working_copy();
+
+    for (auto i = 0LL; i < num; i++)
+    {
+        carve(ranges, list[i].from, list[i].size);
+        place(ranges, list[i]);
+    }
+
+    publish(ranges);
+}
+
+void
+memory_range_index::remove(uintptr_t from, uintptr_t size)
+{
+    if (size == 0)
+        return;
+
+    if (from + size < from)
+        throw std::invalid_argument("range wraps around the address space");
+
+    auto ranges = working_copy();
+
+    carve(ranges, from, size);
+    publish(ranges);
+}
+
+uintptr_t
+memory_range_index::lookup(uintptr_t from) const noexcept
+{
+    auto &&readers = m_readers[m_epoch.load() & 1];
+    readers.fetch_add(1);
+
+    const auto &ranges = *m_current.load();
+
+    auto iter = std::upper_bound(ranges.begin(), ranges.end(), from,
+    [](uintptr_t addr, const memory_range & range)
+    { return addr < range.from; });
+
+    uintptr_t to = 0;
+
+    if (iter != ranges.begin())
+    {
+        --iter;
+
+        if (from - iter->from < iter->size)
+            to = iter->to + (from - iter->from);
+    }
+
+    readers.fetch_sub(1, std::memory_order_release);
+    return to;
+}
+
+memory_range_index::working_type
+memory_range_index::working_copy() const
+{
+    working_type ranges;
+
+    for (const auto &range : this->ranges())
+        ranges.emplace_hint(ranges.end(), range.from, range);
+
+    return ranges;
+}
+
+void
+memory_range_index::publish(const working_type &ranges)
+{
+    auto version = std::make_unique<ranges_type>();
+    version->reserve(ranges.size());
+
+    for (const auto &range : ranges)
+        version->push_back(range.second);
+
+    m_current.store(version.get());
+    synchronize();
+
+    m_version = std::move(version);
+}
+
+void
+memory_range_index::synchronize() noexcept
+{
+    // Once the new array is published, a lookup that registers itself can
+    // only ever see the new array, so the old array can be freed once every
+    // lookup that registered itself before the new array was published has
+    // finished. Waiting for both counters to drain while lookups are still
+    // coming in could take forever, so the epoch is flipped first, which
+    // sends new lookups to the other counter. A lookup might have read the
+    // epoch before a previous flip, and registered itself on the other
+    // counter after that flip's wait, so the epoch is flipped (and the
+    // counter drained) twice.
+
+    for (auto i = 0; i < 2; i++)
+    {
+        auto &&readers = m_readers[m_epoch.fetch_add(1) & 1];
+
+        while (readers.load() != 0)
+            ;
+    }
+}
+
+void
+memory_range_index::carve(working_type &ranges, uintptr_t from, uintptr_t size)
+{
+    auto end = from + size;
+    auto iter = ranges.upper_bound(from);
+
+    if (iter != ranges.begin())
+    {
+        auto prev = std::prev(iter);
+
+        if (prev->second.from + prev->second.size > from)
+            iter = prev;
+    }
+
+    while (iter != ranges.end() && iter->second.from < end)
+    {
+        auto range = iter->second;
+        auto range_end = range.from + range.size;
+
+        iter = ranges.erase(iter);
+
+        if (range.from < from)
+            ranges.emplace(range.from, memory_range{range.from, range.to, from - range.from, range.type});
+
+        if (range_end > end)
+        {
+            auto offset = end - range.from;
+            iter = ranges.emplace(end, memory_range{end, range.to + offset, range_end - end, range.type}).first;
+        }
+    }
+}
+
+void
+memory_range_index::place(working_type &ranges, const memory_range &range)
+{
+    // The range being placed has already been carved out of the index, so
+    // the only thing left to do is merge it with its neighbours if they are
+    // contiguous on both sides, and have the same type.
+
+    auto merged = range;
+    auto iter = ranges.lower_bound(range.from);
+
+    if (iter != ranges.end())
+    {
+        const auto &next = iter->second;
+
+        if (next.from == merged.from + merged.size &&
+            next.to == merged.to + merged.size && next.type == merged.type)
+        {
+            merged.size += next.size;
+            iter = ranges.erase(iter);
+        }
+    }
+
+    if (iter != ranges.begin())
+    {
+        auto &prev = std::prev(iter)->second;
+
+        if (prev.from + prev.size == merged.from &&
+            prev.to + prev.size == merged.to && prev.type == merged.type)
+        {
+            prev.size += merged.size;
+            return;
+        }
+    }
+
+    ranges.emplace_hint(iter, merged.from, merged);
+}
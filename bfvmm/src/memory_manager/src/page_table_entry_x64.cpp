@@ -122,6 +122,18 @@ page_table_entry_x64::set_pat(bool enabled) noexcept
     enabled ? *m_pte |= PTE_FLAGS_PAT : *m_pte &= ~PTE_FLAGS_PAT;
 }
 
+bool
+page_table_entry_x64::ps() const noexcept
+{
+    return (*m_pte & PTE_FLAGS_PS) != 0;
+}
+
+void
+page_table_entry_x64::set_ps(bool enabled) noexcept
+{
+    enabled ? *m_pte |= PTE_FLAGS_PS : *m_pte &= ~PTE_FLAGS_PS;
+}
+
 bool
 page_table_entry_x64::global() const noexcept
 {
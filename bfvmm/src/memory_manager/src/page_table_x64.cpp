@@ -19,56 +19,362 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+
 #include <gsl/gsl>
 
+#include <memory_manager/object_pool.h>
 #include <memory_manager/memory_manager.h>
 #include <memory_manager/page_table_x64.h>
 
-page_table_x64::page_table_x64(uintptr_t *pte) :
+page_table_x64::page_table_x64(uintptr_t *pte, uint64_t bits, uintptr_t large_page) :
     page_table_entry_x64(pte != nullptr ? pte : & m_cr3_shadow),
-    m_ptes(PT_SIZE),
+    m_bits(bits),
     m_cr3_shadow(0)
 {
     m_pt_owner = std::make_unique<uintptr_t[]>(4096 / sizeof(uintptr_t));
     m_pt = gsl::span<uintptr_t>(m_pt_owner.get(), PT_SIZE);
 
-    this->set_phys_addr(g_mm->virt_to_phys(m_pt_owner.get()));
-    this->set_present(true);
-    this->set_rw(true);
-    this->set_us(true);
+    if (m_bits > PT_INDEX)
+        m_tables = std::make_unique<std::shared_ptr<page_table_x64>[]>(PT_SIZE);
+
+    if (large_page != 0)
+    {
+        // Note that a PDPT entry is split into 2MB pages, which can be
+        // split again if needed.
+
+        auto leaf = large_page & (PTE_FLAGS_ATTRS | PTE_FLAGS_MAPPED);
+        auto phys_addr = large_page & PTE_PHYS_ADDR_MASK;
+        auto entry_size = 1ULL << m_bits;
+
+        if (m_bits != PT_INDEX)
+            leaf |= PTE_FLAGS_PS;
+
+        for (auto i = 0; i < PT_SIZE; i++)
+            m_pt[i] = ((phys_addr + (i * entry_size)) & PTE_PHYS_ADDR_MASK) | leaf;
+    }
+
+    auto entry = (g_mm->virt_to_phys(m_pt_owner.get()) & PTE_PHYS_ADDR_MASK) |
+                 PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_US;
+
+    __atomic_store_n(pte != nullptr ? pte : &m_cr3_shadow, entry, __ATOMIC_RELEASE);
 }
 
-std::shared_ptr<page_table_entry_x64>
+page_table_entry_x64
 page_table_x64::add_page(uintptr_t virt_addr)
 {
-    return add_page(virt_addr, PML4_INDEX);
+    return add_page(virt_addr, PT_INDEX);
+}
+
+page_table_entry_x64
+page_table_x64::add_page_2m(uintptr_t virt_addr)
+{
+    if ((virt_addr & (PAGE_SIZE_2M - 1)) != 0)
+        throw std::invalid_argument("add_page_2m: virt_addr must be 2MB aligned");
+
+    return add_page(virt_addr, PD_INDEX);
+}
+
+page_table_entry_x64
+page_table_x64::add_page_1g(uintptr_t virt_addr)
+{
+    if ((virt_addr & (PAGE_SIZE_1G - 1)) != 0)
+        throw std::invalid_argument("add_page_1g: virt_addr must be 1GB aligned");
+
+    return add_page(virt_addr, PDPT_INDEX);
+}
+
+void
+page_table_x64::map_range(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size,
+                          uint64_t attrs, uint64_t max_page_size)
+{
+    if (((virt_addr | phys_addr | size) & (PAGE_SIZE_4K - 1)) != 0)
+        throw std::invalid_argument("map_range: virt_addr, phys_addr and size must be 4k aligned");
+
+    if ((attrs & ~PTE_FLAGS_ATTRS) != 0)
+        throw std::invalid_argument("map_range: invalid attrs");
+
+    switch (max_page_size)
+    {
+        case PAGE_SIZE_4K:
+            return map_entries(virt_addr, phys_addr, size, attrs, PT_INDEX);
+
+        case PAGE_SIZE_2M:
+            return map_entries(virt_addr, phys_addr, size, attrs, PD_INDEX);
+
+        case PAGE_SIZE_1G:
+            return map_entries(virt_addr, phys_addr, size, attrs, PDPT_INDEX);
+
+        default:
+            throw std::invalid_argument("map_range: invalid max_page_size");
+    }
 }
 
-std::shared_ptr<page_table_entry_x64>
-page_table_x64::add_page(uintptr_t virt_addr, uint64_t bits)
+void
+page_table_x64::remap_range(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size,
+                            uint64_t attrs, uint64_t max_page_size)
 {
-    auto index = (virt_addr & ((INDEX_MASK) << bits)) >> bits;
+    if (((virt_addr | phys_addr | size) & (PAGE_SIZE_4K - 1)) != 0)
+        throw std::invalid_argument("remap_range: virt_addr, phys_addr and size must be 4k aligned");
+
+    if ((attrs & ~PTE_FLAGS_ATTRS) != 0)
+        throw std::invalid_argument("remap_range: invalid attrs");
 
-    if (bits > PT_INDEX)
+    switch (max_page_size)
     {
-        auto pte = std::dynamic_pointer_cast<page_table_x64>(m_ptes[index]);
+        case PAGE_SIZE_4K:
+            return remap_entries(virt_addr, phys_addr, size, attrs, PT_INDEX);
 
-        if (pte)
-            return pte->add_page(virt_addr, bits - BITS_PER_INDEX);
+        case PAGE_SIZE_2M:
+            return remap_entries(virt_addr, phys_addr, size, attrs, PD_INDEX);
 
-        pte = std::make_shared<page_table_x64>(&m_pt[index]);
-        m_ptes[index] = pte;
+        case PAGE_SIZE_1G:
+            return remap_entries(virt_addr, phys_addr, size, attrs, PDPT_INDEX);
 
-        return pte->add_page(virt_addr, bits - BITS_PER_INDEX);
+        default:
+            throw std::invalid_argument("remap_range: invalid max_page_size");
     }
+}
+
+void
+page_table_x64::unmap_range(uintptr_t virt_addr, uint64_t size)
+{
+    if (((virt_addr | size) & (PAGE_SIZE_4K - 1)) != 0)
+        throw std::invalid_argument("unmap_range: virt_addr and size must be 4k aligned");
+
+    if (unmap_entries(virt_addr, size, m_retired) != 0)
+        throw std::invalid_argument("unmap_range: range is out of bounds");
+}
+
+uint64_t
+page_table_x64::num_tables() const noexcept
+{
+    auto num = 1ULL;
+
+    if (!m_tables)
+        return num;
+
+    for (auto i = 0; i < PT_SIZE; i++)
+    {
+        if (m_tables[i])
+            num += m_tables[i]->num_tables();
+    }
+
+    return num;
+}
+
+void
+page_table_x64::free_retired() noexcept
+{
+    m_retired.clear();
+}
+
+uint64_t
+page_table_x64::num_retired() const noexcept
+{
+    return m_retired.size();
+}
+
+page_table_entry_x64
+page_table_x64::add_page(uintptr_t virt_addr, uint64_t leaf_bits)
+{
+    auto index = (virt_addr & ((INDEX_MASK) << m_bits)) >> m_bits;
 
-    auto pte = m_ptes[index];
+    // The hardware entry is the source of truth. An entry is in use if
+    // it points to a table (which has a child in m_tables), or if it was
+    // handed out as a page, which is marked using PTE_FLAGS_MAPPED (one of
+    // the bits that the hardware ignores) as the caller might not have
+    // filled the entry in yet.
 
-    if (pte)
+    if (m_bits > leaf_bits)
+    {
+        auto pt = m_tables[index];
+
+        if (!pt)
+            pt = add_table(index);
+
+        return pt->add_page(virt_addr, leaf_bits);
+    }
+
+    if (m_pt[index] != 0)
         throw std::logic_error("add_page: page mapping already exists");
 
-    pte = std::make_shared<page_table_entry_x64>(&m_pt[index]);
-    m_ptes[index] = pte;
+    auto pte = page_table_entry_x64(&m_pt[index]);
+
+    m_pt[index] = PTE_FLAGS_MAPPED;
+
+    if (leaf_bits != PT_INDEX)
+        pte.set_ps(true);
 
     return pte;
 }
+
+void
+page_table_x64::map_entries(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size,
+                            uint64_t attrs, uint64_t leaf_bits)
+{
+    auto entry_size = 1ULL << m_bits;
+    auto index = (virt_addr >> m_bits) & INDEX_MASK;
+
+    auto leaf = attrs | PTE_FLAGS_MAPPED;
+
+    if (m_bits != PT_INDEX)
+        leaf |= PTE_FLAGS_PS;
+
+    while (size != 0)
+    {
+        if (index >= PT_SIZE)
+            throw std::invalid_argument("map_range: range is out of bounds");
+
+        auto offset = virt_addr & (entry_size - 1);
+        auto chunk = entry_size - offset < size ? entry_size - offset : size;
+
+        if (m_bits <= leaf_bits && chunk == entry_size && (phys_addr & (entry_size - 1)) == 0)
+        {
+            if (m_pt[index] != 0)
+                throw std::logic_error("map_range: page mapping already exists");
+
+            m_pt[index] = (phys_addr & PTE_PHYS_ADDR_MASK) | leaf;
+        }
+        else
+        {
+            auto pt = m_tables[index];
+
+            if (!pt)
+                pt = add_table(index);
+
+            pt->map_entries(virt_addr, phys_addr, chunk, attrs, leaf_bits);
+        }
+
+        virt_addr += chunk;
+        phys_addr += chunk;
+        size -= chunk;
+        index++;
+    }
+}
+
+void
+page_table_x64::remap_entries(uintptr_t virt_addr, uintptr_t phys_addr, uint64_t size,
+                              uint64_t attrs, uint64_t leaf_bits)
+{
+    auto entry_size = 1ULL << m_bits;
+    auto index = (virt_addr >> m_bits) & INDEX_MASK;
+
+    auto leaf = attrs | PTE_FLAGS_MAPPED;
+
+    if (m_bits != PT_INDEX)
+        leaf |= PTE_FLAGS_PS;
+
+    while (size != 0)
+    {
+        if (index >= PT_SIZE)
+            throw std::invalid_argument("remap_range: range is out of bounds");
+
+        auto offset = virt_addr & (entry_size - 1);
+        auto chunk = entry_size - offset < size ? entry_size - offset : size;
+
+        auto pt = m_tables ? m_tables[index] : nullptr;
+
+        if (!pt && m_bits <= leaf_bits && chunk == entry_size && (phys_addr & (entry_size - 1)) == 0)
+        {
+            __atomic_store_n(&m_pt[index], (phys_addr & PTE_PHYS_ADDR_MASK) | leaf, __ATOMIC_RELEASE);
+        }
+        else
+        {
+            if (!pt)
+                pt = m_pt[index] != 0 ? split(index) : add_table(index);
+
+            pt->remap_entries(virt_addr, phys_addr, chunk, attrs, leaf_bits);
+        }
+
+        virt_addr += chunk;
+        phys_addr += chunk;
+        size -= chunk;
+        index++;
+    }
+}
+
+uint64_t
+page_table_x64::unmap_entries(uintptr_t virt_addr, uint64_t size, retired_tables &retired)
+{
+    auto entry_size = 1ULL << m_bits;
+    auto index = (virt_addr >> m_bits) & INDEX_MASK;
+
+    while (size != 0 && index < PT_SIZE)
+    {
+        auto offset = virt_addr & (entry_size - 1);
+        auto chunk = entry_size - offset < size ? entry_size - offset : size;
+
+        if (m_tables && m_tables[index])
+        {
+            m_tables[index]->unmap_entries(virt_addr, chunk, retired);
+
+            if (m_tables[index]->empty())
+            {
+                // The table is unlinked before it is released, and kept
+                // until the caller has flushed the TLB, so that a walk that
+                // is still using it never reads memory that was reused.
+
+                retired.push_back(m_tables[index]);
+
+                __atomic_store_n(&m_pt[index], 0, __ATOMIC_RELEASE);
+                m_tables[index].reset();
+            }
+        }
+        else if (m_pt[index] != 0)
+        {
+            if (chunk == entry_size)
+            {
+                __atomic_store_n(&m_pt[index], 0, __ATOMIC_RELEASE);
+            }
+            else
+            {
+                split(index);
+                m_tables[index]->unmap_entries(virt_addr, chunk, retired);
+            }
+        }
+
+        virt_addr += chunk;
+        size -= chunk;
+        index++;
+    }
+
+    return size;
+}
+
+std::shared_ptr<page_table_x64>
+page_table_x64::add_table(uint64_t index)
+{
+    if (m_pt[index] != 0)
+        throw std::logic_error("add_table: large page mapping already exists");
+
+    auto pt = make_pooled<page_table_x64>(&m_pt[index], m_bits - BITS_PER_INDEX);
+    m_tables[index] = pt;
+
+    return pt;
+}
+
+std::shared_ptr<page_table_x64>
+page_table_x64::split(uint64_t index)
+{
+    // Replaces a large page with a table of smaller pages that map the
+    // same physical memory with the same attributes. The new table is
+    // filled in before it replaces the large page, so the memory is
+    // mapped the whole time.
+
+    auto pt = make_pooled<page_table_x64>(&m_pt[index], m_bits - BITS_PER_INDEX, m_pt[index]);
+    m_tables[index] = pt;
+
+    return pt;
+}
+
+bool
+page_table_x64::empty() const noexcept
+{
+    for (auto i = 0; i < PT_SIZE; i++)
+    {
+        if (m_pt[i] != 0)
+            return false;
+    }
+
+    return true;
+}
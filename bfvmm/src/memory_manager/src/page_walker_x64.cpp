@@ -0,0 +1,73 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <memory_manager/memory_manager.h>
+#include <memory_manager/page_walker_x64.h>
+
+page_walk_x64
+page_walker_x64::walk(uintptr_t cr3, uintptr_t virt) const
+{
+    page_walk_x64 result = {false, 0, 0, true, true, false};
+
+    auto phys = cr3 & PTE_PHYS_ADDR_MASK;
+
+    for (auto bits = PML4_INDEX; bits >= PT_INDEX; bits -= BITS_PER_INDEX)
+    {
+        auto pt = this->table(phys);
+
+        if (pt == nullptr)
+            return result;
+
+        auto pte = pt[(virt >> bits) & INDEX_MASK];
+
+        if ((pte & PTE_FLAGS_P) == 0)
+            return result;
+
+        result.rw = result.rw && (pte & PTE_FLAGS_RW) != 0;
+        result.us = result.us && (pte & PTE_FLAGS_US) != 0;
+        result.nx = result.nx || (pte & PTE_FLAGS_NX) != 0;
+
+        phys = pte & PTE_PHYS_ADDR_MASK;
+
+        // A PML4 entry cannot map a page, so the PS bit is only looked at
+        // in the PDPT and the PD. In the PT, this bit is the PAT bit.
+
+        if (bits == PT_INDEX || (bits != PML4_INDEX && (pte & PTE_FLAGS_PS) != 0))
+        {
+            auto page_size = 1ULL << bits;
+
+            result.present = true;
+            result.page_size = page_size;
+            result.phys = (phys & ~(page_size - 1)) | (virt & (page_size - 1));
+
+            return result;
+        }
+    }
+
+    return result;
+}
+
+const uintptr_t *
+page_walker_x64::table(uintptr_t phys) const
+{
+    return static_cast<const uintptr_t *>(g_mm->phys_to_virt_ptr(phys));
+}
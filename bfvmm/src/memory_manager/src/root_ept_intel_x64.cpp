@@ -0,0 +1,463 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <gsl/gsl>
+
+#include <algorithm>
+
+#include <constants.h>
+#include <error_codes.h>
+#include <guard_exceptions.h>
+#include <memory_manager/object_pool.h>
+#include <memory_manager/root_ept_intel_x64.h>
+
+root_ept_intel_x64::root_ept_intel_x64(std::shared_ptr<intrinsics_intel_x64> intrinsics) :
+    m_intrinsics(std::move(intrinsics)),
+    m_enabled(false),
+    m_eptp(0),
+    m_max_page_size(PAGE_SIZE_2M),
+    m_identity_map_size(EPT_IDENTITY_MAP_SIZE),
+    m_accessed_dirty(false),
+    m_generation(0),
+    m_harvest_gpa(0),
+    m_retired_generation(0)
+{
+    if (!m_intrinsics)
+        m_intrinsics = std::make_shared<intrinsics_intel_x64>();
+}
+
+root_ept_intel_x64 *
+root_ept_intel_x64::instance() noexcept
+{
+    static root_ept_intel_x64 self;
+    return &self;
+}
+
+void
+root_ept_intel_x64::enable() noexcept
+{
+    m_enabled.store(true, std::memory_order_release);
+}
+
+bool
+root_ept_intel_x64::is_enabled() const noexcept
+{
+    return m_enabled.load(std::memory_order_acquire);
+}
+
+uint64_t
+root_ept_intel_x64::eptp()
+{
+    auto eptp = m_eptp.load(std::memory_order_acquire);
+
+    if (eptp != 0)
+        return eptp;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (m_pml4)
+        return m_eptp.load(std::memory_order_relaxed);
+
+    // With EPT on, the MTRRs are ignored, and the EPT's memory type takes
+    // their place, so each part of the identity map gets the type that the
+    // MTRRs give it. The ignore PAT bit is not set, so the guest's PAT is
+    // still combined with that type (e.g. MMIO that is only UC because of
+    // an MTRR stays UC, even if the host OS maps it as WB).
+
+    auto pml4 = make_pooled<ept_intel_x64>();
+    auto ranges = this->memory_type_ranges(m_identity_map_size.load(std::memory_order_relaxed));
+
+    for (const auto &range : ranges)
+    {
+        pml4->map_range(range.gpa, range.gpa, range.size,
+                        EPTE_FLAGS_RWX | EPTE_MEMORY_TYPE(range.type),
+                        m_max_page_size.load(std::memory_order_relaxed));
+    }
+
+    m_pml4 = pml4;
+
+    eptp = pml4->phys_addr() | EPTP_PAGE_WALK_LENGTH_4 | EPT_MEMORY_TYPE_WB;
+
+    if (m_accessed_dirty.load(std::memory_order_relaxed))
+        eptp |= EPTP_ACCESSED_DIRTY_FLAGS_ENABLED;
+
+    m_eptp.store(eptp, std::memory_order_release);
+
+    return eptp;
+}
+
+void
+root_ept_intel_x64::set_max_page_size(uint64_t max_page_size)
+{
+    switch (max_page_size)
+    {
+        case PAGE_SIZE_2M:
+        case PAGE_SIZE_1G:
+            m_max_page_size.store(max_page_size, std::memory_order_relaxed);
+            break;
+
+        default:
+            throw std::invalid_argument("set_max_page_size: invalid max_page_size");
+    }
+}
+
+void
+root_ept_intel_x64::set_identity_map_size(uint64_t size)
+{
+    if (size == 0 || (size & (PAGE_SIZE_2M - 1)) != 0 || size > (0x1ULL << 48))
+        throw std::invalid_argument("set_identity_map_size: invalid size");
+
+    m_identity_map_size.store(size, std::memory_order_relaxed);
+}
+
+void
+root_ept_intel_x64::enable_accessed_dirty() noexcept
+{
+    m_accessed_dirty.store(true, std::memory_order_relaxed);
+}
+
+void
+root_ept_intel_x64::attach(std::atomic<uint64_t> *acked)
+{
+    if (acked == nullptr)
+        throw std::invalid_argument("attach: acked == nullptr");
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_vcpus.push_back(acked);
+}
+
+void
+root_ept_intel_x64::detach(std::atomic<uint64_t> *acked) noexcept
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    for (auto iter = m_vcpus.begin(); iter != m_vcpus.end(); ++iter)
+    {
+        if (*iter == acked)
+        {
+            m_vcpus.erase(iter);
+            return;
+        }
+    }
+}
+
+void
+root_ept_intel_x64::protect_range(uintptr_t gpa, uint64_t size, uint64_t attrs)
+{
+    this->eptp();
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    this->free_retired();
+
+    auto fa1 = gsl::finally([&]
+    { m_retired_generation = m_generation.fetch_add(1, std::memory_order_release) + 1; });
+
+    m_pml4->protect_range(gpa, size, attrs, m_max_page_size.load(std::memory_order_relaxed));
+}
+
+void
+root_ept_intel_x64::harvest_dirty(struct dirty_bitmap *bitmap)
+{
+    if (bitmap == nullptr)
+        throw std::invalid_argument("harvest_dirty: bitmap == nullptr");
+
+    if ((this->eptp() & EPTP_ACCESSED_DIRTY_FLAGS_ENABLED) == 0)
+        throw std::logic_error("harvest_dirty: accessed and dirty flags are not enabled");
+
+    auto generation = 0ULL;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        this->free_retired();
+
+        auto total_size = m_identity_map_size.load(std::memory_order_relaxed);
+        auto window_size = DIRTY_BITMAP_NUM_WORDS * 64 * EPT_DIRTY_BITMAP_GRANULARITY;
+
+        if (m_harvest_gpa >= total_size)
+            m_harvest_gpa = 0;
+
+        auto gpa = m_harvest_gpa;
+        auto size = total_size - gpa < window_size ? total_size - gpa : window_size;
+
+        *bitmap = {};
+        bitmap->gpa = gpa;
+        bitmap->size = size;
+        bitmap->total_size = total_size;
+        bitmap->granularity = EPT_DIRTY_BITMAP_GRANULARITY;
+        bitmap->synchronized = 1;
+
+        auto cleared = m_pml4->harvest_dirty(gpa, size, bitmap->bitmap, EPT_DIRTY_BITMAP_GRANULARITY);
+
+        if (cleared != 0)
+            generation = m_generation.fetch_add(1, std::memory_order_release) + 1;
+
+        m_harvest_gpa = gpa + size;
+    }
+
+    if (generation != 0 && !this->synchronize(generation))
+        bitmap->synchronized = 0;
+}
+
+uint64_t
+root_ept_intel_x64::generation() const noexcept
+{
+    return m_generation.load(std::memory_order_acquire);
+}
+
+uint64_t
+root_ept_intel_x64::num_tables()
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_pml4 ? m_pml4->num_tables() : 0;
+}
+
+// The fixed MTRRs cover the first 1MB of memory: 8 MSRs with 8 ranges each,
+// 64KB ranges in the first MSR, 16KB ranges in the next 2, and 4KB ranges
+// in the last 8.
+
+static const uint64_t g_fixed_mtrr_end = 0x100000;
+
+static uint64_t
+fixed_mtrr(uint64_t addr) noexcept
+{
+    if (addr < 0x80000)
+        return (addr >> 16) & 0x7;
+
+    if (addr < 0xC0000)
+        return 8 + ((addr - 0x80000) >> 14);
+
+    return 24 + ((addr - 0xC0000) >> 12);
+}
+
+static uint32_t
+fixed_mtrr_msr(uint64_t index) noexcept
+{
+    if (index < 8)
+        return IA32_MTRR_FIX64K_00000_MSR;
+
+    if (index < 24)
+        return static_cast<uint32_t>(IA32_MTRR_FIX16K_80000_MSR + ((index - 8) >> 3));
+
+    return static_cast<uint32_t>(IA32_MTRR_FIX4K_C0000_MSR + ((index - 24) >> 3));
+}
+
+static uint64_t
+fixed_mtrr_size(uint64_t index) noexcept
+{
+    if (index < 8)
+        return 0x10000;
+
+    return index < 24 ? 0x4000 : 0x1000;
+}
+
+static uint64_t
+valid_memory_type(uint64_t type) noexcept
+{
+    switch (type)
+    {
+        case EPT_MEMORY_TYPE_UC:
+        case EPT_MEMORY_TYPE_WC:
+        case EPT_MEMORY_TYPE_WT:
+        case EPT_MEMORY_TYPE_WP:
+        case EPT_MEMORY_TYPE_WB:
+            return type;
+
+        default:
+            return EPT_MEMORY_TYPE_UC;
+    }
+}
+
+static bool
+write_through_or_back(uint64_t type) noexcept
+{ return type == EPT_MEMORY_TYPE_WT || type == EPT_MEMORY_TYPE_WB; }
+
+std::vector<root_ept_intel_x64::memory_type_range>
+root_ept_intel_x64::memory_type_ranges(uint64_t size) const
+{
+    struct variable_mtrr
+    {
+        uint64_t base;
+        uint64_t mask;
+        uint64_t type;
+    };
+
+    std::vector<memory_type_range> ranges;
+
+    auto def_type = m_intrinsics->read_msr(IA32_MTRR_DEF_TYPE_MSR);
+
+    if ((def_type & IA32_MTRR_DEF_TYPE_E) == 0)
+    {
+        ranges.push_back({0, size, EPT_MEMORY_TYPE_UC});
+        return ranges;
+    }
+
+    auto mtrrcap = m_intrinsics->read_msr(IA32_MTRRCAP_MSR);
+    auto fixed = (mtrrcap & IA32_MTRRCAP_FIX) != 0 && (def_type & IA32_MTRR_DEF_TYPE_FE) != 0;
+
+    std::vector<variable_mtrr> mtrrs;
+    std::vector<uint64_t> bounds = {0, size};
+
+    for (auto i = 0U; i < (mtrrcap & IA32_MTRRCAP_VCNT); i++)
+    {
+        auto mask = m_intrinsics->read_msr(IA32_MTRR_PHYSMASK0_MSR + (i << 1));
+
+        if ((mask & IA32_MTRR_PHYSMASK_VALID) == 0)
+            continue;
+
+        auto base = m_intrinsics->read_msr(IA32_MTRR_PHYSBASE0_MSR + (i << 1));
+
+        // A variable MTRR whose mask is not contiguous covers more than
+        // one range, which no OS uses, so it is not supported.
+
+        mask &= IA32_MTRR_PHYS_ADDR_MASK;
+        auto range_size = mask & ~(mask - 1);
+        auto ones = mask | (range_size - 1);
+
+        if (mask == 0 || (ones & (ones + 1)) != 0)
+            throw std::runtime_error("eptp: variable MTRR mask is not contiguous");
+
+        auto from = base & mask;
+
+        mtrrs.push_back({from, mask, valid_memory_type(base & IA32_MTRR_PHYSBASE_TYPE)});
+        bounds.push_back(from);
+        bounds.push_back(from + range_size);
+    }
+
+    if (fixed)
+    {
+        for (auto addr = 0ULL; addr < g_fixed_mtrr_end; addr += fixed_mtrr_size(fixed_mtrr(addr)))
+            bounds.push_back(addr);
+
+        bounds.push_back(g_fixed_mtrr_end);
+    }
+
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    // Each range between two bounds has a single memory type. Where more
+    // than one variable MTRR applies, UC wins, WT wins over WB, and any
+    // other combination is undefined, so UC is used.
+
+    for (auto i = 1U; i < bounds.size() && bounds[i - 1] < size; i++)
+    {
+        auto from = bounds[i - 1];
+        auto to = bounds[i] < size ? bounds[i] : size;
+        auto type = valid_memory_type(def_type & IA32_MTRR_DEF_TYPE_TYPE);
+
+        if (fixed && from < g_fixed_mtrr_end)
+        {
+            auto index = fixed_mtrr(from);
+            auto msr = m_intrinsics->read_msr(fixed_mtrr_msr(index));
+
+            type = valid_memory_type((msr >> ((index & 0x7) << 3)) & 0xFF);
+        }
+        else
+        {
+            auto found = false;
+
+            for (const auto &mtrr : mtrrs)
+            {
+                if ((from & mtrr.mask) != mtrr.base)
+                    continue;
+
+                if (!found || type == mtrr.type)
+                    type = mtrr.type;
+                else if (write_through_or_back(type) && write_through_or_back(mtrr.type))
+                    type = EPT_MEMORY_TYPE_WT;
+                else
+                    type = EPT_MEMORY_TYPE_UC;
+
+                found = true;
+            }
+        }
+
+        if (!ranges.empty() && ranges.back().type == type)
+            ranges.back().size += to - from;
+        else
+            ranges.push_back({from, to - from, type});
+    }
+
+    return ranges;
+}
+
+bool
+root_ept_intel_x64::acknowledged(uint64_t generation) const noexcept
+{
+    for (const auto &acked : m_vcpus)
+    {
+        if (acked->load(std::memory_order_acquire) < generation)
+            return false;
+    }
+
+    return true;
+}
+
+bool
+root_ept_intel_x64::synchronize(uint64_t generation)
+{
+    // The lock is only held while checking, so that vCPUs can attach and
+    // detach while we wait. There is no way to interrupt a vCPU that is
+    // running the guest, but CPUID always exits, so this core acknowledges
+    // the new generation after the first check. Every other vCPU does so
+    // the next time it exits, which, on a core that is idle, might not
+    // happen before we give up.
+
+    for (auto i = 0ULL; i < EPT_HARVEST_SYNC_ATTEMPTS; i++)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if (this->acknowledged(generation))
+                return true;
+        }
+
+        m_intrinsics->cpuid_eax(0);
+    }
+
+    return false;
+}
+
+void
+root_ept_intel_x64::free_retired() noexcept
+{
+    // Tables that were retired while a newer modification was pending
+    // simply wait for that modification to be acknowledged as well, so a
+    // single generation is enough to track all of them.
+
+    if (!m_pml4 || m_pml4->num_retired() == 0)
+        return;
+
+    if (this->acknowledged(m_retired_generation))
+        m_pml4->free_retired();
+}
+
+extern "C" int64_t
+get_dirty_bitmap(struct dirty_bitmap *bitmap) noexcept
+{
+    return guard_exceptions(MEMORY_MANAGER_FAILURE, [&]()
+    {
+        g_ept->harvest_dirty(bitmap);
+        return MEMORY_MANAGER_SUCCESS;
+    });
+}
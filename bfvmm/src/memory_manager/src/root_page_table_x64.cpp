@@ -0,0 +1,125 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <memory_manager/object_pool.h>
+#include <memory_manager/root_page_table_x64.h>
+
+root_page_table_x64::root_page_table_x64() noexcept :
+    m_cr3(0),
+    m_max_page_size(PAGE_SIZE_2M),
+    m_generation(0)
+{
+}
+
+root_page_table_x64::~root_page_table_x64()
+{
+    if (m_pml4)
+        g_mm->set_range_listener(nullptr);
+}
+
+root_page_table_x64 *
+root_page_table_x64::instance() noexcept
+{
+    static root_page_table_x64 self;
+    return &self;
+}
+
+uintptr_t
+root_page_table_x64::cr3()
+{
+    auto cr3 = m_cr3.load(std::memory_order_acquire);
+
+    if (cr3 != 0)
+        return cr3;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (m_pml4)
+        return m_cr3.load(std::memory_order_relaxed);
+
+    // The PML4 is only stored once the listener has been registered (which
+    // maps all of the memory that has been added so far), so that if
+    // something goes wrong, the next call starts over with a new PML4.
+
+    auto pml4 = make_pooled<page_table_x64>();
+
+    m_pml4 = pml4;
+
+    try
+    {
+        g_mm->set_range_listener(this);
+    }
+    catch (...)
+    {
+        m_pml4.reset();
+        throw;
+    }
+
+    cr3 = pml4->phys_addr();
+    m_cr3.store(cr3, std::memory_order_release);
+
+    return cr3;
+}
+
+void
+root_page_table_x64::set_max_page_size(uint64_t max_page_size)
+{
+    switch (max_page_size)
+    {
+        case PAGE_SIZE_4K:
+        case PAGE_SIZE_2M:
+        case PAGE_SIZE_1G:
+            m_max_page_size.store(max_page_size, std::memory_order_relaxed);
+            break;
+
+        default:
+            throw std::invalid_argument("set_max_page_size: invalid max_page_size");
+    }
+}
+
+void
+root_page_table_x64::ranges_added(const memory_range *ranges, int64_t num)
+{
+    // Memory that is re-added replaces the existing mappings, just like
+    // it replaces the existing ranges in the memory manager. Other cores
+    // might be using these page tables, so the mappings are replaced in
+    // place (never unmapped), and the generation is bumped so that each
+    // core flushes it's TLB before it uses them again.
+
+    auto max_page_size = m_max_page_size.load(std::memory_order_relaxed);
+
+    for (auto i = 0LL; i < num; i++)
+    {
+        const auto &range = ranges[i];
+        auto attrs = PTE_FLAGS_P;
+
+        if ((range.type & MEMORY_TYPE_W) != 0)
+            attrs |= PTE_FLAGS_RW;
+
+        if ((range.type & MEMORY_TYPE_E) == 0)
+            attrs |= PTE_FLAGS_NX;
+
+        m_pml4->remap_range(range.from, range.to, range.size, attrs, max_page_size);
+    }
+
+    m_generation.fetch_add(1, std::memory_order_release);
+}
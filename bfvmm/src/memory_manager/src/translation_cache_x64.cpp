@@ -0,0 +1,95 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <memory_manager/translation_cache_x64.h>
+
+static_assert((TRANSLATION_CACHE_SIZE & (TRANSLATION_CACHE_SIZE - 1)) == 0,
+              "TRANSLATION_CACHE_SIZE must be a power of 2");
+
+translation_cache_x64::translation_cache_x64(std::shared_ptr<page_walker_x64> walker) :
+    m_walker(std::move(walker)),
+    m_generation(1),
+    m_entries(),
+    m_hits(0),
+    m_misses(0)
+{
+    if (!m_walker)
+        m_walker = std::make_shared<page_walker_x64>();
+}
+
+page_walk_x64
+translation_cache_x64::translate(uintptr_t cr3, uintptr_t virt)
+{
+    auto page = virt & ~(PAGE_SIZE_4K - 1);
+    auto offset = virt & (PAGE_SIZE_4K - 1);
+    auto &entry = m_entries[(page >> PT_INDEX) & (TRANSLATION_CACHE_SIZE - 1)];
+
+    if (entry.generation == m_generation && entry.cr3 == cr3 && entry.virt == page)
+    {
+        auto walk = entry.walk;
+        walk.phys |= offset;
+
+        m_hits++;
+        return walk;
+    }
+
+    m_misses++;
+
+    auto walk = m_walker->walk(cr3, page);
+
+    if (!walk.present)
+        return walk;
+
+    entry.generation = m_generation;
+    entry.cr3 = cr3;
+    entry.virt = page;
+    entry.walk = walk;
+
+    walk.phys |= offset;
+    return walk;
+}
+
+void
+translation_cache_x64::flush() noexcept
+{
+    m_generation++;
+}
+
+void
+translation_cache_x64::flush(uintptr_t cr3) noexcept
+{
+    for (auto &entry : m_entries)
+    {
+        if (entry.cr3 == cr3)
+            entry.generation = 0;
+    }
+}
+
+void
+translation_cache_x64::flush(uintptr_t cr3, uintptr_t virt) noexcept
+{
+    auto page = virt & ~(PAGE_SIZE_4K - 1);
+    auto &entry = m_entries[(page >> PT_INDEX) & (TRANSLATION_CACHE_SIZE - 1)];
+
+    if (entry.cr3 == cr3 && entry.virt == page)
+        entry.generation = 0;
+}
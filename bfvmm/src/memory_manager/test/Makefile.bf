@@ -34,7 +34,7 @@ TARGET_COMPILER:=native
 NATIVE_CCFLAGS+=
 NATIVE_CXXFLAGS+=
 NATIVE_ASMFLAGS+=
-NATIVE_LDFLAGS+=
+NATIVE_LDFLAGS+=-pthread
 NATIVE_ARFLAGS+=
 NATIVE_DEFINES+=
 
@@ -53,6 +53,14 @@ SOURCES+=test.cpp
 SOURCES+=test_memory_manager.cpp
 SOURCES+=test_page_table_x64.cpp
 SOURCES+=test_page_table_entry_x64.cpp
+SOURCES+=test_root_page_table_x64.cpp
+SOURCES+=test_page_walker_x64.cpp
+SOURCES+=test_dirty_ring_x64.cpp
+SOURCES+=test_ept_intel_x64.cpp
+SOURCES+=test_ept_entry_intel_x64.cpp
+SOURCES+=test_root_ept_intel_x64.cpp
+SOURCES+=test_memory_range_index.cpp
+SOURCES+=test_object_pool.cpp
 HEADERS=
 
 INCLUDE_PATHS+=./
@@ -60,6 +68,7 @@ INCLUDE_PATHS+=%HYPER_ABS%/include/
 INCLUDE_PATHS+=%HYPER_ABS%/bfvmm/include/
 
 LIBS+=memory_manager
+LIBS+=intrinsics
 
 LIBRARY_PATHS+=%BUILD_REL%/../bin/native/
 
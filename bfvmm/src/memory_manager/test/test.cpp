@@ -90,6 +90,8 @@ memory_manager_ut::list()
     this->test_memory_manager_malloc_heap_sparse_fragments();
     this->test_memory_manager_malloc_heap_massive();
     this->test_memory_manager_malloc_heap_resize_fragments();
+    this->test_memory_manager_malloc_heap_coalesce_neighbours();
+    this->test_memory_manager_malloc_heap_fragmented_latency();
     this->test_memory_manager_malloc_page_valid();
     this->test_memory_manager_multiple_malloc_page_should_be_contiguous();
     this->test_memory_manager_malloc_page_free_malloc();
@@ -101,6 +103,22 @@ memory_manager_ut::list()
     this->test_memory_manager_malloc_page_sparse_fragments();
     this->test_memory_manager_malloc_page_resize_fragments();
     this->test_memory_manager_malloc_page_alignment();
+    this->test_memory_manager_malloc_page_natural_alignment();
+    this->test_memory_manager_malloc_page_non_power_of_two();
+    this->test_memory_manager_malloc_page_large_aligned_after_fragmentation();
+    this->test_memory_manager_add_pool_invalid();
+    this->test_memory_manager_add_pool_success();
+    this->test_memory_manager_add_pool_max_pools();
+    this->test_memory_manager_malloc_heap_spills_into_page_pool();
+    this->test_memory_manager_realloc_null_and_zero();
+    this->test_memory_manager_realloc_heap_grow_in_place();
+    this->test_memory_manager_realloc_heap_grow_moves();
+    this->test_memory_manager_realloc_page();
+    this->test_memory_manager_calloc();
+    this->test_memory_manager_calloc_zeroed_pages();
+    this->test_memory_manager_stats_heap();
+    this->test_memory_manager_stats_page();
+    this->test_memory_manager_stats_failed_allocs();
     this->test_memory_manager_add_md_no_exceptions();
     this->test_memory_manager_add_md_invalid_md();
     this->test_memory_manager_add_md_invalid_virt();
@@ -108,18 +126,34 @@ memory_manager_ut::list()
     this->test_memory_manager_add_md_invalid_type();
     this->test_memory_manager_add_md_unaligned_physical();
     this->test_memory_manager_add_md_unaligned_virtual();
+    this->test_memory_manager_add_mdl_no_exceptions();
+    this->test_memory_manager_add_mdl_invalid_mdl();
+    this->test_memory_manager_add_mdl_invalid_md();
+    this->test_memory_manager_add_mdl_success();
+    this->test_memory_manager_add_mdl_coalesces_ranges();
+    this->test_memory_manager_range_listener_existing_ranges();
+    this->test_memory_manager_range_listener_add_mdl();
+    this->test_memory_manager_range_listener_throws();
     this->test_memory_manager_virt_to_phys_unknown();
     this->test_memory_manager_phys_to_virt_unknown();
     this->test_memory_manager_virt_to_phys_random_address();
     this->test_memory_manager_virt_to_phys_nullptr();
     this->test_memory_manager_virt_to_phys_upper_limit();
     this->test_memory_manager_virt_to_phys_lower_limit();
-    this->test_memory_manager_virt_to_phys_map();
+    this->test_memory_manager_virt_to_phys_ranges();
     this->test_memory_manager_phys_to_virt_random_address();
     this->test_memory_manager_phys_to_virt_nullptr();
     this->test_memory_manager_phys_to_virt_upper_limit();
     this->test_memory_manager_phys_to_virt_lower_limit();
-    this->test_memory_manager_phys_to_virt_map();
+    this->test_memory_manager_phys_to_virt_ranges();
+    this->test_memory_manager_magazine_malloc_free_malloc();
+    this->test_memory_manager_magazine_refill_is_batched();
+    this->test_memory_manager_magazine_free_twice();
+    this->test_memory_manager_magazine_large_malloc_bypasses_magazine();
+    this->test_memory_manager_magazine_overflow_returns_batch();
+    this->test_memory_manager_magazine_all_memory_fragmented();
+    this->test_memory_manager_magazine_scaling();
+    this->test_memory_manager_magazine_concurrent_heap();
 
     this->test_page_table_x64_no_entry();
     this->test_page_table_x64_with_entry();
@@ -130,6 +164,65 @@ memory_manager_ut::list()
     this->test_page_table_x64_add_page_twice_failure();
     this->test_page_table_x64_table_phys_addr_success();
     this->test_page_table_x64_table_phys_addr_failure();
+    this->test_page_table_x64_add_page_2m_success();
+    this->test_page_table_x64_add_page_1g_success();
+    this->test_page_table_x64_add_large_page_unaligned_failure();
+    this->test_page_table_x64_add_large_page_overlap_failure();
+    this->test_page_table_x64_add_page_entry_view();
+    this->test_page_table_x64_num_tables();
+    this->test_page_table_x64_map_range_success();
+    this->test_page_table_x64_map_range_large_pages();
+    this->test_page_table_x64_map_range_invalid();
+    this->test_page_table_x64_map_range_overlap_failure();
+    this->test_page_table_x64_remap_range_success();
+    this->test_page_table_x64_remap_range_invalid();
+    this->test_page_table_x64_unmap_range_success();
+    this->test_page_table_x64_unmap_range_split_1g();
+    this->test_page_table_x64_unmap_range_invalid();
+
+    this->test_root_page_table_x64_cr3_success();
+    this->test_root_page_table_x64_cr3_parallel();
+    this->test_root_page_table_x64_cr3_failure();
+    this->test_root_page_table_x64_ranges_added();
+    this->test_root_page_table_x64_set_max_page_size();
+
+    this->test_ept_intel_x64_no_entry();
+    this->test_ept_intel_x64_map_range_success();
+    this->test_ept_intel_x64_map_range_invalid();
+    this->test_ept_intel_x64_unmap_range_success();
+    this->test_ept_intel_x64_protect_range_split();
+    this->test_ept_intel_x64_protect_range_merge();
+    this->test_ept_intel_x64_protect_range_no_merge();
+    this->test_ept_intel_x64_protect_range_invalid();
+    this->test_ept_intel_x64_harvest_dirty_large_pages();
+    this->test_ept_intel_x64_harvest_dirty_split();
+    this->test_ept_intel_x64_harvest_dirty_partial();
+    this->test_ept_intel_x64_harvest_dirty_merge();
+    this->test_ept_intel_x64_harvest_dirty_invalid();
+
+    this->test_root_ept_intel_x64_enable();
+    this->test_root_ept_intel_x64_eptp_success();
+    this->test_root_ept_intel_x64_eptp_parallel();
+    this->test_root_ept_intel_x64_eptp_mtrrs();
+    this->test_root_ept_intel_x64_protect_range();
+    this->test_root_ept_intel_x64_protect_range_retire();
+    this->test_root_ept_intel_x64_invalid_settings();
+    this->test_root_ept_intel_x64_harvest_dirty();
+    this->test_root_ept_intel_x64_harvest_dirty_disabled();
+    this->test_root_ept_intel_x64_harvest_dirty_synchronized();
+
+    this->test_page_walker_x64_walk_4k();
+    this->test_page_walker_x64_walk_large_pages();
+    this->test_page_walker_x64_walk_not_present();
+    this->test_page_walker_x64_walk_unknown_table();
+    this->test_translation_cache_x64_hits();
+    this->test_translation_cache_x64_tagged_by_cr3();
+    this->test_translation_cache_x64_flush();
+
+    this->test_dirty_ring_x64_invalid_size();
+    this->test_dirty_ring_x64_push_pop();
+    this->test_dirty_ring_x64_full();
+    this->test_dirty_ring_x64_concurrent();
 
     this->test_page_table_entry_x64_present();
     this->test_page_table_entry_x64_rw();
@@ -143,6 +236,34 @@ memory_manager_ut::list()
     this->test_page_table_entry_x64_nx();
     this->test_page_table_entry_x64_phys_addr();
 
+    this->test_ept_entry_intel_x64_read_access();
+    this->test_ept_entry_intel_x64_write_access();
+    this->test_ept_entry_intel_x64_execute_access();
+    this->test_ept_entry_intel_x64_memory_type();
+    this->test_ept_entry_intel_x64_ignore_pat();
+    this->test_ept_entry_intel_x64_ps();
+    this->test_ept_entry_intel_x64_accessed();
+    this->test_ept_entry_intel_x64_dirty();
+    this->test_ept_entry_intel_x64_phys_addr();
+
+    this->test_memory_range_index_lookup_unmapped();
+    this->test_memory_range_index_lookup_success();
+    this->test_memory_range_index_insert_invalid();
+    this->test_memory_range_index_insert_replace();
+    this->test_memory_range_index_insert_merges();
+    this->test_memory_range_index_insert_last_wins();
+    this->test_memory_range_index_remove();
+    this->test_memory_range_index_remove_splits();
+    this->test_memory_range_index_upper_half();
+    this->test_memory_range_index_concurrent_lookup();
+    this->test_memory_range_index_benchmark();
+
+    this->test_object_pool_slot_size();
+    this->test_object_pool_reuse();
+    this->test_object_pool_refill();
+    this->test_object_pool_allocator();
+    this->test_object_pool_page_tables();
+
     return true;
 }
 
@@ -58,6 +58,8 @@ private:
     void test_memory_manager_malloc_heap_sparse_fragments();
     void test_memory_manager_malloc_heap_massive();
     void test_memory_manager_malloc_heap_resize_fragments();
+    void test_memory_manager_malloc_heap_coalesce_neighbours();
+    void test_memory_manager_malloc_heap_fragmented_latency();
     void test_memory_manager_malloc_page_valid();
     void test_memory_manager_multiple_malloc_page_should_be_contiguous();
     void test_memory_manager_malloc_page_free_malloc();
@@ -69,6 +71,22 @@ private:
     void test_memory_manager_malloc_page_sparse_fragments();
     void test_memory_manager_malloc_page_resize_fragments();
     void test_memory_manager_malloc_page_alignment();
+    void test_memory_manager_malloc_page_natural_alignment();
+    void test_memory_manager_malloc_page_non_power_of_two();
+    void test_memory_manager_malloc_page_large_aligned_after_fragmentation();
+    void test_memory_manager_add_pool_invalid();
+    void test_memory_manager_add_pool_success();
+    void test_memory_manager_add_pool_max_pools();
+    void test_memory_manager_malloc_heap_spills_into_page_pool();
+    void test_memory_manager_realloc_null_and_zero();
+    void test_memory_manager_realloc_heap_grow_in_place();
+    void test_memory_manager_realloc_heap_grow_moves();
+    void test_memory_manager_realloc_page();
+    void test_memory_manager_calloc();
+    void test_memory_manager_calloc_zeroed_pages();
+    void test_memory_manager_stats_heap();
+    void test_memory_manager_stats_page();
+    void test_memory_manager_stats_failed_allocs();
     void test_memory_manager_add_md_no_exceptions();
     void test_memory_manager_add_md_invalid_md();
     void test_memory_manager_add_md_invalid_virt();
@@ -76,18 +94,34 @@ private:
     void test_memory_manager_add_md_invalid_type();
     void test_memory_manager_add_md_unaligned_physical();
     void test_memory_manager_add_md_unaligned_virtual();
+    void test_memory_manager_add_mdl_no_exceptions();
+    void test_memory_manager_add_mdl_invalid_mdl();
+    void test_memory_manager_add_mdl_invalid_md();
+    void test_memory_manager_add_mdl_success();
+    void test_memory_manager_add_mdl_coalesces_ranges();
+    void test_memory_manager_range_listener_existing_ranges();
+    void test_memory_manager_range_listener_add_mdl();
+    void test_memory_manager_range_listener_throws();
     void test_memory_manager_virt_to_phys_unknown();
     void test_memory_manager_phys_to_virt_unknown();
     void test_memory_manager_virt_to_phys_random_address();
     void test_memory_manager_virt_to_phys_nullptr();
     void test_memory_manager_virt_to_phys_upper_limit();
     void test_memory_manager_virt_to_phys_lower_limit();
-    void test_memory_manager_virt_to_phys_map();
+    void test_memory_manager_virt_to_phys_ranges();
     void test_memory_manager_phys_to_virt_random_address();
     void test_memory_manager_phys_to_virt_nullptr();
     void test_memory_manager_phys_to_virt_upper_limit();
     void test_memory_manager_phys_to_virt_lower_limit();
-    void test_memory_manager_phys_to_virt_map();
+    void test_memory_manager_phys_to_virt_ranges();
+    void test_memory_manager_magazine_malloc_free_malloc();
+    void test_memory_manager_magazine_refill_is_batched();
+    void test_memory_manager_magazine_free_twice();
+    void test_memory_manager_magazine_large_malloc_bypasses_magazine();
+    void test_memory_manager_magazine_overflow_returns_batch();
+    void test_memory_manager_magazine_all_memory_fragmented();
+    void test_memory_manager_magazine_scaling();
+    void test_memory_manager_magazine_concurrent_heap();
 
     void test_page_table_x64_no_entry();
     void test_page_table_x64_with_entry();
@@ -98,6 +132,65 @@ private:
     void test_page_table_x64_add_page_twice_failure();
     void test_page_table_x64_table_phys_addr_success();
     void test_page_table_x64_table_phys_addr_failure();
+    void test_page_table_x64_add_page_2m_success();
+    void test_page_table_x64_add_page_1g_success();
+    void test_page_table_x64_add_large_page_unaligned_failure();
+    void test_page_table_x64_add_large_page_overlap_failure();
+    void test_page_table_x64_add_page_entry_view();
+    void test_page_table_x64_num_tables();
+    void test_page_table_x64_map_range_success();
+    void test_page_table_x64_map_range_large_pages();
+    void test_page_table_x64_map_range_invalid();
+    void test_page_table_x64_map_range_overlap_failure();
+    void test_page_table_x64_remap_range_success();
+    void test_page_table_x64_remap_range_invalid();
+    void test_page_table_x64_unmap_range_success();
+    void test_page_table_x64_unmap_range_split_1g();
+    void test_page_table_x64_unmap_range_invalid();
+
+    void test_root_page_table_x64_cr3_success();
+    void test_root_page_table_x64_cr3_parallel();
+    void test_root_page_table_x64_cr3_failure();
+    void test_root_page_table_x64_ranges_added();
+    void test_root_page_table_x64_set_max_page_size();
+
+    void test_ept_intel_x64_no_entry();
+    void test_ept_intel_x64_map_range_success();
+    void test_ept_intel_x64_map_range_invalid();
+    void test_ept_intel_x64_unmap_range_success();
+    void test_ept_intel_x64_protect_range_split();
+    void test_ept_intel_x64_protect_range_merge();
+    void test_ept_intel_x64_protect_range_no_merge();
+    void test_ept_intel_x64_protect_range_invalid();
+    void test_ept_intel_x64_harvest_dirty_large_pages();
+    void test_ept_intel_x64_harvest_dirty_split();
+    void test_ept_intel_x64_harvest_dirty_partial();
+    void test_ept_intel_x64_harvest_dirty_merge();
+    void test_ept_intel_x64_harvest_dirty_invalid();
+
+    void test_root_ept_intel_x64_enable();
+    void test_root_ept_intel_x64_eptp_success();
+    void test_root_ept_intel_x64_eptp_parallel();
+    void test_root_ept_intel_x64_eptp_mtrrs();
+    void test_root_ept_intel_x64_protect_range();
+    void test_root_ept_intel_x64_protect_range_retire();
+    void test_root_ept_intel_x64_invalid_settings();
+    void test_root_ept_intel_x64_harvest_dirty();
+    void test_root_ept_intel_x64_harvest_dirty_disabled();
+    void test_root_ept_intel_x64_harvest_dirty_synchronized();
+
+    void test_page_walker_x64_walk_4k();
+    void test_page_walker_x64_walk_large_pages();
+    void test_page_walker_x64_walk_not_present();
+    void test_page_walker_x64_walk_unknown_table();
+    void test_translation_cache_x64_hits();
+    void test_translation_cache_x64_tagged_by_cr3();
+    void test_translation_cache_x64_flush();
+
+    void test_dirty_ring_x64_invalid_size();
+    void test_dirty_ring_x64_push_pop();
+    void test_dirty_ring_x64_full();
+    void test_dirty_ring_x64_concurrent();
 
     void test_page_table_entry_x64_present();
     void test_page_table_entry_x64_rw();
@@ -110,6 +203,34 @@ private:
     void test_page_table_entry_x64_global();
     void test_page_table_entry_x64_nx();
     void test_page_table_entry_x64_phys_addr();
+
+    void test_ept_entry_intel_x64_read_access();
+    void test_ept_entry_intel_x64_write_access();
+    void test_ept_entry_intel_x64_execute_access();
+    void test_ept_entry_intel_x64_memory_type();
+    void test_ept_entry_intel_x64_ignore_pat();
+    void test_ept_entry_intel_x64_ps();
+    void test_ept_entry_intel_x64_accessed();
+    void test_ept_entry_intel_x64_dirty();
+    void test_ept_entry_intel_x64_phys_addr();
+
+    void test_memory_range_index_lookup_unmapped();
+    void test_memory_range_index_lookup_success();
+    void test_memory_range_index_insert_invalid();
+    void test_memory_range_index_insert_replace();
+    void test_memory_range_index_insert_merges();
+    void test_memory_range_index_insert_last_wins();
+    void test_memory_range_index_remove();
+    void test_memory_range_index_remove_splits();
+    void test_memory_range_index_upper_half();
+    void test_memory_range_index_concurrent_lookup();
+    void test_memory_range_index_benchmark();
+
+    void test_object_pool_slot_size();
+    void test_object_pool_reuse();
+    void test_object_pool_refill();
+    void test_object_pool_allocator();
+    void test_object_pool_page_tables();
 };
 
 #endif
@@ -0,0 +1,126 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <test.h>
+#include <memory_manager/dirty_ring_x64.h>
+
+#include <thread>
+
+void
+memory_manager_ut::test_dirty_ring_x64_invalid_size()
+{
+    EXPECT_EXCEPTION(dirty_ring_x64(0), std::invalid_argument);
+    EXPECT_EXCEPTION(dirty_ring_x64(3), std::invalid_argument);
+    EXPECT_NO_EXCEPTION(dirty_ring_x64(4));
+}
+
+void
+memory_manager_ut::test_dirty_ring_x64_push_pop()
+{
+    dirty_ring_x64 ring(4);
+    uintptr_t gpa = 0;
+
+    EXPECT_TRUE(ring.capacity() == 4);
+    EXPECT_TRUE(ring.size() == 0);
+    EXPECT_FALSE(ring.pop(gpa));
+
+    EXPECT_TRUE(ring.push(0x1000));
+    EXPECT_TRUE(ring.push(0x2000));
+    EXPECT_TRUE(ring.size() == 2);
+
+    EXPECT_TRUE(ring.pop(gpa));
+    EXPECT_TRUE(gpa == 0x1000);
+    EXPECT_TRUE(ring.pop(gpa));
+    EXPECT_TRUE(gpa == 0x2000);
+    EXPECT_FALSE(ring.pop(gpa));
+
+    for (auto i = 0U; i < 10; i++)
+    {
+        EXPECT_TRUE(ring.push(i * 0x1000));
+        EXPECT_TRUE(ring.pop(gpa));
+        EXPECT_TRUE(gpa == i * 0x1000);
+    }
+
+    EXPECT_TRUE(ring.size() == 0);
+    EXPECT_TRUE(ring.drops() == 0);
+}
+
+void
+memory_manager_ut::test_dirty_ring_x64_full()
+{
+    dirty_ring_x64 ring(4);
+    uintptr_t gpa = 0;
+
+    for (auto i = 0U; i < 4; i++)
+        EXPECT_TRUE(ring.push(i * 0x1000));
+
+    EXPECT_FALSE(ring.push(0x4000));
+    EXPECT_FALSE(ring.push(0x5000));
+    EXPECT_TRUE(ring.size() == 4);
+    EXPECT_TRUE(ring.drops() == 2);
+
+    EXPECT_TRUE(ring.pop(gpa));
+    EXPECT_TRUE(gpa == 0);
+    EXPECT_TRUE(ring.push(0x6000));
+
+    for (auto expected : {0x1000U, 0x2000U, 0x3000U, 0x6000U})
+    {
+        EXPECT_TRUE(ring.pop(gpa));
+        EXPECT_TRUE(gpa == expected);
+    }
+
+    EXPECT_FALSE(ring.pop(gpa));
+}
+
+void
+memory_manager_ut::test_dirty_ring_x64_concurrent()
+{
+    dirty_ring_x64 ring(64);
+    const uintptr_t num = 100000;
+
+    auto producer = std::thread([&]
+    {
+        for (uintptr_t i = 1; i <= num; i++)
+            while (!ring.push(i));
+    });
+
+    auto in_order = true;
+    uintptr_t expected = 1;
+
+    while (expected <= num)
+    {
+        uintptr_t gpa = 0;
+
+        if (!ring.pop(gpa))
+            continue;
+
+        if (gpa != expected)
+            in_order = false;
+
+        expected++;
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_TRUE(ring.size() == 0);
+}
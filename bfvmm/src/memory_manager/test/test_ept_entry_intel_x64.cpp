@@ -0,0 +1,138 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <test.h>
+#include <memory_manager/ept_entry_intel_x64.h>
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_read_access()
+{
+    uintptr_t entry = 0;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_read_access(true);
+    EXPECT_TRUE(epte->read_access() == true);
+    epte->set_read_access(false);
+    EXPECT_TRUE(epte->read_access() == false);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_write_access()
+{
+    uintptr_t entry = 0;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_write_access(true);
+    EXPECT_TRUE(epte->write_access() == true);
+    epte->set_write_access(false);
+    EXPECT_TRUE(epte->write_access() == false);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_execute_access()
+{
+    uintptr_t entry = 0;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_execute_access(true);
+    EXPECT_TRUE(epte->execute_access() == true);
+    epte->set_execute_access(false);
+    EXPECT_TRUE(epte->execute_access() == false);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_memory_type()
+{
+    uintptr_t entry = EPTE_FLAGS_RWX;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_memory_type(EPT_MEMORY_TYPE_WB);
+    EXPECT_TRUE(epte->memory_type() == EPT_MEMORY_TYPE_WB);
+    epte->set_memory_type(EPT_MEMORY_TYPE_UC);
+    EXPECT_TRUE(epte->memory_type() == EPT_MEMORY_TYPE_UC);
+    EXPECT_TRUE(entry == EPTE_FLAGS_RWX);
+
+    EXPECT_EXCEPTION(epte->set_memory_type(2), std::invalid_argument);
+    EXPECT_EXCEPTION(epte->set_memory_type(7), std::invalid_argument);
+    EXPECT_TRUE(epte->memory_type() == EPT_MEMORY_TYPE_UC);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_ignore_pat()
+{
+    uintptr_t entry = 0;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_ignore_pat(true);
+    EXPECT_TRUE(epte->ignore_pat() == true);
+    epte->set_ignore_pat(false);
+    EXPECT_TRUE(epte->ignore_pat() == false);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_ps()
+{
+    uintptr_t entry = 0;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_ps(true);
+    EXPECT_TRUE(epte->ps() == true);
+    epte->set_ps(false);
+    EXPECT_TRUE(epte->ps() == false);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_accessed()
+{
+    uintptr_t entry = 0;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_accessed(true);
+    EXPECT_TRUE(epte->accessed() == true);
+    epte->set_accessed(false);
+    EXPECT_TRUE(epte->accessed() == false);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_dirty()
+{
+    uintptr_t entry = 0;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_dirty(true);
+    EXPECT_TRUE(epte->dirty() == true);
+    epte->set_dirty(false);
+    EXPECT_TRUE(epte->dirty() == false);
+}
+
+void
+memory_manager_ut::test_ept_entry_intel_x64_phys_addr()
+{
+    uintptr_t entry = EPTE_FLAGS_RWX;
+    auto epte = std::make_shared<ept_entry_intel_x64>(&entry);
+
+    epte->set_phys_addr(0x0000000ABCDEF0123);
+    EXPECT_TRUE(epte->phys_addr() == 0x0000000ABCDEF0000);
+    EXPECT_TRUE(epte->read_access() == true);
+    epte->set_phys_addr(0);
+    EXPECT_TRUE(epte->phys_addr() == 0);
+    EXPECT_TRUE(entry == EPTE_FLAGS_RWX);
+}
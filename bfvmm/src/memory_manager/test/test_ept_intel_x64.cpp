@@ -0,0 +1,483 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <test.h>
+#include <memory_manager/ept_intel_x64.h>
+#include <memory_manager/memory_manager.h>
+
+static uintptr_t
+virt_to_phys_ptr(void *ptr)
+{
+    (void) ptr;
+
+    return 0x0000000ABCDEF0000;
+}
+
+static const auto g_rwx_wb = EPTE_FLAGS_RWX | EPTE_MEMORY_TYPE(EPT_MEMORY_TYPE_WB);
+static const auto g_r_wb = EPTE_FLAGS_R | EPTE_MEMORY_TYPE(EPT_MEMORY_TYPE_WB);
+
+void
+memory_manager_ut::test_ept_intel_x64_no_entry()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<ept_intel_x64>();
+
+        EXPECT_TRUE(pml4->phys_addr() == 0x0000000ABCDEF0000);
+        EXPECT_TRUE(pml4->read_access() == true);
+        EXPECT_TRUE(pml4->write_access() == true);
+        EXPECT_TRUE(pml4->execute_access() == true);
+        EXPECT_TRUE(pml4->num_tables() == 1);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_map_range_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto size = PAGE_SIZE_1G + PAGE_SIZE_2M + PAGE_SIZE_4K;
+
+        auto pml4_1g = std::make_shared<ept_intel_x64>();
+        pml4_1g->map_range(0, 0, size, g_rwx_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4_1g->num_tables() == 4);
+
+        auto epte = pml4_1g->entry(PAGE_SIZE_1G - PAGE_SIZE_4K);
+        EXPECT_TRUE(epte.phys_addr() == 0);
+        EXPECT_TRUE(epte.ps() == true);
+        EXPECT_TRUE(epte.read_access() == true);
+        EXPECT_TRUE(epte.write_access() == true);
+        EXPECT_TRUE(epte.execute_access() == true);
+        EXPECT_TRUE(epte.memory_type() == EPT_MEMORY_TYPE_WB);
+
+        epte = pml4_1g->entry(PAGE_SIZE_1G + PAGE_SIZE_2M);
+        EXPECT_TRUE(epte.phys_addr() == PAGE_SIZE_1G + PAGE_SIZE_2M);
+        EXPECT_TRUE(epte.ps() == false);
+
+        auto pml4_2m = std::make_shared<ept_intel_x64>();
+        pml4_2m->map_range(0, 0, size, g_rwx_wb);
+        EXPECT_TRUE(pml4_2m->num_tables() == 5);
+        EXPECT_TRUE(pml4_2m->entry(PAGE_SIZE_2M + PAGE_SIZE_4K).phys_addr() == PAGE_SIZE_2M);
+
+        EXPECT_EXCEPTION(pml4_2m->entry(size), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4_2m->entry(0x0001000000000000), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_map_range_invalid()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<ept_intel_x64>();
+
+        EXPECT_EXCEPTION(pml4->map_range(0x10, 0, PAGE_SIZE_4K, g_rwx_wb), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0, 0x10, PAGE_SIZE_4K, g_rwx_wb), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0, 0, 0x10, g_rwx_wb), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0, 0, PAGE_SIZE_4K, EPTE_FLAGS_MAPPED), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0, 0, PAGE_SIZE_4K, g_rwx_wb, 0x10), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0x0000FFFFFFFFF000, 0, 2 * PAGE_SIZE_4K, g_rwx_wb), std::invalid_argument);
+
+        pml4->map_range(0, 0, PAGE_SIZE_2M, g_rwx_wb);
+        EXPECT_EXCEPTION(pml4->map_range(PAGE_SIZE_4K, 0, PAGE_SIZE_4K, g_rwx_wb), std::logic_error);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_unmap_range_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<ept_intel_x64>();
+
+        pml4->map_range(0, 0, PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 2);
+
+        pml4->unmap_range(PAGE_SIZE_4K, PAGE_SIZE_4K);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+        EXPECT_TRUE(pml4->num_retired() == 0);
+        EXPECT_EXCEPTION(pml4->entry(PAGE_SIZE_4K), std::invalid_argument);
+        EXPECT_TRUE(pml4->entry(0).phys_addr() == 0);
+        EXPECT_TRUE(pml4->entry(PAGE_SIZE_1G - PAGE_SIZE_4K).phys_addr() == PAGE_SIZE_1G - PAGE_SIZE_2M);
+
+        pml4->unmap_range(0, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 1);
+        EXPECT_TRUE(pml4->num_retired() == 3);
+
+        pml4->free_retired();
+        EXPECT_TRUE(pml4->num_retired() == 0);
+
+        EXPECT_EXCEPTION(pml4->unmap_range(0x10, PAGE_SIZE_4K), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->unmap_range(0x0000FFFFFFFFF000, 2 * PAGE_SIZE_4K), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_protect_range_split()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<ept_intel_x64>();
+        auto gpa = PAGE_SIZE_1G + PAGE_SIZE_2M + PAGE_SIZE_4K;
+
+        pml4->map_range(0, 0, 2 * PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 2);
+
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_r_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        auto epte = pml4->entry(gpa);
+        EXPECT_TRUE(epte.phys_addr() == gpa);
+        EXPECT_TRUE(epte.ps() == false);
+        EXPECT_TRUE(epte.read_access() == true);
+        EXPECT_TRUE(epte.write_access() == false);
+        EXPECT_TRUE(epte.execute_access() == false);
+
+        epte = pml4->entry(gpa - PAGE_SIZE_4K);
+        EXPECT_TRUE(epte.phys_addr() == gpa - PAGE_SIZE_4K);
+        EXPECT_TRUE(epte.write_access() == true);
+
+        epte = pml4->entry(gpa + PAGE_SIZE_2M);
+        EXPECT_TRUE(epte.phys_addr() == gpa + PAGE_SIZE_2M - PAGE_SIZE_4K);
+        EXPECT_TRUE(epte.ps() == true);
+        EXPECT_TRUE(epte.write_access() == true);
+
+        epte = pml4->entry(0);
+        EXPECT_TRUE(epte.ps() == true);
+        EXPECT_TRUE(epte.write_access() == true);
+
+        pml4->entry(0).set_dirty(true);
+        pml4->protect_range(0, PAGE_SIZE_1G, g_r_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+        EXPECT_TRUE(pml4->entry(0).write_access() == false);
+        EXPECT_TRUE(pml4->entry(0).dirty() == true);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_protect_range_merge()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<ept_intel_x64>();
+        auto gpa = PAGE_SIZE_1G + PAGE_SIZE_2M + PAGE_SIZE_4K;
+
+        pml4->map_range(0, 0, 2 * PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_r_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_rwx_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 2);
+        EXPECT_TRUE(pml4->num_retired() == 2);
+
+        pml4->free_retired();
+        EXPECT_TRUE(pml4->num_retired() == 0);
+
+        auto epte = pml4->entry(gpa);
+        EXPECT_TRUE(epte.phys_addr() == PAGE_SIZE_1G);
+        EXPECT_TRUE(epte.ps() == true);
+        EXPECT_TRUE(epte.write_access() == true);
+
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_r_wb, PAGE_SIZE_1G);
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_rwx_wb, PAGE_SIZE_2M);
+        EXPECT_TRUE(pml4->num_tables() == 3);
+        EXPECT_TRUE(pml4->entry(gpa).phys_addr() == PAGE_SIZE_1G + PAGE_SIZE_2M);
+        EXPECT_TRUE(pml4->entry(gpa).ps() == true);
+
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_r_wb, PAGE_SIZE_1G);
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_rwx_wb, PAGE_SIZE_4K);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+        EXPECT_TRUE(pml4->entry(gpa).phys_addr() == gpa);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_protect_range_no_merge()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4_unaligned = std::make_shared<ept_intel_x64>();
+
+        pml4_unaligned->map_range(0, PAGE_SIZE_4K, PAGE_SIZE_2M, g_rwx_wb);
+        EXPECT_TRUE(pml4_unaligned->num_tables() == 4);
+
+        pml4_unaligned->protect_range(0, PAGE_SIZE_2M, g_r_wb);
+        EXPECT_TRUE(pml4_unaligned->num_tables() == 4);
+        EXPECT_TRUE(pml4_unaligned->entry(0).write_access() == false);
+
+        auto pml4_partial = std::make_shared<ept_intel_x64>();
+
+        pml4_partial->map_range(0, 0, PAGE_SIZE_2M - PAGE_SIZE_4K, g_rwx_wb);
+        EXPECT_TRUE(pml4_partial->num_tables() == 4);
+
+        pml4_partial->protect_range(0, PAGE_SIZE_2M, g_r_wb);
+        EXPECT_TRUE(pml4_partial->num_tables() == 4);
+        EXPECT_EXCEPTION(pml4_partial->entry(PAGE_SIZE_2M - PAGE_SIZE_4K), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_protect_range_invalid()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<ept_intel_x64>();
+
+        EXPECT_EXCEPTION(pml4->protect_range(0x10, PAGE_SIZE_4K, g_r_wb), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->protect_range(0, 0x10, g_r_wb), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->protect_range(0, PAGE_SIZE_4K, EPTE_FLAGS_PS), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->protect_range(0, PAGE_SIZE_4K, g_r_wb, 0x10), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->protect_range(0x0000FFFFFFFFF000, 2 * PAGE_SIZE_4K, g_r_wb), std::invalid_argument);
+
+        pml4->protect_range(0, PAGE_SIZE_2M, g_r_wb);
+        EXPECT_TRUE(pml4->num_tables() == 1);
+    });
+}
+
+static uint64_t
+num_dirty(gsl::span<uint64_t> bitmap)
+{
+    auto num = 0ULL;
+
+    for (auto word : bitmap)
+        num += static_cast<uint64_t>(__builtin_popcountll(word));
+
+    return num;
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_harvest_dirty_large_pages()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        uintptr_t pml4e = 0;
+        uint64_t bitmap[16] = {};
+
+        auto pdpt = std::make_shared<ept_intel_x64>(&pml4e, PDPT_INDEX);
+        pdpt->map_range(0, 0, 2 * PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, 2 * PAGE_SIZE_1G, bitmap, PAGE_SIZE_2M) == 0);
+        EXPECT_TRUE(num_dirty(bitmap) == 0);
+
+        pdpt->entry(PAGE_SIZE_1G).set_accessed(true);
+        pdpt->entry(PAGE_SIZE_1G).set_dirty(true);
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, 2 * PAGE_SIZE_1G, bitmap, PAGE_SIZE_2M) == 1);
+        EXPECT_TRUE(num_dirty(bitmap) == 512);
+        EXPECT_TRUE(bitmap[7] == 0);
+        EXPECT_TRUE(bitmap[8] == ~0ULL);
+        EXPECT_TRUE(bitmap[15] == ~0ULL);
+        EXPECT_TRUE(pdpt->entry(PAGE_SIZE_1G).accessed() == false);
+        EXPECT_TRUE(pdpt->entry(PAGE_SIZE_1G).dirty() == false);
+
+        uint64_t bitmap_clean[16] = {};
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, 2 * PAGE_SIZE_1G, bitmap_clean, PAGE_SIZE_2M) == 0);
+        EXPECT_TRUE(num_dirty(bitmap_clean) == 0);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_harvest_dirty_split()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        uintptr_t pml4e = 0;
+        uint64_t bitmap[8] = {};
+
+        auto pdpt = std::make_shared<ept_intel_x64>(&pml4e, PDPT_INDEX);
+        pdpt->map_range(0, 0, PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+
+        pdpt->entry(0).set_accessed(true);
+        pdpt->entry(0).set_dirty(true);
+
+        pdpt->protect_range(PAGE_SIZE_4K, PAGE_SIZE_4K, g_r_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pdpt->num_tables() == 3);
+        EXPECT_TRUE(pdpt->entry(0).dirty() == true);
+        EXPECT_TRUE(pdpt->entry(PAGE_SIZE_2M).dirty() == true);
+
+        // 1 PDPT entry + 511 2MB pages + 1 PD entry + 512 4k pages
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, PAGE_SIZE_1G, bitmap, PAGE_SIZE_2M) == 1025);
+        EXPECT_TRUE(num_dirty(bitmap) == 512);
+        EXPECT_TRUE(pdpt->entry(0).dirty() == false);
+        EXPECT_TRUE(pdpt->entry(PAGE_SIZE_2M).dirty() == false);
+
+        // Without the accessed flags of the tables above it, a dirty page
+        // has not been walked since the last harvest, and is skipped.
+
+        uint64_t bitmap_skipped[8] = {};
+        pdpt->entry(PAGE_SIZE_2M).set_dirty(true);
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, PAGE_SIZE_1G, bitmap_skipped, PAGE_SIZE_2M) == 0);
+        EXPECT_TRUE(num_dirty(bitmap_skipped) == 0);
+        EXPECT_TRUE(pdpt->entry(PAGE_SIZE_2M).dirty() == true);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_harvest_dirty_partial()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        uintptr_t pml4e = 0;
+
+        auto pdpt = std::make_shared<ept_intel_x64>(&pml4e, PDPT_INDEX);
+        pdpt->map_range(0, 0, PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+
+        pdpt->entry(0).set_accessed(true);
+        pdpt->entry(0).set_dirty(true);
+
+        uint64_t bitmap_4k[16] = {};
+
+        EXPECT_TRUE(pdpt->harvest_dirty(PAGE_SIZE_2M, 2 * PAGE_SIZE_2M, bitmap_4k, PAGE_SIZE_4K) == 0);
+        EXPECT_TRUE(num_dirty(bitmap_4k) == 1024);
+        EXPECT_TRUE(pdpt->entry(0).dirty() == true);
+
+        uint64_t bitmap_first[8] = {};
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, PAGE_SIZE_1G / 2, bitmap_first, PAGE_SIZE_2M) == 0);
+        EXPECT_TRUE(num_dirty(bitmap_first) == 256);
+        EXPECT_TRUE(pdpt->entry(0).dirty() == true);
+
+        uint64_t bitmap_all[8] = {};
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, PAGE_SIZE_1G, bitmap_all, PAGE_SIZE_2M) == 1);
+        EXPECT_TRUE(num_dirty(bitmap_all) == 512);
+        EXPECT_TRUE(pdpt->entry(0).dirty() == false);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_harvest_dirty_merge()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<ept_intel_x64>();
+        auto gpa = PAGE_SIZE_1G + PAGE_SIZE_2M + PAGE_SIZE_4K;
+
+        pml4->map_range(0, 0, 2 * PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_r_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+        EXPECT_TRUE(pml4->entry(gpa).dirty() == false);
+
+        pml4->entry(gpa).set_dirty(true);
+
+        pml4->protect_range(gpa, PAGE_SIZE_4K, g_rwx_wb, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 2);
+        EXPECT_TRUE(pml4->num_retired() == 2);
+
+        pml4->free_retired();
+        EXPECT_TRUE(pml4->num_retired() == 0);
+        EXPECT_TRUE(pml4->entry(gpa).ps() == true);
+        EXPECT_TRUE(pml4->entry(gpa).dirty() == true);
+        EXPECT_TRUE(pml4->entry(0).dirty() == false);
+    });
+}
+
+void
+memory_manager_ut::test_ept_intel_x64_harvest_dirty_invalid()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        uintptr_t pml4e = 0;
+        uint64_t bitmap[1] = {};
+
+        auto pdpt = std::make_shared<ept_intel_x64>(&pml4e, PDPT_INDEX);
+        pdpt->map_range(0, 0, PAGE_SIZE_1G, g_rwx_wb, PAGE_SIZE_1G);
+
+        EXPECT_TRUE(pdpt->harvest_dirty(0, 0, bitmap, PAGE_SIZE_2M) == 0);
+
+        EXPECT_EXCEPTION(pdpt->harvest_dirty(0, PAGE_SIZE_2M, bitmap, 0x800), std::invalid_argument);
+        EXPECT_EXCEPTION(pdpt->harvest_dirty(0, PAGE_SIZE_2M, bitmap, 3 * PAGE_SIZE_4K), std::invalid_argument);
+        EXPECT_EXCEPTION(pdpt->harvest_dirty(PAGE_SIZE_4K, PAGE_SIZE_2M, bitmap, PAGE_SIZE_2M), std::invalid_argument);
+        EXPECT_EXCEPTION(pdpt->harvest_dirty(0, PAGE_SIZE_4K, bitmap, PAGE_SIZE_2M), std::invalid_argument);
+        EXPECT_EXCEPTION(pdpt->harvest_dirty(0, 65 * PAGE_SIZE_2M, bitmap, PAGE_SIZE_2M), std::invalid_argument);
+        EXPECT_EXCEPTION(pdpt->harvest_dirty(512 * PAGE_SIZE_1G, PAGE_SIZE_2M, bitmap, PAGE_SIZE_2M), std::invalid_argument);
+    });
+}
@@ -23,12 +23,27 @@
 #include <constants.h>
 #include <memory_manager/memory_manager.h>
 
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #include <vector>
+#include <iostream>
 #include <gsl/gsl>
 
 extern "C" int64_t
 add_md(struct memory_descriptor *md) noexcept;
 
+extern "C" int64_t
+add_mdl(struct memory_descriptor *mdl, int64_t num) noexcept;
+
+extern "C" int64_t
+add_pool(struct memory_descriptor *mdl, int64_t num) noexcept;
+
+extern "C" int64_t
+get_memory_stats(struct memory_stats *stats) noexcept;
+
 void
 memory_manager_ut::test_memory_manager_malloc_zero()
 {
@@ -443,6 +458,10 @@ memory_manager_ut::test_memory_manager_malloc_page_free_malloc()
     void *addr1 = nullptr;
     void *addr2 = nullptr;
 
+    // The page pool is a buddy allocator, so multi-page allocations are
+    // aligned to their order, and smaller free blocks are used before larger
+    // blocks are split.
+
     g_mm->malloc(0x1000);
     addr1 = g_mm->malloc(0x1000);
     g_mm->free(addr1);
@@ -465,7 +484,7 @@ memory_manager_ut::test_memory_manager_malloc_page_free_malloc()
     g_mm->free(addr1);
     addr2 = g_mm->malloc(0x2000);
 
-    EXPECT_TRUE(addr1 == addr2);
+    EXPECT_TRUE(static_cast<uint8_t *>(addr2) == static_cast<uint8_t *>(addr1) + 0x1000);
     g_mm->clear();
 
     g_mm->malloc(0x1000);
@@ -482,7 +501,7 @@ memory_manager_ut::test_memory_manager_malloc_page_free_malloc()
     g_mm->free(addr1);
     addr2 = g_mm->malloc(0x1000);
 
-    EXPECT_TRUE(addr1 == addr2);
+    EXPECT_TRUE(static_cast<uint8_t *>(addr2) == static_cast<uint8_t *>(addr1) - 0x1000);
     g_mm->clear();
 
     g_mm->malloc(0x1000);
@@ -576,6 +595,10 @@ memory_manager_ut::test_memory_manager_malloc_page_sparse_fragments()
     void *addr3 = nullptr;
     void *addr4 = nullptr;
 
+    // The page pool is a buddy allocator, so multi-page allocations are
+    // aligned to their order, and smaller free blocks are used before larger
+    // blocks are split.
+
     g_mm->malloc(0x1000);
     addr1 = g_mm->malloc(0x1000);
     g_mm->malloc(0x1000);
@@ -586,8 +609,8 @@ memory_manager_ut::test_memory_manager_malloc_page_sparse_fragments()
     addr3 = g_mm->malloc(0x1000);
     addr4 = g_mm->malloc(0x1000);
 
-    EXPECT_TRUE(addr3 == addr1);
-    EXPECT_TRUE(addr4 == addr2);
+    EXPECT_TRUE(addr3 == addr2);
+    EXPECT_TRUE(addr4 == addr1);
     g_mm->clear();
 
     g_mm->malloc(0x1000);
@@ -614,8 +637,8 @@ memory_manager_ut::test_memory_manager_malloc_page_sparse_fragments()
     addr3 = g_mm->malloc(0x1000);
     addr4 = g_mm->malloc(0x2000);
 
-    EXPECT_TRUE(addr3 == addr1);
-    EXPECT_TRUE(addr4 != addr1);
+    EXPECT_TRUE(addr3 == addr2);
+    EXPECT_TRUE(addr4 == addr1);
     g_mm->clear();
 
     g_mm->malloc(0x1000);
@@ -657,6 +680,10 @@ memory_manager_ut::test_memory_manager_malloc_page_resize_fragments()
     void *addr5 = nullptr;
     void *addr6 = nullptr;
 
+    // The page pool is a buddy allocator, so multi-page allocations are
+    // aligned to their order, and smaller free blocks are used before larger
+    // blocks are split.
+
     g_mm->malloc(0x1000);
     addr1 = g_mm->malloc(0x1000);
     addr2 = g_mm->malloc(0x3000);
@@ -670,7 +697,7 @@ memory_manager_ut::test_memory_manager_malloc_page_resize_fragments()
     addr5 = g_mm->malloc(0x1000);
     addr6 = g_mm->malloc(0x3000);
 
-    EXPECT_TRUE(addr5 == addr1);
+    EXPECT_TRUE(addr5 != addr1);
     EXPECT_TRUE(addr6 == addr2);
     EXPECT_TRUE(addr5 == addr3);
     g_mm->clear();
@@ -690,7 +717,7 @@ memory_manager_ut::test_memory_manager_malloc_page_resize_fragments()
 
     EXPECT_TRUE(addr5 == addr1);
     EXPECT_TRUE(addr6 == addr2);
-    EXPECT_TRUE(addr5 == addr3);
+    EXPECT_TRUE(addr5 == addr4);
     g_mm->clear();
 
     g_mm->malloc(0x1000);
@@ -706,9 +733,9 @@ memory_manager_ut::test_memory_manager_malloc_page_resize_fragments()
     addr5 = g_mm->malloc(0x2000);
     addr6 = g_mm->malloc(0x2000);
 
-    EXPECT_TRUE(addr5 == addr1);
-    EXPECT_TRUE(addr6 == addr2);
-    EXPECT_TRUE(addr5 == addr3);
+    EXPECT_TRUE(addr5 == addr2);
+    EXPECT_TRUE(addr6 == addr1);
+    EXPECT_TRUE(addr5 == addr4);
     g_mm->clear();
 
     g_mm->malloc(0x1000);
@@ -726,7 +753,7 @@ memory_manager_ut::test_memory_manager_malloc_page_resize_fragments()
 
     EXPECT_TRUE(addr5 == addr1);
     EXPECT_TRUE(addr6 == addr2);
-    EXPECT_TRUE(addr5 == addr3);
+    EXPECT_TRUE(addr6 == addr3);
     g_mm->clear();
 }
 
@@ -791,6 +818,193 @@ memory_manager_ut::test_memory_manager_add_md_unaligned_virtual()
     EXPECT_EXCEPTION(g_mm->add_md(&md), std::logic_error);
 }
 
+void
+memory_manager_ut::test_memory_manager_add_mdl_no_exceptions()
+{
+    EXPECT_TRUE(add_mdl(nullptr, 1) == MEMORY_MANAGER_FAILURE);
+}
+
+void
+memory_manager_ut::test_memory_manager_add_mdl_invalid_mdl()
+{
+    memory_descriptor mdl[] = {{0x12345000, 0x54321000, 7}};
+
+    EXPECT_EXCEPTION(g_mm->add_mdl(nullptr, 1), std::invalid_argument);
+    EXPECT_EXCEPTION(g_mm->add_mdl(mdl, 0), std::invalid_argument);
+    EXPECT_EXCEPTION(g_mm->add_mdl(mdl, -1), std::invalid_argument);
+}
+
+void
+memory_manager_ut::test_memory_manager_add_mdl_invalid_md()
+{
+    memory_descriptor mdl[] =
+    {
+        {0x12345000, 0x54321000, 7},
+        {0x12346000, 0x54322000, 0},
+    };
+
+    EXPECT_EXCEPTION(g_mm->add_mdl(mdl, 2), std::invalid_argument);
+    EXPECT_TRUE(g_mm->virt_to_phys(0x54321000) == 0);
+
+    mdl[1] = {0x12346000, 0x54322123, 7};
+
+    EXPECT_EXCEPTION(g_mm->add_mdl(mdl, 2), std::logic_error);
+    EXPECT_TRUE(g_mm->virt_to_phys(0x54321000) == 0);
+}
+
+void
+memory_manager_ut::test_memory_manager_add_mdl_success()
+{
+    memory_descriptor mdl[] =
+    {
+        {0x12345000, 0x54321000, 7},
+        {0x12346000, 0x54322000, 7},
+        {0x22345000, 0x54323000, 3},
+    };
+
+    EXPECT_NO_EXCEPTION(g_mm->add_mdl(mdl, 3));
+
+    EXPECT_TRUE(g_mm->virt_to_phys(0x54321ABC) == 0x12345ABC);
+    EXPECT_TRUE(g_mm->virt_to_phys(0x54322ABC) == 0x12346ABC);
+    EXPECT_TRUE(g_mm->virt_to_phys(0x54323ABC) == 0x22345ABC);
+    EXPECT_TRUE(g_mm->phys_to_virt(0x22345ABC) == 0x54323ABC);
+
+    for (const auto &md : mdl)
+    {
+        g_mm->m_virt_to_phys_index.remove(md.virt, MAX_PAGE_SIZE);
+        g_mm->m_phys_to_virt_index.remove(md.phys, MAX_PAGE_SIZE);
+    }
+}
+
+void
+memory_manager_ut::test_memory_manager_add_mdl_coalesces_ranges()
+{
+    std::vector<memory_descriptor> mdl;
+
+    for (auto i = 0ULL; i < 256; i++)
+        mdl.push_back({0x90000000 + (i << 12), 0x80000000 + (i << 12), 5});
+
+    for (auto i = 0ULL; i < 256; i++)
+        mdl.push_back({0x90100000 + (i << 12), 0x70000000 + (i << 12), 3});
+
+    auto num_ranges = g_mm->virt_to_phys_ranges().size();
+
+    EXPECT_NO_EXCEPTION(g_mm->add_mdl(mdl.data(), static_cast<int64_t>(mdl.size())));
+
+    EXPECT_TRUE(g_mm->virt_to_phys_ranges().size() == num_ranges + 2);
+    EXPECT_TRUE(g_mm->phys_to_virt_ranges().size() == num_ranges + 2);
+    EXPECT_TRUE(g_mm->virt_to_phys(0x800FF123) == 0x900FF123);
+    EXPECT_TRUE(g_mm->virt_to_phys(0x90100123) == 0);
+    EXPECT_TRUE(g_mm->phys_to_virt(0x901FF123) == 0x700FF123);
+
+    g_mm->m_virt_to_phys_index.remove(0x80000000, 0x100000);
+    g_mm->m_virt_to_phys_index.remove(0x70000000, 0x100000);
+    g_mm->m_phys_to_virt_index.remove(0x90000000, 0x200000);
+}
+
+class test_range_listener : public memory_range_listener
+{
+public:
+
+    void ranges_added(const memory_range *ranges, int64_t num) override
+    {
+        if (m_throw)
+            throw std::runtime_error("error");
+
+        for (auto i = 0LL; i < num; i++)
+            m_ranges.push_back(ranges[i]);
+    }
+
+    bool m_throw{false};
+    std::vector<memory_range> m_ranges;
+};
+
+void
+memory_manager_ut::test_memory_manager_range_listener_existing_ranges()
+{
+    memory_descriptor md = {0x12345000, 0x54321000, 7};
+    EXPECT_NO_EXCEPTION(g_mm->add_md(&md));
+
+    test_range_listener listener;
+    EXPECT_NO_EXCEPTION(g_mm->set_range_listener(&listener));
+
+    EXPECT_TRUE(listener.m_ranges.size() == g_mm->virt_to_phys_ranges().size());
+    EXPECT_TRUE(std::any_of(listener.m_ranges.begin(), listener.m_ranges.end(), [](const memory_range & range)
+    { return range.from == 0x54321000 && range.to == 0x12345000 && range.size == MAX_PAGE_SIZE; }));
+
+    EXPECT_NO_EXCEPTION(g_mm->set_range_listener(nullptr));
+
+    g_mm->m_virt_to_phys_index.remove(md.virt, MAX_PAGE_SIZE);
+    g_mm->m_phys_to_virt_index.remove(md.phys, MAX_PAGE_SIZE);
+}
+
+void
+memory_manager_ut::test_memory_manager_range_listener_add_mdl()
+{
+    memory_descriptor mdl[] =
+    {
+        {0x12345000, 0x54321000, 7},
+        {0x12346000, 0x54322000, 7},
+        {0x22345000, 0x54323000, 3},
+    };
+
+    test_range_listener listener;
+    EXPECT_NO_EXCEPTION(g_mm->set_range_listener(&listener));
+
+    listener.m_ranges.clear();
+    EXPECT_NO_EXCEPTION(g_mm->add_mdl(mdl, 3));
+
+    EXPECT_TRUE(listener.m_ranges.size() == 2);
+    EXPECT_TRUE(listener.m_ranges[0].from == 0x54321000);
+    EXPECT_TRUE(listener.m_ranges[0].size == 2 * MAX_PAGE_SIZE);
+    EXPECT_TRUE(listener.m_ranges[1].from == 0x54323000);
+    EXPECT_TRUE(listener.m_ranges[1].type == 3);
+
+    EXPECT_NO_EXCEPTION(g_mm->set_range_listener(nullptr));
+
+    listener.m_ranges.clear();
+    EXPECT_NO_EXCEPTION(g_mm->add_mdl(mdl, 3));
+    EXPECT_TRUE(listener.m_ranges.empty());
+
+    for (const auto &md : mdl)
+    {
+        g_mm->m_virt_to_phys_index.remove(md.virt, MAX_PAGE_SIZE);
+        g_mm->m_phys_to_virt_index.remove(md.phys, MAX_PAGE_SIZE);
+    }
+}
+
+void
+memory_manager_ut::test_memory_manager_range_listener_throws()
+{
+    memory_descriptor md1 = {0x12345000, 0x54321000, 7};
+    memory_descriptor md2 = {0x22345000, 0x54323000, 3};
+
+    test_range_listener listener;
+    EXPECT_NO_EXCEPTION(g_mm->set_range_listener(&listener));
+
+    listener.m_throw = true;
+    EXPECT_EXCEPTION(g_mm->add_md(&md1), std::runtime_error);
+    EXPECT_TRUE(g_mm->virt_to_phys(0x54321000) == 0);
+    EXPECT_TRUE(g_mm->phys_to_virt(0x12345000) == 0);
+
+    listener.m_throw = false;
+    EXPECT_NO_EXCEPTION(g_mm->add_md(&md1));
+
+    listener.m_throw = true;
+    EXPECT_EXCEPTION(g_mm->set_range_listener(&listener), std::runtime_error);
+
+    listener.m_throw = false;
+    listener.m_ranges.clear();
+    EXPECT_NO_EXCEPTION(g_mm->add_md(&md2));
+    EXPECT_TRUE(listener.m_ranges.empty());
+
+    for (const auto &md : {md1, md2})
+    {
+        g_mm->m_virt_to_phys_index.remove(md.virt, MAX_PAGE_SIZE);
+        g_mm->m_phys_to_virt_index.remove(md.phys, MAX_PAGE_SIZE);
+    }
+}
+
 void
 memory_manager_ut::test_memory_manager_virt_to_phys_unknown()
 {
@@ -839,18 +1053,18 @@ memory_manager_ut::test_memory_manager_virt_to_phys_lower_limit()
 }
 
 void
-memory_manager_ut::test_memory_manager_virt_to_phys_map()
+memory_manager_ut::test_memory_manager_virt_to_phys_ranges()
 {
     memory_descriptor md = {0x12345000, 0x54321000, 7};
 
     EXPECT_NO_EXCEPTION(g_mm->add_md(&md));
 
-    for (const auto &iter : g_mm->virt_to_phys_map())
+    for (const auto &range : g_mm->virt_to_phys_ranges())
     {
-        EXPECT_TRUE(iter.first == (0x54321000 >> 12));
-        EXPECT_TRUE(iter.second.phys == md.phys);
-        EXPECT_TRUE(iter.second.virt == md.virt);
-        EXPECT_TRUE(iter.second.type == md.type);
+        EXPECT_TRUE(range.from == 0x54321000);
+        EXPECT_TRUE(range.to == 0x12345000);
+        EXPECT_TRUE(range.size == MAX_PAGE_SIZE);
+        EXPECT_TRUE(range.type == md.type);
     }
 }
 
@@ -890,17 +1104,788 @@ memory_manager_ut::test_memory_manager_phys_to_virt_lower_limit()
 }
 
 void
-memory_manager_ut::test_memory_manager_phys_to_virt_map()
+memory_manager_ut::test_memory_manager_phys_to_virt_ranges()
 {
     memory_descriptor md = {0x12345000, 0x54321000, 7};
 
     EXPECT_NO_EXCEPTION(g_mm->add_md(&md));
 
-    for (const auto &iter : g_mm->phys_to_virt_map())
+    for (const auto &range : g_mm->phys_to_virt_ranges())
+    {
+        EXPECT_TRUE(range.from == 0x12345000);
+        EXPECT_TRUE(range.to == 0x54321000);
+        EXPECT_TRUE(range.size == MAX_PAGE_SIZE);
+        EXPECT_TRUE(range.type == md.type);
+    }
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_malloc_free_malloc()
+{
+    g_mm->m_magazines_enabled = true;
+
+    auto addr1 = g_mm->malloc(sizeof(uint64_t));
+    g_mm->free(addr1);
+    auto addr2 = g_mm->malloc(sizeof(uint64_t));
+
+    EXPECT_TRUE(addr1 != nullptr);
+    EXPECT_TRUE(addr2 == addr1);
+
+    g_mm->m_magazines_enabled = false;
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_refill_is_batched()
+{
+    g_mm->m_magazines_enabled = true;
+
+    auto addr1 = static_cast<uint64_t *>(g_mm->malloc(sizeof(uint64_t)));
+    auto addr2 = addr1;
+
+    for (auto i = 1ULL; i < MAGAZINE_BATCH; i++)
+    {
+        auto addr3 = static_cast<uint64_t *>(g_mm->malloc(sizeof(uint64_t)));
+        EXPECT_TRUE(addr3 == addr2 + 2);
+
+        addr2 = addr3;
+    }
+
+    g_mm->m_magazines_enabled = false;
+
+    auto addr4 = static_cast<uint64_t *>(g_mm->malloc(sizeof(uint64_t)));
+    EXPECT_TRUE(addr4 == addr1 + MAGAZINE_BATCH * 2);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_free_twice()
+{
+    g_mm->m_magazines_enabled = true;
+
+    auto addr1 = g_mm->malloc(sizeof(uint64_t));
+    g_mm->free(addr1);
+    g_mm->free(addr1);
+    auto addr2 = g_mm->malloc(sizeof(uint64_t));
+    auto addr3 = g_mm->malloc(sizeof(uint64_t));
+
+    EXPECT_TRUE(addr2 == addr1);
+    EXPECT_TRUE(addr3 != addr1);
+
+    g_mm->m_magazines_enabled = false;
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_large_malloc_bypasses_magazine()
+{
+    g_mm->m_magazines_enabled = true;
+
+    auto addr1 = static_cast<uint64_t *>(g_mm->malloc(MAGAZINE_MAX_BLOCKS * sizeof(uint64_t)));
+
+    g_mm->m_magazines_enabled = false;
+
+    auto addr2 = static_cast<uint64_t *>(g_mm->malloc(sizeof(uint64_t)));
+    EXPECT_TRUE(addr2 == addr1 + MAGAZINE_MAX_BLOCKS + 1);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_overflow_returns_batch()
+{
+    std::vector<void *> addrs;
+
+    g_mm->m_magazines_enabled = true;
+
+    for (auto i = 0ULL; i <= MAGAZINE_SIZE; i++)
+        addrs.push_back(g_mm->malloc(sizeof(uint64_t)));
+
+    for (const auto &addr : addrs)
+        g_mm->free(addr);
+
+    g_mm->m_magazines_enabled = false;
+
+    EXPECT_TRUE(g_mm->malloc(sizeof(uint64_t)) == addrs[0]);
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_all_memory_fragmented()
+{
+    std::vector<void *> addrs;
+
+    g_mm->m_magazines_enabled = true;
+
+    for (auto i = 0U; i < MAX_HEAP_POOL / 2; i++)
+        addrs.push_back(g_mm->malloc(sizeof(uint64_t)));
+
+    EXPECT_TRUE(addrs.back() != nullptr);
+
+    for (const auto &addr : addrs)
+        g_mm->free(addr);
+
+    EXPECT_TRUE(g_mm->malloc((MAX_HEAP_POOL - 1) * sizeof(uint64_t)) != nullptr);
+
+    g_mm->m_magazines_enabled = false;
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_scaling()
+{
+    auto run = [&](auto num_threads)
+    {
+        constexpr const auto num_iterations = 2000;
+        constexpr const auto num_addrs = 16;
+
+        std::vector<std::thread> threads;
+        std::atomic<uint64_t> failures{0};
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        for (auto t = 0; t < num_threads; t++)
+        {
+            threads.push_back(std::thread([&]
+            {
+                std::array<void *, num_addrs> addrs;
+
+                for (auto i = 0; i < num_iterations; i++)
+                {
+                    for (auto j = 0; j < num_addrs; j++)
+                    {
+                        if ((addrs[j] = g_mm->malloc(8 + (j & 0x7) * 8)) == nullptr)
+                            failures++;
+                    }
+
+                    for (auto j = 0; j < num_addrs; j++)
+                        g_mm->free(addrs[j]);
+                }
+            }));
+        }
+
+        for (auto &&thread : threads)
+            thread.join();
+
+        auto end = std::chrono::high_resolution_clock::now();
+        auto secs = std::chrono::duration<double>(end - start).count();
+
+        EXPECT_TRUE(failures == 0);
+        g_mm->clear();
+
+        return static_cast<uint64_t>(num_threads * num_iterations * num_addrs / secs);
+    };
+
+    std::cout << std::endl;
+    std::cout << "magazine scaling (allocs/sec):" << std::endl;
+
+    for (auto num_threads = 1; num_threads <= 8; num_threads <<= 1)
+    {
+        g_mm->m_magazines_enabled = false;
+        auto heap = run(num_threads);
+
+        g_mm->m_magazines_enabled = true;
+        auto magazine = run(num_threads);
+
+        std::cout << "  threads: " << num_threads
+                  << ", heap: " << heap
+                  << ", magazines: " << magazine << std::endl;
+    }
+
+    g_mm->m_magazines_enabled = false;
+}
+
+void
+memory_manager_ut::test_memory_manager_magazine_concurrent_heap()
+{
+    constexpr const auto num_threads = 8;
+    constexpr const auto num_iterations = 2000;
+    constexpr const auto num_addrs = 16;
+
+    std::vector<std::thread> threads;
+    std::atomic<uint64_t> failures{0};
+    std::atomic<uint64_t> corruptions{0};
+
+    g_mm->m_magazines_enabled = true;
+
+    // Small allocations go through the magazines, while large allocations
+    // go to the heap, which updates the headers of their neighbours (some
+    // of which are cached by another core's magazine) while the magazines
+    // are changing the same headers.
+
+    for (auto t = 0; t < num_threads; t++)
+    {
+        threads.push_back(std::thread([&, t]
+        {
+            std::array<uint64_t *, num_addrs> addrs;
+            std::array<uint64_t, num_addrs> sizes;
+
+            for (auto i = 0; i < num_iterations; i++)
+            {
+                for (auto j = 0; j < num_addrs; j++)
+                {
+                    auto large = ((i + j + t) & 0x3) == 0;
+
+                    sizes[j] = large ? 32 + static_cast<uint64_t>(j) : 1 + static_cast<uint64_t>(j & 0x7);
+                    addrs[j] = static_cast<uint64_t *>(g_mm->malloc(sizes[j] * sizeof(uint64_t)));
+
+                    if (addrs[j] == nullptr)
+                    {
+                        failures++;
+                        continue;
+                    }
+
+                    std::fill(addrs[j], addrs[j] + sizes[j], reinterpret_cast<uint64_t>(addrs[j]));
+                }
+
+                for (auto j = 0; j < num_addrs; j++)
+                {
+                    if (addrs[j] == nullptr)
+                        continue;
+
+                    auto pattern = reinterpret_cast<uint64_t>(addrs[j]);
+
+                    if (std::any_of(addrs[j], addrs[j] + sizes[j], [&](auto val) { return val != pattern; }))
+                        corruptions++;
+
+                    g_mm->free(addrs[j]);
+                }
+            }
+        }));
+    }
+
+    for (auto &&thread : threads)
+        thread.join();
+
+    EXPECT_TRUE(failures == 0);
+    EXPECT_TRUE(corruptions == 0);
+
+    // If a header update was lost, either a block is still marked as cached
+    // (and leaked), or the heap no longer coalesces back into a single
+    // fragment.
+
+    g_mm->flush_magazines();
+    EXPECT_TRUE(g_mm->malloc((MAX_HEAP_POOL - 1) * sizeof(uint64_t)) != nullptr);
+
+    g_mm->m_magazines_enabled = false;
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_malloc_heap_coalesce_neighbours()
+{
+    g_mm->malloc(sizeof(uint64_t));
+    auto addr1 = g_mm->malloc(10);
+    auto addr2 = g_mm->malloc(10);
+    auto addr3 = g_mm->malloc(10);
+    g_mm->malloc(sizeof(uint64_t));
+
+    g_mm->free(addr1);
+    g_mm->free(addr3);
+    g_mm->free(addr2);
+
+    EXPECT_TRUE(g_mm->malloc(64) == addr1);
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_malloc_heap_fragmented_latency()
+{
+    std::vector<void *> addrs;
+
+    auto time = [&](auto size)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto addr = g_mm->malloc(size);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        g_mm->free(addr);
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    };
+
+    auto clean = time(0x100);
+
+    for (auto i = 0U; i < MAX_HEAP_POOL / 2 - 0x100; i++)
+        addrs.push_back(g_mm->malloc(sizeof(uint64_t)));
+
+    for (auto i = 0U; i < addrs.size(); i += 2)
+        g_mm->free(addrs[i]);
+
+    auto fragmented = time(0x100);
+
+    EXPECT_TRUE(g_mm->malloc(24) != addrs[0]);
+    g_mm->free(addrs[1]);
+    EXPECT_TRUE(g_mm->malloc(24) == addrs[0]);
+
+    std::cout << std::endl;
+    std::cout << "malloc latency (ns): clean: " << clean
+              << ", fragmented: " << fragmented << std::endl;
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_malloc_page_natural_alignment()
+{
+    g_mm->clear();
+
+    auto base = static_cast<uint8_t *>(g_mm->malloc(0x1000));
+
+    for (auto pages = 1U; pages <= 16; pages++)
+    {
+        auto order_size = 0x1000U;
+
+        while (order_size < pages * 0x1000U)
+            order_size <<= 1;
+
+        auto addr = static_cast<uint8_t *>(g_mm->malloc(pages * 0x1000));
+
+        EXPECT_TRUE(addr != nullptr);
+        EXPECT_TRUE(((addr - base) & (order_size - 1)) == 0);
+    }
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_malloc_page_non_power_of_two()
+{
+    g_mm->clear();
+
+    auto addr1 = static_cast<uint8_t *>(g_mm->malloc(0x3000));
+    auto addr2 = static_cast<uint8_t *>(g_mm->malloc(0x1000));
+
+    EXPECT_TRUE(addr2 == addr1 + 0x3000);
+
+    g_mm->free(addr1);
+    g_mm->free(addr2);
+
+    EXPECT_TRUE(g_mm->malloc(0x4000) == addr1);
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_malloc_page_large_aligned_after_fragmentation()
+{
+    std::vector<void *> addrs;
+
+    g_mm->clear();
+
+    auto base = static_cast<uint8_t *>(g_mm->malloc(0x1000));
+    addrs.push_back(base);
+
+    for (auto i = 1U; i < MAX_PAGE_POOL; i++)
+        addrs.push_back(g_mm->malloc(0x1000));
+
+    EXPECT_TRUE(g_mm->malloc(0x1000) == nullptr);
+
+    for (auto i = 0U; i < addrs.size(); i += 2)
+        g_mm->free(addrs[i]);
+
+    EXPECT_TRUE(g_mm->malloc(0x2000) == nullptr);
+
+    for (auto i = addrs.size() - 1; i < addrs.size(); i -= 2)
+        g_mm->free(addrs[i]);
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(0x200000));
+
+    EXPECT_TRUE(addr != nullptr);
+    EXPECT_TRUE(((addr - base) & (0x200000 - 1)) == 0);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_add_pool_invalid()
+{
+    std::vector<memory_descriptor> mdl;
+
+    for (auto i = 0ULL; i < 4; i++)
+        mdl.push_back({0xA0000000 + (i << 12), 0xB0000000 + (i << 12), MEMORY_TYPE_R | MEMORY_TYPE_W});
+
+    auto num_ranges = g_mm->virt_to_phys_ranges().size();
+
+    EXPECT_EXCEPTION(g_mm->add_pool(nullptr, 4), std::invalid_argument);
+    EXPECT_EXCEPTION(g_mm->add_pool(mdl.data(), 1), std::invalid_argument);
+
+    mdl[2].virt += 0x1000;
+    EXPECT_EXCEPTION(g_mm->add_pool(mdl.data(), 4), std::invalid_argument);
+    mdl[2].virt -= 0x1000;
+
+    mdl[3].type = MEMORY_TYPE_R;
+    EXPECT_EXCEPTION(g_mm->add_pool(mdl.data(), 4), std::invalid_argument);
+    EXPECT_TRUE(add_pool(mdl.data(), 4) == MEMORY_MANAGER_FAILURE);
+
+    EXPECT_TRUE(g_mm->virt_to_phys_ranges().size() == num_ranges);
+}
+
+void
+memory_manager_ut::test_memory_manager_add_pool_success()
+{
+    std::vector<memory_descriptor> mdl;
+    auto buf = static_cast<uint8_t *>(aligned_alloc(MAX_PAGE_SIZE, 64 * MAX_PAGE_SIZE));
+
+    for (auto i = 0ULL; i < 64; i++)
+        mdl.push_back({0xA0000000 + (i << 12), reinterpret_cast<uintptr_t>(buf) + (i << 12), MEMORY_TYPE_R | MEMORY_TYPE_W});
+
+    g_mm->clear();
+
+    EXPECT_TRUE(g_mm->malloc(MAX_PAGE_POOL * MAX_PAGE_SIZE) != nullptr);
+    EXPECT_TRUE(g_mm->malloc(MAX_PAGE_SIZE) == nullptr);
+
+    EXPECT_TRUE(add_pool(mdl.data(), 64) == MEMORY_MANAGER_SUCCESS);
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(MAX_PAGE_SIZE));
+
+    EXPECT_TRUE(addr > buf);
+    EXPECT_TRUE(addr < buf + 64 * MAX_PAGE_SIZE);
+    EXPECT_TRUE(g_mm->virt_to_phys(addr) == 0xA0000000 + static_cast<uintptr_t>(addr - buf));
+
+    // One page of the pool is used for bookkeeping, which leaves 63 pages,
+    // the largest naturally aligned block of which is 32 pages.
+
+    EXPECT_TRUE(g_mm->malloc(32 * MAX_PAGE_SIZE) != nullptr);
+    EXPECT_TRUE(g_mm->malloc(32 * MAX_PAGE_SIZE) == nullptr);
+
+    g_mm->free(addr);
+    EXPECT_TRUE(g_mm->malloc(MAX_PAGE_SIZE) == addr);
+
+    g_mm->clear();
+    g_mm->m_virt_to_phys_index.remove(reinterpret_cast<uintptr_t>(buf), 64 * MAX_PAGE_SIZE);
+    g_mm->m_phys_to_virt_index.remove(0xA0000000, 64 * MAX_PAGE_SIZE);
+
+    EXPECT_TRUE(g_mm->malloc(MAX_PAGE_POOL * MAX_PAGE_SIZE) != nullptr);
+    EXPECT_TRUE(g_mm->malloc(MAX_PAGE_SIZE) == nullptr);
+
+    g_mm->clear();
+    free(buf);
+}
+
+void
+memory_manager_ut::test_memory_manager_add_pool_max_pools()
+{
+    std::vector<memory_descriptor> mdl;
+    auto pages = 2 * (MAX_NUM_POOLS + 1);
+    auto buf = static_cast<uint8_t *>(aligned_alloc(MAX_PAGE_SIZE, pages * MAX_PAGE_SIZE));
+
+    for (auto i = 0ULL; i < pages; i++)
+        mdl.push_back({0xA0000000 + (i << 12), reinterpret_cast<uintptr_t>(buf) + (i << 12), MEMORY_TYPE_R | MEMORY_TYPE_W});
+
+    g_mm->clear();
+
+    // A pool whose memory cannot be registered gives its slot back, so it
+    // does not count towards the limit.
+
+    mdl[1].phys += 1;
+    EXPECT_TRUE(add_pool(&mdl[0], 2) == MEMORY_MANAGER_FAILURE);
+    mdl[1].phys -= 1;
+
+    for (auto i = 0ULL; i < MAX_NUM_POOLS; i++)
+        EXPECT_TRUE(add_pool(&mdl[i * 2], 2) == MEMORY_MANAGER_SUCCESS);
+
+    EXPECT_TRUE(g_mm->stats().num_page_pools == MAX_NUM_POOLS + 1);
+    EXPECT_EXCEPTION(g_mm->add_pool(&mdl[MAX_NUM_POOLS * 2], 2), std::runtime_error);
+    EXPECT_TRUE(g_mm->stats().num_page_pools == MAX_NUM_POOLS + 1);
+
+    g_mm->clear();
+    g_mm->m_virt_to_phys_index.remove(reinterpret_cast<uintptr_t>(buf), MAX_NUM_POOLS * 2 * MAX_PAGE_SIZE);
+    g_mm->m_phys_to_virt_index.remove(0xA0000000, MAX_NUM_POOLS * 2 * MAX_PAGE_SIZE);
+
+    EXPECT_TRUE(g_mm->stats().num_page_pools == 1);
+
+    free(buf);
+}
+
+void
+memory_manager_ut::test_memory_manager_malloc_heap_spills_into_page_pool()
+{
+    std::vector<memory_descriptor> mdl;
+    auto buf = static_cast<uint8_t *>(aligned_alloc(MAX_PAGE_SIZE, 4 * MAX_PAGE_SIZE));
+
+    for (auto i = 0ULL; i < 4; i++)
+        mdl.push_back({0xA0000000 + (i << 12), reinterpret_cast<uintptr_t>(buf) + (i << 12), MEMORY_TYPE_R | MEMORY_TYPE_W});
+
+    g_mm->clear();
+
+    EXPECT_TRUE(g_mm->malloc((MAX_HEAP_POOL - 1) * sizeof(uint64_t)) != nullptr);
+    EXPECT_TRUE(g_mm->malloc(100) == nullptr);
+
+    EXPECT_TRUE(add_pool(mdl.data(), 4) == MEMORY_MANAGER_SUCCESS);
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(100));
+
+    EXPECT_TRUE(addr > buf);
+    EXPECT_TRUE(addr < buf + 4 * MAX_PAGE_SIZE);
+    EXPECT_TRUE((reinterpret_cast<uintptr_t>(addr) & (MAX_PAGE_SIZE - 1)) == 0);
+    EXPECT_TRUE(g_mm->malloc(MAX_PAGE_SIZE + 100) != nullptr);
+    EXPECT_TRUE(g_mm->malloc(100) == nullptr);
+
+    g_mm->free(addr);
+    EXPECT_TRUE(g_mm->malloc(100) == addr);
+
+    g_mm->clear();
+    g_mm->m_virt_to_phys_index.remove(reinterpret_cast<uintptr_t>(buf), 4 * MAX_PAGE_SIZE);
+    g_mm->m_phys_to_virt_index.remove(0xA0000000, 4 * MAX_PAGE_SIZE);
+
+    free(buf);
+}
+
+void
+memory_manager_ut::test_memory_manager_realloc_null_and_zero()
+{
+    g_mm->clear();
+
+    auto addr = g_mm->realloc(nullptr, 100);
+    EXPECT_TRUE(addr != nullptr);
+
+    EXPECT_TRUE(g_mm->realloc(addr, 0) == nullptr);
+    EXPECT_TRUE(g_mm->malloc(100) == addr);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_realloc_heap_grow_in_place()
+{
+    g_mm->clear();
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(100));
+    auto next = static_cast<uint8_t *>(g_mm->malloc(100));
+
+    g_mm->free(next);
+
+    for (auto i = 0; i < 100; i++)
+        addr[i] = static_cast<uint8_t>(i);
+
+    EXPECT_TRUE(g_mm->realloc(addr, 1000) == addr);
+    EXPECT_TRUE(g_mm->realloc(addr, 150) == addr);
+
+    for (auto i = 0; i < 100; i++)
+        EXPECT_TRUE(addr[i] == static_cast<uint8_t>(i));
+
+    // Shrinking returned the end of the fragment to the heap, so the next
+    // allocation is made right after it.
+
+    EXPECT_TRUE(g_mm->malloc(100) == addr + 160);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_realloc_heap_grow_moves()
+{
+    g_mm->clear();
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(100));
+    auto next = static_cast<uint8_t *>(g_mm->malloc(100));
+
+    for (auto i = 0; i < 100; i++)
+        addr[i] = static_cast<uint8_t>(i);
+
+    auto moved = static_cast<uint8_t *>(g_mm->realloc(addr, 1000));
+
+    EXPECT_TRUE(moved != nullptr);
+    EXPECT_TRUE(moved != addr);
+
+    for (auto i = 0; i < 100; i++)
+        EXPECT_TRUE(moved[i] == static_cast<uint8_t>(i));
+
+    EXPECT_TRUE(g_mm->malloc(100) == addr);
+    EXPECT_TRUE(g_mm->realloc(next, MAX_HEAP_POOL * sizeof(uint64_t)) == nullptr);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_realloc_page()
+{
+    g_mm->clear();
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(4 * MAX_PAGE_SIZE));
+
+    addr[0] = 42;
+    EXPECT_TRUE(g_mm->realloc(addr, 2 * MAX_PAGE_SIZE) == addr);
+
+    // The pages that were released by the shrink are used before the rest
+    // of the page pool is split.
+
+    EXPECT_TRUE(g_mm->malloc(2 * MAX_PAGE_SIZE) == addr + 2 * MAX_PAGE_SIZE);
+
+    auto moved = static_cast<uint8_t *>(g_mm->realloc(addr, 8 * MAX_PAGE_SIZE));
+
+    EXPECT_TRUE(moved != nullptr);
+    EXPECT_TRUE(moved != addr);
+    EXPECT_TRUE(moved[0] == 42);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_calloc()
+{
+    g_mm->clear();
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(100));
+
+    __builtin_memset(addr, 0xFF, 100);
+    g_mm->free(addr);
+
+    addr = static_cast<uint8_t *>(g_mm->calloc(10, 10));
+
+    for (auto i = 0; i < 100; i++)
+        EXPECT_TRUE(addr[i] == 0);
+
+    EXPECT_TRUE(g_mm->calloc(0xFFFFFFFFFFFFFFFF, 2) == nullptr);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_calloc_zeroed_pages()
+{
+    g_mm->clear();
+    g_mm->refill_zeroed_pages();
+
+    auto addr = static_cast<uint8_t *>(g_mm->malloc(MAX_PAGE_SIZE));
+    EXPECT_TRUE(addr != nullptr);
+
+    // All of the pages that remain are either on the zeroed page list, or
+    // are in the page pool. Using up the page pool does not stop page
+    // sized callocs from being served.
+
+    std::vector<void *> addrs;
+
+    while (auto page = g_mm->malloc(MAX_PAGE_SIZE))
+        addrs.push_back(page);
+
+    EXPECT_TRUE(addrs.size() == MAX_PAGE_POOL - ZEROED_PAGES - 1);
+
+    for (auto i = 0U; i < ZEROED_PAGES; i++)
     {
-        EXPECT_TRUE(iter.first == (0x12345000 >> 12));
-        EXPECT_TRUE(iter.second.phys == md.phys);
-        EXPECT_TRUE(iter.second.virt == md.virt);
-        EXPECT_TRUE(iter.second.type == md.type);
+        auto page = static_cast<uint8_t *>(g_mm->calloc(1, MAX_PAGE_SIZE));
+
+        EXPECT_TRUE(page != nullptr);
+        EXPECT_TRUE(page[0] == 0 && page[MAX_PAGE_SIZE - 1] == 0);
     }
+
+    EXPECT_TRUE(g_mm->calloc(1, MAX_PAGE_SIZE) == nullptr);
+
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_stats_heap()
+{
+    g_mm->clear();
+
+    auto stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.heap_size == MAX_HEAP_POOL * sizeof(uint64_t));
+    EXPECT_TRUE(stats.heap_in_use == 0);
+    EXPECT_TRUE(stats.heap_peak == 0);
+    EXPECT_TRUE(stats.heap_largest_free == (MAX_HEAP_POOL - 1) * sizeof(uint64_t));
+
+    // A 100 byte allocation uses 13 blocks, plus the header, and is counted
+    // in the size class for allocations of up to 128 bytes.
+
+    auto addr1 = g_mm->malloc(100);
+    auto addr2 = g_mm->malloc(10);
+
+    stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.heap_in_use == 14 * sizeof(uint64_t) + 3 * sizeof(uint64_t));
+    EXPECT_TRUE(stats.heap_largest_free == (MAX_HEAP_POOL - 18) * sizeof(uint64_t));
+    EXPECT_TRUE(stats.allocs[3] == 1);
+    EXPECT_TRUE(stats.allocs[0] == 1);
+
+    g_mm->free(addr1);
+
+    stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.heap_in_use == 3 * sizeof(uint64_t));
+    EXPECT_TRUE(stats.heap_peak == 17 * sizeof(uint64_t));
+    EXPECT_TRUE(stats.frees[3] == 1);
+    EXPECT_TRUE(stats.frees[0] == 0);
+
+    g_mm->free(addr2);
+    g_mm->free(addr2);
+
+    stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.heap_in_use == 0);
+    EXPECT_TRUE(stats.heap_peak == 17 * sizeof(uint64_t));
+    EXPECT_TRUE(stats.heap_largest_free == (MAX_HEAP_POOL - 1) * sizeof(uint64_t));
+    EXPECT_TRUE(stats.frees[0] == 1);
+
+    g_mm->clear();
+
+    stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.heap_peak == 0);
+    EXPECT_TRUE(stats.allocs[3] == 0);
+}
+
+void
+memory_manager_ut::test_memory_manager_stats_page()
+{
+    g_mm->clear();
+
+    auto stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.num_page_pools == 1);
+    EXPECT_TRUE(stats.page_pool_size == MAX_PAGE_POOL * MAX_PAGE_SIZE);
+    EXPECT_TRUE(stats.page_pool_in_use == 0);
+    EXPECT_TRUE(stats.page_pool_largest_free == MAX_PAGE_POOL * MAX_PAGE_SIZE);
+
+    auto addr1 = g_mm->malloc(MAX_PAGE_SIZE);
+    auto addr2 = g_mm->malloc(3 * MAX_PAGE_SIZE);
+
+    stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.page_pool_in_use == 4 * MAX_PAGE_SIZE);
+    EXPECT_TRUE(stats.page_pool_largest_free == MAX_PAGE_POOL * MAX_PAGE_SIZE / 2);
+    EXPECT_TRUE(stats.allocs[8] == 1);
+    EXPECT_TRUE(stats.allocs[10] == 1);
+
+    g_mm->free(addr2);
+    g_mm->free(addr1);
+
+    stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.page_pool_in_use == 0);
+    EXPECT_TRUE(stats.page_pool_peak == 4 * MAX_PAGE_SIZE);
+    EXPECT_TRUE(stats.page_pool_largest_free == MAX_PAGE_POOL * MAX_PAGE_SIZE);
+    EXPECT_TRUE(stats.frees[8] == 1);
+    EXPECT_TRUE(stats.frees[10] == 1);
+
+    auto addr3 = g_mm->malloc(MAX_PAGE_POOL * MAX_PAGE_SIZE);
+
+    stats = g_mm->stats();
+
+    EXPECT_TRUE(stats.page_pool_largest_free == 0);
+    EXPECT_TRUE(stats.allocs[MEMORY_STATS_NUM_CLASSES - 1] == 1);
+
+    g_mm->free(addr3);
+    g_mm->clear();
+}
+
+void
+memory_manager_ut::test_memory_manager_stats_failed_allocs()
+{
+    g_mm->clear();
+
+    EXPECT_TRUE(g_mm->malloc(MAX_HEAP_POOL * sizeof(uint64_t)) == nullptr);
+    EXPECT_TRUE(g_mm->malloc((MAX_PAGE_POOL + 1) * MAX_PAGE_SIZE) == nullptr);
+
+    struct memory_stats stats = {};
+
+    EXPECT_TRUE(get_memory_stats(nullptr) == MEMORY_MANAGER_FAILURE);
+    EXPECT_TRUE(get_memory_stats(&stats) == MEMORY_MANAGER_SUCCESS);
+
+    EXPECT_TRUE(stats.failed_allocs == 2);
+    EXPECT_TRUE(stats.heap_in_use == 0);
+    EXPECT_TRUE(stats.page_pool_in_use == 0);
+
+    g_mm->clear();
 }
@@ -0,0 +1,314 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <test.h>
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <iostream>
+
+#include <constants.h>
+#include <memory_manager/memory_range_index.h>
+
+void
+memory_manager_ut::test_memory_range_index_lookup_unmapped()
+{
+    memory_range_index index;
+
+    EXPECT_TRUE(index.lookup(0) == 0);
+    EXPECT_TRUE(index.lookup(0x12345000) == 0);
+
+    memory_range range = {0x12345000, 0xABCDE000, 0x2000, 7};
+    index.insert(&range, 1);
+
+    EXPECT_TRUE(index.lookup(0x12344FFF) == 0);
+    EXPECT_TRUE(index.lookup(0x12347000) == 0);
+    EXPECT_TRUE(index.lookup(0xFFFF800012345000) == 0);
+}
+
+void
+memory_manager_ut::test_memory_range_index_lookup_success()
+{
+    memory_range_index index;
+
+    memory_range range = {0x12345000, 0xABCDE000, 0x2000, 7};
+    index.insert(&range, 1);
+
+    EXPECT_TRUE(index.lookup(0x12345000) == 0xABCDE000);
+    EXPECT_TRUE(index.lookup(0x12345123) == 0xABCDE123);
+    EXPECT_TRUE(index.lookup(0x12346FFF) == 0xABCDFFFF);
+}
+
+void
+memory_manager_ut::test_memory_range_index_insert_invalid()
+{
+    memory_range_index index;
+
+    memory_range empty = {0x12345000, 0xABCDE000, 0, 7};
+    memory_range wraps = {0xFFFFFFFFFFFFF000, 0xABCDE000, 0x2000, 7};
+
+    EXPECT_EXCEPTION(index.insert(nullptr, 1), std::invalid_argument);
+    EXPECT_EXCEPTION(index.insert(&empty, 1), std::invalid_argument);
+    EXPECT_EXCEPTION(index.insert(&wraps, 1), std::invalid_argument);
+    EXPECT_TRUE(index.ranges().empty());
+}
+
+void
+memory_manager_ut::test_memory_range_index_insert_replace()
+{
+    memory_range_index index;
+
+    memory_range range1 = {0x12345000, 0xABCDE000, 0x3000, 7};
+    memory_range range2 = {0x12346000, 0x54321000, 0x1000, 7};
+
+    index.insert(&range1, 1);
+    index.insert(&range2, 1);
+
+    EXPECT_TRUE(index.ranges().size() == 3);
+    EXPECT_TRUE(index.lookup(0x12345010) == 0xABCDE010);
+    EXPECT_TRUE(index.lookup(0x12346010) == 0x54321010);
+    EXPECT_TRUE(index.lookup(0x12347010) == 0xABCE0010);
+}
+
+void
+memory_manager_ut::test_memory_range_index_insert_merges()
+{
+    memory_range_index index;
+
+    memory_range list[] =
+    {
+        {0x3000, 0x13000, 0x1000, 7},
+        {0x1000, 0x11000, 0x1000, 7},
+        {0x2000, 0x12000, 0x1000, 7},
+        {0x4000, 0x24000, 0x1000, 7},
+        {0x5000, 0x25000, 0x1000, 3},
+    };
+
+    index.insert(list, 5);
+
+    ASSERT_TRUE(index.ranges().size() == 3);
+    EXPECT_TRUE(index.ranges()[0].from == 0x1000);
+    EXPECT_TRUE(index.ranges()[0].size == 0x3000);
+    EXPECT_TRUE(index.ranges()[1].from == 0x4000);
+    EXPECT_TRUE(index.ranges()[2].from == 0x5000);
+}
+
+void
+memory_manager_ut::test_memory_range_index_insert_last_wins()
+{
+    memory_range_index index;
+
+    memory_range list[] =
+    {
+        {0x1000, 0x11000, 0x2000, 7},
+        {0x2000, 0x22000, 0x1000, 3},
+    };
+
+    index.insert(list, 2);
+
+    ASSERT_TRUE(index.ranges().size() == 2);
+    EXPECT_TRUE(index.lookup(0x1000) == 0x11000);
+    EXPECT_TRUE(index.lookup(0x2000) == 0x22000);
+    EXPECT_TRUE(index.ranges()[1].type == 3);
+}
+
+void
+memory_manager_ut::test_memory_range_index_remove()
+{
+    memory_range_index index;
+
+    index.remove(0x12345000, 0x1000);
+
+    memory_range list[] =
+    {
+        {0x12345000, 0xABCDE000, 0x1000, 7},
+        {0x12347000, 0xABCDF000, 0x1000, 7},
+    };
+
+    index.insert(list, 2);
+    index.remove(0x12345000, 0x1000);
+
+    EXPECT_TRUE(index.lookup(0x12345000) == 0);
+    EXPECT_TRUE(index.lookup(0x12347000) == 0xABCDF000);
+    EXPECT_EXCEPTION(index.remove(0xFFFFFFFFFFFFF000, 0x2000), std::invalid_argument);
+}
+
+void
+memory_manager_ut::test_memory_range_index_remove_splits()
+{
+    memory_range_index index;
+
+    memory_range range = {0x100000, 0x200000, 0x10000, 7};
+
+    index.insert(&range, 1);
+    index.remove(0x104000, 0x2000);
+
+    ASSERT_TRUE(index.ranges().size() == 2);
+    EXPECT_TRUE(index.ranges()[0].size == 0x4000);
+    EXPECT_TRUE(index.ranges()[1].from == 0x106000);
+    EXPECT_TRUE(index.ranges()[1].to == 0x206000);
+    EXPECT_TRUE(index.ranges()[1].size == 0xA000);
+    EXPECT_TRUE(index.lookup(0x105000) == 0);
+    EXPECT_TRUE(index.lookup(0x10F000) == 0x20F000);
+}
+
+void
+memory_manager_ut::test_memory_range_index_upper_half()
+{
+    memory_range_index index;
+
+    memory_range list[] =
+    {
+        {0xFFFF800012345000, 0x1000, 0x1000, 7},
+        {0x0000800012345000, 0x2000, 0x1000, 7},
+        {0x3000, 0xFFFF800012345000, 0x1000, 7},
+    };
+
+    index.insert(list, 3);
+
+    EXPECT_TRUE(index.lookup(0xFFFF800012345000) == 0x1000);
+    EXPECT_TRUE(index.lookup(0x0000800012345000) == 0x2000);
+    EXPECT_TRUE(index.lookup(0x3008) == 0xFFFF800012345008);
+}
+
+void
+memory_manager_ut::test_memory_range_index_concurrent_lookup()
+{
+    // Each insert replaces (and frees) the array that the lookups are
+    // using, so this checks that an array is never freed while a lookup
+    // is still using it.
+
+    constexpr const auto num_threads = 4;
+    constexpr const auto num_pages = 2000ULL;
+
+    memory_range_index index;
+    memory_range range = {0x1000, 0xA000, 0x1000, 7};
+
+    index.insert(&range, 1);
+
+    std::atomic<bool> done{false};
+    std::atomic<uint64_t> failures{0};
+    std::vector<std::thread> threads;
+
+    for (auto t = 0; t < num_threads; t++)
+    {
+        threads.push_back(std::thread([&]
+        {
+            while (!done)
+            {
+                if (index.lookup(0x1008) != 0xA008)
+                    failures++;
+            }
+        }));
+    }
+
+    for (auto i = 0ULL; i < num_pages; i++)
+    {
+        memory_range page = {0x100000 + (i << 13), 0x200000 + (i << 13), 0x1000, 7};
+        index.insert(&page, 1);
+    }
+
+    done = true;
+
+    for (auto &&thread : threads)
+        thread.join();
+
+    EXPECT_TRUE(failures == 0);
+    EXPECT_TRUE(index.ranges().size() == num_pages + 1);
+}
+
+void
+memory_manager_ut::test_memory_range_index_benchmark()
+{
+    // Compares the cost of a lookup, and the memory that is used, with the
+    // per page std::map + mutex that the memory manager used before. Every
+    // 16th page is not contiguous with the page before it, so the index
+    // ends up with one range per 16 pages. The pages are looked up in a
+    // pseudo random order so that the benchmark is not just measuring the
+    // cache.
+
+    std::cout << std::endl;
+    std::cout << "virt_to_phys lookup (ns/lookup):" << std::endl;
+
+    for (auto num = 10000ULL; num <= 1000000ULL; num *= 10)
+    {
+        std::mutex mutex;
+        std::map<uintptr_t, memory_descriptor> map;
+        std::vector<memory_range> list;
+        memory_range_index index;
+
+        auto virt = 0xFFFF800000000000ULL;
+        auto phys = 0x0000000100000000ULL;
+
+        for (auto i = 0ULL; i < num; i++)
+        {
+            auto md = memory_descriptor{phys + (i << 12) + ((i >> 4) << 16), virt + (i << 12), MEMORY_TYPE_R};
+
+            map[md.virt >> MAX_PAGE_SHIFT] = md;
+            list.push_back({md.virt, md.phys, MAX_PAGE_SIZE, md.type});
+        }
+
+        index.insert(list.data(), static_cast<int64_t>(list.size()));
+
+        std::vector<uintptr_t> addrs;
+
+        for (auto i = 0ULL, n = 1ULL; i < 100000; i++)
+        {
+            n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+            addrs.push_back(virt + (((n >> 33) % num) << 12) + (i & 0xFFF));
+        }
+
+        uintptr_t map_sum = 0;
+        uintptr_t index_sum = 0;
+
+        auto map_start = std::chrono::high_resolution_clock::now();
+
+        for (const auto &addr : addrs)
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+
+            const auto &iter = map.find(addr >> MAX_PAGE_SHIFT);
+            map_sum += (iter->second.phys & ~(MAX_PAGE_SIZE - 1)) | (addr & (MAX_PAGE_SIZE - 1));
+        }
+
+        auto index_start = std::chrono::high_resolution_clock::now();
+
+        for (const auto &addr : addrs)
+            index_sum += index.lookup(addr);
+
+        auto index_end = std::chrono::high_resolution_clock::now();
+
+        EXPECT_TRUE(map_sum == index_sum);
+        EXPECT_TRUE(index.ranges().size() == num / 16);
+
+        auto map_ns = std::chrono::duration<double, std::nano>(index_start - map_start).count();
+        auto index_ns = std::chrono::duration<double, std::nano>(index_end - index_start).count();
+
+        std::cout << "  pages: " << num
+                  << ", ranges: " << index.ranges().size()
+                  << ", map: " << map_ns / addrs.size()
+                  << ", index: " << index_ns / addrs.size() << std::endl;
+    }
+}
@@ -0,0 +1,155 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <test.h>
+
+#include <set>
+#include <vector>
+
+#include <constants.h>
+#include <memory_manager/object_pool.h>
+#include <memory_manager/page_table_x64.h>
+
+struct pooled_object
+{
+    pooled_object(uint64_t val = 0) :
+        m_val(val)
+    { }
+
+    uint64_t m_val;
+    uint8_t m_pad[3000];
+};
+
+void
+memory_manager_ut::test_object_pool_slot_size()
+{
+    EXPECT_TRUE(object_pool_slot_size(1) == sizeof(void *));
+    EXPECT_TRUE(object_pool_slot_size(8) == 8);
+    EXPECT_TRUE(object_pool_slot_size(24) == 32);
+    EXPECT_TRUE(object_pool_slot_size(MAX_CACHE_LINE_SIZE) == MAX_CACHE_LINE_SIZE);
+    EXPECT_TRUE(object_pool_slot_size(MAX_CACHE_LINE_SIZE + 1) == 2 * MAX_CACHE_LINE_SIZE);
+    EXPECT_TRUE(object_pool_slot_size(3 * MAX_CACHE_LINE_SIZE - 1) == 3 * MAX_CACHE_LINE_SIZE);
+}
+
+void
+memory_manager_ut::test_object_pool_reuse()
+{
+    auto obj1 = make_pooled<pooled_object>(10);
+    auto addr = obj1.get();
+
+    EXPECT_TRUE(obj1->m_val == 10);
+
+    obj1.reset();
+
+    auto obj2 = make_pooled<pooled_object>(20);
+
+    EXPECT_TRUE(obj2.get() == addr);
+    EXPECT_TRUE(obj2->m_val == 20);
+}
+
+void
+memory_manager_ut::test_object_pool_refill()
+{
+    using allocator_type = object_pool_allocator<pooled_object>;
+
+    auto pool = allocator_type::pool();
+    auto slots = OBJECT_POOL_SLAB_SIZE / object_pool_slot_size(sizeof(pooled_object));
+
+    std::set<pooled_object *> unique;
+    std::vector<pooled_object *> objs;
+    allocator_type alloc;
+
+    // Drain whatever is left in the current slab, so that the number of
+    // slabs needed for the next set of allocations is known.
+
+    auto slabs = pool->num_slabs();
+
+    while (pool->num_slabs() == slabs)
+        objs.push_back(alloc.allocate(1));
+
+    slabs = pool->num_slabs();
+
+    for (auto i = 1ULL; i < slots; i++)
+        objs.push_back(alloc.allocate(1));
+
+    EXPECT_TRUE(pool->num_slabs() == slabs);
+
+    objs.push_back(alloc.allocate(1));
+    EXPECT_TRUE(pool->num_slabs() == slabs + 1);
+
+    for (auto obj : objs)
+        unique.insert(obj);
+
+    EXPECT_TRUE(unique.size() == objs.size());
+
+    for (auto obj : objs)
+        alloc.deallocate(obj, 1);
+
+    objs.clear();
+
+    for (auto i = 0ULL; i < unique.size(); i++)
+        objs.push_back(alloc.allocate(1));
+
+    EXPECT_TRUE(pool->num_slabs() == slabs + 1);
+
+    for (auto obj : objs)
+        alloc.deallocate(obj, 1);
+}
+
+void
+memory_manager_ut::test_object_pool_allocator()
+{
+    object_pool_allocator<pooled_object> alloc1;
+    object_pool_allocator<uint64_t> alloc2(alloc1);
+
+    EXPECT_TRUE(alloc1 == alloc2);
+    EXPECT_FALSE(alloc1 != alloc2);
+
+    auto array = alloc2.allocate(16);
+
+    for (auto i = 0; i < 16; i++)
+        array[i] = static_cast<uint64_t>(i);
+
+    alloc2.deallocate(array, 16);
+    alloc2.deallocate(nullptr, 1);
+}
+
+void
+memory_manager_ut::test_object_pool_page_tables()
+{
+    // Page table entries are views of the hardware page table, so mapping
+    // a full page table only allocates the tables themselves (and their
+    // control blocks) from the object pool, and never any entries.
+
+    constexpr auto slot = object_pool_slot_size(sizeof(page_table_entry_x64) + 16);
+
+    auto pool = object_pool<slot>::instance();
+    auto slabs = pool->num_slabs();
+
+    auto pt = make_pooled<page_table_x64>();
+
+    for (auto i = 0ULL; i < PT_SIZE; i++)
+        pt->add_page(i << 12);
+
+    EXPECT_TRUE(pt->num_tables() == 4);
+    EXPECT_TRUE(pool->num_slabs() == slabs);
+}
@@ -206,3 +206,392 @@ memory_manager_ut::test_page_table_x64_table_phys_addr_failure()
         EXPECT_TRUE(pt->phys_addr() == 0);
     });
 }
+
+void
+memory_manager_ut::test_page_table_x64_add_page_2m_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123456800000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        auto entry = pml4->add_page_2m(virt);
+        EXPECT_TRUE(entry.ps());
+
+        pml4->add_page(virt + PAGE_SIZE_2M);
+        pml4->add_page_2m(virt - PAGE_SIZE_2M);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_add_page_1g_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        auto entry = pml4->add_page_1g(virt);
+        EXPECT_TRUE(entry.ps());
+
+        pml4->add_page_2m(virt + PAGE_SIZE_1G);
+        pml4->add_page(virt - PAGE_SIZE_1G);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_add_large_page_unaligned_failure()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        EXPECT_EXCEPTION(pml4->add_page_2m(0x0000123456780000), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->add_page_1g(0x0000123456800000), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_add_large_page_overlap_failure()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        pml4->add_page(virt);
+        EXPECT_EXCEPTION(pml4->add_page_2m(virt), std::logic_error);
+        EXPECT_EXCEPTION(pml4->add_page_1g(virt), std::logic_error);
+
+        pml4->add_page_2m(virt + PAGE_SIZE_2M);
+        EXPECT_EXCEPTION(pml4->add_page(virt + PAGE_SIZE_2M + PAGE_SIZE_4K), std::logic_error);
+        EXPECT_EXCEPTION(pml4->add_page_2m(virt + PAGE_SIZE_2M), std::logic_error);
+
+        pml4->add_page_1g(virt + PAGE_SIZE_1G);
+        EXPECT_EXCEPTION(pml4->add_page(virt + PAGE_SIZE_1G), std::logic_error);
+        EXPECT_EXCEPTION(pml4->add_page_2m(virt + PAGE_SIZE_1G + PAGE_SIZE_2M), std::logic_error);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_add_page_entry_view()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123456780000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        auto entry = pml4->add_page(virt);
+        EXPECT_FALSE(entry.present());
+        EXPECT_FALSE(entry.ps());
+
+        entry.set_phys_addr(0x0000000ABCDE1000);
+        entry.set_present(true);
+
+        auto copy = entry;
+        EXPECT_TRUE(copy.present());
+        EXPECT_TRUE(copy.phys_addr() == 0x0000000ABCDE1000);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_num_tables()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        EXPECT_TRUE(pml4->num_tables() == 1);
+
+        for (auto i = 0ULL; i < PT_SIZE; i++)
+            pml4->add_page(virt + (i * PAGE_SIZE_4K));
+
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        pml4->add_page_2m(virt + PAGE_SIZE_2M);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        pml4->add_page_1g(virt + PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_map_range_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        pml4->map_range(virt, 0x0000000ABCDE0000, 16 * PAGE_SIZE_4K, PTE_FLAGS_P | PTE_FLAGS_RW);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        for (auto i = 0ULL; i < 16; i++)
+            EXPECT_EXCEPTION(pml4->add_page(virt + (i * PAGE_SIZE_4K)), std::logic_error);
+
+        pml4->add_page(virt + (16 * PAGE_SIZE_4K));
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_map_range_large_pages()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto size = PAGE_SIZE_1G + PAGE_SIZE_2M + PAGE_SIZE_4K;
+
+        auto pml4_1g = std::make_shared<page_table_x64>();
+        pml4_1g->map_range(virt, 0x0000004000000000, size, PTE_FLAGS_P, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4_1g->num_tables() == 4);
+
+        auto pml4_2m = std::make_shared<page_table_x64>();
+        pml4_2m->map_range(virt, 0x0000004000000000, size, PTE_FLAGS_P);
+        EXPECT_TRUE(pml4_2m->num_tables() == 5);
+
+        auto pml4_4k = std::make_shared<page_table_x64>();
+        pml4_4k->map_range(virt, 0x0000004000000000, PAGE_SIZE_2M, PTE_FLAGS_P, PAGE_SIZE_4K);
+        EXPECT_TRUE(pml4_4k->num_tables() == 4);
+
+        auto pml4_unaligned = std::make_shared<page_table_x64>();
+        pml4_unaligned->map_range(virt, 0x0000004000001000, PAGE_SIZE_2M, PTE_FLAGS_P);
+        EXPECT_TRUE(pml4_unaligned->num_tables() == 4);
+
+        EXPECT_EXCEPTION(pml4_1g->add_page_2m(virt + PAGE_SIZE_2M), std::logic_error);
+        EXPECT_EXCEPTION(pml4_1g->add_page(virt + PAGE_SIZE_1G + PAGE_SIZE_2M), std::logic_error);
+        pml4_1g->add_page(virt + PAGE_SIZE_1G + PAGE_SIZE_2M + PAGE_SIZE_4K);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_map_range_invalid()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        EXPECT_EXCEPTION(pml4->map_range(0x1001, 0x1000, 0x1000, PTE_FLAGS_P), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0x1000, 0x1001, 0x1000, PTE_FLAGS_P), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0x1000, 0x1000, 0x1001, PTE_FLAGS_P), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0x1000, 0x1000, 0x1000, PTE_FLAGS_PS), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0x1000, 0x1000, 0x1000, PTE_FLAGS_P, 0x1234), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->map_range(0x0000FFFFFFFFF000, 0x1000, 0x2000, PTE_FLAGS_P), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_map_range_overlap_failure()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        pml4->map_range(virt, 0x0000004000000000, PAGE_SIZE_2M, PTE_FLAGS_P);
+
+        EXPECT_EXCEPTION(pml4->map_range(virt, 0x0000004000000000, PAGE_SIZE_4K, PTE_FLAGS_P), std::logic_error);
+        EXPECT_EXCEPTION(pml4->map_range(virt - PAGE_SIZE_4K, 0x1000, 2 * PAGE_SIZE_4K, PTE_FLAGS_P), std::logic_error);
+        EXPECT_EXCEPTION(pml4->map_range(virt, 0x0000004000000000, PAGE_SIZE_2M, PTE_FLAGS_P), std::logic_error);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_remap_range_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000ULL;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        pml4->map_range(virt, 0x0000004000000000, PAGE_SIZE_2M, PTE_FLAGS_P);
+        EXPECT_TRUE(pml4->num_tables() == 3);
+
+        auto pd = pml4->m_tables[(virt >> PML4_INDEX) & INDEX_MASK]->m_tables[(virt >> PDPT_INDEX) & INDEX_MASK];
+        auto index = static_cast<std::ptrdiff_t>((virt >> PD_INDEX) & INDEX_MASK);
+
+        // Remapping part of a large page splits it, keeping the rest of the
+        // large page mapped as it was
+
+        pml4->remap_range(virt + PAGE_SIZE_4K, 0x0000005000000000, PAGE_SIZE_4K, PTE_FLAGS_P | PTE_FLAGS_RW);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        auto pt = pd->m_tables[index];
+
+        EXPECT_TRUE(pt->m_pt[0] == (0x0000004000000000 | PTE_FLAGS_P | PTE_FLAGS_MAPPED));
+        EXPECT_TRUE(pt->m_pt[1] == (0x0000005000000000 | PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_MAPPED));
+        EXPECT_TRUE(pt->m_pt[2] == (0x0000004000002000 | PTE_FLAGS_P | PTE_FLAGS_MAPPED));
+        EXPECT_TRUE((pd->m_pt[index] & PTE_PHYS_ADDR_MASK) == pt->phys_addr());
+
+        // Remapping all of it keeps the table, and replaces each entry
+
+        pml4->remap_range(virt, 0x0000006000000000, PAGE_SIZE_2M, PTE_FLAGS_P);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+        EXPECT_TRUE(pd->m_tables[index] == pt);
+
+        for (auto i = 0; i < PT_SIZE; i++)
+            EXPECT_TRUE(pt->m_pt[i] == ((0x0000006000000000 + (static_cast<uint64_t>(i) << PT_INDEX)) | PTE_FLAGS_P | PTE_FLAGS_MAPPED));
+
+        // Remapping memory that is not mapped maps it
+
+        pml4->remap_range(virt + PAGE_SIZE_2M, 0x0000007000000000, PAGE_SIZE_2M, PTE_FLAGS_P);
+        EXPECT_TRUE(pd->m_pt[index + 1] == (0x0000007000000000 | PTE_FLAGS_P | PTE_FLAGS_PS | PTE_FLAGS_MAPPED));
+        EXPECT_EXCEPTION(pml4->add_page(virt + PAGE_SIZE_2M), std::logic_error);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_remap_range_invalid()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        EXPECT_EXCEPTION(pml4->remap_range(0x1001, 0x1000, 0x1000, PTE_FLAGS_P), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->remap_range(0x1000, 0x1000, 0x1000, PTE_FLAGS_PS), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->remap_range(0x1000, 0x1000, 0x1000, PTE_FLAGS_P, 0x1234), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->remap_range(0x0000FFFFFFFFF000, 0x1000, 0x2000, PTE_FLAGS_P), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_unmap_range_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        pml4->map_range(virt, 0x0000004000000000, PAGE_SIZE_2M, PTE_FLAGS_P);
+        EXPECT_TRUE(pml4->num_tables() == 3);
+
+        pml4->unmap_range(virt + PAGE_SIZE_4K, PAGE_SIZE_4K);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        EXPECT_EXCEPTION(pml4->add_page(virt), std::logic_error);
+        EXPECT_EXCEPTION(pml4->add_page(virt + (2 * PAGE_SIZE_4K)), std::logic_error);
+
+        pml4->add_page(virt + PAGE_SIZE_4K);
+        EXPECT_TRUE(pml4->num_retired() == 0);
+
+        pml4->unmap_range(virt, PAGE_SIZE_2M);
+        EXPECT_TRUE(pml4->num_tables() == 1);
+        EXPECT_TRUE(pml4->num_retired() == 3);
+
+        pml4->free_retired();
+        EXPECT_TRUE(pml4->num_retired() == 0);
+
+        pml4->unmap_range(virt, PAGE_SIZE_1G);
+        pml4->map_range(virt, 0x0000004000000000, PAGE_SIZE_2M, PTE_FLAGS_P, PAGE_SIZE_4K);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_unmap_range_split_1g()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto virt = 0x0000123440000000;
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        pml4->map_range(virt, 0x0000004000000000, PAGE_SIZE_1G, PTE_FLAGS_P, PAGE_SIZE_1G);
+        EXPECT_TRUE(pml4->num_tables() == 2);
+
+        pml4->unmap_range(virt + PAGE_SIZE_1G - PAGE_SIZE_4K, PAGE_SIZE_4K);
+        EXPECT_TRUE(pml4->num_tables() == 4);
+
+        EXPECT_EXCEPTION(pml4->add_page(virt), std::logic_error);
+        EXPECT_EXCEPTION(pml4->add_page(virt + PAGE_SIZE_1G - (2 * PAGE_SIZE_4K)), std::logic_error);
+        pml4->add_page(virt + PAGE_SIZE_1G - PAGE_SIZE_4K);
+    });
+}
+
+void
+memory_manager_ut::test_page_table_x64_unmap_range_invalid()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pml4 = std::make_shared<page_table_x64>();
+
+        EXPECT_EXCEPTION(pml4->unmap_range(0x1001, 0x1000), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->unmap_range(0x1000, 0x1001), std::invalid_argument);
+        EXPECT_EXCEPTION(pml4->unmap_range(0x0000FFFFFFFFF000, 0x2000), std::invalid_argument);
+    });
+}
@@ -0,0 +1,238 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <test.h>
+#include <memory_manager/memory_manager.h>
+#include <memory_manager/page_walker_x64.h>
+#include <memory_manager/translation_cache_x64.h>
+
+#include <map>
+
+// The test page tables are plain arrays, and their "physical addresses"
+// are just keys into a map, so that the tables can be walked without a
+// memory manager.
+
+class test_page_walker_x64 : public page_walker_x64
+{
+public:
+
+    test_page_walker_x64()
+    {
+        m_tables[0x1000] = m_pml4;
+        m_tables[0x2000] = m_pdpt;
+        m_tables[0x3000] = m_pd;
+        m_tables[0x4000] = m_pt;
+        m_tables[0x6000] = m_pml4;
+
+        m_pml4[1] = 0x2000 | PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_US;
+        m_pdpt[2] = 0x3000 | PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_US;
+        m_pd[3] = 0x4000 | PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_US;
+        m_pt[4] = 0xABCDE000 | PTE_FLAGS_P | PTE_FLAGS_US | PTE_FLAGS_PAT;
+        m_pt[5] = 0xABCDF000 | PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_NX;
+
+        m_pd[6] = 0x40000000 | PTE_FLAGS_P | PTE_FLAGS_PS | PTE_FLAGS_RW | PTE_FLAGS_US;
+        m_pdpt[7] = 0x80000000 | PTE_FLAGS_P | PTE_FLAGS_PS | PTE_FLAGS_RW | PTE_FLAGS_US;
+        m_pdpt[8] = 0x5000 | PTE_FLAGS_P | PTE_FLAGS_RW | PTE_FLAGS_US;
+    }
+
+    page_walk_x64 walk(uintptr_t cr3, uintptr_t virt) const override
+    {
+        m_num_walks++;
+        return page_walker_x64::walk(cr3, virt);
+    }
+
+    const uintptr_t *table(uintptr_t phys) const override
+    {
+        auto iter = m_tables.find(phys);
+        return iter != m_tables.end() ? iter->second : nullptr;
+    }
+
+    uintptr_t m_pml4[PT_SIZE] = {};
+    uintptr_t m_pdpt[PT_SIZE] = {};
+    uintptr_t m_pd[PT_SIZE] = {};
+    uintptr_t m_pt[PT_SIZE] = {};
+
+    std::map<uintptr_t, uintptr_t *> m_tables;
+    mutable uint64_t m_num_walks{0};
+};
+
+static uintptr_t
+make_virt(uintptr_t pml4, uintptr_t pdpt, uintptr_t pd, uintptr_t pt, uintptr_t offset)
+{
+    return (pml4 << PML4_INDEX) | (pdpt << PDPT_INDEX) | (pd << PD_INDEX) | (pt << PT_INDEX) | offset;
+}
+
+void
+memory_manager_ut::test_page_walker_x64_walk_4k()
+{
+    test_page_walker_x64 walker;
+
+    auto walk = walker.walk(0x1000, make_virt(1, 2, 3, 4, 0x123));
+    EXPECT_TRUE(walk.present);
+    EXPECT_TRUE(walk.phys == 0xABCDE123);
+    EXPECT_TRUE(walk.page_size == PAGE_SIZE_4K);
+    EXPECT_FALSE(walk.rw);
+    EXPECT_TRUE(walk.us);
+    EXPECT_FALSE(walk.nx);
+
+    walk = walker.walk(0x1000, make_virt(1, 2, 3, 5, 0xFFF));
+    EXPECT_TRUE(walk.present);
+    EXPECT_TRUE(walk.phys == 0xABCDFFFF);
+    EXPECT_TRUE(walk.rw);
+    EXPECT_FALSE(walk.us);
+    EXPECT_TRUE(walk.nx);
+}
+
+void
+memory_manager_ut::test_page_walker_x64_walk_large_pages()
+{
+    test_page_walker_x64 walker;
+
+    auto walk = walker.walk(0x1000, make_virt(1, 2, 6, 0x1FF, 0x123));
+    EXPECT_TRUE(walk.present);
+    EXPECT_TRUE(walk.phys == 0x401FF123);
+    EXPECT_TRUE(walk.page_size == PAGE_SIZE_2M);
+    EXPECT_TRUE(walk.rw);
+    EXPECT_TRUE(walk.us);
+
+    walk = walker.walk(0x1000, make_virt(1, 7, 0x155, 0x1AA, 0x123));
+    EXPECT_TRUE(walk.present);
+    EXPECT_TRUE(walk.phys == (0x80000000 | (0x155ULL << PD_INDEX) | (0x1AAULL << PT_INDEX) | 0x123));
+    EXPECT_TRUE(walk.page_size == PAGE_SIZE_1G);
+}
+
+void
+memory_manager_ut::test_page_walker_x64_walk_not_present()
+{
+    test_page_walker_x64 walker;
+
+    EXPECT_FALSE(walker.walk(0x1000, make_virt(0, 2, 3, 4, 0)).present);
+    EXPECT_FALSE(walker.walk(0x1000, make_virt(1, 0, 3, 4, 0)).present);
+    EXPECT_FALSE(walker.walk(0x1000, make_virt(1, 2, 0, 4, 0)).present);
+    EXPECT_FALSE(walker.walk(0x1000, make_virt(1, 2, 3, 0, 0)).present);
+    EXPECT_FALSE(walker.walk(0x1000, make_virt(1, 8, 0, 0, 0)).present);
+    EXPECT_FALSE(walker.walk(0x9000, make_virt(1, 2, 3, 4, 0)).present);
+}
+
+void
+memory_manager_ut::test_page_walker_x64_walk_unknown_table()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (void *(memory_manager::*)(uintptr_t))&memory_manager::phys_to_virt_ptr).Return(nullptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        page_walker_x64 walker;
+        EXPECT_FALSE(walker.walk(0x1000, 0x1000).present);
+    });
+}
+
+void
+memory_manager_ut::test_translation_cache_x64_hits()
+{
+    auto walker = std::make_shared<test_page_walker_x64>();
+    translation_cache_x64 cache(walker);
+
+    auto walk = cache.translate(0x1000, make_virt(1, 2, 3, 4, 0x123));
+    EXPECT_TRUE(walk.present);
+    EXPECT_TRUE(walk.phys == 0xABCDE123);
+
+    walk = cache.translate(0x1000, make_virt(1, 2, 3, 4, 0x456));
+    EXPECT_TRUE(walk.present);
+    EXPECT_TRUE(walk.phys == 0xABCDE456);
+    EXPECT_FALSE(walk.rw);
+    EXPECT_TRUE(walk.page_size == PAGE_SIZE_4K);
+
+    EXPECT_TRUE(walker->m_num_walks == 1);
+    EXPECT_TRUE(cache.hits() == 1);
+    EXPECT_TRUE(cache.misses() == 1);
+
+    walk = cache.translate(0x1000, make_virt(1, 2, 6, 0x10, 0x789));
+    walk = cache.translate(0x1000, make_virt(1, 2, 6, 0x10, 0x78A));
+    EXPECT_TRUE(walk.phys == 0x4001078A);
+    EXPECT_TRUE(walk.page_size == PAGE_SIZE_2M);
+    EXPECT_TRUE(walker->m_num_walks == 2);
+}
+
+void
+memory_manager_ut::test_translation_cache_x64_tagged_by_cr3()
+{
+    auto walker = std::make_shared<test_page_walker_x64>();
+    translation_cache_x64 cache(walker);
+
+    auto virt = make_virt(1, 2, 3, 4, 0);
+
+    EXPECT_TRUE(cache.translate(0x1000, virt).present);
+    EXPECT_TRUE(cache.translate(0x6000, virt).present);
+    EXPECT_TRUE(walker->m_num_walks == 2);
+
+    // Translations that are not present are not cached, and do not evict
+    // the translations that are.
+
+    EXPECT_FALSE(cache.translate(0x9000, virt).present);
+    EXPECT_FALSE(cache.translate(0x9000, virt).present);
+    EXPECT_TRUE(walker->m_num_walks == 4);
+
+    EXPECT_TRUE(cache.translate(0x6000, virt).present);
+    EXPECT_TRUE(walker->m_num_walks == 4);
+}
+
+void
+memory_manager_ut::test_translation_cache_x64_flush()
+{
+    auto walker = std::make_shared<test_page_walker_x64>();
+    translation_cache_x64 cache(walker);
+
+    auto virt1 = make_virt(1, 2, 3, 4, 0);
+    auto virt2 = make_virt(1, 2, 3, 5, 0);
+
+    cache.translate(0x1000, virt1);
+    cache.translate(0x1000, virt2);
+    EXPECT_TRUE(walker->m_num_walks == 2);
+
+    cache.flush();
+    cache.translate(0x1000, virt1);
+    cache.translate(0x1000, virt2);
+    EXPECT_TRUE(walker->m_num_walks == 4);
+
+    cache.flush(0x1000, virt1);
+    cache.translate(0x1000, virt1);
+    cache.translate(0x1000, virt2);
+    EXPECT_TRUE(walker->m_num_walks == 5);
+
+    cache.flush(0x2000);
+    cache.translate(0x1000, virt1);
+    EXPECT_TRUE(walker->m_num_walks == 5);
+
+    cache.flush(0x1000);
+    cache.translate(0x1000, virt1);
+    cache.translate(0x1000, virt2);
+    EXPECT_TRUE(walker->m_num_walks == 7);
+
+    walker->m_pt[4] = 0;
+    EXPECT_TRUE(cache.translate(0x1000, virt1).present);
+
+    cache.flush();
+    EXPECT_FALSE(cache.translate(0x1000, virt1).present);
+}
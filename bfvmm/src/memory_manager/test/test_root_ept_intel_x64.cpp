@@ -0,0 +1,420 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <test.h>
+#include <memory_manager/root_ept_intel_x64.h>
+#include <memory_manager/memory_manager.h>
+
+#include <map>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+extern "C" int64_t
+get_dirty_bitmap(struct dirty_bitmap *bitmap) noexcept;
+
+static uintptr_t
+virt_to_phys_ptr(void *ptr)
+{
+    (void) ptr;
+
+    return 0x0000000ABCDEF0000;
+}
+
+static uint64_t
+read_msr_wb(uint32_t msr)
+{
+    if (msr == IA32_MTRR_DEF_TYPE_MSR)
+        return IA32_MTRR_DEF_TYPE_E | EPT_MEMORY_TYPE_WB;
+
+    return 0;
+}
+
+static std::shared_ptr<intrinsics_intel_x64>
+mock_intrinsics(MockRepository &mocks)
+{
+    auto in = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+    mocks.OnCall(in.get(), intrinsics_intel_x64::read_msr).Do(read_msr_wb);
+
+    return in;
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_enable()
+{
+    auto ept = std::make_shared<root_ept_intel_x64>();
+
+    EXPECT_FALSE(ept->is_enabled());
+    ept->enable();
+    EXPECT_TRUE(ept->is_enabled());
+    EXPECT_TRUE(ept->num_tables() == 0);
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_eptp_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = mock_intrinsics(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto ept_1g = std::make_shared<root_ept_intel_x64>(in);
+        ept_1g->set_max_page_size(PAGE_SIZE_1G);
+
+        EXPECT_TRUE(ept_1g->num_tables() == 0);
+        EXPECT_TRUE(ept_1g->eptp() == (0x0000000ABCDEF0000 | EPTP_PAGE_WALK_LENGTH_4 | EPT_MEMORY_TYPE_WB));
+        EXPECT_TRUE(ept_1g->eptp() == (0x0000000ABCDEF0000 | EPTP_PAGE_WALK_LENGTH_4 | EPT_MEMORY_TYPE_WB));
+        EXPECT_TRUE(ept_1g->num_tables() == 2);
+
+        auto ept_2m = std::make_shared<root_ept_intel_x64>(in);
+        ept_2m->set_identity_map_size(4 * PAGE_SIZE_1G);
+
+        EXPECT_TRUE(ept_2m->eptp() == (0x0000000ABCDEF0000 | EPTP_PAGE_WALK_LENGTH_4 | EPT_MEMORY_TYPE_WB));
+        EXPECT_TRUE(ept_2m->num_tables() == 6);
+    });
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_eptp_parallel()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = mock_intrinsics(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto ept = std::make_shared<root_ept_intel_x64>(in);
+        ept->set_max_page_size(PAGE_SIZE_1G);
+
+        std::atomic<int> num_correct(0);
+        std::vector<std::thread> threads;
+
+        for (auto i = 0; i < 8; i++)
+        {
+            threads.emplace_back([&]
+            {
+                if (ept->eptp() == (0x0000000ABCDEF0000 | EPTP_PAGE_WALK_LENGTH_4 | EPT_MEMORY_TYPE_WB))
+                    num_correct++;
+            });
+        }
+
+        for (auto &thread : threads)
+            thread.join();
+
+        EXPECT_TRUE(num_correct == 8);
+        EXPECT_TRUE(ept->num_tables() == 2);
+    });
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_protect_range()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = mock_intrinsics(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto ept = std::make_shared<root_ept_intel_x64>(in);
+        ept->set_max_page_size(PAGE_SIZE_1G);
+
+        auto rwx = EPTE_FLAGS_RWX | EPTE_MEMORY_TYPE(EPT_MEMORY_TYPE_WB);
+        auto rw = EPTE_FLAGS_R | EPTE_FLAGS_W | EPTE_MEMORY_TYPE(EPT_MEMORY_TYPE_WB);
+
+        ept->protect_range(0x0000000000100000, PAGE_SIZE_4K, rw);
+        EXPECT_TRUE(ept->num_tables() == 4);
+
+        ept->protect_range(0x0000000000100000, PAGE_SIZE_4K, rwx);
+        EXPECT_TRUE(ept->num_tables() == 2);
+
+        EXPECT_EXCEPTION(ept->protect_range(0x10, PAGE_SIZE_4K, rw), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_protect_range_retire()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = mock_intrinsics(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto ept = std::make_shared<root_ept_intel_x64>(in);
+        ept->set_max_page_size(PAGE_SIZE_1G);
+
+        auto rwx = EPTE_FLAGS_RWX | EPTE_MEMORY_TYPE(EPT_MEMORY_TYPE_WB);
+        auto rw = EPTE_FLAGS_R | EPTE_FLAGS_W | EPTE_MEMORY_TYPE(EPT_MEMORY_TYPE_WB);
+
+        std::atomic<uint64_t> acked(0);
+
+        EXPECT_EXCEPTION(ept->attach(nullptr), std::invalid_argument);
+        ept->attach(&acked);
+
+        ept->protect_range(0x0000000000100000, PAGE_SIZE_4K, rw);
+        ept->protect_range(0x0000000000100000, PAGE_SIZE_4K, rwx);
+        EXPECT_TRUE(ept->generation() == 2);
+        EXPECT_TRUE(ept->m_pml4->num_retired() == 2);
+
+        acked = 1;
+        ept->protect_range(0x0000000000100000, PAGE_SIZE_4K, rw);
+        EXPECT_TRUE(ept->m_pml4->num_retired() == 2);
+
+        acked = ept->generation();
+        ept->protect_range(0x0000000000100000, PAGE_SIZE_4K, rwx);
+        EXPECT_TRUE(ept->m_pml4->num_retired() == 2);
+        EXPECT_TRUE(ept->num_tables() == 2);
+
+        ept->detach(&acked);
+        ept->detach(&acked);
+        ept->protect_range(0x0000000000100000, PAGE_SIZE_4K, rw);
+        EXPECT_TRUE(ept->m_pml4->num_retired() == 0);
+        EXPECT_TRUE(ept->generation() == 5);
+    });
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_invalid_settings()
+{
+    auto ept = std::make_shared<root_ept_intel_x64>();
+
+    EXPECT_EXCEPTION(ept->set_max_page_size(PAGE_SIZE_4K), std::invalid_argument);
+    EXPECT_EXCEPTION(ept->set_max_page_size(0x10), std::invalid_argument);
+    EXPECT_NO_EXCEPTION(ept->set_max_page_size(PAGE_SIZE_2M));
+    EXPECT_NO_EXCEPTION(ept->set_max_page_size(PAGE_SIZE_1G));
+
+    EXPECT_EXCEPTION(ept->set_identity_map_size(0), std::invalid_argument);
+    EXPECT_EXCEPTION(ept->set_identity_map_size(PAGE_SIZE_4K), std::invalid_argument);
+    EXPECT_EXCEPTION(ept->set_identity_map_size((0x1ULL << 48) + PAGE_SIZE_2M), std::invalid_argument);
+    EXPECT_NO_EXCEPTION(ept->set_identity_map_size(0x1ULL << 48));
+    EXPECT_NO_EXCEPTION(ept->set_identity_map_size(PAGE_SIZE_2M));
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_harvest_dirty()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = mock_intrinsics(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto window_size = DIRTY_BITMAP_NUM_WORDS * 64 * EPT_DIRTY_BITMAP_GRANULARITY;
+
+        auto ept = std::make_shared<root_ept_intel_x64>(in);
+        ept->set_max_page_size(PAGE_SIZE_1G);
+        ept->set_identity_map_size(window_size + PAGE_SIZE_1G);
+        ept->enable_accessed_dirty();
+
+        EXPECT_TRUE(ept->eptp() == (0x0000000ABCDEF0000 | EPTP_PAGE_WALK_LENGTH_4 |
+                                    EPT_MEMORY_TYPE_WB | EPTP_ACCESSED_DIRTY_FLAGS_ENABLED));
+
+        struct dirty_bitmap bitmap;
+
+        ept->harvest_dirty(&bitmap);
+        EXPECT_TRUE(bitmap.gpa == 0);
+        EXPECT_TRUE(bitmap.size == window_size);
+        EXPECT_TRUE(bitmap.total_size == window_size + PAGE_SIZE_1G);
+        EXPECT_TRUE(bitmap.granularity == EPT_DIRTY_BITMAP_GRANULARITY);
+
+        ept->harvest_dirty(&bitmap);
+        EXPECT_TRUE(bitmap.gpa == window_size);
+        EXPECT_TRUE(bitmap.size == PAGE_SIZE_1G);
+
+        ept->harvest_dirty(&bitmap);
+        EXPECT_TRUE(bitmap.gpa == 0);
+        EXPECT_TRUE(bitmap.size == window_size);
+
+        EXPECT_TRUE(ept->generation() == 0);
+        EXPECT_EXCEPTION(ept->harvest_dirty(nullptr), std::invalid_argument);
+    });
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_harvest_dirty_disabled()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = mock_intrinsics(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto ept = std::make_shared<root_ept_intel_x64>(in);
+        ept->set_max_page_size(PAGE_SIZE_1G);
+
+        struct dirty_bitmap bitmap;
+
+        EXPECT_EXCEPTION(ept->harvest_dirty(&bitmap), std::logic_error);
+        EXPECT_TRUE(get_dirty_bitmap(nullptr) == MEMORY_MANAGER_FAILURE);
+    });
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_harvest_dirty_synchronized()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = mock_intrinsics(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    auto ept = std::make_shared<root_ept_intel_x64>(in);
+
+    std::atomic<uint64_t> acked(0);
+    std::atomic<uint64_t> idle(0);
+
+    // CPUID forces the calling core to exit, which is when its vCPU
+    // acknowledges the new generation.
+
+    mocks.OnCall(in.get(), intrinsics_intel_x64::cpuid_eax).Do([&](uint32_t) -> uint32_t
+    {
+        acked = ept->generation();
+        return 0;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        ept->set_max_page_size(PAGE_SIZE_1G);
+        ept->set_identity_map_size(DIRTY_BITMAP_NUM_WORDS * 64 * EPT_DIRTY_BITMAP_GRANULARITY);
+        ept->enable_accessed_dirty();
+        ept->eptp();
+
+        struct dirty_bitmap bitmap;
+
+        ept->attach(&acked);
+
+        ept->m_pml4->m_tables[0]->set_accessed(true);
+        ept->m_pml4->entry(0).set_dirty(true);
+        ept->harvest_dirty(&bitmap);
+        EXPECT_TRUE(bitmap.synchronized == 1);
+        EXPECT_TRUE((bitmap.bitmap[0] & 1) != 0);
+        EXPECT_TRUE(acked == 1);
+
+        ept->attach(&idle);
+
+        ept->m_pml4->m_tables[0]->set_accessed(true);
+        ept->m_pml4->entry(0).set_dirty(true);
+        ept->harvest_dirty(&bitmap);
+        EXPECT_TRUE(bitmap.synchronized == 0);
+        EXPECT_TRUE((bitmap.bitmap[0] & 1) != 0);
+        EXPECT_TRUE(acked == 2);
+
+        ept->detach(&idle);
+        ept->detach(&acked);
+    });
+}
+
+void
+memory_manager_ut::test_root_ept_intel_x64_eptp_mtrrs()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    auto in = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+
+    // The VGA hole (0xA0000 - 0xBFFFF) is UC through the fixed MTRRs, and
+    // the last GB below 4GB is UC through a variable MTRR, which overlaps a
+    // WT one. The rest of memory is WB by default.
+
+    auto mask_1g = (~(PAGE_SIZE_1G - 1) & IA32_MTRR_PHYS_ADDR_MASK) | IA32_MTRR_PHYSMASK_VALID;
+    auto mask_256m = (~(0x10000000ULL - 1) & IA32_MTRR_PHYS_ADDR_MASK) | IA32_MTRR_PHYSMASK_VALID;
+    auto def_type = IA32_MTRR_DEF_TYPE_E | IA32_MTRR_DEF_TYPE_FE | EPT_MEMORY_TYPE_WB;
+
+    std::map<uint32_t, uint64_t> msrs;
+
+    mocks.OnCall(in.get(), intrinsics_intel_x64::read_msr).Do([&](uint32_t msr) -> uint64_t
+    {
+        if (msrs.count(msr) != 0)
+            return msrs[msr];
+
+        return msr >= IA32_MTRR_FIX64K_00000_MSR && msr <= IA32_MTRR_FIX4K_C0000_MSR + 7 ? 0x0606060606060606 : 0;
+    });
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        msrs[IA32_MTRRCAP_MSR] = IA32_MTRRCAP_FIX | 3;
+        msrs[IA32_MTRR_DEF_TYPE_MSR] = def_type;
+        msrs[IA32_MTRR_FIX16K_80000_MSR + 1] = 0;
+        msrs[IA32_MTRR_PHYSBASE0_MSR] = 0xC0000000 | EPT_MEMORY_TYPE_UC;
+        msrs[IA32_MTRR_PHYSMASK0_MSR] = mask_1g;
+        msrs[IA32_MTRR_PHYSBASE0_MSR + 2] = 0xD0000000 | EPT_MEMORY_TYPE_WT;
+        msrs[IA32_MTRR_PHYSMASK0_MSR + 2] = mask_256m;
+
+        auto ept = std::make_shared<root_ept_intel_x64>(in);
+        ept->set_max_page_size(PAGE_SIZE_1G);
+        ept->set_identity_map_size(8 * PAGE_SIZE_1G);
+
+        auto ranges = ept->memory_type_ranges(8 * PAGE_SIZE_1G);
+
+        EXPECT_TRUE(ranges.size() == 5);
+        EXPECT_TRUE(ranges[0].gpa == 0 && ranges[0].size == 0xA0000 && ranges[0].type == EPT_MEMORY_TYPE_WB);
+        EXPECT_TRUE(ranges[1].gpa == 0xA0000 && ranges[1].size == 0x20000 && ranges[1].type == EPT_MEMORY_TYPE_UC);
+        EXPECT_TRUE(ranges[2].gpa == 0xC0000 && ranges[2].type == EPT_MEMORY_TYPE_WB);
+        EXPECT_TRUE(ranges[3].gpa == 0xC0000000 && ranges[3].size == PAGE_SIZE_1G && ranges[3].type == EPT_MEMORY_TYPE_UC);
+        EXPECT_TRUE(ranges[4].gpa == 4 * PAGE_SIZE_1G && ranges[4].size == 4 * PAGE_SIZE_1G && ranges[4].type == EPT_MEMORY_TYPE_WB);
+
+        ept->eptp();
+        EXPECT_TRUE(ept->m_pml4->entry(0x9F000).memory_type() == EPT_MEMORY_TYPE_WB);
+        EXPECT_TRUE(ept->m_pml4->entry(0xA0000).memory_type() == EPT_MEMORY_TYPE_UC);
+        EXPECT_TRUE(ept->m_pml4->entry(0xD0000000).memory_type() == EPT_MEMORY_TYPE_UC);
+        EXPECT_TRUE(ept->m_pml4->entry(0x100000000).memory_type() == EPT_MEMORY_TYPE_WB);
+
+        // WT wins over WB, and with the fixed MTRRs disabled, the first 1MB
+        // uses the variable MTRRs like the rest of memory.
+
+        msrs[IA32_MTRR_DEF_TYPE_MSR] = IA32_MTRR_DEF_TYPE_E | EPT_MEMORY_TYPE_WB;
+        msrs[IA32_MTRR_PHYSBASE0_MSR] = 0xC0000000 | EPT_MEMORY_TYPE_WB;
+
+        ranges = ept->memory_type_ranges(8 * PAGE_SIZE_1G);
+
+        EXPECT_TRUE(ranges.size() == 3);
+        EXPECT_TRUE(ranges[0].gpa == 0 && ranges[0].size == 0xD0000000 && ranges[0].type == EPT_MEMORY_TYPE_WB);
+        EXPECT_TRUE(ranges[1].gpa == 0xD0000000 && ranges[1].size == 0x10000000 && ranges[1].type == EPT_MEMORY_TYPE_WT);
+
+        // With the MTRRs disabled, all of memory is UC.
+
+        msrs[IA32_MTRR_DEF_TYPE_MSR] = EPT_MEMORY_TYPE_WB;
+
+        ranges = ept->memory_type_ranges(8 * PAGE_SIZE_1G);
+
+        EXPECT_TRUE(ranges.size() == 1);
+        EXPECT_TRUE(ranges[0].size == 8 * PAGE_SIZE_1G && ranges[0].type == EPT_MEMORY_TYPE_UC);
+
+        msrs[IA32_MTRR_DEF_TYPE_MSR] = def_type;
+        msrs[IA32_MTRR_PHYSMASK0_MSR] = mask_1g & ~0x80000000ULL;
+
+        EXPECT_EXCEPTION(ept->memory_type_ranges(8 * PAGE_SIZE_1G), std::runtime_error);
+    });
+}
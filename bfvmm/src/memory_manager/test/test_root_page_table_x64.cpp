@@ -0,0 +1,178 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <test.h>
+#include <memory_manager/root_page_table_x64.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static uintptr_t
+virt_to_phys_ptr(void *ptr)
+{
+    (void) ptr;
+
+    return 0x0000000ABCDEF0000;
+}
+
+static memory_range g_ranges[] =
+{
+    {0x0000123440000000, 0x0000000040000000, 0x0000000000200000, MEMORY_TYPE_R | MEMORY_TYPE_E},
+    {0x0000123440200000, 0x0000000050001000, 0x0000000000003000, MEMORY_TYPE_R | MEMORY_TYPE_W},
+};
+
+static memory_range g_new_range =
+{0x0000123440400000, 0x0000000060000000, 0x0000000000001000, MEMORY_TYPE_R};
+
+static std::atomic<int> g_num_listeners(0);
+static memory_range_listener *g_listener = nullptr;
+
+static void
+set_range_listener(memory_range_listener *listener)
+{
+    if (listener == nullptr)
+        return;
+
+    g_num_listeners++;
+    g_listener = listener;
+
+    listener->ranges_added(g_ranges, 2);
+}
+
+void
+memory_manager_ut::test_root_page_table_x64_cr3_success()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+    mocks.OnCall(mm, memory_manager::set_range_listener).Do(set_range_listener);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        g_num_listeners = 0;
+
+        auto pt = std::make_shared<root_page_table_x64>();
+
+        EXPECT_TRUE(pt->cr3() == 0x0000000ABCDEF0000);
+        EXPECT_TRUE(pt->cr3() == 0x0000000ABCDEF0000);
+        EXPECT_TRUE(g_num_listeners == 1);
+        EXPECT_TRUE(g_listener == pt.get());
+    });
+}
+
+void
+memory_manager_ut::test_root_page_table_x64_cr3_parallel()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+    mocks.OnCall(mm, memory_manager::set_range_listener).Do(set_range_listener);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        g_num_listeners = 0;
+
+        auto pt = std::make_shared<root_page_table_x64>();
+        std::atomic<int> num_correct(0);
+
+        std::vector<std::thread> threads;
+
+        for (auto i = 0; i < 8; i++)
+        {
+            threads.emplace_back([&]
+            {
+                if (pt->cr3() == 0x0000000ABCDEF0000)
+                    num_correct++;
+            });
+        }
+
+        for (auto &thread : threads)
+            thread.join();
+
+        EXPECT_TRUE(num_correct == 8);
+        EXPECT_TRUE(g_num_listeners == 1);
+    });
+}
+
+void
+memory_manager_ut::test_root_page_table_x64_cr3_failure()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+    mocks.ExpectCall(mm, memory_manager::set_range_listener).Throw(std::runtime_error("error"));
+    mocks.OnCall(mm, memory_manager::set_range_listener).Do(set_range_listener);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        g_num_listeners = 0;
+
+        auto pt = std::make_shared<root_page_table_x64>();
+
+        EXPECT_EXCEPTION(pt->cr3(), std::runtime_error);
+        EXPECT_TRUE(pt->cr3() == 0x0000000ABCDEF0000);
+        EXPECT_TRUE(g_num_listeners == 1);
+    });
+}
+
+void
+memory_manager_ut::test_root_page_table_x64_ranges_added()
+{
+    MockRepository mocks;
+    auto mm = mocks.Mock<memory_manager>();
+    mocks.OnCallFunc(memory_manager::instance).Return(mm);
+    mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
+    mocks.OnCall(mm, memory_manager::set_range_listener).Do(set_range_listener);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        auto pt = std::make_shared<root_page_table_x64>();
+        pt->cr3();
+
+        // Memory that is added again replaces the existing mappings
+
+        auto generation = pt->generation();
+
+        EXPECT_NO_EXCEPTION(pt->ranges_added(g_ranges, 2));
+        EXPECT_NO_EXCEPTION(pt->ranges_added(&g_new_range, 1));
+
+        // Each time memory is mapped, the generation is bumped so that each
+        // core flushes it's TLB
+
+        EXPECT_TRUE(pt->generation() == generation + 2);
+    });
+}
+
+void
+memory_manager_ut::test_root_page_table_x64_set_max_page_size()
+{
+    auto pt = std::make_shared<root_page_table_x64>();
+
+    EXPECT_NO_EXCEPTION(pt->set_max_page_size(PAGE_SIZE_4K));
+    EXPECT_NO_EXCEPTION(pt->set_max_page_size(PAGE_SIZE_2M));
+    EXPECT_NO_EXCEPTION(pt->set_max_page_size(PAGE_SIZE_1G));
+    EXPECT_EXCEPTION(pt->set_max_page_size(0x1234), std::invalid_argument);
+}
@@ -22,6 +22,7 @@
 #include <gsl/gsl>
 
 #include <vcpu/vcpu_intel_x64.h>
+#include <memory_manager/object_pool.h>
 #include <memory_manager/memory_manager.h>
 
 vcpu_intel_x64::vcpu_intel_x64(uint64_t id,
@@ -50,15 +51,14 @@ vcpu_intel_x64::init(void *attr)
     auto fa1 = gsl::finally([&]
     { this->fini(); });
 
-    auto ss = new state_save_intel_x64();
-    m_state_save = std::shared_ptr<state_save_intel_x64>(ss);
+    m_state_save = make_pooled<state_save_intel_x64>();
 
-    if (!m_intrinsics) m_intrinsics = std::make_shared<intrinsics_intel_x64>();
-    if (!m_vmxon) m_vmxon = std::make_shared<vmxon_intel_x64>(m_intrinsics);
-    if (!m_vmcs) m_vmcs = std::make_shared<vmcs_intel_x64>(m_intrinsics);
-    if (!m_exit_handler) m_exit_handler = std::make_shared<exit_handler_intel_x64>(m_intrinsics);
-    if (!m_vmm_state) m_vmm_state = std::make_shared<vmcs_intel_x64_vmm_state>(m_state_save);
-    if (!m_guest_state) m_guest_state = std::make_shared<vmcs_intel_x64_host_vm_state>(m_intrinsics);
+    if (!m_intrinsics) m_intrinsics = make_pooled<intrinsics_intel_x64>();
+    if (!m_vmxon) m_vmxon = make_pooled<vmxon_intel_x64>(m_intrinsics);
+    if (!m_vmcs) m_vmcs = make_pooled<vmcs_intel_x64>(m_intrinsics);
+    if (!m_exit_handler) m_exit_handler = make_pooled<exit_handler_intel_x64>(m_intrinsics);
+    if (!m_vmm_state) m_vmm_state = make_pooled<vmcs_intel_x64_vmm_state>(m_state_save);
+    if (!m_guest_state) m_guest_state = make_pooled<vmcs_intel_x64_host_vm_state>(m_intrinsics);
 
     m_state_save->vcpuid = this->id();
     m_state_save->vmxon_ptr = reinterpret_cast<uintptr_t>(m_vmxon.get());
@@ -69,6 +69,7 @@ vcpu_intel_x64::init(void *attr)
 
     m_exit_handler->set_vmcs(m_vmcs);
     m_exit_handler->set_state_save(m_state_save);
+    m_exit_handler->set_exit_stats(make_pooled<exit_stats_intel_x64>(this->id()));
 
     fa1.ignore();
 
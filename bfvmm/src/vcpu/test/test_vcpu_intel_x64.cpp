@@ -33,13 +33,6 @@ virt_to_phys_ptr(void *ptr)
     return 0x0000000ABCDEF0000;
 }
 
-static const std::map<uintptr_t, memory_descriptor> &
-virt_to_phys_map() noexcept
-{
-    static std::map<uintptr_t, memory_descriptor> m_virt_to_phys_map;
-    return m_virt_to_phys_map;
-}
-
 void
 vcpu_ut::test_vcpu_intel_x64_invalid_id()
 {
@@ -123,7 +116,7 @@ vcpu_ut::test_vcpu_intel_x64_init_null_params_valid_intrinsics()
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -148,10 +141,11 @@ vcpu_ut::test_vcpu_intel_x64_init_valid_params_null_intrinsics()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -177,10 +171,11 @@ vcpu_ut::test_vcpu_intel_x64_init_valid()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -206,10 +201,11 @@ vcpu_ut::test_vcpu_intel_x64_init_vmcs_throws()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -248,7 +244,7 @@ vcpu_ut::test_vcpu_intel_x64_fini_null_params_valid_intrinsics()
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -274,10 +270,11 @@ vcpu_ut::test_vcpu_intel_x64_fini_valid_params_null_intrinsics()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -304,10 +301,11 @@ vcpu_ut::test_vcpu_intel_x64_fini_valid()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -359,10 +357,11 @@ vcpu_ut::test_vcpu_intel_x64_run_launch()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -395,10 +394,11 @@ vcpu_ut::test_vcpu_intel_x64_run_launch_is_host_vcpu()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -431,10 +431,11 @@ vcpu_ut::test_vcpu_intel_x64_run_resume()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -468,10 +469,11 @@ vcpu_ut::test_vcpu_intel_x64_run_no_init()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -503,10 +505,11 @@ vcpu_ut::test_vcpu_intel_x64_run_vmxon_throws()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -539,10 +542,11 @@ vcpu_ut::test_vcpu_intel_x64_run_vmcs_throws()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -575,10 +579,11 @@ vcpu_ut::test_vcpu_intel_x64_hlt_no_init()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -610,10 +615,11 @@ vcpu_ut::test_vcpu_intel_x64_hlt_no_run()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -646,10 +652,11 @@ vcpu_ut::test_vcpu_intel_x64_hlt_valid()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -683,10 +690,11 @@ vcpu_ut::test_vcpu_intel_x64_hlt_valid_is_host_vcpu()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
@@ -720,10 +728,11 @@ vcpu_ut::test_vcpu_intel_x64_hlt_vmxon_throws()
 
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_vmcs);
     mocks.OnCall(eh.get(), exit_handler_intel_x64::set_state_save);
+    mocks.OnCall(eh.get(), exit_handler_intel_x64::set_exit_stats);
 
     mocks.OnCallFunc(memory_manager::instance).Return(mm);
     mocks.OnCallOverload(mm, (uintptr_t(memory_manager::*)(void *))&memory_manager::virt_to_phys).Do(virt_to_phys_ptr);
-    mocks.OnCall(mm, memory_manager::virt_to_phys_map).Do(virt_to_phys_map);
+    mocks.OnCall(mm, memory_manager::set_range_listener);
 
     RUN_UNITTEST_WITH_MOCKS(mocks, [&]
     {
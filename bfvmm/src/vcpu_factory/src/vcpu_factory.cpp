@@ -20,11 +20,12 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
 #include <vcpu/vcpu_factory.h>
+#include <memory_manager/object_pool.h>
 
 std::shared_ptr<vcpu>
 vcpu_factory::make_vcpu(uint64_t vcpuid, void *attr)
 {
     (void) attr;
 
-    return std::make_shared<vcpu_intel_x64>(vcpuid);
+    return make_pooled<vcpu_intel_x64>(vcpuid);
 }
@@ -72,6 +72,7 @@ SOURCES+=vmcs_intel_x64_check_misc.cpp
 SOURCES+=vmcs_intel_x64_debug.cpp
 SOURCES+=vmcs_intel_x64_vmm_state.cpp
 SOURCES+=vmcs_intel_x64_host_vm_state.cpp
+SOURCES+=vmcs_field_cache_intel_x64.cpp
 SOURCES+=vmcs_intel_x64_promote.asm
 SOURCES+=vmcs_intel_x64_resume.asm
 
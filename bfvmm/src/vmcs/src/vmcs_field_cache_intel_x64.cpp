@@ -0,0 +1,124 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <vmcs/vmcs_field_cache_intel_x64.h>
+
+vmcs_field_cache_intel_x64::vmcs_field_cache_intel_x64() noexcept :
+    m_size(0),
+    m_num_dirty(0),
+    m_entries()
+{ }
+
+bool
+vmcs_field_cache_intel_x64::read(uint64_t field, uint64_t &value) const noexcept
+{
+    auto e = this->find(field);
+
+    if (e == nullptr)
+        return false;
+
+    value = e->value;
+    return true;
+}
+
+void
+vmcs_field_cache_intel_x64::fill(uint64_t field, uint64_t value) noexcept
+{
+    if (m_size == m_entries.size() || this->find(field) != nullptr)
+        return;
+
+    m_entries[m_size++] = {field, value, false};
+}
+
+bool
+vmcs_field_cache_intel_x64::write(uint64_t field, uint64_t value) noexcept
+{
+    auto e = this->find(field);
+
+    if (e == nullptr)
+    {
+        if (m_size == m_entries.size())
+            return false;
+
+        m_entries[m_size++] = {field, value, true};
+        m_num_dirty++;
+
+        return true;
+    }
+
+    if (e->value == value)
+        return true;
+
+    e->value = value;
+
+    if (!e->dirty)
+    {
+        e->dirty = true;
+        m_num_dirty++;
+    }
+
+    return true;
+}
+
+void
+vmcs_field_cache_intel_x64::flush(const writer_type &writer)
+{
+    if (m_num_dirty == 0)
+        return;
+
+    for (auto i = 0ULL; i < m_size; i++)
+    {
+        auto &e = m_entries[i];
+
+        if (!e.dirty)
+            continue;
+
+        writer(e.field, e.value);
+
+        e.dirty = false;
+        m_num_dirty--;
+    }
+}
+
+vmcs_field_cache_intel_x64::entry *
+vmcs_field_cache_intel_x64::find(uint64_t field) noexcept
+{
+    for (auto i = 0ULL; i < m_size; i++)
+    {
+        if (m_entries[i].field == field)
+            return &m_entries[i];
+    }
+
+    return nullptr;
+}
+
+const vmcs_field_cache_intel_x64::entry *
+vmcs_field_cache_intel_x64::find(uint64_t field) const noexcept
+{
+    for (auto i = 0ULL; i < m_size; i++)
+    {
+        if (m_entries[i].field == field)
+            return &m_entries[i];
+    }
+
+    return nullptr;
+}
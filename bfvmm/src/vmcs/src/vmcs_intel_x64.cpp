@@ -19,6 +19,7 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <atomic>
 #include <gsl/gsl>
 
 #include <debug.h>
@@ -28,14 +29,77 @@
 #include <vmcs/vmcs_intel_x64_resume.h>
 #include <vmcs/vmcs_intel_x64_promote.h>
 #include <memory_manager/memory_manager.h>
+#include <memory_manager/root_ept_intel_x64.h>
 #include <exit_handler/exit_handler_intel_x64_support.h>
 
+// Each VMCS is given its own VPID, so that the guest-linear translations
+// of each vCPU are tagged, and survive VM entries and exits. VPID 0 belongs
+// to the VMM (and VMX root operation in general), so it is skipped if the
+// counter ever wraps. Since a VPID can then be handed out again, launch()
+// flushes the VPID's stale translations before using it.
+
+static std::atomic<uint16_t> g_next_vpid(1);
+
+static uint16_t
+allocate_vpid() noexcept
+{
+    auto vpid = g_next_vpid++;
+
+    if (vpid == 0)
+        vpid = g_next_vpid++;
+
+    return vpid;
+}
+
+static bool
+msr_bitmap_location(uint32_t msr, std::ptrdiff_t &byte, uint8_t &mask) noexcept
+{
+    if (msr <= MSR_BITMAP_LOW_MSRS_LAST)
+        byte = msr >> 3;
+    else if (msr >= MSR_BITMAP_HIGH_MSRS_FIRST && msr <= MSR_BITMAP_HIGH_MSRS_LAST)
+        byte = MSR_BITMAP_HIGH_OFFSET + ((msr - MSR_BITMAP_HIGH_MSRS_FIRST) >> 3);
+    else
+        return false;
+
+    mask = static_cast<uint8_t>(1U << (msr & 0x7));
+    return true;
+}
+
 vmcs_intel_x64::vmcs_intel_x64(std::shared_ptr<intrinsics_intel_x64> intrinsics) :
     m_intrinsics(std::move(intrinsics)),
-    m_vmcs_region_phys(0)
+    m_vmcs_region_phys(0),
+    m_vpid(allocate_vpid()),
+    m_ept_attached(false),
+    m_ept_generation(0),
+    m_pml_phys(0),
+    m_msr_bitmap(std::make_unique<uint8_t[]>(MSR_BITMAP_SIZE)),
+    m_io_bitmaps(std::make_unique<uint8_t[]>(IO_BITMAP_SIZE * 2))
 {
     if (!m_intrinsics)
         m_intrinsics = std::make_shared<intrinsics_intel_x64>();
+
+    // By default, the only MSRs that exit are the ones whose guest state is
+    // held in the VMCS, and the undefined MSRs that the exit handler
+    // emulates for CPU-Z (see exit_handler_intel_x64::handle_rdmsr).
+    // Everything else (e.g. IA32_TSC_DEADLINE and IA32_SPEC_CTRL, which the
+    // host OS touches on every context switch) runs at native speed.
+
+    for (auto msr : std::initializer_list<uint32_t> {IA32_DEBUGCTL_MSR, IA32_PAT_MSR, IA32_EFER_MSR,
+                     IA32_PERF_GLOBAL_CTRL_MSR, IA32_SYSENTER_CS_MSR,
+                     IA32_SYSENTER_ESP_MSR, IA32_SYSENTER_EIP_MSR,
+                     IA32_FS_BASE_MSR, IA32_GS_BASE_MSR})
+    {
+        this->update_msr_bitmap(msr, MSR_BITMAP_READ_OFFSET, true);
+        this->update_msr_bitmap(msr, MSR_BITMAP_WRITE_OFFSET, true);
+    }
+
+    for (auto msr : {0x31U, 0x39U, 0x1AEU, 0x1AFU, 0x602U})
+        this->update_msr_bitmap(msr, MSR_BITMAP_READ_OFFSET, true);
+}
+
+vmcs_intel_x64::~vmcs_intel_x64()
+{
+    this->detach_ept();
 }
 
 void
@@ -46,10 +110,13 @@ vmcs_intel_x64::launch(const std::shared_ptr<vmcs_intel_x64_state> &host_state,
     {
         this->release_vmcs_region();
         this->release_exit_handler_stack();
+        this->release_pml();
+        this->detach_ept();
     });
 
     this->create_vmcs_region();
     this->create_exit_handler_stack();
+    this->create_pml();
 
     this->clear();
     this->load();
@@ -75,6 +142,14 @@ vmcs_intel_x64::launch(const std::shared_ptr<vmcs_intel_x64_state> &host_state,
     this->vm_exit_controls();
     this->vm_entry_controls();
 
+    if (this->is_supported_vpid_tagging())
+    {
+        if (!m_intrinsics->invvpid_single_context(m_vpid))
+            throw std::runtime_error("invvpid failed");
+    }
+
+    this->attach_ept();
+
     if (!m_intrinsics->vmlaunch())
     {
         this->dump_vmcs();
@@ -106,6 +181,34 @@ vmcs_intel_x64::launch(const std::shared_ptr<vmcs_intel_x64_state> &host_state,
 void
 vmcs_intel_x64::promote()
 {
+    // Translations that are tagged with a VPID or an EPTP survive VMXOFF,
+    // and VPIDs are handed out again (see allocate_vpid()), so they are all
+    // flushed before this core leaves VMX operation. If the CPU cannot
+    // flush all contexts, at least this vCPU's context is flushed.
+
+    auto ia32_vmx_ept_vpid_cap_msr =
+        m_intrinsics->read_msr(IA32_VMX_EPT_VPID_CAP_MSR);
+
+    if (this->is_supported_vpid_tagging())
+    {
+        auto flushed = (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_INVVPID_ALL_CONTEXTS) != 0 ?
+                       m_intrinsics->invvpid_all_contexts() : m_intrinsics->invvpid_single_context(m_vpid);
+
+        if (!flushed)
+            throw std::runtime_error("invvpid failed");
+    }
+
+    if (m_ept_attached)
+    {
+        auto flushed = (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_INVEPT_ALL_CONTEXTS) != 0 ?
+                       m_intrinsics->invept_all_contexts() : m_intrinsics->invept_single_context(g_ept->eptp());
+
+        if (!flushed)
+            throw std::runtime_error("invept failed");
+    }
+
+    this->detach_ept();
+
     vmcs_promote(vmread(VMCS_HOST_GS_BASE));
 
     throw std::runtime_error("vmcs promote failed");
@@ -114,6 +217,28 @@ vmcs_intel_x64::promote()
 void
 vmcs_intel_x64::resume()
 {
+    // The TLB might still hold translations that were marked as dirty
+    // before the EPT's dirty flags were last harvested, and writes through
+    // those translations would not set the dirty flags again, so the EPT's
+    // translations are flushed if there has been a harvest since this vCPU
+    // last resumed. The same goes for translations that were provided by
+    // tables that have since been unlinked from the EPT, which the root EPT
+    // only frees once each vCPU has acknowledged (see root_ept_intel_x64).
+    // Otherwise, this only costs a single atomic load.
+
+    if (m_ept_attached)
+    {
+        auto ept_generation = g_ept->generation();
+
+        if (ept_generation != m_ept_generation.load(std::memory_order_relaxed))
+        {
+            if (!m_intrinsics->invept_single_context(g_ept->eptp()))
+                throw std::runtime_error("invept failed");
+
+            m_ept_generation.store(ept_generation, std::memory_order_release);
+        }
+    }
+
     vmcs_resume(m_state_save.get());
 
     throw std::runtime_error("vmcs resume failed");
@@ -133,6 +258,56 @@ vmcs_intel_x64::clear()
         throw std::runtime_error("vmcs clear failed");
 }
 
+void
+vmcs_intel_x64::trap_read_msr(uint32_t msr)
+{ this->update_msr_bitmap(msr, MSR_BITMAP_READ_OFFSET, true); }
+
+void
+vmcs_intel_x64::trap_write_msr(uint32_t msr)
+{ this->update_msr_bitmap(msr, MSR_BITMAP_WRITE_OFFSET, true); }
+
+void
+vmcs_intel_x64::pass_through_msr(uint32_t msr)
+{
+    if (!this->update_msr_bitmap(msr, MSR_BITMAP_READ_OFFSET, false))
+        throw std::invalid_argument("msr is not covered by the msr bitmap");
+
+    this->update_msr_bitmap(msr, MSR_BITMAP_WRITE_OFFSET, false);
+}
+
+void
+vmcs_intel_x64::trap_io_port(uint16_t port)
+{
+    gsl::span<uint8_t> bitmaps{m_io_bitmaps.get(), IO_BITMAP_SIZE * 2};
+    bitmaps[port >> 3] |= static_cast<uint8_t>(1U << (port & 0x7));
+}
+
+void
+vmcs_intel_x64::pass_through_io_port(uint16_t port)
+{
+    gsl::span<uint8_t> bitmaps{m_io_bitmaps.get(), IO_BITMAP_SIZE * 2};
+    bitmaps[port >> 3] &= static_cast<uint8_t>(~(1U << (port & 0x7)));
+}
+
+bool
+vmcs_intel_x64::update_msr_bitmap(uint32_t msr, std::ptrdiff_t offset, bool trap) noexcept
+{
+    std::ptrdiff_t byte = 0;
+    uint8_t mask = 0;
+
+    if (!msr_bitmap_location(msr, byte, mask))
+        return false;
+
+    gsl::span<uint8_t> bitmap{m_msr_bitmap.get(), MSR_BITMAP_SIZE};
+
+    if (trap)
+        bitmap[offset + byte] |= mask;
+    else
+        bitmap[offset + byte] &= static_cast<uint8_t>(~mask);
+
+    return true;
+}
+
 void
 vmcs_intel_x64::create_vmcs_region()
 {
@@ -178,12 +353,70 @@ vmcs_intel_x64::release_exit_handler_stack()
     m_exit_handler_stack.reset();
 }
 
+void
+vmcs_intel_x64::create_pml()
+{
+    if (!this->is_supported_pml_logging())
+        return;
+
+    auto fa1 = gsl::finally([&]
+    { this->release_pml(); });
+
+    m_pml = std::make_unique<uint64_t[]>(PML_NUM_ENTRIES);
+    m_pml_phys = g_mm->virt_to_phys(m_pml.get());
+
+    if (m_pml_phys == 0)
+        throw std::logic_error("m_pml_phys == nullptr");
+
+    fa1.ignore();
+}
+
+void
+vmcs_intel_x64::release_pml()
+{
+    m_pml.reset();
+    m_pml_phys = 0;
+}
+
+void
+vmcs_intel_x64::attach_ept()
+{
+    // This core might still hold translations from a previous launch that
+    // used the same EPTP, so they are flushed before the vCPU is attached
+    // to the root EPT, having acknowledged the current generation.
+
+    if (!this->is_supported_ept_identity_map())
+        return;
+
+    auto ept_generation = g_ept->generation();
+
+    if (!m_intrinsics->invept_single_context(g_ept->eptp()))
+        throw std::runtime_error("invept failed");
+
+    m_ept_generation.store(ept_generation, std::memory_order_release);
+
+    g_ept->attach(&m_ept_generation);
+    m_ept_attached = true;
+}
+
+void
+vmcs_intel_x64::detach_ept() noexcept
+{
+    if (!m_ept_attached)
+        return;
+
+    g_ept->detach(&m_ept_generation);
+    m_ept_attached = false;
+}
+
 void
 vmcs_intel_x64::write_16bit_control_state(const std::shared_ptr<vmcs_intel_x64_state> &state)
 {
     (void) state;
 
-    // unused: VMCS_VIRTUAL_PROCESSOR_IDENTIFIER
+    if (this->is_supported_vpid_tagging())
+        vmwrite(VMCS_VIRTUAL_PROCESSOR_IDENTIFIER, m_vpid);
+
     // unused: VMCS_POSTED_INTERRUPT_NOTIFICATION_VECTOR
     // unused: VMCS_EPTP_INDEX
 }
@@ -193,9 +426,60 @@ vmcs_intel_x64::write_64bit_control_state(const std::shared_ptr<vmcs_intel_x64_s
 {
     (void) state;
 
-    // unused: VMCS_ADDRESS_OF_IO_BITMAP_A_FULL
-    // unused: VMCS_ADDRESS_OF_IO_BITMAP_B_FULL
-    // unused: VMCS_ADDRESS_OF_MSR_BITMAPS_FULL
+    // The EPT identity maps as much of the host's physical memory as the
+    // CPU can address, using 1GB pages when the CPU supports them, so that
+    // the host OS pays as little as possible (in TLB entries and page walk
+    // steps) for running with EPT turned on.
+
+    if (this->is_supported_ept_identity_map())
+    {
+        auto ia32_vmx_ept_vpid_cap_msr =
+            m_intrinsics->read_msr(IA32_VMX_EPT_VPID_CAP_MSR);
+        auto phys_addr_bits =
+            m_intrinsics->cpuid_eax(CPUID_ADDRESS_SIZES) & CPUID_ADDRESS_SIZES_EAX_PHYS_ADDR_BITS;
+
+        if ((ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_1G) != 0)
+            g_ept->set_max_page_size(PAGE_SIZE_1G);
+
+        if ((0x1ULL << phys_addr_bits) < EPT_IDENTITY_MAP_SIZE)
+            g_ept->set_identity_map_size(0x1ULL << phys_addr_bits);
+
+        if (this->is_supported_ept_accessed_dirty())
+            g_ept->enable_accessed_dirty();
+
+        vmwrite(VMCS_EPT_POINTER_FULL, g_ept->eptp());
+    }
+
+    if (this->is_supported_pml_logging())
+        vmwrite(VMCS_PML_ADDRESS_FULL, m_pml_phys);
+
+    // Bitmap A covers ports 0x0000 - 0x7FFF, and bitmap B covers ports
+    // 0x8000 - 0xFFFF, so they are stored back to back, and a port's bit
+    // can be found without knowing which bitmap it is in. They are still
+    // two pages as far as the CPU is concerned though.
+
+    if (this->is_supported_io_bitmaps())
+    {
+        auto io_bitmap_a_phys = g_mm->virt_to_phys(m_io_bitmaps.get());
+        auto io_bitmap_b_phys = g_mm->virt_to_phys(m_io_bitmaps.get() + IO_BITMAP_SIZE);
+
+        if (io_bitmap_a_phys == 0 || io_bitmap_b_phys == 0)
+            throw std::logic_error("io_bitmap_phys == nullptr");
+
+        vmwrite(VMCS_ADDRESS_OF_IO_BITMAP_A_FULL, io_bitmap_a_phys);
+        vmwrite(VMCS_ADDRESS_OF_IO_BITMAP_B_FULL, io_bitmap_b_phys);
+    }
+
+    if (this->is_supported_msr_bitmaps())
+    {
+        auto msr_bitmap_phys = g_mm->virt_to_phys(m_msr_bitmap.get());
+
+        if (msr_bitmap_phys == 0)
+            throw std::logic_error("msr_bitmap_phys == nullptr");
+
+        vmwrite(VMCS_ADDRESS_OF_MSR_BITMAPS_FULL, msr_bitmap_phys);
+    }
+
     // unused: VMCS_VM_EXIT_MSR_STORE_ADDRESS_FULL
     // unused: VMCS_VM_EXIT_MSR_LOAD_ADDRESS_FULL
     // unused: VMCS_VM_ENTRY_MSR_LOAD_ADDRESS_FULL
@@ -205,7 +489,6 @@ vmcs_intel_x64::write_64bit_control_state(const std::shared_ptr<vmcs_intel_x64_s
     // unused: VMCS_APIC_ACCESS_ADDRESS_FULL
     // unused: VMCS_POSTED_INTERRUPT_DESCRIPTOR_ADDRESS_FULL
     // unused: VMCS_VM_FUNCTION_CONTROLS_FULL
-    // unused: VMCS_EPT_POINTER_FULL
     // unused: VMCS_EOI_EXIT_BITMAP_0_FULL
     // unused: VMCS_EOI_EXIT_BITMAP_1_FULL
     // unused: VMCS_EOI_EXIT_BITMAP_2_FULL
@@ -293,6 +576,12 @@ vmcs_intel_x64::write_16bit_guest_state(const std::shared_ptr<vmcs_intel_x64_sta
     vmwrite(VMCS_GUEST_LDTR_SELECTOR, state->ldtr());
     vmwrite(VMCS_GUEST_TR_SELECTOR, state->tr());
 
+    // The CPU logs into the PML from the last entry down, and exits once
+    // the index drops below 0 (see exit_handler_intel_x64).
+
+    if (this->is_supported_pml_logging())
+        vmwrite(VMCS_GUEST_PML_INDEX, PML_INDEX_START);
+
     // unused: VMCS_GUEST_INTERRUPT_STATUS
 }
 
@@ -461,13 +750,17 @@ vmcs_intel_x64::primary_processor_based_vm_execution_controls()
     // controls |= VM_EXEC_P_PROC_BASED_NMI_WINDOW_EXITING;
     // controls |= VM_EXEC_P_PROC_BASED_MOV_DR_EXITING;
     // controls |= VM_EXEC_P_PROC_BASED_UNCONDITIONAL_IO_EXITING;
-    // controls |= VM_EXEC_P_PROC_BASED_USE_IO_BITMAPS;
     // controls |= VM_EXEC_P_PROC_BASED_MONITOR_TRAP_FLAG;
-    // controls |= VM_EXEC_P_PROC_BASED_USE_MSR_BITMAPS;
     // controls |= VM_EXEC_P_PROC_BASED_MONITOR_EXITING;
     // controls |= VM_EXEC_P_PROC_BASED_PAUSE_EXITING;
     controls |= VM_EXEC_P_PROC_BASED_ACTIVATE_SECONDARY_CONTROLS;
 
+    if (this->is_supported_io_bitmaps())
+        controls |= VM_EXEC_P_PROC_BASED_USE_IO_BITMAPS;
+
+    if (this->is_supported_msr_bitmaps())
+        controls |= VM_EXEC_P_PROC_BASED_USE_MSR_BITMAPS;
+
     this->filter_unsupported(IA32_VMX_TRUE_PROCBASED_CTLS_MSR, controls);
 
     vmwrite(VMCS_PRIMARY_PROCESSOR_BASED_VM_EXECUTION_CONTROLS, controls);
@@ -479,11 +772,9 @@ vmcs_intel_x64::secondary_processor_based_vm_execution_controls()
     auto controls = vmread(VMCS_SECONDARY_PROCESSOR_BASED_VM_EXECUTION_CONTROLS);
 
     // controls |= VM_EXEC_S_PROC_BASED_VIRTUALIZE_APIC_ACCESSES;
-    // controls |= VM_EXEC_S_PROC_BASED_ENABLE_EPT;
     // controls |= VM_EXEC_S_PROC_BASED_DESCRIPTOR_TABLE_EXITING;
     controls |= VM_EXEC_S_PROC_BASED_ENABLE_RDTSCP;
     // controls |= VM_EXEC_S_PROC_BASED_VIRTUALIZE_X2APIC_MODE;
-    // controls |= VM_EXEC_S_PROC_BASED_ENABLE_VPID;
     // controls |= VM_EXEC_S_PROC_BASED_WBINVD_EXITING;
     // controls |= VM_EXEC_S_PROC_BASED_UNRESTRICTED_GUEST;
     // controls |= VM_EXEC_S_PROC_BASED_APIC_REGISTER_VIRTUALIZATION;
@@ -497,6 +788,15 @@ vmcs_intel_x64::secondary_processor_based_vm_execution_controls()
     // controls |= VM_EXEC_S_PROC_BASED_EPT_VIOLATION_VE;
     controls |= VM_EXEC_S_PROC_BASED_ENABLE_XSAVES_XRSTORS;
 
+    if (this->is_supported_ept_identity_map())
+        controls |= VM_EXEC_S_PROC_BASED_ENABLE_EPT;
+
+    if (this->is_supported_vpid_tagging())
+        controls |= VM_EXEC_S_PROC_BASED_ENABLE_VPID;
+
+    if (this->is_supported_pml_logging())
+        controls |= VM_EXEC_S_PROC_BASED_ENABLE_PML;
+
     this->filter_unsupported(IA32_VMX_PROCBASED_CTLS2_MSR, controls);
 
     vmwrite(VMCS_SECONDARY_PROCESSOR_BASED_VM_EXECUTION_CONTROLS, controls);
@@ -569,6 +869,69 @@ vmcs_intel_x64::vmwrite(uint64_t field, uint64_t value)
     }
 }
 
+bool
+vmcs_intel_x64::is_supported_ept_identity_map() const
+{
+    // The identity map uses a 4 level EPT, that is write-back, and is made
+    // of 2MB (or larger) pages, so EPT is only turned on if the CPU supports
+    // all of these, and if the root EPT has been opted into.
+
+    if (!g_ept->is_enabled())
+        return false;
+
+    if (!this->is_supported_secondary_controls() || !this->is_supported_ept())
+        return false;
+
+    auto ia32_vmx_ept_vpid_cap_msr =
+        m_intrinsics->read_msr(IA32_VMX_EPT_VPID_CAP_MSR);
+
+    return (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_PAGE_WALK_LENGTH_4) != 0 &&
+           (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_WB) != 0 &&
+           (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_2M) != 0;
+}
+
+bool
+vmcs_intel_x64::is_supported_vpid_tagging() const
+{
+    // A VPID is only used if the CPU can also flush it (see launch()).
+
+    if (!this->is_supported_secondary_controls() || !this->is_supported_vpid())
+        return false;
+
+    auto ia32_vmx_ept_vpid_cap_msr =
+        m_intrinsics->read_msr(IA32_VMX_EPT_VPID_CAP_MSR);
+
+    return (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_INVVPID) != 0 &&
+           (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_INVVPID_SINGLE_CONTEXT) != 0;
+}
+
+bool
+vmcs_intel_x64::is_supported_ept_accessed_dirty() const
+{
+    // The accessed and dirty flags are only turned on if the CPU can
+    // also flush the EPT's translations, as each vCPU has to INVEPT
+    // once the dirty flags have been harvested (see resume()).
+
+    if (!this->is_supported_ept_identity_map())
+        return false;
+
+    auto ia32_vmx_ept_vpid_cap_msr =
+        m_intrinsics->read_msr(IA32_VMX_EPT_VPID_CAP_MSR);
+
+    return (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_AD) != 0 &&
+           (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_INVEPT) != 0 &&
+           (ia32_vmx_ept_vpid_cap_msr & IA32_VMX_EPT_VPID_CAP_INVEPT_SINGLE_CONTEXT) != 0;
+}
+
+bool
+vmcs_intel_x64::is_supported_pml_logging() const
+{
+    // The CPU only logs a page when it sets the page's EPT dirty flag, so
+    // PML is only turned on if the EPT's dirty flags are.
+
+    return this->is_supported_ept_accessed_dirty() && this->is_supported_pml();
+}
+
 void
 vmcs_intel_x64::filter_unsupported(uint64_t msr, uint64_t &ctrl)
 {
@@ -54,6 +54,7 @@ vmcs_intel_x64::checks_on_vm_execution_control_fields()
     check_control_unrestricted_guests();
     check_control_enable_vm_functions();
     check_control_enable_vmcs_shadowing();
+    check_control_enable_pml_checks();
     check_control_enable_ept_violation_checks();
 }
 
@@ -424,6 +425,25 @@ vmcs_intel_x64::check_control_enable_vmcs_shadowing()
         throw std::logic_error("vmcs write bitmap address addr too large");
 }
 
+void
+vmcs_intel_x64::check_control_enable_pml_checks()
+{
+    if (!is_enabled_pml())
+        return;
+
+    if (!is_enabled_ept())
+        throw std::logic_error("ept must be enabled if pml is enabled");
+
+    auto vmcs_pml_address =
+        vmread(VMCS_PML_ADDRESS_FULL);
+
+    if ((vmcs_pml_address & 0x0000000000000FFF) != 0)
+        throw std::logic_error("bits 11:0 must be 0 for the vmcs pml address");
+
+    if (!is_physical_address_valid(vmcs_pml_address))
+        throw std::logic_error("vmcs pml address addr too large");
+}
+
 void
 vmcs_intel_x64::check_control_enable_ept_violation_checks()
 {
@@ -814,6 +814,20 @@ vmcs_intel_x64::is_enabled_rdseed_exiting() const
     return true;
 }
 
+bool
+vmcs_intel_x64::is_enabled_pml() const
+{
+    auto ctls = get_proc2_ctls();
+
+    if ((ctls & VM_EXEC_S_PROC_BASED_ENABLE_PML) == 0)
+        return false;
+
+    if (!is_supported_pml())
+        return false;
+
+    return true;
+}
+
 bool
 vmcs_intel_x64::is_enabled_ept_violation_ve() const
 {
@@ -1444,6 +1458,15 @@ vmcs_intel_x64::is_supported_rdseed_exiting() const
     return (ia32_vmx_procbased_ctls2_msr & (VM_EXEC_S_PROC_BASED_RDSEED_EXITING << 32)) != 0;
 }
 
+bool
+vmcs_intel_x64::is_supported_pml() const
+{
+    auto ia32_vmx_procbased_ctls2_msr =
+        m_intrinsics->read_msr(IA32_VMX_PROCBASED_CTLS2_MSR);
+
+    return (ia32_vmx_procbased_ctls2_msr & (VM_EXEC_S_PROC_BASED_ENABLE_PML << 32)) != 0;
+}
+
 bool
 vmcs_intel_x64::is_supported_ept_violation_ve() const
 {
@@ -84,6 +84,7 @@ vmcs_intel_x64::dump_vmcs_16bit_guest_state()
     PRINT_FIELD(true, VMCS_GUEST_TR_SELECTOR);
     PRINT_FIELD(is_supported_virtual_interrupt_delivery(),
                 VMCS_GUEST_INTERRUPT_STATUS);
+    PRINT_FIELD(is_supported_pml(), VMCS_GUEST_PML_INDEX);
 }
 
 void
@@ -121,6 +122,8 @@ vmcs_intel_x64::dump_vmcs_64bit_control_state()
     PRINT_FIELD(true, VMCS_VM_ENTRY_MSR_LOAD_ADDRESS_HIGH);
     PRINT_FIELD(true, VMCS_EXECUTIVE_VMCS_POINTER_FULL);
     PRINT_FIELD(true, VMCS_EXECUTIVE_VMCS_POINTER_HIGH);
+    PRINT_FIELD(is_supported_pml(), VMCS_PML_ADDRESS_FULL);
+    PRINT_FIELD(is_supported_pml(), VMCS_PML_ADDRESS_HIGH);
     PRINT_FIELD(true, VMCS_TSC_OFFSET_FULL);
     PRINT_FIELD(true, VMCS_TSC_OFFSET_HIGH);
     PRINT_FIELD(is_supported_tpr_shadow(),
@@ -501,6 +504,7 @@ vmcs_intel_x64::print_secondary_processor_based_vm_execution_controls()
     PRINT_CONTROL(VM_EXEC_S_PROC_BASED_ENABLE_VM_FUNCTIONS);
     PRINT_CONTROL(VM_EXEC_S_PROC_BASED_VMCS_SHADOWING);
     PRINT_CONTROL(VM_EXEC_S_PROC_BASED_RDSEED_EXITING);
+    PRINT_CONTROL(VM_EXEC_S_PROC_BASED_ENABLE_PML);
     PRINT_CONTROL(VM_EXEC_S_PROC_BASED_EPT_VIOLATION_VE);
     PRINT_CONTROL(VM_EXEC_S_PROC_BASED_ENABLE_XSAVES_XRSTORS);
 
@@ -20,10 +20,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
 #include <vmcs/vmcs_intel_x64_vmm_state.h>
-#include <memory_manager/memory_manager.h>
-#include <memory_manager/page_table_x64.h>
-
-std::shared_ptr<page_table_x64> m_pml4;
+#include <memory_manager/root_page_table_x64.h>
 
 vmcs_intel_x64_vmm_state::vmcs_intel_x64_vmm_state(const std::shared_ptr<state_save_intel_x64> &state_save) :
     m_gdt(6),
@@ -87,31 +84,12 @@ vmcs_intel_x64_vmm_state::vmcs_intel_x64_vmm_state(const std::shared_ptr<state_s
     m_gs = m_gs_index << 3;
     m_tr = m_tr_index << 3;
 
-    // TODO: We need to guard the additions to the page tables here. Just
-    // in case more than one core attempts to change these at the same time.
-
-    if (!m_pml4)
-    {
-        m_pml4 = std::make_shared<page_table_x64>();
-
-        for (const auto &md : g_mm->virt_to_phys_map())
-        {
-            auto entry = m_pml4->add_page(md.second.virt);
-
-            entry->set_phys_addr(md.second.phys);
-            entry->set_present(true);
-
-            if ((md.second.type & MEMORY_TYPE_W) != 0)
-                entry->set_rw(true);
-            else
-                entry->set_rw(false);
+    // The host page tables are shared by every core, and are built by
+    // whichever core gets here first. 1GB pages are optional, and are only
+    // used if the CPU says it supports them.
 
-            if ((md.second.type & MEMORY_TYPE_E) != 0)
-                entry->set_nx(false);
-            else
-                entry->set_nx(true);
-        }
-    }
+    if ((__cpuid_edx(CPUID_EXTENDED_FEATURE_BITS) & CPUID_EXTENDED_FEATURE_EDX_PDPE1GB) != 0)
+        g_pt->set_max_page_size(PAGE_SIZE_1G);
 
     m_cr0 = 0;
     m_cr0 |= CRO_PE_PROTECTION_ENABLE;
@@ -119,7 +97,7 @@ vmcs_intel_x64_vmm_state::vmcs_intel_x64_vmm_state(const std::shared_ptr<state_s
     m_cr0 |= CR0_NE_NUMERIC_ERROR;
     m_cr0 |= CR0_PG_PAGING;
 
-    m_cr3 = m_pml4->phys_addr();
+    m_cr3 = g_pt->cr3();
 
     m_cr4 = 0;
     m_cr4 |= CR4_PAE_PHYSICAL_ADDRESS_EXTENSIONS;
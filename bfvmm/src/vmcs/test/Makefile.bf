@@ -51,6 +51,7 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 
 SOURCES+=test.cpp
 SOURCES+=test_vmcs_intel_x64.cpp
+SOURCES+=test_vmcs_field_cache_intel_x64.cpp
 
 INCLUDE_PATHS+=./
 INCLUDE_PATHS+=%HYPER_ABS%/include/
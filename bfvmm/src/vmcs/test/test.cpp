@@ -40,6 +40,22 @@ vmcs_ut::fini()
 bool
 vmcs_ut::list()
 {
+    this->test_msr_bitmap_default_policy();
+    this->test_msr_bitmap_trap_read();
+    this->test_msr_bitmap_trap_write();
+    this->test_msr_bitmap_pass_through();
+    this->test_msr_bitmap_high_msrs();
+    this->test_msr_bitmap_out_of_range();
+    this->test_io_bitmap_default_policy();
+    this->test_io_bitmap_trap_and_pass_through();
+    this->test_field_cache_read_fill();
+    this->test_field_cache_write_flush();
+    this->test_field_cache_unchanged_write();
+    this->test_field_cache_full();
+    this->test_field_cache_invalidate();
+    this->test_promote_flushes_all_contexts();
+    this->test_promote_flushes_single_context();
+
     return true;
 }
 
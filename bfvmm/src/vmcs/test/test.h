@@ -39,6 +39,21 @@ protected:
 
 private:
 
+    void test_msr_bitmap_default_policy();
+    void test_msr_bitmap_trap_read();
+    void test_msr_bitmap_trap_write();
+    void test_msr_bitmap_pass_through();
+    void test_msr_bitmap_high_msrs();
+    void test_msr_bitmap_out_of_range();
+    void test_io_bitmap_default_policy();
+    void test_io_bitmap_trap_and_pass_through();
+    void test_field_cache_read_fill();
+    void test_field_cache_write_flush();
+    void test_field_cache_unchanged_write();
+    void test_field_cache_full();
+    void test_field_cache_invalidate();
+    void test_promote_flushes_all_contexts();
+    void test_promote_flushes_single_context();
 };
 
 #endif
@@ -0,0 +1,146 @@
+//
+// Bareflank Hypervisor
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <test.h>
+#include <vector>
+#include <intrinsics/intrinsics_intel_x64.h>
+#include <vmcs/vmcs_field_cache_intel_x64.h>
+
+using write_list = std::vector<std::pair<uint64_t, uint64_t>>;
+
+void
+vmcs_ut::test_field_cache_read_fill()
+{
+    uint64_t value = 0;
+    vmcs_field_cache_intel_x64 cache;
+
+    EXPECT_FALSE(cache.read(VMCS_GUEST_RIP, value));
+
+    cache.fill(VMCS_GUEST_RIP, 0x1000);
+    EXPECT_TRUE(cache.read(VMCS_GUEST_RIP, value));
+    EXPECT_TRUE(value == 0x1000);
+
+    // A field that is already cached is never refilled
+
+    cache.fill(VMCS_GUEST_RIP, 0x2000);
+    EXPECT_TRUE(cache.read(VMCS_GUEST_RIP, value));
+    EXPECT_TRUE(value == 0x1000);
+
+    EXPECT_TRUE(cache.size() == 1);
+    EXPECT_TRUE(cache.num_dirty() == 0);
+}
+
+void
+vmcs_ut::test_field_cache_write_flush()
+{
+    uint64_t value = 0;
+    write_list writes;
+    vmcs_field_cache_intel_x64 cache;
+
+    cache.fill(VMCS_GUEST_RFLAGS, 0x2);
+
+    EXPECT_TRUE(cache.write(VMCS_GUEST_RFLAGS, 0x202));
+    EXPECT_TRUE(cache.write(VMCS_GUEST_RFLAGS, 0x302));
+    EXPECT_TRUE(cache.write(VMCS_GUEST_RIP, 0x1000));
+
+    EXPECT_TRUE(cache.read(VMCS_GUEST_RFLAGS, value));
+    EXPECT_TRUE(value == 0x302);
+    EXPECT_TRUE(cache.num_dirty() == 2);
+
+    cache.flush([&](uint64_t f, uint64_t v)
+    { writes.push_back({f, v}); });
+
+    EXPECT_TRUE(writes.size() == 2);
+    EXPECT_TRUE(writes[0].first == VMCS_GUEST_RFLAGS);
+    EXPECT_TRUE(writes[0].second == 0x302);
+    EXPECT_TRUE(writes[1].first == VMCS_GUEST_RIP);
+    EXPECT_TRUE(writes[1].second == 0x1000);
+    EXPECT_TRUE(cache.num_dirty() == 0);
+
+    // Flushed fields stay cached, but are not written again
+
+    EXPECT_TRUE(cache.read(VMCS_GUEST_RIP, value));
+    EXPECT_TRUE(value == 0x1000);
+
+    cache.flush([&](uint64_t f, uint64_t v)
+    { writes.push_back({f, v}); });
+
+    EXPECT_TRUE(writes.size() == 2);
+}
+
+void
+vmcs_ut::test_field_cache_unchanged_write()
+{
+    write_list writes;
+    vmcs_field_cache_intel_x64 cache;
+
+    cache.fill(VMCS_GUEST_CR0, 0x80000031);
+    EXPECT_TRUE(cache.write(VMCS_GUEST_CR0, 0x80000031));
+    EXPECT_TRUE(cache.num_dirty() == 0);
+
+    cache.flush([&](uint64_t f, uint64_t v)
+    { writes.push_back({f, v}); });
+
+    EXPECT_TRUE(writes.empty());
+}
+
+void
+vmcs_ut::test_field_cache_full()
+{
+    uint64_t value = 0;
+    vmcs_field_cache_intel_x64 cache;
+
+    for (auto i = 0ULL; i < VMCS_FIELD_CACHE_SIZE; i++)
+        cache.fill(i, i);
+
+    EXPECT_TRUE(cache.size() == VMCS_FIELD_CACHE_SIZE);
+
+    cache.fill(VMCS_FIELD_CACHE_SIZE, 0);
+    EXPECT_FALSE(cache.read(VMCS_FIELD_CACHE_SIZE, value));
+    EXPECT_FALSE(cache.write(VMCS_FIELD_CACHE_SIZE, 0));
+
+    // Fields that are already cached can still be written
+
+    EXPECT_TRUE(cache.write(0, 1));
+    EXPECT_TRUE(cache.num_dirty() == 1);
+}
+
+void
+vmcs_ut::test_field_cache_invalidate()
+{
+    uint64_t value = 0;
+    write_list writes;
+    vmcs_field_cache_intel_x64 cache;
+
+    cache.fill(VMCS_GUEST_CR3, 0x1000);
+    cache.write(VMCS_GUEST_CR4, 0x2000);
+    cache.invalidate();
+
+    EXPECT_TRUE(cache.size() == 0);
+    EXPECT_TRUE(cache.num_dirty() == 0);
+    EXPECT_FALSE(cache.read(VMCS_GUEST_CR3, value));
+
+    cache.flush([&](uint64_t f, uint64_t v)
+    { writes.push_back({f, v}); });
+
+    EXPECT_TRUE(writes.empty());
+}
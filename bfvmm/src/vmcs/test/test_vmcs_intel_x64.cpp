@@ -20,3 +20,190 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
 #include <test.h>
+#include <vmcs/vmcs_intel_x64.h>
+#include <vmcs/vmcs_intel_x64_promote.h>
+
+static bool
+msr_trapped(const std::unique_ptr<uint8_t[]> &bitmap, uint32_t msr, uint32_t offset)
+{
+    if (msr >= MSR_BITMAP_HIGH_MSRS_FIRST)
+    {
+        msr -= MSR_BITMAP_HIGH_MSRS_FIRST;
+        offset += MSR_BITMAP_HIGH_OFFSET;
+    }
+
+    return (bitmap[offset + (msr >> 3)] & (1U << (msr & 0x7))) != 0;
+}
+
+static bool
+io_trapped(const std::unique_ptr<uint8_t[]> &bitmaps, uint32_t port)
+{ return (bitmaps[port >> 3] & (1U << (port & 0x7))) != 0; }
+
+void
+vmcs_ut::test_msr_bitmap_default_policy()
+{
+    vmcs_intel_x64 vmcs;
+
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, IA32_EFER_MSR, MSR_BITMAP_READ_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, IA32_EFER_MSR, MSR_BITMAP_WRITE_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, IA32_SYSENTER_CS_MSR, MSR_BITMAP_READ_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, IA32_SYSENTER_CS_MSR, MSR_BITMAP_WRITE_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, IA32_GS_BASE_MSR, MSR_BITMAP_READ_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, IA32_GS_BASE_MSR, MSR_BITMAP_WRITE_OFFSET));
+
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, 0x602, MSR_BITMAP_READ_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0x602, MSR_BITMAP_WRITE_OFFSET));
+
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0x6E0, MSR_BITMAP_READ_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0x6E0, MSR_BITMAP_WRITE_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0xC0000102, MSR_BITMAP_READ_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0xC0000102, MSR_BITMAP_WRITE_OFFSET));
+}
+
+void
+vmcs_ut::test_msr_bitmap_trap_read()
+{
+    vmcs_intel_x64 vmcs;
+
+    vmcs.trap_read_msr(0x48);
+
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, 0x48, MSR_BITMAP_READ_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0x48, MSR_BITMAP_WRITE_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0x49, MSR_BITMAP_READ_OFFSET));
+}
+
+void
+vmcs_ut::test_msr_bitmap_trap_write()
+{
+    vmcs_intel_x64 vmcs;
+
+    vmcs.trap_write_msr(0x48);
+
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0x48, MSR_BITMAP_READ_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, 0x48, MSR_BITMAP_WRITE_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, 0x49, MSR_BITMAP_WRITE_OFFSET));
+}
+
+void
+vmcs_ut::test_msr_bitmap_pass_through()
+{
+    vmcs_intel_x64 vmcs;
+
+    vmcs.pass_through_msr(IA32_EFER_MSR);
+
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, IA32_EFER_MSR, MSR_BITMAP_READ_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, IA32_EFER_MSR, MSR_BITMAP_WRITE_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, IA32_FS_BASE_MSR, MSR_BITMAP_READ_OFFSET));
+}
+
+void
+vmcs_ut::test_msr_bitmap_high_msrs()
+{
+    vmcs_intel_x64 vmcs;
+
+    vmcs.trap_read_msr(MSR_BITMAP_HIGH_MSRS_LAST);
+    vmcs.trap_write_msr(MSR_BITMAP_HIGH_MSRS_LAST);
+
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, MSR_BITMAP_HIGH_MSRS_LAST, MSR_BITMAP_READ_OFFSET));
+    EXPECT_TRUE(msr_trapped(vmcs.m_msr_bitmap, MSR_BITMAP_HIGH_MSRS_LAST, MSR_BITMAP_WRITE_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, MSR_BITMAP_LOW_MSRS_LAST, MSR_BITMAP_READ_OFFSET));
+    EXPECT_FALSE(msr_trapped(vmcs.m_msr_bitmap, MSR_BITMAP_LOW_MSRS_LAST, MSR_BITMAP_WRITE_OFFSET));
+}
+
+void
+vmcs_ut::test_msr_bitmap_out_of_range()
+{
+    vmcs_intel_x64 vmcs;
+
+    EXPECT_NO_EXCEPTION(vmcs.trap_read_msr(0x40000000));
+    EXPECT_NO_EXCEPTION(vmcs.trap_write_msr(0x40000000));
+    EXPECT_EXCEPTION(vmcs.pass_through_msr(0x40000000), std::invalid_argument);
+    EXPECT_EXCEPTION(vmcs.pass_through_msr(MSR_BITMAP_HIGH_MSRS_LAST + 1), std::invalid_argument);
+}
+
+void
+vmcs_ut::test_io_bitmap_default_policy()
+{
+    vmcs_intel_x64 vmcs;
+    auto trapped = 0U;
+
+    for (auto port = 0U; port < IO_BITMAP_NUM_PORTS; port++)
+        trapped += io_trapped(vmcs.m_io_bitmaps, port) ? 1U : 0U;
+
+    EXPECT_TRUE(trapped == 0);
+}
+
+void
+vmcs_ut::test_io_bitmap_trap_and_pass_through()
+{
+    vmcs_intel_x64 vmcs;
+
+    vmcs.trap_io_port(0x0080);
+    vmcs.trap_io_port(0x7FFF);
+    vmcs.trap_io_port(0x8000);
+    vmcs.trap_io_port(0xFFFF);
+
+    EXPECT_TRUE(io_trapped(vmcs.m_io_bitmaps, 0x0080));
+    EXPECT_FALSE(io_trapped(vmcs.m_io_bitmaps, 0x0081));
+    EXPECT_TRUE(io_trapped(vmcs.m_io_bitmaps, 0x7FFF));
+    EXPECT_TRUE(vmcs.m_io_bitmaps[IO_BITMAP_SIZE - 1] == 0x80);
+    EXPECT_TRUE(io_trapped(vmcs.m_io_bitmaps, 0x8000));
+    EXPECT_TRUE(vmcs.m_io_bitmaps[IO_BITMAP_SIZE] == 0x01);
+    EXPECT_TRUE(io_trapped(vmcs.m_io_bitmaps, 0xFFFF));
+
+    vmcs.pass_through_io_port(0x0080);
+    vmcs.pass_through_io_port(0x8000);
+
+    EXPECT_FALSE(io_trapped(vmcs.m_io_bitmaps, 0x0080));
+    EXPECT_FALSE(io_trapped(vmcs.m_io_bitmaps, 0x8000));
+    EXPECT_TRUE(io_trapped(vmcs.m_io_bitmaps, 0x7FFF));
+    EXPECT_TRUE(io_trapped(vmcs.m_io_bitmaps, 0xFFFF));
+}
+
+void
+vmcs_ut::test_promote_flushes_all_contexts()
+{
+    MockRepository mocks;
+    auto in = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(in.get(), intrinsics_intel_x64::read_msr).Return(0xFFFFFFFFFFFFFFFF);
+    mocks.OnCall(in.get(), intrinsics_intel_x64::vmread).Return(true);
+    mocks.OnCallFunc(vmcs_promote);
+
+    mocks.ExpectCall(in.get(), intrinsics_intel_x64::invvpid_all_contexts).Return(true);
+    mocks.ExpectCall(in.get(), intrinsics_intel_x64::invept_all_contexts).Return(true);
+    mocks.NeverCall(in.get(), intrinsics_intel_x64::invvpid_single_context);
+    mocks.NeverCall(in.get(), intrinsics_intel_x64::invept_single_context);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        vmcs_intel_x64 vmcs(in);
+        vmcs.m_ept_attached = true;
+
+        EXPECT_EXCEPTION(vmcs.promote(), std::runtime_error);
+        EXPECT_FALSE(vmcs.m_ept_attached);
+    });
+}
+
+void
+vmcs_ut::test_promote_flushes_single_context()
+{
+    MockRepository mocks;
+    auto in = bfn::mock_shared<intrinsics_intel_x64>(mocks);
+
+    mocks.OnCall(in.get(), intrinsics_intel_x64::read_msr).Return(~IA32_VMX_EPT_VPID_CAP_INVVPID_ALL_CONTEXTS);
+    mocks.OnCall(in.get(), intrinsics_intel_x64::vmread).Return(true);
+    mocks.OnCallFunc(vmcs_promote);
+
+    mocks.NeverCall(in.get(), intrinsics_intel_x64::invvpid_all_contexts);
+    mocks.NeverCall(in.get(), intrinsics_intel_x64::invept_all_contexts);
+    mocks.NeverCall(in.get(), intrinsics_intel_x64::invept_single_context);
+
+    RUN_UNITTEST_WITH_MOCKS(mocks, [&]
+    {
+        vmcs_intel_x64 vmcs(in);
+
+        mocks.ExpectCall(in.get(), intrinsics_intel_x64::invvpid_single_context).With(vmcs.vpid()).Return(false);
+        EXPECT_EXCEPTION(vmcs.promote(), std::runtime_error);
+    });
+}
@@ -97,12 +97,181 @@
  * Max Page Pool
  *
  * This defines the internal memory that the hypervisor allocates to use
- * for allocating pages.
+ * for allocating pages. The page pool is managed by a buddy allocator, so
+ * the largest naturally aligned allocation that can be made is the largest
+ * power of two pages that fits in the pool. The default is large enough for
+ * a 2MB allocation, aligned to 2MB relative to the start of the pool (the
+ * pool itself is only page aligned).
  *
- * Note: defined in bytes (defaults to 8MB)
+ * Note: defined in pages (defaults to 2MB)
  */
 #ifndef MAX_PAGE_POOL
-#define MAX_PAGE_POOL (256)
+#define MAX_PAGE_POOL (512)
+#endif
+
+/*
+ * Max Number of Pools
+ *
+ * Defines the number of page pools that the driver entry can add to the VMM
+ * in addition to the page pool defined by MAX_PAGE_POOL. The driver entry
+ * adds one pool per CPU when the VMM is loaded, so if the system has more
+ * CPUs than this, the remaining CPUs do not get their own pool.
+ */
+#ifndef MAX_NUM_POOLS
+#define MAX_NUM_POOLS (128ULL)
+#endif
+
+/*
+ * Pool Size
+ *
+ * Defines the size of each page pool that the driver entry adds to the VMM.
+ * A few pages of each pool are used by the VMM to keep track of the rest.
+ *
+ * Note: defined in bytes (defaults to 1MB)
+ */
+#ifndef POOL_SIZE
+#define POOL_SIZE (256 * MAX_PAGE_SIZE)
+#endif
+
+/*
+ * Zeroed Pages
+ *
+ * Defines the number of pages that the memory manager zeroes ahead of time
+ * so that page sized callocs do not have to zero the page when they are
+ * made. The list is topped up each time a vCPU is started.
+ */
+#ifndef ZEROED_PAGES
+#define ZEROED_PAGES (32ULL)
+#endif
+
+/*
+ * Max Magazines
+ *
+ * Small heap allocations are served from a per-core magazine cache before
+ * the global heap is consulted, so that the common malloc / free path does
+ * not need the global heap lock. This defines the number of magazines that
+ * are available. Cores are mapped to a magazine using a hash of the stack
+ * they are running on, so if the system has more cores than this, some cores
+ * will share a magazine.
+ */
+#ifndef MAX_MAGAZINES
+#define MAX_MAGAZINES (64ULL)
+#endif
+
+/*
+ * Magazine Max Blocks
+ *
+ * Defines the largest heap allocation (in 8 byte blocks, including the
+ * block header) that is served by the magazines. Larger allocations always
+ * go to the global heap.
+ *
+ * Note: defined in blocks (defaults to 120 bytes of usable memory)
+ */
+#ifndef MAGAZINE_MAX_BLOCKS
+#define MAGAZINE_MAX_BLOCKS (16ULL)
+#endif
+
+/*
+ * Magazine Size
+ *
+ * Defines the number of cached allocations each magazine can hold per size
+ * class. When a magazine is empty, it is refilled from the global heap with
+ * MAGAZINE_BATCH allocations, and when it is full, MAGAZINE_BATCH
+ * allocations are returned to the global heap, both while taking the global
+ * heap lock only once.
+ */
+#ifndef MAGAZINE_SIZE
+#define MAGAZINE_SIZE (32ULL)
+#endif
+
+#ifndef MAGAZINE_BATCH
+#define MAGAZINE_BATCH (MAGAZINE_SIZE / 2)
+#endif
+
+/*
+ * Object Pool Slab Size
+ *
+ * Objects that the VMM creates in bulk (page tables, vCPU components, etc.)
+ * are allocated from typed object pools instead of the heap. Each object
+ * pool carves it's objects out of slabs of this size, which should be a
+ * multiple of MAX_PAGE_SIZE so that the slabs come from the page pools,
+ * and are page aligned.
+ *
+ * Note: defined in bytes
+ */
+#ifndef OBJECT_POOL_SLAB_SIZE
+#define OBJECT_POOL_SLAB_SIZE (4 * MAX_PAGE_SIZE)
+#endif
+
+/*
+ * Translation Cache Size
+ *
+ * Each vCPU caches the results of the software page walks that it performs
+ * (for example, to read guest instruction bytes), in a direct mapped cache
+ * with this many entries. Must be a power of 2.
+ *
+ * Note: defined in entries
+ */
+#ifndef TRANSLATION_CACHE_SIZE
+#define TRANSLATION_CACHE_SIZE (64)
+#endif
+
+/*
+ * Dirty Ring Size
+ *
+ * Each vCPU hands the guest physical pages that its page-modification log
+ * reports as dirty to consumers through a ring with this many entries. If
+ * the consumers fall behind, and the ring fills up, pages are dropped (and
+ * counted), so a consumer that sees drops has to fall back to a full scan
+ * of the EPT's dirty flags. Must be a power of 2.
+ *
+ * Note: defined in entries
+ */
+#ifndef DIRTY_RING_SIZE
+#define DIRTY_RING_SIZE (4096)
+#endif
+
+/*
+ * VMCS Field Cache Size
+ *
+ * The number of VMCS fields that the exit handler's field cache can hold
+ * during a single exit (when the cache is enabled). Fields that do not fit
+ * are read from, and written to the VMCS directly, so this only needs to be
+ * large enough for the fields that a typical exit touches.
+ *
+ * Note: defined in fields
+ */
+#ifndef VMCS_FIELD_CACHE_SIZE
+#define VMCS_FIELD_CACHE_SIZE (32)
+#endif
+
+/*
+ * EPT Harvest Sync Attempts
+ *
+ * After harvesting the EPT's dirty flags, the VMM waits for each vCPU to
+ * acknowledge the harvest (by flushing its cached translations the next
+ * time it exits), checking this many times before it gives up, and reports
+ * the harvest as approximate. Each check forces the calling core to exit.
+ *
+ * Note: defined in attempts
+ */
+#ifndef EPT_HARVEST_SYNC_ATTEMPTS
+#define EPT_HARVEST_SYNC_ATTEMPTS (100000ULL)
+#endif
+
+/*
+ * EPT Identity Map Size
+ *
+ * The EPT maps guest physical memory 1:1 to host physical memory, from 0 up
+ * to this size (or the CPU's physical address width, whichever is smaller).
+ * 1GB pages are used if the CPU supports them, in which case each 512GB
+ * costs a single page. Otherwise 2MB pages are used, in which case each
+ * 512GB costs 513 pages.
+ *
+ * Note: defined in bytes (defaults to 512GB)
+ */
+#ifndef EPT_IDENTITY_MAP_SIZE
+#define EPT_IDENTITY_MAP_SIZE (0x1ULL << 39)
 #endif
 
 /*
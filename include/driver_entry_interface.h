@@ -68,8 +68,13 @@ extern "C" {
 #define IOCTL_DUMP_VMM_CMD 0x807
 #define IOCTL_VMM_STATUS_CMD 0x808
 #define IOCTL_SET_VCPUID_CMD 0x809
+#define IOCTL_MEM_STATS_CMD 0x80A
+#define IOCTL_DIRTY_BITMAP_CMD 0x80B
+#define IOCTL_EXIT_STATS_CMD 0x80C
 
+#include <memory.h>
 #include <debug_ring_interface.h>
+#include <exit_stats_interface.h>
 
 /* -------------------------------------------------------------------------- */
 /* Linux Interfaces                                                           */
@@ -171,6 +176,33 @@ extern "C" {
  */
 #define IOCTL_SET_VCPUID _IOW(BAREFLANK_MAJOR, IOCTL_SET_VCPUID_CMD, uint64_t *)
 
+/**
+ * Memory Stats
+ *
+ * This IOCTL tells the driver entry to get the VMM's memory statistics.
+ * Note that the VMM must be loaded prior to calling this IOCTL using
+ * IOCTL_LOAD_VMM
+ */
+#define IOCTL_MEM_STATS _IOR(BAREFLANK_MAJOR, IOCTL_MEM_STATS_CMD, struct memory_stats *)
+
+/**
+ * Dirty Bitmap
+ *
+ * This IOCTL tells the driver entry to harvest the next window of the VMM's
+ * dirty bitmap. Note that the VMM must be running prior to calling this
+ * IOCTL using IOCTL_START_VMM
+ */
+#define IOCTL_DIRTY_BITMAP _IOR(BAREFLANK_MAJOR, IOCTL_DIRTY_BITMAP_CMD, struct dirty_bitmap *)
+
+/**
+ * Exit Stats
+ *
+ * This IOCTL tells the driver entry to get the exit statistics of the vCPU
+ * that was last set using IOCTL_SET_VCPUID. Note that the VMM must be
+ * loaded prior to calling this IOCTL using IOCTL_LOAD_VMM
+ */
+#define IOCTL_EXIT_STATS _IOR(BAREFLANK_MAJOR, IOCTL_EXIT_STATS_CMD, struct exit_stats *)
+
 #endif
 
 /* -------------------------------------------------------------------------- */
@@ -267,6 +299,33 @@ DEFINE_GUID(GUID_DEVINTERFACE_bareflank,
  */
 #define IOCTL_SET_VCPUID CTL_CODE(BAREFLANK_DEVICETYPE, IOCTL_SET_VCPUID_CMD, METHOD_IN_DIRECT, FILE_WRITE_DATA)
 
+/**
+ * Memory Stats
+ *
+ * This IOCTL tells the driver entry to get the VMM's memory statistics.
+ * Note that the VMM must be loaded prior to calling this IOCTL using
+ * IOCTL_LOAD_VMM
+ */
+#define IOCTL_MEM_STATS CTL_CODE(BAREFLANK_DEVICETYPE, IOCTL_MEM_STATS_CMD, METHOD_OUT_DIRECT, FILE_READ_DATA)
+
+/**
+ * Dirty Bitmap
+ *
+ * This IOCTL tells the driver entry to harvest the next window of the VMM's
+ * dirty bitmap. Note that the VMM must be running prior to calling this
+ * IOCTL using IOCTL_START_VMM
+ */
+#define IOCTL_DIRTY_BITMAP CTL_CODE(BAREFLANK_DEVICETYPE, IOCTL_DIRTY_BITMAP_CMD, METHOD_OUT_DIRECT, FILE_READ_DATA)
+
+/**
+ * Exit Stats
+ *
+ * This IOCTL tells the driver entry to get the exit statistics of the vCPU
+ * that was last set using IOCTL_SET_VCPUID. Note that the VMM must be
+ * loaded prior to calling this IOCTL using IOCTL_LOAD_VMM
+ */
+#define IOCTL_EXIT_STATS CTL_CODE(BAREFLANK_DEVICETYPE, IOCTL_EXIT_STATS_CMD, METHOD_OUT_DIRECT, FILE_READ_DATA)
+
 #endif
 
 /* -------------------------------------------------------------------------- */
@@ -292,6 +351,9 @@ typedef struct bf_ioctl
 #define IOCTL_DUMP_VMM IOCTL_DUMP_VMM_CMD
 #define IOCTL_VMM_STATUS IOCTL_VMM_STATUS_CMD
 #define IOCTL_SET_VCPUID IOCTL_SET_VCPUID_CMD
+#define IOCTL_MEM_STATS IOCTL_MEM_STATS_CMD
+#define IOCTL_DIRTY_BITMAP IOCTL_DIRTY_BITMAP_CMD
+#define IOCTL_EXIT_STATS IOCTL_EXIT_STATS_CMD
 
 #endif
 
@@ -81,6 +81,13 @@ typedef INT64 int64_t;
 #define GET_DRR_SUCCESS sign(SUCCESS)
 #define GET_DRR_FAILURE sign(0x8000000000010000)
 
+/* -------------------------------------------------------------------------- */
+/* Exit Statistics Error Codes                                                */
+/* -------------------------------------------------------------------------- */
+
+#define GET_EXIT_STATS_SUCCESS sign(SUCCESS)
+#define GET_EXIT_STATS_FAILURE sign(0x8000000000020000)
+
 /* -------------------------------------------------------------------------- */
 /* ELF Loader Error Codes                                                     */
 /* -------------------------------------------------------------------------- */
@@ -156,6 +163,8 @@ ec_to_str(int64_t value)
 
             EC_CASE(GET_DRR_FAILURE);
 
+            EC_CASE(GET_EXIT_STATS_FAILURE);
+
             EC_CASE(MEMORY_MANAGER_FAILURE);
 
             EC_CASE(BFELF_ERROR_INVALID_ARG);
@@ -0,0 +1,106 @@
+/*
+ * Bareflank Hypervisor
+ *
+ * Copyright (C) 2015 Assured Information Security, Inc.
+ * Author: Rian Quinn        <quinnr@ainfosec.com>
+ * Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#ifndef EXIT_STATS_INTERFACE_H
+#define EXIT_STATS_INTERFACE_H
+
+#if !defined(KERNEL) && !defined(_WIN32)
+#include <stdint.h>
+#else
+#include <types.h>
+#endif
+
+#include <constants.h>
+#include <error_codes.h>
+
+#pragma pack(push, 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Exit Statistics Reasons
+ *
+ * The number of (basic) exit reasons that statistics are kept for. Exits
+ * are counted by the basic exit reason, which is the index into the
+ * arrays below.
+ */
+#define EXIT_STATS_NUM_REASONS 65
+
+/**
+ * Exit Statistics Buckets
+ *
+ * The number of buckets in each latency histogram. Bucket i counts exits
+ * that were handled in [2^i, 2^(i + 1)) TSC ticks (bucket 0 also counts
+ * exits that took less than 1 tick), and the last bucket counts everything
+ * that took longer.
+ */
+#define EXIT_STATS_NUM_BUCKETS 32
+
+/**
+ * Exit Statistics
+ *
+ * Describes which exits a vCPU has taken since it was created, and how
+ * long the VMM spent handling them. The time is measured with the TSC from
+ * the start of the exit handler's dispatch, to just before the guest is
+ * resumed, so it does not include the VM exit / VM entry transitions
+ * themselves. Exits that are not resumed (e.g. an unimplemented exit) are
+ * not counted.
+ *
+ * @var exit_stats::vcpuid
+ *     the vCPU that these statistics belong to
+ * @var exit_stats::count
+ *     the number of exits, per exit reason
+ * @var exit_stats::ticks
+ *     the total number of TSC ticks spent handling exits, per exit reason
+ * @var exit_stats::histogram
+ *     the latency histogram (see EXIT_STATS_NUM_BUCKETS), per exit reason
+ */
+struct exit_stats
+{
+    uint64_t vcpuid;
+    uint64_t count[EXIT_STATS_NUM_REASONS];
+    uint64_t ticks[EXIT_STATS_NUM_REASONS];
+    uint64_t histogram[EXIT_STATS_NUM_REASONS][EXIT_STATS_NUM_BUCKETS];
+};
+
+/**
+ * Get Exit Statistics
+ *
+ * This is used by the driver entry to get a vCPU's exit statistics. The
+ * statistics are only ever written by the vCPU that owns them, and no lock
+ * is taken on the exit path, so this can be called while the VMM is running
+ * (the copy might be in the middle of an exit, so the counts of different
+ * exit reasons might be off by one from each other). Readers serialize on
+ * the lock that guards the registry of vCPUs.
+ */
+typedef int64_t (*get_exit_stats_t)(uint64_t vcpuid, struct exit_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#pragma pack(pop)
+
+#endif
@@ -77,6 +77,153 @@ struct memory_descriptor
  */
 typedef int64_t (*add_md_t)(struct memory_descriptor *md);
 
+/**
+ * Add Memory Descriptor List
+ *
+ * This is used by the driver entry to add a list of MDs to the VMM in a
+ * single call. Each call into the VMM has to resolve the entry point and
+ * switch stacks, so the driver entry should collect the memory descriptors
+ * for an entire module and add them all at once using this function instead
+ * of calling add_md for each page.
+ */
+typedef int64_t (*add_mdl_t)(struct memory_descriptor *mdl, int64_t num);
+
+/**
+ * Add Pool
+ *
+ * This is used by the driver entry to give the VMM more memory to allocate
+ * pages from. The list describes a virtually contiguous, writable chunk of
+ * memory, one MD per page, and must be added before the VMM is started.
+ */
+typedef int64_t (*add_pool_t)(struct memory_descriptor *mdl, int64_t num);
+
+/**
+ * Memory Statistics Size Classes
+ *
+ * The number of size classes used to count allocations and frees. Size
+ * class i counts allocations of at most (16 << i) bytes, and the last size
+ * class counts everything that is larger.
+ */
+#define MEMORY_STATS_NUM_CLASSES 16
+
+/**
+ * Memory Statistics
+ *
+ * Provides information about how the VMM is using it's memory, so that it
+ * is possible to tell how close the VMM is to running out of memory, and
+ * how fragmented the heap and page pools are. All sizes are in bytes.
+ *
+ * @var memory_stats::heap_size
+ *     the total size of the heap
+ * @var memory_stats::heap_in_use
+ *     the amount of the heap that is currently allocated (including
+ *     memory that is cached by the per-core magazines)
+ * @var memory_stats::heap_peak
+ *     the largest heap_in_use has ever been
+ * @var memory_stats::heap_largest_free
+ *     the largest allocation that the heap can currently satisfy
+ * @var memory_stats::page_pool_size
+ *     the total size of all of the page pools
+ * @var memory_stats::page_pool_in_use
+ *     the amount of the page pools that is currently allocated
+ * @var memory_stats::page_pool_peak
+ *     the largest page_pool_in_use has ever been
+ * @var memory_stats::page_pool_largest_free
+ *     the largest free block in any of the page pools
+ * @var memory_stats::num_page_pools
+ *     the number of page pools (including the one built into the VMM)
+ * @var memory_stats::failed_allocs
+ *     the number of allocations that could not be satisfied
+ * @var memory_stats::allocs
+ *     the number of allocations, per size class
+ * @var memory_stats::frees
+ *     the number of frees, per size class
+ */
+struct memory_stats
+{
+    uint64_t heap_size;
+    uint64_t heap_in_use;
+    uint64_t heap_peak;
+    uint64_t heap_largest_free;
+    uint64_t page_pool_size;
+    uint64_t page_pool_in_use;
+    uint64_t page_pool_peak;
+    uint64_t page_pool_largest_free;
+    uint64_t num_page_pools;
+    uint64_t failed_allocs;
+    uint64_t allocs[MEMORY_STATS_NUM_CLASSES];
+    uint64_t frees[MEMORY_STATS_NUM_CLASSES];
+};
+
+/**
+ * Get Memory Statistics
+ *
+ * This is used by the driver entry to get the VMM's memory statistics. This
+ * does not take any locks, so it can be called while the VMM is running.
+ */
+typedef int64_t (*get_memory_stats_t)(struct memory_stats *stats);
+
+/**
+ * Dirty Bitmap Size
+ *
+ * The number of 64bit words in each dirty bitmap. Each bit covers one
+ * granule of guest physical memory, so a single call covers
+ * (DIRTY_BITMAP_NUM_WORDS * 64 * granularity) bytes.
+ */
+#define DIRTY_BITMAP_NUM_WORDS 64
+
+/**
+ * Dirty Bitmap
+ *
+ * Describes which parts of a window of guest physical memory have been
+ * written to since the last time that window was harvested. Each call
+ * harvests the next window, wrapping back to 0 once the end of guest
+ * physical memory is reached, so that user space can sample all of memory
+ * with a number of small calls, none of which stall the guest for long.
+ *
+ * A CPU does not set the dirty flag of a page again while it still has a
+ * translation cached for it, so a harvest waits for each vCPU to flush its
+ * cached translations. The VMM cannot interrupt a vCPU though, so a vCPU
+ * that does not exit in time (e.g. an idle core) is not waited for, and
+ * the window is reported as approximate.
+ *
+ * @var dirty_bitmap::gpa
+ *     the guest physical address of the start of the window
+ * @var dirty_bitmap::size
+ *     the size of the window in bytes
+ * @var dirty_bitmap::total_size
+ *     the size of guest physical memory in bytes (the window after the
+ *     one that ends at total_size starts at 0)
+ * @var dirty_bitmap::granularity
+ *     the number of bytes covered by each bit
+ * @var dirty_bitmap::synchronized
+ *     1 if every vCPU flushed its cached translations before the harvest
+ *     returned, 0 if the window is approximate (writes that a vCPU makes
+ *     through translations it cached before the harvest might not be
+ *     reported by the next harvest of this window)
+ * @var dirty_bitmap::bitmap
+ *     bit i is set if [gpa + i * granularity, gpa + (i + 1) * granularity)
+ *     has been written to
+ */
+struct dirty_bitmap
+{
+    uint64_t gpa;
+    uint64_t size;
+    uint64_t total_size;
+    uint64_t granularity;
+    uint64_t synchronized;
+    uint64_t bitmap[DIRTY_BITMAP_NUM_WORDS];
+};
+
+/**
+ * Get Dirty Bitmap
+ *
+ * This is used by the driver entry to harvest the next window of the
+ * VMM's dirty bitmap. Harvesting clears the dirty flags that it reports,
+ * so each write is only ever reported once.
+ */
+typedef int64_t (*get_dirty_bitmap_t)(struct dirty_bitmap *bitmap);
+
 #ifdef __cplusplus
 }
 #endif